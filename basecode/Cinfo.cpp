@@ -558,6 +558,8 @@ const string& Cinfo::destFinfoName( FuncId fid ) const
 			return df->name();
 		}
 	}
+	if ( baseCinfo_ ) // Inherited DestFinfos are only on the base.
+		return baseCinfo_->destFinfoName( fid );
 	cout << "Error: Cinfo::destFinfoName( " << fid << " ): not found\n";
 	return err;
 }
@@ -100,6 +100,8 @@ void DataElement::resize( unsigned int newNumLocalData )
 					temp, numLocalData_, newNumLocalData, 0 );
 	cinfo()->dinfo()->destroyData( temp );
 	numLocalData_ = newNumLocalData;
+	// Anything that expanded messages to all entries must look again.
+	markRewired();
 }
 
 /////////////////////////////////////////////////////////////////////////
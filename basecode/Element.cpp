@@ -12,6 +12,8 @@
 #include "HopFunc.h"
 #include "../shell/Shell.h"
 
+unsigned int Element::rewireCount_ = 0;
+
 Element::Element( Id id, const Cinfo* c, const string& name )
 	:	name_( name ),
 		id_( id ),
@@ -19,6 +21,7 @@ Element::Element( Id id, const Cinfo* c, const string& name )
 		msgBinding_( c->numBindIndex() ),
 		msgDigest_( c->numBindIndex() ),
 		isRewired_( false ),
+		digestVersion_( 0 ),
 		isDoomed_( false )
 {
 	id.bindIdToElement( this );
@@ -395,6 +398,7 @@ unsigned int findNumDigest( const vector< vector< MsgDigest > > & md,
 void Element::digestMessages()
 {
 	bool report = 0; // for debugging
+	++digestVersion_;
 	msgDigest_.clear();
 	msgDigest_.resize( msgBinding_.size() * numData() );
 	vector< bool > temp( Shell::numNodes(), false );
@@ -520,6 +524,17 @@ bool Element::isDoomed() const
 void Element::markRewired()
 {
 	isRewired_ = true;
+	++rewireCount_;
+}
+
+unsigned int Element::getDigestVersion() const
+{
+	return digestVersion_;
+}
+
+unsigned int Element::getRewireCount()
+{
+	return rewireCount_;
 }
 
 void Element::printMsgDigest( unsigned int srcIndex, unsigned int dataId ) const
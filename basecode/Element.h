@@ -235,6 +235,19 @@ class Element
 		 */
 		void markRewired();
 
+		/**
+		 * Returns a count of the times the messages have been digested,
+		 * so that anything that caches the digest can tell it is stale.
+		 */
+		unsigned int getDigestVersion() const;
+
+		/**
+		 * Returns a count that goes up whenever any Element is marked
+		 * as rewired, so that a cache built from the messages of many
+		 * Elements can tell it is stale.
+		 */
+		static unsigned int getRewireCount();
+
 		/**
 		 * Utility function for debugging
 		 */
@@ -380,6 +393,12 @@ class Element
 		/// True if messages have been changed and need to digestMessages.
 		bool isRewired_; 
 
+		/// Incremented by digestMessages.
+		unsigned int digestVersion_;
+
+		/// Incremented by markRewired on any Element.
+		static unsigned int rewireCount_;
+
 		/// True if the element is marked for destruction.
 		bool isDoomed_;
 };
@@ -61,6 +61,8 @@ template < class A > class HopFunc1: public OpFunc1Base< A >
 					const OpFunc1Base< A >* op,
 					unsigned int k ) const
 		{
+			if ( !elm->hasFields() )
+				return op->opLocalVec( elm, arg, k );
 			unsigned int numLocalData = elm->numLocalData();
 			unsigned int start = elm->localDataStart();
 			for ( unsigned int p = 0; p < numLocalData; ++p ) {
@@ -444,12 +446,7 @@ template < class A > class GetHopFunc: public OpFunc1Base< A* >
 		void getLocalVec( Element *elm, vector< A >& ret, 
 				 const GetOpFuncBase< A >* op ) const
 		{
-			unsigned int start = elm->localDataStart();
-			unsigned int end = start + elm->numLocalData();
-			for ( unsigned int p = start; p < end; ++p ) {
-				Eref er( elm, p, 0 );
-				ret.push_back( op->returnOp( er ) );
-			}
+			op->returnOpLocalVec( elm, ret );
 		}
 
 		void getMultiNodeVec( const Eref& e, vector< A >& ret, 
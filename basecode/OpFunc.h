@@ -33,6 +33,19 @@ template< class T, class A > class OpFunc1: public OpFunc1Base<A>
 		void op( const Eref& e, A arg ) const {
 			(reinterpret_cast< T* >( e.data() )->*func_)( arg );
 		}
+
+		/// Skips the Eref and the virtual op for each entry.
+		unsigned int opLocalVec( Element* elm,
+			const vector< A >& arg, unsigned int k ) const
+		{
+			unsigned int n = elm->numLocalData();
+			for ( unsigned int p = 0; p < n; ++p ) {
+				T* obj = reinterpret_cast< T* >( elm->data( p ) );
+				(obj->*func_)( arg[ k % arg.size() ] );
+				k++;
+			}
+			return k;
+		}
 	private:
 		void ( T::*func_ )( A ); 
 };
@@ -176,6 +189,17 @@ template< class T, class A > class GetOpFunc: public GetOpFuncBase< A >
 			return ( reinterpret_cast< T* >( e.data() )->*func_)();
 		}
 
+		/// Skips the Eref and the virtual returnOp for each entry.
+		void returnOpLocalVec( Element* elm, vector< A >& ret ) const {
+			unsigned int n = elm->numLocalData();
+			ret.reserve( ret.size() + n );
+			for ( unsigned int p = 0; p < n; ++p ) {
+				const T* obj = 
+					reinterpret_cast< const T* >( elm->data( p ) );
+				ret.push_back( ( obj->*func_ )() );
+			}
+		}
+
 	private:
 		A ( T::*func_ )() const;
 };
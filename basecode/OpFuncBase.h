@@ -135,6 +135,25 @@ template< class A > class OpFunc1Base: public OpFunc
 						const OpFunc1Base< A >* op ) const
 	   	{ ; } // overridden in HopFuncs.
 
+		/**
+		 * Assigns all the data entries on this node from arg, starting
+		 * at index k of arg and wrapping around. Returns the next
+		 * index. Used for vector sets on Elements without fields.
+		 * OpFunc1 overrides this to call the object directly.
+		 */
+		virtual unsigned int opLocalVec( Element* elm,
+			const vector< A >& arg, unsigned int k ) const
+		{
+			unsigned int start = elm->localDataStart();
+			unsigned int end = start + elm->numLocalData();
+			for ( unsigned int p = start; p < end; ++p ) {
+				Eref er( elm, p, 0 );
+				op( er, arg[ k % arg.size() ] );
+				k++;
+			}
+			return k;
+		}
+
 		string rttiType() const {
 			return Conv< A >::rttiType();
 		}
@@ -315,6 +334,22 @@ template< class A > class GetOpFuncBase: public OpFunc1Base< A* >
 
 		virtual A returnOp( const Eref& e ) const = 0;
 
+		/**
+		 * Appends the values of all the data entries on this node to
+		 * ret. Used for vector gets on Elements without fields.
+		 * GetOpFunc overrides this to call the objects directly.
+		 */
+		virtual void returnOpLocalVec( Element* elm, vector< A >& ret ) 
+			const
+		{
+			unsigned int start = elm->localDataStart();
+			unsigned int end = start + elm->numLocalData();
+			for ( unsigned int p = start; p < end; ++p ) {
+				Eref er( elm, p, 0 );
+				ret.push_back( returnOp( er ) );
+			}
+		}
+
 		// This returns an OpFunc1< A* > so we can pass back the arg A
 		const OpFunc* makeHopFunc( HopIndex hopIndex) const;
 
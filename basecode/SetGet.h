@@ -217,6 +217,39 @@ template< class A > class SetGet1: public SetGet
 			return setVec( destId, field, temp );
 		}
 
+		/**
+		 * Assigns arg[i] to dest[i], for a column of values going to
+		 * many separate objects, such as all the pools read in by a
+		 * model loader. The field is looked up once for each class
+		 * rather than once for each object, and objects on this node
+		 * are called directly. Global objects, which have a copy on
+		 * every node, and objects on other nodes go through set.
+		 */
+		static bool setMany( const vector< ObjId >& dest,
+			const string& field, const vector< A >& arg )
+		{
+			assert( dest.size() == arg.size() );
+			const Cinfo* cinfo = 0;
+			const OpFunc1Base< A >* op = 0;
+			bool ret = true;
+			for ( unsigned int i = 0; i < dest.size(); ++i ) {
+				const Cinfo* c = dest[i].element()->cinfo();
+				if ( c != cinfo ) {
+					cinfo = c;
+					const DestFinfo* df = dynamic_cast< const DestFinfo* >(
+						c->findFinfo( field ) );
+					op = df ? dynamic_cast< const OpFunc1Base< A >* >( 
+						df->getOpFunc() ) : 0;
+				}
+				if ( op && !dest[i].isOffNode() &&
+					!dest[i].element()->isGlobal() )
+					op->op( dest[i].eref(), arg[i] );
+				else
+					ret &= set( dest[i], field, arg[i] );
+			}
+			return ret;
+		}
+
 		/**
 		 * Blocking call using string conversion
 		 */
@@ -265,6 +298,14 @@ template< class A > class Field: public SetGet1< A >
 			return SetGet1< A >::setRepeat( destId, temp, arg );
 		}
 
+		static bool setMany( const vector< ObjId >& dest, 
+			const string& field, const vector< A >& arg )
+		{
+			string temp = "set" + field;
+			temp[3] = toupper( temp[3] );
+			return SetGet1< A >::setMany( dest, temp, arg );
+		}
+
 		/**
 		 * Blocking call using string conversion
 		 */
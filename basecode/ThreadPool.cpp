@@ -0,0 +1,188 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include <vector>
+#include <iostream>
+#include <cassert>
+using namespace std;
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool()
+	:
+		job_( 0 ),
+		generation_( 0 ),
+		pending_( 0 ),
+		quit_( false )
+{
+	pthread_mutex_init( &mutex_, 0 );
+	pthread_cond_init( &startCond_, 0 );
+	pthread_cond_init( &doneCond_, 0 );
+}
+
+ThreadPool::ThreadPool( const ThreadPool& other )
+	:
+		job_( 0 ),
+		generation_( 0 ),
+		pending_( 0 ),
+		quit_( false )
+{
+	pthread_mutex_init( &mutex_, 0 );
+	pthread_cond_init( &startCond_, 0 );
+	pthread_cond_init( &doneCond_, 0 );
+	setNumThreads( other.getNumThreads() );
+}
+
+ThreadPool& ThreadPool::operator=( const ThreadPool& other )
+{
+	if ( this != &other )
+		setNumThreads( other.getNumThreads() );
+	return *this;
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+	pthread_cond_destroy( &doneCond_ );
+	pthread_cond_destroy( &startCond_ );
+	pthread_mutex_destroy( &mutex_ );
+}
+
+//////////////////////////////////////////////////////////////
+// Field access
+//////////////////////////////////////////////////////////////
+
+void ThreadPool::setNumThreads( unsigned int num )
+{
+	if ( num == 0 )
+		num = 1;
+	if ( num == getNumThreads() )
+		return;
+	stopWorkers();
+	startWorkers( num );
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+	return workers_.size() + 1;
+}
+
+//////////////////////////////////////////////////////////////
+// Thread management
+//////////////////////////////////////////////////////////////
+
+void ThreadPool::startWorkers( unsigned int num )
+{
+	assert( workers_.size() == 0 );
+	quit_ = false;
+	// Must size workerInfo_ before creating threads, as each thread
+	// holds a pointer into it.
+	workerInfo_.resize( num - 1 );
+	workers_.resize( num - 1 );
+	for ( unsigned int i = 0; i < num - 1; ++i ) {
+		workerInfo_[i].pool = this;
+		workerInfo_[i].threadIndex = i + 1;
+		workerInfo_[i].startGeneration = generation_;
+		int ret = pthread_create( &workers_[i], 0, 
+			&ThreadPool::workerLoop, &workerInfo_[i] );
+		if ( ret != 0 ) {
+			cout << "Warning: ThreadPool::startWorkers: could only start "
+				<< i + 1 << " of " << num << " threads\n";
+			workers_.resize( i );
+			workerInfo_.resize( i );
+			break;
+		}
+	}
+}
+
+void ThreadPool::stopWorkers()
+{
+	if ( workers_.size() == 0 )
+		return;
+	pthread_mutex_lock( &mutex_ );
+	quit_ = true;
+	pthread_cond_broadcast( &startCond_ );
+	pthread_mutex_unlock( &mutex_ );
+	for ( unsigned int i = 0; i < workers_.size(); ++i )
+		pthread_join( workers_[i], 0 );
+	workers_.clear();
+	workerInfo_.clear();
+	quit_ = false;
+}
+
+void* ThreadPool::workerLoop( void* info )
+{
+	WorkerInfo* wi = reinterpret_cast< WorkerInfo* >( info );
+	ThreadPool* tp = wi->pool;
+	// Start from the generation at creation time, not the current one,
+	// so that a job dispatched before this thread first runs is not lost.
+	unsigned long lastGeneration = wi->startGeneration;
+	pthread_mutex_lock( &tp->mutex_ );
+	while ( 1 ) {
+		while ( !tp->quit_ && tp->generation_ == lastGeneration )
+			pthread_cond_wait( &tp->startCond_, &tp->mutex_ );
+		if ( tp->quit_ )
+			break;
+		lastGeneration = tp->generation_;
+		ThreadJob* job = tp->job_;
+		unsigned int numThreads = tp->workers_.size() + 1;
+		pthread_mutex_unlock( &tp->mutex_ );
+
+		job->runThread( wi->threadIndex, numThreads );
+
+		pthread_mutex_lock( &tp->mutex_ );
+		if ( --tp->pending_ == 0 )
+			pthread_cond_signal( &tp->doneCond_ );
+	}
+	pthread_mutex_unlock( &tp->mutex_ );
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////
+// Job dispatch
+//////////////////////////////////////////////////////////////
+
+void ThreadPool::run( ThreadJob* job )
+{
+	unsigned int numThreads = getNumThreads();
+	if ( numThreads == 1 ) {
+		job->runThread( 0, 1 );
+		return;
+	}
+	pthread_mutex_lock( &mutex_ );
+	job_ = job;
+	pending_ = numThreads - 1;
+	++generation_;
+	pthread_cond_broadcast( &startCond_ );
+	pthread_mutex_unlock( &mutex_ );
+
+	job->runThread( 0, numThreads );
+
+	pthread_mutex_lock( &mutex_ );
+	while ( pending_ > 0 )
+		pthread_cond_wait( &doneCond_, &mutex_ );
+	job_ = 0;
+	pthread_mutex_unlock( &mutex_ );
+}
+
+void ThreadPool::partition( unsigned int num, unsigned int threadIndex,
+	unsigned int numThreads, unsigned int& begin, unsigned int& end )
+{
+	assert( threadIndex < numThreads );
+	unsigned int blockSize = num / numThreads;
+	unsigned int remainder = num % numThreads;
+	// The first 'remainder' threads each take one extra entry.
+	if ( threadIndex < remainder ) {
+		begin = threadIndex * ( blockSize + 1 );
+		end = begin + blockSize + 1;
+	} else {
+		begin = remainder * ( blockSize + 1 ) + 
+			( threadIndex - remainder ) * blockSize;
+		end = begin + blockSize;
+	}
+}
@@ -0,0 +1,106 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <pthread.h>
+
+/**
+ * Base class for work handed to a ThreadPool. The pool calls
+ * runThread once on every thread, with the index of the thread and
+ * the total number of threads. The derived class decides how to split
+ * its work, usually by means of ThreadPool::partition.
+ */
+class ThreadJob
+{
+	public:
+		ThreadJob() {;}
+		virtual ~ThreadJob() {;}
+		virtual void runThread( unsigned int threadIndex,
+				unsigned int numThreads ) = 0;
+};
+
+/**
+ * Persistent set of worker threads. The workers are created once
+ * and sleep between calls to run(), so that solvers can hand off each
+ * timestep without paying for thread creation.
+ * The calling thread always does partition 0 itself, so a pool with
+ * numThreads = 1 spawns no threads at all and runs entirely serially.
+ * The run() call returns only after every thread has finished, so
+ * it acts as a barrier between successive timesteps.
+ */
+class ThreadPool
+{
+	public:
+		ThreadPool();
+		/**
+		 * Copies only the number of threads. The copy starts its own
+		 * workers. Needed because Dinfo copies objects by assignment.
+		 */
+		ThreadPool( const ThreadPool& other );
+		ThreadPool& operator=( const ThreadPool& other );
+		~ThreadPool();
+
+		/**
+		 * Assigns the number of threads, including the calling thread.
+		 * Zero is treated as one. Must not be called while run() is
+		 * in progress.
+		 */
+		void setNumThreads( unsigned int num );
+		unsigned int getNumThreads() const;
+
+		/**
+		 * Runs job->runThread( i, numThreads ) on each thread i, and
+		 * blocks until all have returned.
+		 */
+		void run( ThreadJob* job );
+
+		/**
+		 * Utility function to split num entries into numThreads
+		 * contiguous blocks of nearly equal size. Returns the range
+		 * [begin, end) for the specified thread.
+		 */
+		static void partition( unsigned int num, unsigned int threadIndex,
+			unsigned int numThreads,
+			unsigned int& begin, unsigned int& end );
+
+	private:
+		/// Starts worker threads 1 to numThreads - 1.
+		void startWorkers( unsigned int num );
+		/// Tells all worker threads to quit, and joins them.
+		void stopWorkers();
+		/// Entry point for each worker thread.
+		static void* workerLoop( void* info );
+
+		/// Argument passed to each worker thread.
+		struct WorkerInfo {
+			ThreadPool* pool;
+			unsigned int threadIndex;
+			/// Value of generation_ when the thread was started.
+			unsigned long startGeneration;
+		};
+
+		vector< pthread_t > workers_;
+		vector< WorkerInfo > workerInfo_;
+		/// Current job. Valid only while run() is in progress.
+		ThreadJob* job_;
+		/// Incremented each time run() dispatches a job.
+		unsigned long generation_;
+		/// Number of worker threads yet to finish the current job.
+		unsigned int pending_;
+		bool quit_;
+		pthread_mutex_t mutex_;
+		/// Workers wait on this for a new generation.
+		pthread_cond_t startCond_;
+		/// run() waits on this for pending_ to go to zero.
+		pthread_cond_t doneCond_;
+};
+
+#endif // _THREAD_POOL_H
@@ -54,7 +54,7 @@ extern void testKsolveProcess();
 extern void testBiophysics();
 extern void testBiophysicsProcess();
 extern void testDiffusion();
-// extern void testHSolve();
+extern void testHSolve();
 // extern void testKineticsProcess();
 // extern void testGeom();
 extern void testMesh();
@@ -74,7 +74,8 @@ extern void speedTestMultiNodeIntFireNetwork(
 #endif
 // bool benchmarkTests( int argc, char** argv );
 
-extern void mooseBenchmarks( unsigned int option );
+extern void mooseBenchmarks( const string& option );
+extern void setBenchmarkReport( const string& fileName );
 
 //////////////////////////////////////////////////////////////////
 // System-dependent function here
@@ -137,14 +138,14 @@ void checkChildren( Id parent, const string& info )
 }
 
 Id init( int argc, char** argv, bool& doUnitTests, bool& doRegressionTests,
-	  unsigned int& benchmark )
+	  string& benchmark )
 {
 	unsigned int numCores = getNumCores();
 	int numNodes = 1;
 	int myNode = 0;
 	bool isInfinite = 0;
 	int opt;
-	benchmark = 0; // Default, means don't do any benchmarks.
+	benchmark = ""; // Default, means don't do any benchmarks.
 	Cinfo::rebuildOpIndex();
 #ifdef USE_MPI
 	/*
@@ -176,10 +177,11 @@ Id init( int argc, char** argv, bool& doUnitTests, bool& doRegressionTests,
 			case 'n': // Multiple nodes
 			  numNodes = (unsigned int)atoi( optarg );
 				break;
-			case 'b': // Benchmark:
-				benchmark = atoi( optarg );
+			case 'b': // Benchmark: names of cases, see mooseBenchmarks.
+				benchmark = optarg;
 				break;
-			case 'B': // Benchmark plus dump data: handle later.
+			case 'B': // Benchmark plus dump data to a JSON or CSV file.
+				setBenchmarkReport( optarg );
 				break;
 			case 'u': // Do unit tests, pass back.
 				doUnitTests = 1;
@@ -192,7 +194,7 @@ Id init( int argc, char** argv, bool& doUnitTests, bool& doRegressionTests,
 				break;
 			case 'h': // help
 			default:
-				cout << "Usage: moose -help -infiniteLoop -unit_tests -regression_tests -quit -n numNodes -benchmark [ksolve intFire hhNet msg_<msgType>_<size>]\n";
+				cout << "Usage: moose -help -infiniteLoop -unit_tests -regression_tests -quit -n numNodes -benchmark [list all name[:param],...] -Benchmark_report file.[json|csv]\n";
 
 				exit( 1 );
 		}
@@ -278,7 +280,7 @@ void nonMpiTests( Shell* s )
 		testKsolveProcess();
 		testBiophysics();
 		testDiffusion();
-		// testHSolve();
+		testHSolve();
 		// testGeom();
 		testMesh();
 		// testSigNeur();
@@ -329,7 +331,7 @@ int main( int argc, char** argv )
 {
 	bool doUnitTests = 0;
 	bool doRegressionTests = 0;
-	unsigned int benchmark = 0;
+	string benchmark = "";
 	// This reorders the OpFunc to Fid mapping to ensure it is node and
 	// compiler independent.
 	Id shellId = init( argc, argv, doUnitTests, doRegressionTests, benchmark );
@@ -345,7 +347,7 @@ int main( int argc, char** argv )
 			// Use the last clock for the postmaster, so that it is called
 			// after everything else has been processed and all messages
 			// are ready to send out.
-			s->doUseClock( "/postmaster", "process", 9 );
+			s->doUseClock( "/postmaster", "proc", 9 );
 			s->doSetClock( 9, 1.0 ); // Use a sensible default.
 		}
 #ifdef DO_UNIT_TESTS
@@ -358,7 +360,7 @@ int main( int argc, char** argv )
 		// These are outside unit tests because they happen in optimized
 		// mode, using a command-line argument. As soon as they are done
 		// the system quits, in order to estimate timing.
-		if ( benchmark != 0 ) {
+		if ( benchmark != "" ) {
 			mooseBenchmarks( benchmark );
 			s->doQuit();
 		} else {
@@ -17,6 +17,7 @@
 #include "../biophysics/SpikeRingBuffer.h"
 #include "../biophysics/Synapse.h"
 #include "../biophysics/SynHandler.h"
+#include "../biophysics/SpikeRouter.h"
 #include "../biophysics/IntFire.h"
 #include "SparseMatrix.h"
 #include "SparseMsg.h"
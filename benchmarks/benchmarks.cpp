@@ -7,20 +7,285 @@
 ** See the file COPYING.LIB for the full notice.
 **********************************************************************/
 
-#include <iostream>
-using namespace std;
-
-void runKineticsBenchmark1();
-void mooseBenchmarks( unsigned int option )
-{
-	switch ( option ) {
-		case 1:
-			cout << "Kinetics benchmark 1: small model, Exp Euler, 10Ksec, OSC_Cspace.g\n";
-			runKineticsBenchmark1();
-			break;
-		case 2:
-		default:
-			cout << "Unknown benchmark specified, quitting\n";
-			break;
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fstream>
+#include "header.h"
+#include "../shell/Shell.h"
+#include "benchmarks.h"
+
+void runKineticsBenchmark1( unsigned int runtime );
+void runGsolveScalingBenchmark( unsigned int numVoxels );
+void runModelLoadBenchmark( unsigned int numPools );
+void runKsolveBenchmark( unsigned int numVoxels );
+void runGsolveBenchmark( unsigned int numVoxels );
+void runDsolveBenchmark( unsigned int numVoxels );
+void runMeshSetupBenchmark( unsigned int numSegs );
+void runFuncBulkBenchmark( unsigned int numFuncs );
+void runEnsembleBenchmark( unsigned int numReplicas );
+void runMsgFanoutBenchmark( unsigned int numTargets );
+void runHHCableBenchmark( unsigned int numCompts );
+void runHSolveCableBenchmark( unsigned int numCompts );
+void runIntFireBenchmark( unsigned int numNeurons );
+void runHDF5Benchmark( unsigned int numTables );
+
+namespace {
+	typedef void ( *BenchmarkFunc )( unsigned int param );
+
+	class BenchmarkCase
+	{
+		public:
+			const char* name;
+			unsigned int defaultParam;
+			BenchmarkFunc func;
+			const char* doc;
+	};
+
+	/**
+	 * The first three are also run by -b 1, 2 and 3, their numbers
+	 * before the cases had names.
+	 */
+	const BenchmarkCase benchmarkCases[] = {
+		{ "kinetics1", 10000, runKineticsBenchmark1,
+			"small model, Exp Euler, OSC_Cspace.g; param is the run time" },
+		{ "gsolveThreads", 10000, runGsolveScalingBenchmark,
+			"Gsolve on param voxels of a CubeMesh, 1 to 16 threads" },
+		{ "modelLoad", 20000, runModelLoadBenchmark,
+			"param pools made one at a time and in bulk, then the Demos "
+			"kkit models; steps are the objects made" },
+		{ "ksolve", 1000, runKsolveBenchmark,
+			"Ksolve on param voxels of a CubeMesh" },
+		{ "gsolve", 1000, runGsolveBenchmark,
+			"Gsolve on param voxels of a CubeMesh, 1 thread" },
+		{ "dsolve", 1000, runDsolveBenchmark,
+			"Dsolve on a branched NeuroMesh of about param voxels" },
+		{ "meshSetup", 4095, runMeshSetupBenchmark,
+			"NeuroMesh of param branches: building it, nearest, and its "
+			"junctions with a CubeMesh" },
+		{ "funcBulk", 10000, runFuncBulkBenchmark,
+			"param Funcs with the same expression, evaluated one at a time "
+			"and in bulk; steps are the evaluations" },
+		{ "ensemble", 200, runEnsembleBenchmark,
+			"param replicas of the ksolve model with different rates, as "
+			"separate models and in one solver; steps are the replicas" },
+		{ "msgFanout", 10000, runMsgFanoutBenchmark,
+			"one Arith sending to param targets; steps are the messages "
+			"delivered" },
+		{ "hhCable", 100, runHHCableBenchmark,
+			"cable of param Compartments with Na and K HHChannels" },
+		{ "hsolveCable", 100, runHSolveCableBenchmark,
+			"the hhCable model in the HSolve" },
+		{ "intFire", 1024, runIntFireBenchmark,
+			"param IntFires with 10% random connectivity over a SparseMsg"},
+		{ "hdf5", 100, runHDF5Benchmark,
+			"HDF5DataWriter saving param tables, as separate datasets and "
+			"as a population; steps are the samples written" },
+	};
+	const unsigned int numBenchmarkCases =
+		sizeof( benchmarkCases ) / sizeof( BenchmarkCase );
+
+	class BenchmarkResult
+	{
+		public:
+			string name;
+			unsigned int param;
+			string label;
+			double wallTime;
+			double steps;
+			/// Peak RSS of the whole process so far, in kB.
+			long maxRss;
+			/// Growth of maxRss since the start of this case, in kB.
+			long rssGrowth;
+	};
+
+	const BenchmarkCase* currentCase = 0;
+	unsigned int currentParam = 0;
+	long caseStartRss = 0;
+	vector< BenchmarkResult > benchmarkResults;
+	string benchmarkReportFile;
+}
+
+static long maxRss()
+{
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss;
+}
+
+double benchmarkWallTime()
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+void addBenchmarkResult( const string& label, double wallTime, double steps )
+{
+	assert( currentCase );
+	BenchmarkResult r;
+	r.name = currentCase->name;
+	r.param = currentParam;
+	r.label = label;
+	r.wallTime = wallTime;
+	r.steps = steps;
+	r.maxRss = maxRss();
+	r.rssGrowth = r.maxRss - caseStartRss;
+	benchmarkResults.push_back( r );
+
+	cout << r.name << ":" << r.param;
+	if ( label != "" )
+		cout << " " << label;
+	cout << ": " << wallTime << " sec, " << steps << " steps, " <<
+		( wallTime > 0 ? steps / wallTime : 0 ) << " steps/sec, process peak RSS "
+		<< r.maxRss << " kB, grown " << r.rssGrowth << " kB in this case\n";
+}
+
+void runBenchmarkSimulation( const string& label, double runtime,
+	unsigned int tick )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	vector< double > dts = Field< vector< double > >::get( ObjId( 1 ), "dts" );
+	assert( tick < dts.size() && dts[ tick ] > 0.0 );
+	double t0 = benchmarkWallTime();
+	s->doStart( runtime );
+	addBenchmarkResult( label, benchmarkWallTime() - t0,
+		round( runtime / dts[ tick ] ) );
+}
+
+/**
+ * Sets the file to which mooseBenchmarks writes the results, as CSV if
+ * the name ends in .csv and as JSON otherwise.
+ */
+void setBenchmarkReport( const string& fileName )
+{
+	benchmarkReportFile = fileName;
+}
+
+static string jsonString( const string& s )
+{
+	string ret = "\"";
+	for ( string::const_iterator i = s.begin(); i != s.end(); ++i ) {
+		if ( *i == '"' || *i == '\\' )
+			ret += '\\';
+		ret += *i;
+	}
+	return ret + "\"";
+}
+
+static string csvString( const string& s )
+{
+	string ret = "\"";
+	for ( string::const_iterator i = s.begin(); i != s.end(); ++i ) {
+		if ( *i == '"' )
+			ret += '"';
+		ret += *i;
+	}
+	return ret + "\"";
+}
+
+static void writeBenchmarkReport( const string& fileName )
+{
+	ofstream fout( fileName.c_str() );
+	if ( !fout ) {
+		cout << "Warning: mooseBenchmarks: could not open '" << fileName
+			<< "' for the report\n";
+		return;
+	}
+	fout.precision( 10 );
+	bool isCsv = fileName.length() > 4 &&
+		fileName.substr( fileName.length() - 4 ) == ".csv";
+	if ( isCsv ) {
+		fout << "name,param,label,wallTime,steps,stepsPerSec,"
+			"processMaxRssKb,caseRssGrowthKb\n";
+		for ( unsigned int i = 0; i < benchmarkResults.size(); ++i ) {
+			const BenchmarkResult& r = benchmarkResults[i];
+			fout << csvString( r.name ) << "," << r.param << "," <<
+				csvString( r.label ) << "," <<
+				r.wallTime << "," << r.steps << "," <<
+				( r.wallTime > 0 ? r.steps / r.wallTime : 0 ) << "," <<
+				r.maxRss << "," << r.rssGrowth << "\n";
+		}
+		return;
+	}
+	fout << "{\n\"numNodes\": " << Shell::numNodes() <<
+		",\n\"numCores\": " << Shell::numCores() <<
+		",\n\"benchmarks\": [\n";
+	for ( unsigned int i = 0; i < benchmarkResults.size(); ++i ) {
+		const BenchmarkResult& r = benchmarkResults[i];
+		fout << "\t{ \"name\": " << jsonString( r.name ) <<
+			", \"param\": " << r.param <<
+			", \"label\": " << jsonString( r.label ) <<
+			", \"wallTime\": " << r.wallTime <<
+			", \"steps\": " << r.steps <<
+			", \"stepsPerSec\": " <<
+			( r.wallTime > 0 ? r.steps / r.wallTime : 0 ) <<
+			", \"processMaxRssKb\": " << r.maxRss <<
+			", \"caseRssGrowthKb\": " << r.rssGrowth << " }" <<
+			( i + 1 < benchmarkResults.size() ? ",\n" : "\n" );
+	}
+	fout << "]\n}\n";
+}
+
+static const BenchmarkCase* findBenchmarkCase( const string& name )
+{
+	unsigned int num = atoi( name.c_str() );
+	if ( num > 0 && num <= 3 )
+		return &benchmarkCases[ num - 1 ];
+	for ( unsigned int i = 0; i < numBenchmarkCases; ++i )
+		if ( name == benchmarkCases[i].name )
+			return &benchmarkCases[i];
+	return 0;
+}
+
+static void listBenchmarkCases()
+{
+	cout << "Benchmarks, run as -b name[:param][,name[:param]...] or -b all,"
+		" with -B file.json or -B file.csv to save the results:\n";
+	for ( unsigned int i = 0; i < numBenchmarkCases; ++i )
+		cout << "\t" << benchmarkCases[i].name << " (param " <<
+			benchmarkCases[i].defaultParam << "): " <<
+			benchmarkCases[i].doc << "\n";
+}
+
+/**
+ * Runs the benchmarks named in option, which is a comma-separated list
+ * of cases, each with an optional parameter after a colon, such as
+ * "intFire:4096,ksolve". "all" runs every case with its default
+ * parameter, and "list" describes them.
+ */
+void mooseBenchmarks( const string& option )
+{
+	vector< string > items;
+	if ( option == "all" ) {
+		for ( unsigned int i = 0; i < numBenchmarkCases; ++i )
+			items.push_back( benchmarkCases[i].name );
+	} else {
+		Shell::chopString( option, items, ',' );
+	}
+	if ( option == "list" || items.size() == 0 ) {
+		listBenchmarkCases();
+		return;
+	}
+
+	benchmarkResults.clear();
+	for ( unsigned int i = 0; i < items.size(); ++i ) {
+		string::size_type pos = items[i].find( ':' );
+		const BenchmarkCase* bc = findBenchmarkCase(
+			items[i].substr( 0, pos ) );
+		if ( !bc ) {
+			cout << "Unknown benchmark '" << items[i] << "', quitting\n";
+			listBenchmarkCases();
+			return;
+		}
+		currentCase = bc;
+		currentParam = bc->defaultParam;
+		if ( pos != string::npos )
+			currentParam = atoi( items[i].c_str() + pos + 1 );
+		cout << bc->name << ":" << currentParam << ": " << bc->doc << endl;
+		caseStartRss = maxRss();
+		bc->func( currentParam );
 	}
+	currentCase = 0;
+	if ( benchmarkReportFile != "" )
+		writeBenchmarkReport( benchmarkReportFile );
 }
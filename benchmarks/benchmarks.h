@@ -0,0 +1,33 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _BENCHMARKS_H
+#define _BENCHMARKS_H
+
+/// Returns wall-clock time in seconds.
+extern double benchmarkWallTime();
+
+/**
+ * Records one timed run of the benchmark case being run, for the
+ * report. The label tells apart the runs within a case, such as the
+ * thread counts or the model files, and may be empty. Steps is the
+ * number of simulation steps, or of whatever else the case counts,
+ * done in the wallTime.
+ */
+extern void addBenchmarkResult( const string& label, double wallTime,
+	double steps );
+
+/**
+ * Runs the simulation for runtime and records the result, counting the
+ * steps of the given clock tick.
+ */
+extern void runBenchmarkSimulation( const string& label, double runtime,
+	unsigned int tick );
+
+#endif // _BENCHMARKS_H
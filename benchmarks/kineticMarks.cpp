@@ -9,14 +9,412 @@
 
 #include "header.h"
 #include "../shell/Shell.h"
+#include "../shell/Wildcard.h"
+#include "SparseMatrix.h"
+#include "../mesh/VoxelJunction.h"
+#include "../mesh/Boundary.h"
+#include "../mesh/MeshEntry.h"
+#include "../mesh/ChemCompt.h"
+#include "../mesh/MeshCompt.h"
+#include "../mesh/CubeMesh.h"
+#include "../mesh/CylBase.h"
+#include "../mesh/NeuroNode.h"
+#include "../mesh/BoxTree.h"
+#include "../mesh/NeuroMesh.h"
+#include "benchmarks.h"
 
 /// Small model, long runtime.
-void runKineticsBenchmark1()
+void runKineticsBenchmark1( unsigned int runtime )
 {
 	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
-	Id mgr = s->doLoadModel( "../Demos/Genesis_files/OSC_Cspace.g", "/model", "Neutral" );
+	Id mgr = s->doLoadModel( "Demos/Genesis_files/OSC_Cspace.g", "/model", "Neutral" );
 	assert( mgr != Id() );
 	s->doReinit();
-	s->doStart( 10000.0 );
+	runBenchmarkSimulation( "", runtime, 4 );
+	s->doDelete( mgr );
 }
 
+/**
+ * Makes a reaction system on a CubeMesh of numVoxels voxels in a row,
+ * each 1 um cubed, and puts it in a solver of the given class.
+ * The pools are defined once, and the solver makes a copy of the
+ * reaction system for each voxel of the mesh.
+ * A <===> B
+ * B + B <===> C
+ * C ---enz---> D, D ---> A
+ */
+static Id makeCubeModel( const string& solverClass, unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+
+	Id kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	vector< double > coords( 9, 1e-6 );
+	coords[0] = coords[1] = coords[2] = 0.0;
+	coords[3] = numVoxels * 1e-6;
+	Field< vector< double > >::set( kin, "coords", coords );
+	assert( Field< unsigned int >::get( kin, "nx" ) == numVoxels );
+
+	Id A = s->doCreate( "Pool", kin, "A", 1 );
+	Id B = s->doCreate( "Pool", kin, "B", 1 );
+	Id C = s->doCreate( "Pool", kin, "C", 1 );
+	Id D = s->doCreate( "Pool", kin, "D", 1 );
+	Id enzPool = s->doCreate( "Pool", kin, "enzPool", 1 );
+	Id enz = s->doCreate( "MMenz", enzPool, "enz", 1 );
+	Id r1 = s->doCreate( "Reac", kin, "r1", 1 );
+	Id r2 = s->doCreate( "Reac", kin, "r2", 1 );
+	Id r3 = s->doCreate( "Reac", kin, "r3", 1 );
+
+	s->doAddMsg( "Single", r1, "sub", A, "reac" );
+	s->doAddMsg( "Single", r1, "prd", B, "reac" );
+	s->doAddMsg( "Single", r2, "sub", B, "reac" );
+	s->doAddMsg( "Single", r2, "sub", B, "reac" );
+	s->doAddMsg( "Single", r2, "prd", C, "reac" );
+	s->doAddMsg( "Single", enz, "sub", C, "reac" );
+	s->doAddMsg( "Single", enzPool, "nOut", enz, "enzDest" );
+	s->doAddMsg( "Single", enz, "prd", D, "reac" );
+	s->doAddMsg( "Single", r3, "sub", D, "reac" );
+	s->doAddMsg( "Single", r3, "prd", A, "reac" );
+
+	Field< double >::set( A, "concInit", 1e-3 );
+	Field< double >::set( enzPool, "concInit", 1e-4 );
+	Field< double >::set( r1, "Kf", 0.2 );
+	Field< double >::set( r1, "Kb", 0.1 );
+	Field< double >::set( r2, "Kf", 1e3 );
+	Field< double >::set( r2, "Kb", 0.1 );
+	Field< double >::set( r3, "Kf", 0.1 );
+	Field< double >::set( r3, "Kb", 0.0 );
+	Field< double >::set( enz, "Km", 1e-3 );
+	Field< double >::set( enz, "kcat", 1.0 );
+
+	Id solver = s->doCreate( solverClass, kin, "solver", 1 );
+	Id stoich = s->doCreate( "Stoich", solver, "stoich", 1 );
+	Field< unsigned int >::set( solver, "numAllVoxels", numVoxels );
+	Field< Id >::set( stoich, "poolInterface", solver );
+	Field< Id >::set( solver, "stoich", stoich );
+	if ( solverClass == "Gsolve" )
+		Field< long >::set( solver, "seed", 1234 );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/solver", "process", 4 );
+	s->doSetClock( 4, 0.1 );
+	return solver;
+}
+
+/**
+ * Only the first voxel picks up the initial conditions from the pools,
+ * so this copies them over to the rest after a reinit.
+ */
+static void reinitCubeModel( Id solver, unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	s->doReinit();
+	vector< double > nVec = LookupField< unsigned int,
+		vector< double > >::get( solver, "nVec", 0 );
+	for ( unsigned int i = 1; i < numVoxels; ++i )
+		LookupField< unsigned int, vector< double > >::set(
+			solver, "nVec", i, nVec );
+}
+
+/**
+ * Runs the Gsolve on 1, 2, 4, 8 and 16 threads, and reports the
+ * speedup for each thread count.
+ */
+void runGsolveScalingBenchmark( unsigned int numVoxels )
+{
+	const double runtime = 10.0;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id gsolve = makeCubeModel( "Gsolve", numVoxels );
+
+	double serialTime = 0.0;
+	for ( unsigned int numThreads = 1; numThreads <= 16; numThreads *= 2 ){
+		Field< unsigned int >::set( gsolve, "numThreads", numThreads );
+		reinitCubeModel( gsolve, numVoxels );
+		double t0 = benchmarkWallTime();
+		stringstream ss;
+		ss << "threads=" << numThreads;
+		runBenchmarkSimulation( ss.str(), runtime, 4 );
+		double t = benchmarkWallTime() - t0;
+		if ( numThreads == 1 )
+			serialTime = t;
+		cout << "Gsolve " << numVoxels << " voxels, " << numThreads <<
+			" threads: speedup = " << serialTime / t << endl;
+	}
+	s->doDelete( Id( "/kinetics" ) );
+}
+
+void runKsolveBenchmark( unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id ksolve = makeCubeModel( "Ksolve", numVoxels );
+	reinitCubeModel( ksolve, numVoxels );
+	runBenchmarkSimulation( "", 100.0, 4 );
+	s->doDelete( Id( "/kinetics" ) );
+}
+
+void runGsolveBenchmark( unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id gsolve = makeCubeModel( "Gsolve", numVoxels );
+	reinitCubeModel( gsolve, numVoxels );
+	runBenchmarkSimulation( "", 10.0, 4 );
+	s->doDelete( Id( "/kinetics" ) );
+}
+
+/**
+ * Makes a cell under a Neutral called name, whose dendrites form a
+ * binary tree of numSegs 40 um segments off a 10 um soma, all in the
+ * xy plane. Returns the Neutral.
+ */
+static Id makeBinaryTreeCell( const string& name, unsigned int numSegs )
+{
+	const double len = 40e-6;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id model = s->doCreate( "Neutral", Id(), name, 1 );
+	vector< Id > compts;
+	vector< double > x( numSegs, 0.0 );
+	vector< double > y( numSegs, 0.0 );
+	for ( unsigned int i = 0; i < numSegs; ++i ) {
+		stringstream ss;
+		ss << "c" << i;
+		Id c = s->doCreate( "Compartment", model, ss.str(), 1 );
+		double x0 = 0.0;
+		double y0 = 0.0;
+		double dia = 10e-6;
+		double length = dia;
+		double theta = PI / 2.0;
+		if ( i > 0 ) {
+			unsigned int pa = ( i - 1 ) / 2;
+			s->doAddMsg( "Single", compts[pa], "raxial", c, "axial" );
+			x0 = x[pa];
+			y0 = y[pa];
+			dia = 2e-6;
+			length = len;
+			theta = ( i % 2 ) ? PI / 4.0 : -PI / 4.0;
+		}
+		x[i] = x0 + length * cos( theta );
+		y[i] = y0 + length * sin( theta );
+		Field< double >::set( c, "x0", x0 );
+		Field< double >::set( c, "y0", y0 );
+		Field< double >::set( c, "x", x[i] );
+		Field< double >::set( c, "y", y[i] );
+		Field< double >::set( c, "diameter", dia );
+		Field< double >::set( c, "length", length );
+		compts.push_back( c );
+	}
+	return model;
+}
+
+/**
+ * Diffusion on a cell whose dendrites form a binary tree of 40 um
+ * segments, with 1 um voxels. The tree has as many segments as needed
+ * for about numVoxels voxels. There is a single diffusing pool, all of
+ * which starts in the soma.
+ */
+void runDsolveBenchmark( unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id model = makeBinaryTreeCell( "model", numVoxels / 40 + 1 );
+
+	Id nm = s->doCreate( "NeuroMesh", model, "neuromesh", 1 );
+	Field< double >::set( nm, "diffLength", 1e-6 );
+	Field< string >::set( nm, "geometryPolicy", "cylinder" );
+	Field< Id >::set( nm, "cell", model );
+	Id dsolve = s->doCreate( "Dsolve", model, "dsolve", 1 );
+	Field< Id >::set( dsolve, "compartment", nm );
+	s->doUseClock( "/model/dsolve", "process", 1 );
+	s->doSetClock( 1, 0.1 );
+	s->doReinit();
+
+	vector< double > nvec = LookupField< unsigned int,
+		vector< double > >::get( dsolve, "nVec", 0 );
+	nvec[0] = 1;
+	LookupField< unsigned int, vector< double > >::set( dsolve, "nVec",
+		0, nvec );
+	stringstream ss;
+	ss << "voxels=" << nvec.size();
+	runBenchmarkSimulation( ss.str(), 100.0, 1 );
+	s->doDelete( model );
+}
+
+/**
+ * Times the setup of the meshes for a cell of numSegs segments, made as
+ * for the dsolve case: the building of the NeuroMesh, nearest for
+ * points scattered over the cell, and the junctions of the NeuroMesh
+ * with a CubeMesh of 1 um voxels over a corner of the cell.
+ */
+void runMeshSetupBenchmark( unsigned int numSegs )
+{
+	const unsigned int numQueries = 10000;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id model = makeBinaryTreeCell( "model", numSegs );
+
+	Id nm = s->doCreate( "NeuroMesh", model, "neuromesh", 1 );
+	Field< double >::set( nm, "diffLength", 1e-6 );
+	Field< string >::set( nm, "geometryPolicy", "cylinder" );
+	double t0 = benchmarkWallTime();
+	Field< Id >::set( nm, "cell", model );
+	addBenchmarkResult( "neuroMesh", benchmarkWallTime() - t0, numSegs );
+	const NeuroMesh* neuro = reinterpret_cast< const NeuroMesh* >(
+		nm.eref().data() );
+
+	// The tree reaches out to about 40 um times its depth.
+	double extent = 40e-6 * log( numSegs + 1.0 ) / log( 2.0 );
+	t0 = benchmarkWallTime();
+	unsigned int index;
+	for ( unsigned int i = 0; i < numQueries; ++i ) {
+		double x = extent * ( ( i * 7919 ) % numQueries ) / numQueries;
+		double y = extent * ( ( i * 104729 ) % numQueries ) / numQueries - 
+			extent / 2.0;
+		neuro->nearest( x, y, 0.0, index );
+	}
+	addBenchmarkResult( "nearest", benchmarkWallTime() - t0, numQueries );
+
+	CubeMesh cm;
+	cm.setPreserveNumEntries( 0 );
+	vector< double > coords( 9, 1e-6 );
+	coords[0] = 0.0;
+	coords[1] = 0.0;
+	coords[2] = -5e-6;
+	coords[3] = 100e-6;
+	coords[4] = 100e-6;
+	coords[5] = 5e-6;
+	cm.innerSetCoords( coords );
+	vector< VoxelJunction > ret;
+	t0 = benchmarkWallTime();
+	neuro->matchCubeMeshEntries( &cm, ret );
+	addBenchmarkResult( "cubeJunctions", benchmarkWallTime() - t0,
+		ret.size() );
+	s->doDelete( model );
+}
+
+/**
+ * A parameter sweep over the rates of r1 in the cube model, run as
+ * numReplicas separate models of one voxel each, and then as replicas
+ * in the voxels of one solver, each with its own rate scale.
+ */
+void runEnsembleBenchmark( unsigned int numReplicas )
+{
+	const double runtime = 100.0;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	double t0 = benchmarkWallTime();
+	for ( unsigned int i = 0; i < numReplicas; ++i ) {
+		makeCubeModel( "Ksolve", 1 );
+		double scale = 0.5 + static_cast< double >( i ) / numReplicas;
+		Field< double >::set( Id( "/kinetics/r1" ), "Kf", 0.2 * scale );
+		Field< double >::set( Id( "/kinetics/r1" ), "Kb", 0.1 * scale );
+		s->doReinit();
+		s->doStart( runtime );
+		s->doDelete( Id( "/kinetics" ) );
+	}
+	addBenchmarkResult( "separate", benchmarkWallTime() - t0, numReplicas );
+
+	t0 = benchmarkWallTime();
+	Id ksolve = makeCubeModel( "Ksolve", numReplicas );
+	Id stoich( "/kinetics/solver/stoich" );
+	unsigned int numRates = Field< unsigned int >::get( stoich, "numRates" );
+	unsigned int r1 = LookupField< Id, unsigned int >::get( 
+		stoich, "rateIndex", Id( "/kinetics/r1" ) );
+	for ( unsigned int i = 0; i < numReplicas; ++i ) {
+		vector< double > scale( numRates, 1.0 );
+		scale[ r1 ] = 0.5 + static_cast< double >( i ) / numReplicas;
+		LookupField< unsigned int, vector< double > >::set(
+			ksolve, "rateScale", i, scale );
+	}
+	reinitCubeModel( ksolve, numReplicas );
+	s->doStart( runtime );
+	addBenchmarkResult( "ensemble", benchmarkWallTime() - t0, numReplicas );
+	s->doDelete( Id( "/kinetics" ) );
+}
+
+/**
+ * An array of numFuncs Funcs with the same expression, each sending its
+ * value to an Arith, evaluated one at a time and then in bulk.
+ */
+void runFuncBulkBenchmark( unsigned int numFuncs )
+{
+	const unsigned int numSteps = 1000;
+	const char* labels[] = { "single", "bulk" };
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id nid = s->doCreate( "Neutral", Id(), "funcs", 1 );
+	Id func = s->doCreate( "Func", nid, "func", numFuncs );
+	Id dest = s->doCreate( "Arith", nid, "dest", numFuncs );
+	s->doAddMsg( "OneToOne", func, "valueOut", dest, "arg1" );
+	vector< double > x( numFuncs );
+	vector< double > y( numFuncs );
+	for ( unsigned int i = 0; i < numFuncs; ++i ) {
+		x[i] = i * 0.001;
+		y[i] = 1.0 - i * 0.0001;
+	}
+	Field< string >::setRepeat( func, "expr",
+		"x * y + sin( x ) - exp( -y )" );
+	Field< double >::setVec( func, "x", x );
+	Field< double >::setVec( func, "y", y );
+	s->doUseClock( "/funcs/func", "process", 0 );
+	s->doSetClock( 0, 1.0 );
+	for ( unsigned int k = 0; k < 2; ++k ) {
+		Field< bool >::setRepeat( func, "useBulk", k == 1 );
+		s->doReinit();
+		double t0 = benchmarkWallTime();
+		s->doStart( numSteps );
+		addBenchmarkResult( labels[k], benchmarkWallTime() - t0,
+			static_cast< double >( numSteps ) * numFuncs );
+	}
+	s->doDelete( nid );
+}
+
+/**
+ * Times the building of models. First makes numPools pools under one
+ * compartment, one at a time through doCreate and Field::set, and then
+ * in bulk through doCreateMany and Field::setMany. Then times the loading
+ * of each of the kkit models in the Demos.
+ */
+void runModelLoadBenchmark( unsigned int numPools )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	vector< string > names( numPools );
+	vector< double > nInit( numPools );
+	for ( unsigned int i = 0; i < numPools; ++i ) {
+		stringstream ss;
+		ss << "p" << i;
+		names[i] = ss.str();
+		nInit[i] = i;
+	}
+
+	Id kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	double t0 = benchmarkWallTime();
+	for ( unsigned int i = 0; i < numPools; ++i ) {
+		Id pool = s->doCreate( "Pool", kin, names[i], 1 );
+		Field< double >::set( pool, "nInit", nInit[i] );
+		Field< double >::set( pool, "diffConst", 1e-12 );
+	}
+	addBenchmarkResult( "single", benchmarkWallTime() - t0, numPools );
+	s->doDelete( kin );
+
+	kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	t0 = benchmarkWallTime();
+	vector< Id > ids = s->doCreateMany( "Pool", kin, names );
+	vector< ObjId > pools( ids.begin(), ids.end() );
+	Field< double >::setMany( pools, "nInit", nInit );
+	Field< double >::setMany( pools, "diffConst",
+		vector< double >( numPools, 1e-12 ) );
+	addBenchmarkResult( "bulk", benchmarkWallTime() - t0, numPools );
+	s->doDelete( kin );
+
+	const char* models[] = { "acc68.g", "EGFR_MAPK_58.g", "Kholodenko.g",
+		"OSC_Cspace.g", "enz_classical_explicit.g", "enz_rea.g",
+		"kkit_objects_example.g", "reaction.g", "traff_nn_diff_BIS.g",
+		"traff_nn_diff_TRI.g" };
+	for ( unsigned int i = 0; i < sizeof( models ) / sizeof( char* ); ++i ){
+		string fname = string( "Demos/Genesis_files/" ) + models[i];
+		t0 = benchmarkWallTime();
+		Id mgr = s->doLoadModel( fname, "/model", "Neutral" );
+		double t = benchmarkWallTime() - t0;
+		if ( mgr == Id() ) {
+			cout << models[i] << ": could not load\n";
+			continue;
+		}
+		vector< ObjId > all;
+		unsigned int num = wildcardFind( "/model/##", all );
+		addBenchmarkResult( models[i], t, num );
+		s->doDelete( mgr );
+	}
+}
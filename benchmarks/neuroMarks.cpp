@@ -0,0 +1,231 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../shell/Shell.h"
+#include "../randnum/randnum.h"
+#ifdef USE_HDF5
+#include "hdf5.h"
+#include "../builtins/HDF5DataWriter.h"
+#endif
+#include "benchmarks.h"
+
+static const double EREST = -0.07;
+
+/**
+ * One Arith sends its output to numTargets Ariths on every step. Only
+ * the source is scheduled, so the time is that of the message dispatch.
+ */
+void runMsgFanoutBenchmark( unsigned int numTargets )
+{
+	const unsigned int numSteps = 1000;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id nid = s->doCreate( "Neutral", Id(), "fanout", 1 );
+	Id src = s->doCreate( "Arith", nid, "src", 1 );
+	Id dest = s->doCreate( "Arith", nid, "dest", numTargets );
+	ObjId mid = s->doAddMsg( "OneToAll", src, "output", dest, "arg1" );
+	assert( !mid.bad() );
+	s->doUseClock( "/fanout/src", "process", 0 );
+	s->doSetClock( 0, 1.0 );
+	s->doReinit();
+	SetGet1< double >::set( src, "arg1", 1.0 );
+
+	double t0 = benchmarkWallTime();
+	s->doStart( numSteps );
+	addBenchmarkResult( "", benchmarkWallTime() - t0,
+		static_cast< double >( numSteps ) * numTargets );
+	assert( doubleEq( Field< double >::get( ObjId( dest, numTargets - 1 ),
+		"arg1Value" ), 1.0 ) );
+	s->doDelete( nid );
+}
+
+static void setupGate( Id chan, const string& gate, double* p )
+{
+	vector< double > parms( p, p + 10 );
+	parms.push_back( 150 );
+	parms.push_back( -0.1 );
+	parms.push_back( 0.05 );
+	Id gateId( chan.path() + "/" + gate );
+	assert( gateId != Id() );
+	SetGet1< vector< double > >::set( gateId, "setupAlpha", parms );
+	Field< bool >::set( gateId, "useInterpolation", 1 );
+}
+
+/**
+ * Makes an unbranched cable of numCompts squid compartments, each with
+ * its own Na and K channels, under a Neutral called name. The first
+ * compartment gets a current injection.
+ */
+static Id makeHHCable( const string& name, unsigned int numCompts )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	double m[] = { 0.1e6 * ( EREST + 0.025 ), -0.1e6, -1,
+		-( EREST + 0.025 ), -0.01, 4e3, 0, 0, -EREST, 0.018 };
+	double h[] = { 70, 0, 0, -EREST, 0.02,
+		1e3, 0, 1, -( EREST + 0.03 ), -0.01 };
+	double n[] = { 1e4 * ( 0.01 + EREST ), -1e4, -1.0,
+		-( EREST + 0.01 ), -0.01, 0.125e3, 0, 0, -EREST, 0.08 };
+
+	Id nid = s->doCreate( "Neutral", Id(), name, 1 );
+	Id prev;
+	for ( unsigned int i = 0; i < numCompts; ++i ) {
+		stringstream ss;
+		ss << "c" << i;
+		Id c = s->doCreate( "Compartment", nid, ss.str(), 1 );
+		Field< double >::set( c, "Cm", 0.007854e-6 );
+		Field< double >::set( c, "Ra", 7639.44e3 );
+		Field< double >::set( c, "Rm", 424.4e3 );
+		Field< double >::set( c, "Em", EREST + 0.010613 );
+		Field< double >::set( c, "initVm", EREST );
+		if ( i == 0 )
+			Field< double >::set( c, "inject", 0.1e-6 );
+		else
+			s->doAddMsg( "Single", prev, "axial", c, "raxial" );
+
+		Id na = s->doCreate( "HHChannel", c, "Na", 1 );
+		Id k = s->doCreate( "HHChannel", c, "K", 1 );
+		s->doAddMsg( "Single", c, "channel", na, "channel" );
+		s->doAddMsg( "Single", c, "channel", k, "channel" );
+		Field< double >::set( na, "Gbar", 0.94248e-3 );
+		Field< double >::set( na, "Ek", EREST + 0.115 );
+		Field< double >::set( na, "Xpower", 3.0 );
+		Field< double >::set( na, "Ypower", 1.0 );
+		Field< double >::set( k, "Gbar", 0.282743e-3 );
+		Field< double >::set( k, "Ek", EREST - 0.012 );
+		Field< double >::set( k, "Xpower", 4.0 );
+		setupGate( na, "gateX", m );
+		setupGate( na, "gateY", h );
+		setupGate( k, "gateX", n );
+		prev = c;
+	}
+	s->doUseClock( "/" + name + "/#[ISA=Compartment]", "init", 0 );
+	s->doUseClock( "/" + name + "/#[ISA=Compartment]", "process", 1 );
+	s->doUseClock( "/" + name + "/#/#[ISA=HHChannel]", "process", 1 );
+	s->doSetClock( 0, 1e-5 );
+	s->doSetClock( 1, 1e-5 );
+	return nid;
+}
+
+void runHHCableBenchmark( unsigned int numCompts )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id nid = makeHHCable( "cable", numCompts );
+	s->doReinit();
+	runBenchmarkSimulation( "", 0.05, 1 );
+	s->doDelete( nid );
+}
+
+void runHSolveCableBenchmark( unsigned int numCompts )
+{
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id nid = makeHHCable( "cable", numCompts );
+	Id hsolve = s->doCreate( "HSolve", nid, "hsolve", 1 );
+	Field< string >::set( hsolve, "target", "/cable" );
+	assert( Field< unsigned int >::get( hsolve, "numCompartments" ) ==
+		numCompts );
+	s->doUseClock( "/cable/hsolve", "proc", 1 );
+	s->doReinit();
+	runBenchmarkSimulation( "", 0.05, 1 );
+	s->doDelete( nid );
+}
+
+/**
+ * A network of numNeurons IntFires, each connected to 10% of the others
+ * through a SparseMsg, with random weights and delays. The initial Vms
+ * are random, so that the network is active from the start.
+ */
+void runIntFireBenchmark( unsigned int numNeurons )
+{
+	const double timestep = 0.2;
+	const double runtime = 200.0;
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	Id net = s->doCreate( "IntFire", Id(), "network", numNeurons );
+	Id synId( net.value() + 1 );
+	Field< double >::setRepeat( net, "bufferTime", 8.0 );
+	Field< double >::setRepeat( net, "thresh", 0.8 );
+	Field< double >::setRepeat( net, "refractoryPeriod", 0.4 );
+	ObjId mid = s->doAddMsg( "Sparse", net, "spikeOut",
+		ObjId( synId, 0 ), "addSpike" );
+	SetGet2< double, long >::set( mid, "setRandomConnectivity",
+		0.1, 5489UL );
+
+	mtseed( 5489UL );
+	vector< unsigned int > numSynVec;
+	Field< unsigned int >::getVec( net, "numSynapses", numSynVec );
+	for ( unsigned int i = 0; i < numNeurons; ++i ) {
+		vector< double > weight( numSynVec[i] );
+		vector< double > delay( numSynVec[i] );
+		for ( unsigned int j = 0; j < numSynVec[i]; ++j ) {
+			weight[j] = mtrand() * 0.02;
+			delay[j] = mtrand() * 4.0;
+		}
+		Field< double >::setVec( ObjId( synId, i ), "weight", weight );
+		Field< double >::setVec( ObjId( synId, i ), "delay", delay );
+	}
+	vector< double > Vm( numNeurons );
+	for ( unsigned int i = 0; i < numNeurons; ++i )
+		Vm[i] = mtrand();
+
+	s->doUseClock( "/network", "process", 0 );
+	s->doSetClock( 0, timestep );
+	s->doSetClock( 9, timestep );
+	s->doReinit();
+	Field< double >::setVec( net, "Vm", Vm );
+	runBenchmarkSimulation( "", runtime, 0 );
+	s->doDelete( net );
+}
+
+#ifdef USE_HDF5
+/**
+ * Feeds numTables sources of 10 samples each per step straight to an
+ * HDF5DataWriter, as the Tables would, in each of its layouts.
+ */
+void runHDF5Benchmark( unsigned int numTables )
+{
+	const unsigned int numSteps = 1000;
+	const unsigned int blockSize = 10;
+	const char* fname = "benchmark_hdf5.h5";
+	const char* layouts[] = { "separate", "population" };
+	Shell* s = reinterpret_cast< Shell* >( ObjId().data() );
+	ObjId tabs = s->doCreate( "Table", ObjId(), "h5tabs", numTables );
+	vector< double > data( blockSize );
+	for ( unsigned int k = 0; k < 2; ++k ) {
+		ObjId wid = s->doCreate( "HDF5DataWriter", ObjId(), "h5w", 1 );
+		Field< string >::set( wid, "filename", fname );
+		Field< unsigned int >::set( wid, "mode", H5F_ACC_TRUNC );
+		Field< string >::set( wid, "layout", layouts[k] );
+		HDF5DataWriter* w = reinterpret_cast< HDF5DataWriter* >(
+			wid.eref().data() );
+		ProcInfo p;
+		w->reinit( wid.eref(), &p );
+
+		double t0 = benchmarkWallTime();
+		for ( unsigned int i = 0; i < numSteps; ++i ) {
+			for ( unsigned int j = 0; j < numTables; ++j ) {
+				for ( unsigned int q = 0; q < blockSize; ++q )
+					data[q] = i * blockSize + q + j;
+				w->recvData( wid.eref(), ObjId( tabs.id, j ), &data[0],
+					blockSize );
+			}
+			w->process( wid.eref(), &p );
+		}
+		SetGet0::set( wid, "close" );
+		addBenchmarkResult( layouts[k], benchmarkWallTime() - t0,
+			static_cast< double >( numSteps ) * numTables * blockSize );
+		s->doDelete( wid );
+	}
+	s->doDelete( tabs );
+	remove( fname );
+}
+#else
+void runHDF5Benchmark( unsigned int numTables )
+{
+	cout << "HDF5 benchmark: not built with USE_HDF5, skipping\n";
+}
+#endif
@@ -179,6 +179,9 @@ CaConc::CaConc()
 		floor_( 0.0 )
 {;}
 
+CaConc::~CaConc()
+{;}
+
 ///////////////////////////////////////////////////
 // Field function definitions
 ///////////////////////////////////////////////////
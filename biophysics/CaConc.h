@@ -37,32 +37,33 @@ class CaConc
 {
 	public:
 		CaConc();
+		virtual ~CaConc();
 		///////////////////////////////////////////////////////////////
 		// Message handling functions
 		///////////////////////////////////////////////////////////////
-		void reinit( const Eref&, ProcPtr info );
-		void process( const Eref&, ProcPtr info );
+		virtual void reinit( const Eref&, ProcPtr info );
+		virtual void process( const Eref&, ProcPtr info );
 
-		void current( double I );
-		void currentFraction( double I, double fraction );
-		void increase( double I );
-		void decrease( double I );
+		virtual void current( double I );
+		virtual void currentFraction( double I, double fraction );
+		virtual void increase( double I );
+		virtual void decrease( double I );
 		///////////////////////////////////////////////////////////////
 		// Field handling functions
 		///////////////////////////////////////////////////////////////
-		void setCa( double val );
-		double getCa() const;
-		void setCaBasal( double val );
+		virtual void setCa( double val );
+		virtual double getCa() const;
+		virtual void setCaBasal( double val );
 		double getCaBasal() const;
-		void setTau( double val );
+		virtual void setTau( double val );
 		double getTau() const;
-		void setB( double val );
+		virtual void setB( double val );
 		double getB() const;
         void setThickness( double val );
         double getThickness() const;
-        void setCeiling( double val );
+        virtual void setCeiling( double val );
         double getCeiling() const;
-        void setFloor( double val );
+        virtual void setFloor( double val );
         double getFloor() const;
 
 		static const Cinfo* initCinfo();
@@ -20,24 +20,24 @@ class ChanBase
 {
 	public:
 		ChanBase();
-		~ChanBase();
+		virtual ~ChanBase();
 
 		/////////////////////////////////////////////////////////////
 		// Value field access function definitions
 		/////////////////////////////////////////////////////////////
 
-		void setGbar( double Gbar );
+		virtual void setGbar( double Gbar );
 		double getGbar() const;
-		void setEk( double Ek );
+		virtual void setEk( double Ek );
 		double getEk() const;
 		// void setInstant( int Instant );
 		// int getInstant() const;
-		void setGk( double Gk );
-		double getGk() const;
+		virtual void setGk( double Gk );
+		virtual double getGk() const;
 		/// Ik is read-only for MOOSE, but we provide the set 
 		/// func for derived classes to update it.
 		void setIk( double Ic );
-		double getIk() const;
+		virtual double getIk() const;
 
 		/////////////////////////////////////////////////////////////
 		// Dest function definitions
@@ -46,7 +46,7 @@ class ChanBase
 		/**
 		 * Assign the local Vm_ to the incoming Vm from the compartment
 		 */
-		void handleVm( double Vm );
+		virtual void handleVm( double Vm );
 
 		/////////////////////////////////////////////////////////////
 		/**
@@ -26,21 +26,23 @@ class Compartment
 			virtual ~Compartment();
 
 			// Value Field access function definitions.
-			void setVm( double Vm );
-			double getVm() const;
-			void setEm( double Em );
+			// The virtual ones are overridden by the ZombieCompartment
+			// so that the HSolve can take over the calculations.
+			virtual void setVm( double Vm );
+			virtual double getVm() const;
+			virtual void setEm( double Em );
 			double getEm() const;
-			void setCm( double Cm );
+			virtual void setCm( double Cm );
 			double getCm() const;
-			void setRm( double Rm );
+			virtual void setRm( double Rm );
 			double getRm() const;
-			void setRa( double Ra );
+			virtual void setRa( double Ra );
 			double getRa() const;
 			void setIm( double Im );
-			double getIm() const;
-			void setInject( double Inject );
-			double getInject() const;
-			void setInitVm( double initVm );
+			virtual double getIm() const;
+			virtual void setInject( double Inject );
+			virtual double getInject() const;
+			virtual void setInitVm( double initVm );
 			double getInitVm() const;
 			void setDiameter( double diameter );
 			double getDiameter() const;
@@ -64,7 +66,7 @@ class Compartment
 			 * The process function does the object updating and sends out
 			 * messages to channels, nernsts, and so on.
 			 */
-			void process( const Eref& e, ProcPtr p );
+			virtual void process( const Eref& e, ProcPtr p );
 
 			/**
 			 * The reinit function reinitializes all fields.
@@ -91,17 +93,17 @@ class Compartment
 			 * handleChannel handles information coming from the channel
 			 * to the compartment
 			 */
-			void handleChannel( double Gk, double Ek);
+			virtual void handleChannel( double Gk, double Ek);
 
 			/**
 			 * handleRaxial handles incoming raxial message data.
 			 */
-			void handleRaxial( double Ra, double Vm);
+			virtual void handleRaxial( double Ra, double Vm);
 
 			/**
 			 * handleAxial handles incoming axial message data.
 			 */
-			void handleAxial( double Vm);
+			virtual void handleAxial( double Vm);
 
 			/**
 			 * Injects a constantly updated current into the compartment.
@@ -110,7 +112,7 @@ class Compartment
 			 * be used as the destination of a message rather than as a
 			 * one-time assignment.
 			 */
-			void injectMsg( double current);
+			virtual void injectMsg( double current);
 
 			/**
 			 * Injects a constantly updated current into the
@@ -118,7 +120,7 @@ class Compartment
 			 * the current amplitude that is random, it is the presence
 			 * or absence of the current that is probabilistic.
 			 */
-			void randInject( double prob, double current);
+			virtual void randInject( double prob, double current);
 
 			/**
 			 * Dummy function to act as recipient of 'cable' message,
@@ -195,9 +195,9 @@ static const Cinfo* hhChannelCinfo = HHChannel::initCinfo();
 HHChannel::HHChannel()
 			: Xpower_( 0.0 ), Ypower_( 0.0 ), Zpower_( 0.0 ),
                           conc_( 0.0 ),
+                          xInited_( false ), yInited_( false ), zInited_( false ),
                           instant_( 0 ),
                           X_( 0.0 ), Y_( 0.0 ), Z_( 0.0 ),
-                          xInited_( false ), yInited_( false ), zInited_( false ),
                           g_( 0.0 ),
                           useConcentration_( 0 ),
                           xGate_( 0 ),
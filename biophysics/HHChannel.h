@@ -69,12 +69,12 @@ class HHChannel: public ChanBase
 		double getZpower( const Eref& e) const;
 		void setInstant( int Instant );
 		int getInstant() const;
-		void setX( double X );
-		double getX() const;
-		void setY( double Y );
-		double getY() const;
-		void setZ( double Z );
-		double getZ() const;
+		virtual void setX( double X );
+		virtual double getX() const;
+		virtual void setY( double Y );
+		virtual double getY() const;
+		virtual void setZ( double Z );
+		virtual double getZ() const;
 		void setUseConcentration( int value );
 		int getUseConcentration() const;
 
@@ -98,7 +98,7 @@ class HHChannel: public ChanBase
 		 * send back to the parent compartment through regular 
 		 * messages.
 		 */
-		void process( const Eref& e, ProcPtr p );
+		virtual void process( const Eref& e, ProcPtr p );
 
 		/**
 		 * Reinitializes the values for the channel. This involves
@@ -107,7 +107,7 @@ class HHChannel: public ChanBase
 		 * involves a similar cycle through the gates and then 
 		 * updates to the parent compartment as for the processFunc.
 		 */
-		void reinit( const Eref& e, ProcPtr p );
+		virtual void reinit( const Eref& e, ProcPtr p );
 
 		/**
 		 * Assign the local Vm_ to the incoming Vm from the compartment
@@ -120,7 +120,7 @@ class HHChannel: public ChanBase
 		 * the message source will be a CaConc object, but there
 		 * are other options for computing the conc.
 		 */
-		void handleConc( double conc );
+		virtual void handleConc( double conc );
 
 		/////////////////////////////////////////////////////////////
 		// Gate handling functions
@@ -211,6 +211,9 @@ class HHChannel: public ChanBase
 		double ( *takeYpower_ )( double, double );
 		double ( *takeZpower_ )( double, double );
 
+        bool xInited_, yInited_, zInited_; // true when a state variable
+        	// has been initialized
+
 	private:
 		/// bitmapped flag for X, Y, Z, to do equil calculation for gate
 		int instant_;
@@ -222,8 +225,6 @@ class HHChannel: public ChanBase
 		/// State variable for Z gate
 		double Z_;
 
-        bool xInited_, yInited_, zInited_; // true when a state variable
-        	// has been initialized
 		double g_;	/// Internal variable used to calculate conductance
 
 		/// Flag for use of conc for input to Z gate calculations.
@@ -274,6 +274,56 @@ void HHGate::lookupBoth( double v, double* A, double* B ) const
 	}
 }
 
+void HHGate::lookupBothArray( const double* v, double* A, double* B,
+	unsigned int n ) const
+{
+	if ( n == 0 )
+		return;
+	const double* tabA = &A_[0];
+	const double* tabB = &B_[0];
+	double lastA = A_.back();
+	double lastB = B_.back();
+	double xmin = xmin_;
+	double xmax = xmax_;
+	double invDx = invDx_;
+	if ( lookupByInterpolation_ ) {
+		for ( unsigned int i = 0; i < n; ++i ) {
+			double x = v[i];
+			if ( x <= xmin ) {
+				A[i] = tabA[0];
+				B[i] = tabB[0];
+			} else if ( x >= xmax ) {
+				A[i] = lastA;
+				B[i] = lastB;
+			} else {
+				unsigned int index =
+					static_cast< unsigned int >( ( x - xmin ) * invDx );
+				double frac = ( x - xmin - index / invDx ) * invDx;
+				A[i] = tabA[ index ] * ( 1 - frac ) +
+					tabA[ index + 1 ] * frac;
+				B[i] = tabB[ index ] * ( 1 - frac ) +
+					tabB[ index + 1 ] * frac;
+			}
+		}
+	} else {
+		for ( unsigned int i = 0; i < n; ++i ) {
+			double x = v[i];
+			if ( x <= xmin ) {
+				A[i] = tabA[0];
+				B[i] = tabB[0];
+			} else if ( x >= xmax ) {
+				A[i] = lastA;
+				B[i] = lastB;
+			} else {
+				unsigned int index =
+					static_cast< unsigned int >( ( x - xmin ) * invDx );
+				A[i] = tabA[ index ];
+				B[i] = tabB[ index ];
+			}
+		}
+	}
+}
+
 vector< double > HHGate::getAlpha( const Eref& e) const 
 {
 	return alpha_;
@@ -114,6 +114,15 @@ class HHGate
 		 */
 		void lookupBoth( double v, double* A, double* B ) const;
 
+		/**
+		 * Looks up A and B for n values at once, with the same results
+		 * as calling lookupBoth on each. Used by solvers that keep many
+		 * channels on the same gate, so that the table stays in cache
+		 * and the loop has no calls in it.
+		 */
+		void lookupBothArray( const double* v, double* A, double* B,
+			unsigned int n ) const;
+
 
 		/////////////////////////////////////////////////////////////////
 		// Utility funcs
@@ -12,6 +12,7 @@
 #include "SpikeRingBuffer.h"
 #include "Synapse.h"
 #include "SynHandler.h"
+#include "SpikeRouter.h"
 #include "IntFire.h"
 
 static SrcFinfo1< double > *spikeOut() {
@@ -160,7 +161,8 @@ void IntFire::process( const Eref &e, ProcPtr p )
 
 	if ( Vm_ > thresh_ && (p->currTime - lastSpike_) > refractoryPeriod_ ) {
 		// spikeOut()->send( e, e.dataIndex() );
-		spikeOut()->send( e, p->currTime );
+		if ( !router_.send( e, spikeOut(), p->currTime ) )
+			spikeOut()->send( e, p->currTime );
 		Vm_ = -1.0e-7;
 		lastSpike_ = p->currTime;
 	} else {
@@ -198,6 +200,7 @@ void IntFire::process( const Eref &e, ProcPtr p )
 void IntFire::reinit( const Eref& e, ProcPtr p )
 {
 	reinitBuffer( p->dt, bufferTime_ );
+	router_.reinit();
 	Vm_ = 0.0;
 }
 
@@ -251,3 +254,17 @@ double IntFire::getBufferTime() const
 {
 	return bufferTime_;
 }
+
+void IntFire::getState( vector< double >& s ) const
+{
+	s.push_back( lastSpike_ );
+	getBufferState( s );
+}
+
+bool IntFire::setState( const double* s, unsigned int size )
+{
+	if ( size < 1 || !setBufferState( s + 1, size - 1 ) )
+		return false;
+	lastSpike_ = s[0];
+	return true;
+}
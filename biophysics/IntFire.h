@@ -15,6 +15,7 @@ class IntFire: public SynHandler
 {
 	friend void testStandaloneIntFire();
 	friend void testSynapse();
+	friend void runSpikeRouter( double tgtDt );
 	public: 
 		IntFire();
 		IntFire( double thresh, double tau );
@@ -46,6 +47,13 @@ class IntFire: public SynHandler
 		void process( const Eref& e, ProcPtr p );
 		void reinit( const Eref&  e, ProcPtr p );
 
+		////////////////////////////////////////////////////////////////
+		// Checkpoint state: the time of the last spike and the buffer.
+		// Vm goes through its field.
+		////////////////////////////////////////////////////////////////
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
 		static const Cinfo* initCinfo();
 	private:
 		double Vm_; // State variable: Membrane potential. Resting pot is 0.
@@ -54,6 +62,7 @@ class IntFire: public SynHandler
 		double refractoryPeriod_; // Minimum time between successive spikes
 		double lastSpike_; // Time of last action potential.
 		double bufferTime_; // size of ring buffer.
+		SpikeRouter router_; // Delivers spikes to the target synapses.
 };
 
 #endif // _INT_FIRE_H
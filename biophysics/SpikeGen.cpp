@@ -8,6 +8,9 @@
 **********************************************************************/
 
 #include "header.h"
+#include "SpikeRingBuffer.h"
+#include "Synapse.h"
+#include "SpikeRouter.h"
 #include "SpikeGen.h"
 
 	///////////////////////////////////////////////////////
@@ -193,7 +196,8 @@ void SpikeGen::process( const Eref& e, ProcPtr p )
 	if ( V_ > threshold_ ) {
 		if ((t + p->dt/2.0) >= (lastEvent_ + refractT_)) {
 			if ( !( edgeTriggered_ && fired_ ) ) {
-				spikeOut()->send( e, t );
+				if ( !router_.send( e, spikeOut(), t ) )
+					spikeOut()->send( e, t );
 				lastEvent_ = t;
 				fired_ = true;                    
 			}
@@ -207,6 +211,7 @@ void SpikeGen::process( const Eref& e, ProcPtr p )
 void SpikeGen::reinit( const Eref& e, ProcPtr p )
 {
 	lastEvent_ = -refractT_ ;
+	router_.reinit();
 }
 
 void SpikeGen::handleVm( double val )
@@ -214,6 +219,23 @@ void SpikeGen::handleVm( double val )
 	V_ = val;
 }
 
+void SpikeGen::getState( vector< double >& s ) const
+{
+	s.push_back( lastEvent_ );
+	s.push_back( fired_ );
+	s.push_back( V_ );
+}
+
+bool SpikeGen::setState( const double* s, unsigned int size )
+{
+	if ( size != 3 )
+		return false;
+	lastEvent_ = s[0];
+	fired_ = ( s[1] != 0.0 );
+	V_ = s[2];
+	return true;
+}
+
 /////////////////////////////////////////////////////////////////////
 
 #ifdef DO_UNIT_TESTS
@@ -44,6 +44,10 @@ class SpikeGen
 		void reinit( const Eref& e, ProcPtr p );
 		void handleVm( double val );
 
+		/// Checkpoint state: the last event, whether it fired, and Vm.
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
 		static const Cinfo* initCinfo();
 	private:
 		double threshold_;
@@ -52,6 +56,7 @@ class SpikeGen
 		double V_;
 		bool fired_;
 		bool edgeTriggered_;
+		SpikeRouter router_;
 };
 
 #endif // _SpikeGen_h
@@ -76,3 +76,22 @@ double SpikeRingBuffer::pop( double currTime )
 	weightSum_[ currentBin_++ ] = 0.0;
 	return ret;
 }
+
+void SpikeRingBuffer::getState( vector< double >& s ) const
+{
+	s.push_back( dt_ );
+	s.push_back( currTime_ );
+	s.push_back( currentBin_ );
+	s.insert( s.end(), weightSum_.begin(), weightSum_.end() );
+}
+
+bool SpikeRingBuffer::setState( const double* s, unsigned int size )
+{
+	if ( size != 3 + weightSum_.size() || s[2] > weightSum_.size() )
+		return false;
+	dt_ = s[0];
+	currTime_ = s[1];
+	currentBin_ = s[2];
+	weightSum_.assign( s + 3, s + size );
+	return true;
+}
@@ -28,6 +28,18 @@ class SpikeRingBuffer
 		void addSpike( double timestamp, double weight );
 		/// Advances the buffer one step, returns the current weight
 		double pop( double currTime );
+
+		/**
+		 * Appends dt, the current time, the current bin and the
+		 * pending weights to s, for a checkpoint.
+		 */
+		void getState( vector< double >& s ) const;
+
+		/**
+		 * Takes back the state from getState. Returns false, leaving
+		 * the buffer alone, if it does not have the same number of bins.
+		 */
+		bool setState( const double* s, unsigned int size );
 	private:
 		static const unsigned int MAXBIN;
 		double dt_;
@@ -0,0 +1,134 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "SpikeRingBuffer.h"
+#include "Synapse.h"
+#include "SynHandler.h"
+#include "SpikeRouter.h"
+#include "../mpi/PostMaster.h"
+
+SpikeRouter::SpikeRouter()
+	: isBuilt_( false ), isRoutable_( false ), hasRemote_( false ),
+	digestVersion_( 0 ), layoutVersion_( 0 )
+{;}
+
+void SpikeRouter::reinit()
+{
+	isBuilt_ = false;
+	isRoutable_ = false;
+	hasRemote_ = false;
+	delay_.clear();
+	groupStart_.clear();
+	synapse_.clear();
+	buffer_.clear();
+}
+
+bool SpikeRouter::send( const Eref& e, const SrcFinfo* src, double t )
+{
+	if ( !isBuilt_ || isStale( e, src ) ) {
+		isRoutable_ = build( e, src );
+		isBuilt_ = true;
+	}
+	if ( !isRoutable_ )
+		return false;
+	// Each buffer finds the bin from its own dt and time, as it does
+	// for Synapse::addSpike, since its dt need not be that of the source.
+	for ( unsigned int i = 0; i < delay_.size(); ++i ) {
+		double arrival = t + delay_[i];
+		unsigned int end = groupStart_[i + 1];
+		for ( unsigned int j = groupStart_[i]; j < end; ++j )
+			buffer_[j]->addSpike( arrival, synapse_[j]->getWeight() );
+	}
+	if ( hasRemote_ ) {
+		static PostMaster* p = reinterpret_cast< PostMaster* >(
+			ObjId( 3 ).data() );
+		p->addSpike( e, src->getBindIndex(), t );
+	}
+	return true;
+}
+
+bool SpikeRouter::isStale( const Eref& e, const SrcFinfo* src ) const
+{
+	// Looking up the digest redigests the messages if they have changed.
+	e.msgDigest( src->getBindIndex() );
+	return digestVersion_ != e.element()->getDigestVersion() ||
+		layoutVersion_ != SynHandler::getLayoutVersion();
+}
+
+unsigned int SpikeRouter::getNumTargets() const
+{
+	return synapse_.size();
+}
+
+namespace {
+	class RouteEntry
+	{
+		public:
+			RouteEntry( double delay, const Synapse* syn,
+				SpikeRingBuffer* buf )
+				: delay_( delay ), syn_( syn ), buf_( buf )
+			{;}
+			bool operator<( const RouteEntry& other ) const {
+				return delay_ < other.delay_;
+			}
+			double delay_;
+			const Synapse* syn_;
+			SpikeRingBuffer* buf_;
+	};
+}
+
+bool SpikeRouter::build( const Eref& e, const SrcFinfo* src )
+{
+	static const DestFinfo* addSpike = dynamic_cast< const DestFinfo* >(
+		Synapse::initCinfo()->findFinfo( "addSpike" ) );
+	assert( addSpike );
+
+	reinit();
+	vector< RouteEntry > entries;
+	const vector< MsgDigest >& md = e.msgDigest( src->getBindIndex() );
+	digestVersion_ = e.element()->getDigestVersion();
+	layoutVersion_ = SynHandler::getLayoutVersion();
+	for ( vector< MsgDigest >::const_iterator
+		i = md.begin(); i != md.end(); ++i ) {
+		if ( i->targets.size() == 0 )
+			continue;
+		// Off-node targets get the spike through the PostMaster.
+		if ( dynamic_cast< const HopFunc1< double >* >( i->func ) ) {
+			hasRemote_ = true;
+			continue;
+		}
+		if ( i->func != addSpike->getOpFunc() )
+			return false;
+		for ( vector< Eref >::const_iterator
+			j = i->targets.begin(); j != i->targets.end(); ++j ) {
+			if ( j->dataIndex() == ALLDATA || !j->isDataHere() )
+				return false;
+			const Synapse* syn =
+				reinterpret_cast< const Synapse* >( j->data() );
+			SpikeRingBuffer* buf = syn->getBuffer();
+			if ( buf == 0 )
+				return false;
+			entries.push_back( RouteEntry( syn->getDelay(), syn, buf ) );
+		}
+	}
+
+	// Stable, so that entries with the same delay stay in message order.
+	stable_sort( entries.begin(), entries.end() );
+	for ( unsigned int i = 0; i < entries.size(); ++i ) {
+		if ( i == 0 || entries[i].delay_ != delay_.back() ) {
+			delay_.push_back( entries[i].delay_ );
+			groupStart_.push_back( i );
+		}
+		synapse_.push_back( entries[i].syn_ );
+		buffer_.push_back( entries[i].buf_ );
+	}
+	groupStart_.push_back( entries.size() );
+	return true;
+}
@@ -0,0 +1,84 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _SPIKE_ROUTER_H
+#define _SPIKE_ROUTER_H
+
+/**
+ * Delivers the spikes of a single source, such as an IntFire or a
+ * SpikeGen, straight into the ring buffers of its target Synapses.
+ * This skips the message dispatch and the Eref lookups that the
+ * messages need for every target, which dominate the run time of large
+ * networks. Each buffer still rounds the arrival time into its own
+ * bins, as Synapse::addSpike has it do, since the targets may run at
+ * a different dt from the source and from each other.
+ *
+ * The table is built from the message digest of the source on its
+ * first spike after reinit, when all the targets have set up their
+ * buffers. Each target is an entry holding the Synapse, its buffer and
+ * its delay. The entries are sorted by delay, and
+ * entries with the same delay are kept in message order so that
+ * coincident spikes add up in the same order as they would through
+ * the messages. The weights are read from the Synapses on every spike,
+ * so they may be changed during a run. The table is built again if the
+ * messages of the source are redigested, or if any SynHandler resizes
+ * its Synapses or goes, since the pointers in it may then be stale.
+ * Changes to the delays need a reinit.
+ *
+ * Targets on other nodes are reached through PostMaster::addSpike,
+ * which passes the spike on as a few integers rather than as a
+ * message. If any target on this node is not a Synapse, the router
+ * gives up and the source sends its spikes through the messages.
+ */
+class SpikeRouter
+{
+	public:
+		SpikeRouter();
+
+		/// Discards the table, so that it is built on the next spike.
+		void reinit();
+
+		/**
+		 * Delivers a spike sent at time t to all targets of src on
+		 * the source e. Returns false without delivering anything if
+		 * the targets cannot be routed, and the caller should then
+		 * send the spike as a message.
+		 */
+		bool send( const Eref& e, const SrcFinfo* src, double t );
+
+		/// Returns the number of targets in the table.
+		unsigned int getNumTargets() const;
+
+	private:
+		/// Fills the table from the message digest of src on e.
+		bool build( const Eref& e, const SrcFinfo* src );
+
+		/// True if the messages or the Synapses changed since the build.
+		bool isStale( const Eref& e, const SrcFinfo* src ) const;
+
+		bool isBuilt_;
+		bool isRoutable_;
+		/// True if the source has targets on other nodes.
+		bool hasRemote_;
+		/// Element::getDigestVersion of the source at the build.
+		unsigned int digestVersion_;
+		/// SynHandler::getLayoutVersion at the build.
+		unsigned int layoutVersion_;
+
+		/**
+		 * The entries with delay delay_[i] run from groupStart_[i]
+		 * to groupStart_[i+1].
+		 */
+		vector< double > delay_;
+		vector< unsigned int > groupStart_;
+		vector< const Synapse* > synapse_;
+		vector< SpikeRingBuffer* > buffer_;
+};
+
+#endif // _SPIKE_ROUTER_H
@@ -272,6 +272,22 @@ void SynChan::modulator( double val )
 	modulation_ *= val;
 }
 
+void SynChan::getState( vector< double >& s ) const
+{
+	s.push_back( X_ );
+	s.push_back( Y_ );
+	getBufferState( s );
+}
+
+bool SynChan::setState( const double* s, unsigned int size )
+{
+	if ( size < 2 || !setBufferState( s + 2, size - 2 ) )
+		return false;
+	X_ = s[0];
+	Y_ = s[1];
+	return true;
+}
+
 ///////////////////////////////////////////////////
 // Utility function
 ///////////////////////////////////////////////////
@@ -54,6 +54,10 @@ class SynChan: public SynChanBase
 
 		void activation( double val );
 		void modulator( double val );
+
+		/// Checkpoint state: X, Y and the buffer of pending spikes.
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
 ///////////////////////////////////////////////////
 		/**
 		 * Override base class function for spike handling
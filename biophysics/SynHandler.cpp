@@ -15,6 +15,7 @@
 
 /// This is bigger than # synapses for any neuron I know of: should suffice.
 const unsigned int SynHandler::MAX_SYNAPSES = 1000000;
+unsigned int SynHandler::layoutVersion_ = 0;
 
 /**
  * These are the base set of fields for any object managing synapses.
@@ -63,12 +64,16 @@ SynHandler::SynHandler()
 { ; }
 
 SynHandler::~SynHandler()
-{ ; }
+{
+	++layoutVersion_;
+}
 
 void SynHandler::setNumSynapses( const unsigned int v )
 {
 	assert( v < MAX_SYNAPSES );
 	unsigned int prevSize = synapses_.size();
+	if ( v != prevSize )
+		++layoutVersion_;
 	synapses_.resize( v );
 	for ( unsigned int i = prevSize; i < v; ++i )
 		synapses_[i].setBuffer( &buf_ );
@@ -94,6 +99,11 @@ void SynHandler::reinitBuffer( double dt, double bufferTime )
 		buf_.reinit( dt, bufferTime );
 }
 
+unsigned int SynHandler::getLayoutVersion()
+{
+	return layoutVersion_;
+}
+
 void SynHandler::setBufferOnAllSynapses()
 {
 	for ( vector< Synapse >::iterator 
@@ -106,9 +116,20 @@ double SynHandler::popBuffer( double currentTime )
 	return buf_.pop( currentTime );
 }
 
+void SynHandler::getBufferState( vector< double >& s ) const
+{
+	buf_.getState( s );
+}
+
+bool SynHandler::setBufferState( const double* s, unsigned int size )
+{
+	return buf_.setState( s, size );
+}
+
 unsigned int SynHandler::addSynapse()
 {
 	unsigned int newSynIndex = synapses_.size();
+	++layoutVersion_;
 	synapses_.resize( newSynIndex + 1 );
 	synapses_[newSynIndex].setBuffer( &buf_ );
 	return newSynIndex;
@@ -55,6 +55,10 @@ class SynHandler
 		 * Returns the current buffer entry, and advances it.
 		 */
 		double popBuffer( double currentTime );
+
+		/// Saves and restores the pending spikes for a checkpoint.
+		void getBufferState( vector< double >& s ) const;
+		bool setBufferState( const double* s, unsigned int size );
 		////////////////////////////////////////////////////////////////
 		// Used to ensure all synapses point to the correct buffer
 		////////////////////////////////////////////////////////////////
@@ -67,9 +71,17 @@ class SynHandler
 		////////////////////////////////////////////////////////////////
 		static const unsigned int MAX_SYNAPSES;
 		static const Cinfo* initCinfo();
+
+		/**
+		 * Returns a count that changes whenever the Synapses or the
+		 * buffer of any SynHandler may have moved or gone, so that a
+		 * SpikeRouter can tell its pointers are stale.
+		 */
+		static unsigned int getLayoutVersion();
 	private:
 		vector< Synapse > synapses_;
 		SpikeRingBuffer buf_;
+		static unsigned int layoutVersion_;
 };
 
 #endif // _SYN_HANDLER_H
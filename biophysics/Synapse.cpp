@@ -83,6 +83,11 @@ void Synapse::setBuffer( SpikeRingBuffer* buf )
 	buffer_ = buf;
 }
 
+SpikeRingBuffer* Synapse::getBuffer() const
+{
+	return buffer_;
+}
+
 
 void Synapse::addSpike( const Eref& e, double time )
 {
@@ -21,6 +21,7 @@ class Synapse
 		double getDelay() const;
 
 		void setBuffer( SpikeRingBuffer* buf );
+		SpikeRingBuffer* getBuffer() const;
 
 		void addSpike( const Eref& e, double time );
 		static void addMsgCallback( 
@@ -13,6 +13,11 @@
 #include "../shell/Shell.h"
 #include "../randnum/randnum.h"
 #include "Compartment.h"
+#include "SpikeRingBuffer.h"
+#include "Synapse.h"
+#include "SynHandler.h"
+#include "SpikeRouter.h"
+#include "IntFire.h"
 /*
 #include "HHGate.h"
 #include "ChanBase.h"
@@ -41,7 +46,7 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	static const double delayMax = 4;
 	static const double delayMin = 0;
 	static const double connectionProbability = 0.1;
-	static const unsigned int NUM_TOT_SYN = 104576;
+	static const unsigned int NUM_TOT_SYN = 104470;
 	unsigned int size = 1024;
 	string arg;
 	Eref sheller( Id().eref() );
@@ -68,12 +73,11 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	if ( Shell::numNodes() == 1 )
 		assert( nd == NUM_TOT_SYN );
 	else if ( Shell::numNodes() == 2 )
-		assert( nd == 52446 );
+		assert( nd == 52524 );
 	else if ( Shell::numNodes() == 3 )
-		//assert( nd == 34969 );
-		assert( nd == 35087 );
+		assert( nd == 35104 );
 	else if ( Shell::numNodes() == 4 )
-		assert( nd == 26381 );
+		assert( nd == 26530 );
 
 	//////////////////////////////////////////////////////////////////
 	// Checking access to message info through SparseMsg on many nodes.
@@ -86,13 +90,13 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	funcs = LookupField< string, vector< string > >::
 			get( oi, "msgDestFunctions", "spikeOut" );
 	assert( tgts.size() == funcs.size() );
-	assert( tgts.size() == 116  );
-	assert( tgts[0] == ObjId( synId, 20, 11 ) );
-	assert( tgts[1] == ObjId( synId, 27, 15 ) );
-	assert( tgts[2] == ObjId( synId, 57, 14 ) );
-	assert( tgts[90] == ObjId( synId, 788, 15 ) );
-	assert( tgts[91] == ObjId( synId, 792, 12 ) );
-	assert( tgts[92] == ObjId( synId, 801, 17 ) );
+	assert( tgts.size() == 102  );
+	assert( tgts[0] == ObjId( synId, 0, 11 ) );
+	assert( tgts[1] == ObjId( synId, 10, 11 ) );
+	assert( tgts[2] == ObjId( synId, 13, 10 ) );
+	assert( tgts[90] == ObjId( synId, 921, 10 ) );
+	assert( tgts[91] == ObjId( synId, 927, 11 ) );
+	assert( tgts[92] == ObjId( synId, 929, 11 ) );
 	for ( unsigned int i = 0; i < funcs.size(); ++i )
 		assert( funcs[i] == "addSpike" );
 
@@ -119,6 +123,9 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	// Here we have an interesting problem. The mtRand might be called
 	// by multiple threads if the above Set call is not complete.
 
+	// The connectivity has its own random numbers, so reseed mtrand
+	// here to make the rest of the test independent of earlier tests.
+	mtseed( 5489UL );
 	vector< double > origVm( size, 0.0 );
 	for ( unsigned int i = 0; i < size; ++i )
 		origVm[i] = mtrand() * Vmax;
@@ -190,13 +197,13 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	double retVm901 = Field< double >::get( ObjId( i2, 901 ), "Vm" );
 	double retVm902 = Field< double >::get( ObjId( i2, 902 ), "Vm" );
 
-	assert( doubleEq( retVm100, 0.00734036 ) );
-	assert( doubleEq( retVm101, 0.246818 ) );
-	assert( doubleEq( retVm102, 0.200087 ) );
-	assert( doubleEq( retVm99, 0.0095779083 ) );
-	assert( doubleEq( retVm900, 0.1150573482 ) );
-	assert( doubleEq( retVm901, 0.289321534 ) );
-	assert( doubleEq( retVm902, 0.01011172486 ) );
+	assert( doubleEq( retVm100, 0.1278874258 ) );
+	assert( doubleEq( retVm101, 0.265413986 ) );
+	assert( doubleEq( retVm102, 0.2378421164 ) );
+	assert( doubleEq( retVm99, 0.02188015512 ) );
+	assert( doubleEq( retVm900, 0.02439490231 ) );
+	assert( doubleEq( retVm901, 0.2250360075 ) );
+	assert( doubleEq( retVm902, 0.0250093245 ) );
 	/*
 	cout << "testIntFireNetwork: Vm100 = " << retVm100 << ", " <<
 			retVm101 << ", " << retVm102 << ", " << retVm99 <<
@@ -209,6 +216,346 @@ void testIntFireNetwork( unsigned int runsteps = 5 )
 	shell->doDelete( i2 );
 }
 
+/**
+ * Sends a spike from one IntFire to three others with different delays,
+ * once through the SpikeRouter and once through the messages. The
+ * second source also sends to an Arith, which is not a Synapse, so it
+ * cannot use the router. The targets run on tick 1 at tgtDt, and must
+ * see identical inputs.
+ */
+void runSpikeRouter( double tgtDt )
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	static const double dt = 0.1;
+	static const double delay[] = { 0.0, 0.2, 0.4 };
+	static const double weight[] = { 0.1, 0.2, 0.3 };
+	unsigned int size = 3;
+	Id nid = shell->doCreate( "Neutral", Id(), "route", 1 );
+	Id src = shell->doCreate( "IntFire", nid, "src", 1 );
+	Id src2 = shell->doCreate( "IntFire", nid, "src2", 1 );
+	Id tgt = shell->doCreate( "IntFire", nid, "tgt", size );
+	Id ref = shell->doCreate( "IntFire", nid, "ref", size );
+	Id arith = shell->doCreate( "Arith", nid, "arith", 1 );
+	Field< double >::setRepeat( src, "thresh", 0.5 );
+	Field< double >::setRepeat( src2, "thresh", 0.5 );
+	Field< double >::setRepeat( tgt, "thresh", 10.0 );
+	Field< double >::setRepeat( ref, "thresh", 10.0 );
+	Field< double >::setRepeat( tgt, "tau", 100.0 );
+	Field< double >::setRepeat( ref, "tau", 100.0 );
+	Field< double >::setRepeat( src, "bufferTime", 1.0 );
+	Field< double >::setRepeat( src2, "bufferTime", 1.0 );
+	Field< double >::setRepeat( tgt, "bufferTime", 1.0 );
+	Field< double >::setRepeat( ref, "bufferTime", 1.0 );
+	Id tgtSyn( tgt.value() + 1 );
+	Id refSyn( ref.value() + 1 );
+	vector< unsigned int > tgtIndex;
+	vector< unsigned int > synIndex( size, 0 );
+	for ( unsigned int i = 0; i < size; ++i )
+		tgtIndex.push_back( i );
+	ObjId mid = shell->doAddMsg( "Sparse", src, "spikeOut",
+		ObjId( tgtSyn, 0 ), "addSpike" );
+	assert( !mid.bad() );
+	SetGet3< vector< unsigned int >, vector< unsigned int >,
+		vector< unsigned int > >::set( mid, "tripletFill",
+		vector< unsigned int >( size, 0 ), tgtIndex, synIndex );
+	mid = shell->doAddMsg( "Sparse", src2, "spikeOut",
+		ObjId( refSyn, 0 ), "addSpike" );
+	assert( !mid.bad() );
+	SetGet3< vector< unsigned int >, vector< unsigned int >,
+		vector< unsigned int > >::set( mid, "tripletFill",
+		vector< unsigned int >( size, 0 ), tgtIndex, synIndex );
+	mid = shell->doAddMsg( "Single", src2, "spikeOut",
+		ObjId( arith, 0 ), "arg1" );
+	assert( !mid.bad() );
+	Field< unsigned int >::setRepeat( tgt, "numSynapses", 1 );
+	Field< unsigned int >::setRepeat( ref, "numSynapses", 1 );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		Field< double >::set( ObjId( tgtSyn, i, 0 ), "delay", delay[i] );
+		Field< double >::set( ObjId( refSyn, i, 0 ), "delay", delay[i] );
+		Field< double >::set( ObjId( tgtSyn, i, 0 ), "weight", weight[i] );
+		Field< double >::set( ObjId( refSyn, i, 0 ), "weight", weight[i] );
+	}
+	shell->doUseClock( "/route/src", "process", 0 );
+	shell->doUseClock( "/route/src2", "process", 0 );
+	shell->doUseClock( "/route/tgt", "process", 1 );
+	shell->doUseClock( "/route/ref", "process", 1 );
+	shell->doSetClock( 0, dt );
+	shell->doSetClock( 1, tgtDt );
+	shell->doReinit();
+	Field< double >::setRepeat( src, "Vm", 1.0 );
+	Field< double >::setRepeat( src2, "Vm", 1.0 );
+
+	vector< double > arrival( size, 0.0 );
+	for ( unsigned int step = 0; step < 10; ++step ) {
+		shell->doStart( dt );
+		for ( unsigned int i = 0; i < size; ++i ) {
+			double x = Field< double >::get( ObjId( tgt, i ), "Vm" );
+			double y = Field< double >::get( ObjId( ref, i ), "Vm" );
+			assert( x == y );
+			if ( arrival[i] == 0.0 && x > 0.0 )
+				arrival[i] = step;
+		}
+	}
+	// Each extra 0.2 of delay is two more steps.
+	assert( arrival[0] > 0.0 );
+	if ( tgtDt <= dt ) {
+		assert( doubleEq( arrival[1], arrival[0] + 2 ) );
+		assert( doubleEq( arrival[2], arrival[0] + 4 ) );
+	}
+
+	if ( Shell::numNodes() == 1 ) { // Otherwise some targets are remote.
+		const IntFire* routed = reinterpret_cast< const IntFire* >(
+			src.eref().data() );
+		const IntFire* unrouted = reinterpret_cast< const IntFire* >(
+			src2.eref().data() );
+		assert( routed->router_.getNumTargets() == size );
+		assert( unrouted->router_.getNumTargets() == 0 );
+	}
+
+	// Growing the synapses between runs moves them, and the table must
+	// follow them rather than read the old weights.
+	Field< unsigned int >::setRepeat( tgt, "numSynapses", 4 );
+	Field< unsigned int >::setRepeat( ref, "numSynapses", 4 );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		Field< double >::set( ObjId( tgtSyn, i, 0 ), "weight", 1.0 );
+		Field< double >::set( ObjId( refSyn, i, 0 ), "weight", 1.0 );
+	}
+	Field< double >::setRepeat( tgt, "Vm", 0.0 );
+	Field< double >::setRepeat( ref, "Vm", 0.0 );
+	Field< double >::setRepeat( src, "Vm", 1.0 );
+	Field< double >::setRepeat( src2, "Vm", 1.0 );
+	for ( unsigned int step = 0; step < 10; ++step ) {
+		shell->doStart( dt );
+		for ( unsigned int i = 0; i < size; ++i ) {
+			double x = Field< double >::get( ObjId( tgt, i ), "Vm" );
+			double y = Field< double >::get( ObjId( ref, i ), "Vm" );
+			assert( x == y );
+		}
+	}
+	assert( Field< double >::get( ObjId( tgt, 0 ), "Vm" ) > 0.5 );
+
+	shell->doDelete( nid );
+}
+
+/**
+ * Runs the router with the targets at the dt of the source, at a finer
+ * dt, and at a coarser one where a spike may be sent part way through
+ * a target step. Each run then resizes the synapses and runs again.
+ */
+void testSpikeRouter()
+{
+	runSpikeRouter( 0.1 );
+	runSpikeRouter( 0.025 );
+	runSpikeRouter( 0.3 );
+	cout << "." << flush;
+}
+
+/**
+ * Runs a network whose delays are all at least 1.0, first with the
+ * PostMaster swapping spikes on every step and then with the lookahead
+ * found from the delays. On many nodes the second run only syncs every
+ * fifth step, and the Vms must come out the same.
+ */
+void testPostMasterLookahead()
+{
+	static const double timestep = 0.2;
+	static const unsigned int runsteps = 40;
+	unsigned int size = 256;
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	ObjId pm( 3 );
+	assert( pm.element()->cinfo()->name() == "PostMaster" );
+
+	Id i2 = shell->doCreate( "IntFire", Id(), "window", size );
+	Id synId( i2.value() + 1 );
+	Field< double >::setRepeat( i2, "bufferTime", 4.0 );
+	Field< double >::setRepeat( i2, "thresh", 0.8 );
+	ObjId mid = shell->doAddMsg( "Sparse", i2, "spikeOut",
+		ObjId( synId, 0 ), "addSpike" );
+	SetGet2< double, long >::set( mid, "setRandomConnectivity", 
+		0.1, 1234UL );
+	mtseed( 1234UL );
+	vector< unsigned int > numSynVec;
+	Field< unsigned int >::getVec( i2, "numSynapses", numSynVec );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		vector< double > weight( numSynVec[i] );
+		vector< double > delay( numSynVec[i] );
+		for ( unsigned int j = 0; j < numSynVec[i]; ++j ) {
+			weight[j] = mtrand() * 0.1;
+			delay[j] = 1.0 + mtrand();
+		}
+		Field< double >::setVec( ObjId( synId, i ), "weight", weight );
+		Field< double >::setVec( ObjId( synId, i ), "delay", delay );
+	}
+	vector< double > origVm( size );
+	for ( unsigned int i = 0; i < size; ++i )
+		origVm[i] = mtrand();
+
+	shell->doUseClock( "/window", "process", 0 );
+	shell->doSetClock( 0, timestep );
+	shell->doSetClock( 9, timestep );
+	vector< vector< double > > Vm( 2 );
+	for ( unsigned int k = 0; k < 2; ++k ) {
+		Field< bool >::set( pm, "autoLookahead", k == 1 );
+		shell->doReinit();
+		if ( Shell::numNodes() > 1 ) {
+			double lookahead = Field< double >::get( pm, "lookahead" );
+			unsigned int interval = 
+				Field< unsigned int >::get( pm, "syncInterval" );
+			if ( k == 0 ) {
+				assert( lookahead == 0.0 );
+				assert( interval == 1 );
+			} else {
+				assert( lookahead >= 1.0 && lookahead < 1.2 );
+				assert( interval == 5 );
+			}
+		}
+		Field< double >::setVec( i2, "Vm", origVm );
+		// This also clears the time of the last spike.
+		Field< double >::setRepeat( i2, "refractoryPeriod", 0.4 );
+		shell->doStart( timestep * runsteps );
+		Field< double >::getVec( i2, "Vm", Vm[k] );
+	}
+	assert( Vm[0].size() == size );
+	unsigned int numChanged = 0;
+	for ( unsigned int i = 0; i < size; ++i ) {
+		assert( Vm[0][i] == Vm[1][i] );
+		numChanged += ( Vm[0][i] != origVm[i] );
+	}
+	assert( numChanged > 0 );
+
+	Field< bool >::set( pm, "autoLookahead", false );
+	Field< double >::set( pm, "lookahead", 0.0 );
+	shell->doDelete( i2 );
+	cout << "." << flush;
+}
+
+/**
+ * Makes random connectivity with a seed of zero, after seeding mtrand,
+ * and returns the number of synapses on each target.
+ */
+static vector< unsigned int > connectFromGlobalSeed( long globalSeed )
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id cells = shell->doCreate( "IntFire", Id(), "cells", 50 );
+	Id synId( cells.value() + 1 );
+	ObjId mid = shell->doAddMsg( "Sparse", cells, "spikeOut",
+		ObjId( synId, 0 ), "addSpike" );
+	mtseed( globalSeed );
+	SetGet2< double, long >::set( mid, "setRandomConnectivity", 0.1, 0 );
+	vector< unsigned int > ret;
+	Field< unsigned int >::getVec( cells, "numSynapses", ret );
+	shell->doDelete( cells );
+	return ret;
+}
+
+/**
+ * A SparseMsg without a seed of its own takes one from the global
+ * generator, so that the global seed repeats the network and another
+ * global seed gives another network.
+ */
+void testSparseMsgGlobalSeed()
+{
+	vector< unsigned int > a = connectFromGlobalSeed( 1234 );
+	vector< unsigned int > b = connectFromGlobalSeed( 1234 );
+	vector< unsigned int > c = connectFromGlobalSeed( 4321 );
+	assert( a.size() == 50 );
+	assert( a == b );
+	assert( a != c );
+	cout << "." << flush;
+}
+
+/**
+ * Saves a checkpoint of a spiking network half way through a run, and
+ * restores it after a reinit. Spikes still on their way, the times of
+ * the last spikes and the SpikeGen must all come back, and so must the
+ * global random numbers, for the rest of the run to match.
+ */
+void testCheckpointSpikes()
+{
+	static const double timestep = 0.2;
+	static const double runtime = 4.0;
+	const string fname = "testCheckpointSpikes.bin";
+	unsigned int size = 64;
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id nid = shell->doCreate( "Neutral", Id(), "ckp", 1 );
+	Id cells = shell->doCreate( "IntFire", nid, "cells", size );
+	Id synId( cells.value() + 1 );
+	Id tgt = shell->doCreate( "IntFire", nid, "tgt", 1 );
+	Id tgtSyn( tgt.value() + 1 );
+	Id spike = shell->doCreate( "SpikeGen", nid, "spike", 1 );
+	Field< double >::setRepeat( cells, "bufferTime", 4.0 );
+	Field< double >::set( tgt, "bufferTime", 4.0 );
+	Field< double >::setRepeat( cells, "thresh", 0.8 );
+	Field< double >::set( tgt, "thresh", 0.8 );
+	Field< double >::set( spike, "threshold", 0.5 );
+	Field< double >::set( spike, "refractT", 0.7 );
+	Field< bool >::set( spike, "edgeTriggered", false );
+	ObjId mid = shell->doAddMsg( "Sparse", cells, "spikeOut",
+		ObjId( synId, 0 ), "addSpike" );
+	SetGet2< double, long >::set( mid, "setRandomConnectivity", 
+		0.2, 4321UL );
+	mid = shell->doAddMsg( "Sparse", spike, "spikeOut",
+		ObjId( tgtSyn, 0 ), "addSpike" );
+	SetGet3< vector< unsigned int >, vector< unsigned int >,
+		vector< unsigned int > >::set( mid, "tripletFill",
+		vector< unsigned int >( 1, 0 ), vector< unsigned int >( 1, 0 ),
+		vector< unsigned int >( 1, 0 ) );
+	Field< unsigned int >::set( tgt, "numSynapses", 1 );
+	Field< double >::set( ObjId( tgtSyn, 0, 0 ), "weight", 0.3 );
+	Field< double >::set( ObjId( tgtSyn, 0, 0 ), "delay", 0.5 );
+
+	mtseed( 4321UL );
+	vector< unsigned int > numSynVec;
+	Field< unsigned int >::getVec( cells, "numSynapses", numSynVec );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		vector< double > weight( numSynVec[i] );
+		vector< double > delay( numSynVec[i] );
+		for ( unsigned int j = 0; j < numSynVec[i]; ++j ) {
+			weight[j] = mtrand() * 0.5;
+			delay[j] = 1.0 + mtrand();
+		}
+		Field< double >::setVec( ObjId( synId, i ), "weight", weight );
+		Field< double >::setVec( ObjId( synId, i ), "delay", delay );
+	}
+	vector< double > origVm( size );
+	for ( unsigned int i = 0; i < size; ++i )
+		origVm[i] = mtrand();
+
+	shell->doUseClock( "/ckp/##", "process", 0 );
+	shell->doSetClock( 0, timestep );
+	shell->doReinit();
+	Field< double >::setVec( cells, "Vm", origVm );
+	Field< double >::setRepeat( cells, "refractoryPeriod", 0.4 );
+	SetGet1< double >::set( spike, "Vm", 1.0 );
+	shell->doStart( runtime );
+	assert( shell->doSaveCheckpoint( nid, fname ) );
+	double r = mtrand();
+
+	shell->doStart( runtime );
+	vector< double > Vm;
+	Field< double >::getVec( cells, "Vm", Vm );
+	double tgtVm = Field< double >::get( tgt, "Vm" );
+	unsigned int numChanged = 0;
+	for ( unsigned int i = 0; i < size; ++i )
+		numChanged += ( Vm[i] != origVm[i] );
+	assert( numChanged > 0 );
+
+	shell->doReinit();
+	assert( shell->doRestoreCheckpoint( nid, fname ) );
+	assert( doubleEq( Field< double >::get( Id( 1 ), "currentTime" ), 
+		runtime ) );
+	assert( mtrand() == r );
+	shell->doStart( runtime );
+	vector< double > restored;
+	Field< double >::getVec( cells, "Vm", restored );
+	assert( restored == Vm );
+	assert( Field< double >::get( tgt, "Vm" ) == tgtVm );
+
+	shell->doDelete( nid );
+	remove( fname.c_str() );
+	cout << "." << flush;
+}
+
 #if 0
 void testHHGateCreation()
 {
@@ -1484,6 +1831,10 @@ void testBiophysics()
 void testBiophysicsProcess()
 {
 	testIntFireNetwork();
+	testSpikeRouter();
+	testPostMasterLookahead();
+	testSparseMsgGlobalSeed();
+	testCheckpointSpikes();
 	testCompartmentProcess();
 #if 0
 	testHHChannel();
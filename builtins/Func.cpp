@@ -49,6 +49,28 @@
 #include "../utility/utility.h"
 #include "Func.h"
 
+/**
+   A group of entries of a Func array that have the same expression. The
+   group is compiled once into its own parser, whose variables point
+   into a struct-of-arrays buffer holding the values of each variable
+   for all the members, so that a single bulk evaluation does them all.
+ */
+class FuncBulk
+{
+  public:
+    mu::Parser parser;
+    /// Data indices of the members, the first being the leader.
+    vector< unsigned int > members;
+    /// Expression version of each member when the group was built.
+    vector< unsigned int > versions;
+    /// Variable storage of each member, as src[var * n + member].
+    vector< double * > src;
+    /// Values of the variables, as buf[var * n + member].
+    vector< double > buf;
+    vector< double > results;
+    vector< Func * > funcs;
+};
+
 static SrcFinfo1<double> *valueOut()
 {
     static SrcFinfo1<double> valueOut("valueOut",
@@ -81,6 +103,21 @@ const Cinfo * Func::initCinfo()
                                                  " 3: both function value and derivative at current variable values will be funculated.",
                                                  &Func::setMode,
                                                  &Func::getMode);
+    static ValueFinfo< Func, bool > useBulk("useBulk",
+                                            "When true, this entry is evaluated together with the other entries\n"
+                                            "of its Func array that have the same expression and useBulk set.\n"
+                                            "Each such group is compiled once and evaluated in a single bulk pass\n"
+                                            "of muParser over a struct-of-arrays buffer of the variables, and the\n"
+                                            "outputs of the group are all sent when its first entry is processed.\n"
+                                            "The groups are made on the first process call after reinit, from the\n"
+                                            "entries that were reinited, which are those that are scheduled. They\n"
+                                            "should all be on the same tick. An entry whose expression is changed\n"
+                                            "after that is evaluated on its own until the next reinit.\n"
+                                            "When the Clock runs on several threads, an array with useBulk set on\n"
+                                            "any entry is processed within one thread, along with the objects that\n"
+                                            "send to it or get its outputs.",
+                                            &Func::setUseBulk,
+                                            &Func::getUseBulk);
     static ValueFinfo< Func, string > expr("expr",
                                            "Mathematical expression defining the function. The underlying parser\n"
                                            "is muParser. Hence the available functions and operators are (from\n"
@@ -229,6 +266,7 @@ const Cinfo * Func::initCinfo()
                 &value,
                 &derivative,
                 &mode,
+                &useBulk,
                 &expr,
                 &var,
                 &vars,
@@ -279,7 +317,9 @@ static const Cinfo * funcCinfo = Func::initCinfo();
 
 const int Func::VARMAX = 10;
 
-Func::Func():_x(NULL), _y(NULL), _z(NULL), _mode(1), _valid(false)
+Func::Func():_x(NULL), _y(NULL), _z(NULL), _mode(1), _valid(false),
+             _useBulk(false), _exprVersion(0), _bulkMember(false),
+             _bulkStale(false), _bulk(NULL)
 {
     _varbuf.reserve(VARMAX);
     _parser.SetVarFactory(_addVar, this);
@@ -288,9 +328,57 @@ Func::Func():_x(NULL), _y(NULL), _z(NULL), _mode(1), _valid(false)
     _parser.DefineConst(_T("e"), (mu::value_type)M_E);
 }
 
-Func::~Func()
+Func::Func(const Func& other):_x(NULL), _y(NULL), _z(NULL), _mode(1),
+                              _valid(false), _useBulk(false),
+                              _exprVersion(0), _bulkMember(false),
+                              _bulkStale(false), _bulk(NULL)
 {
+    _varbuf.reserve(VARMAX);
+    _parser.SetVarFactory(_addVar, this);
+    _parser.DefineConst(_T("pi"), (mu::value_type)M_PI);
+    _parser.DefineConst(_T("e"), (mu::value_type)M_E);
+    *this = other;
+}
 
+/**
+   The parser of the original refers to its own variables, so the copy
+   parses the expression afresh and then takes over the values. The
+   bulk groups are not copied, they are made again on reinit.
+ */
+Func& Func::operator=(const Func& other)
+{
+    if (this == &other){
+        return *this;
+    }
+    delete _bulk;
+    _bulk = NULL;
+    _bulkMember = false;
+    _bulkStale = false;
+    _mode = other._mode;
+    _useBulk = other._useBulk;
+    _clearBuffer();
+    _x = NULL;
+    _y = NULL;
+    _z = NULL;
+    _valid = false;
+    ++_exprVersion;
+    if (!other._valid){
+        return *this;
+    }
+    setExpr(other._parser.GetExpr());
+    if (_valid){
+        const mu::varmap_type &vars = other._parser.GetVar();
+        for (mu::varmap_type::const_iterator v = vars.begin();
+             v != vars.end(); ++v){
+            setVar(v->first, *v->second);
+        }
+    }
+    return *this;
+}
+
+Func::~Func()
+{
+    delete _bulk;
     _clearBuffer();
 }
 
@@ -327,6 +415,7 @@ double * _addVar(const char *name, void *data)
 void Func::setExpr(string expr)
 {
     _valid = false;
+    ++_exprVersion;
     _x = NULL;
     _y = NULL;
     _z = NULL;
@@ -500,6 +589,16 @@ unsigned int Func::getMode() const
     return _mode;
 }
 
+void Func::setUseBulk(bool value)
+{
+    _useBulk = value;
+}
+
+bool Func::getUseBulk() const
+{
+    return _useBulk;
+}
+
 double Func::getValue() const
 {
     double value = 0.0;
@@ -570,7 +669,14 @@ void Func::setVarValues(vector<string> vars, vector<double> vals)
 
 void Func::process(const Eref &e, ProcPtr p)
 {
-    if (!_valid){
+    if (_bulkStale){
+        _buildBulkGroups(e);
+    }
+    if (_bulk != NULL){
+        _processBulk(e);
+        return;
+    }
+    if (_bulkMember || !_valid){
         return;
     }
     if (_mode & 1){
@@ -583,6 +689,9 @@ void Func::process(const Eref &e, ProcPtr p)
 
 void Func::reinit(const Eref &e, ProcPtr p)
 {
+    // The bulk groups are made by whichever entry is processed first,
+    // once all the scheduled entries have been reinited.
+    _bulkStale = true;
     if (!_valid){
         cout << "Error: Func::reinit() - invalid parser state. Will do nothing." << endl;
         return;
@@ -593,5 +702,173 @@ void Func::reinit(const Eref &e, ProcPtr p)
         _valid = false;
     }
 }
+
+/**
+   True if b has the same variable names as a, all with storage.
+ */
+static bool _sameVarNames(const mu::varmap_type &a, const mu::varmap_type &b)
+{
+    if (a.size() != b.size()){
+        return false;
+    }
+    mu::varmap_type::const_iterator u = a.begin();
+    for (mu::varmap_type::const_iterator v = b.begin(); v != b.end();
+         ++u, ++v){
+        if (u->first != v->first || v->second == NULL){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+   Groups the local entries of the Func array that use bulk evaluation by
+   their expression. Only the entries reinited since the last grouping
+   are taken, so that entries that are not scheduled are left out. The
+   first entry of each group with more than one member becomes its
+   leader, and is the one to evaluate it.
+
+   The variables of each member are matched to those of the group by
+   name, using only the ones the expression uses: variables made by the
+   factory for an earlier expression stay in GetVar(). A member whose
+   used variables differ from the leader's is left to evaluate itself.
+ */
+void Func::_buildBulkGroups(const Eref &e)
+{
+    Element *elm = e.element();
+    unsigned int start = elm->localDataStart();
+    unsigned int end = start + elm->numLocalData();
+    map< string, vector< unsigned int > > groups;
+    for (unsigned int ii = start; ii < end; ++ii){
+        Func *f = reinterpret_cast< Func * >(Eref(elm, ii).data());
+        delete f->_bulk;
+        f->_bulk = NULL;
+        f->_bulkMember = false;
+        bool isScheduled = f->_bulkStale;
+        f->_bulkStale = false;
+        if (isScheduled && f->_useBulk && f->_valid &&
+            trim(f->_parser.GetExpr(), " \t\n\r").length() > 0){
+            groups[f->_parser.GetExpr()].push_back(ii);
+        }
+    }
+    for (map< string, vector< unsigned int > >::iterator g = groups.begin();
+         g != groups.end(); ++g){
+        if (g->second.size() < 2){
+            continue;
+        }
+        Func *leader = reinterpret_cast< Func * >(
+            Eref(elm, g->second[0]).data());
+        mu::varmap_type vars;
+        vector< unsigned int > members;
+        vector< mu::varmap_type > memberVars;
+        for (unsigned int kk = 0; kk < g->second.size(); ++kk){
+            Func *f = reinterpret_cast< Func * >(
+                Eref(elm, g->second[kk]).data());
+            mu::varmap_type fvars;
+            try{
+                fvars = f->_parser.GetUsedVar();
+            } catch (mu::Parser::exception_type &err){
+                _showError(err);
+                continue;
+            }
+            if (f == leader){
+                vars = fvars;
+            }
+            if (!_sameVarNames(vars, fvars)){
+                continue;
+            }
+            members.push_back(g->second[kk]);
+            memberVars.push_back(fvars);
+        }
+        unsigned int n = members.size();
+        if (n < 2 || members[0] != g->second[0]){
+            continue;
+        }
+        FuncBulk *bulk = new FuncBulk;
+        bulk->members = members;
+        bulk->versions.resize(n);
+        bulk->src.resize(vars.size() * n);
+        bulk->buf.resize(vars.size() * n, 0.0);
+        bulk->results.resize(n);
+        bulk->funcs.resize(n);
+        try{
+            bulk->parser.DefineConst(_T("pi"), (mu::value_type)M_PI);
+            bulk->parser.DefineConst(_T("e"), (mu::value_type)M_E);
+            unsigned int jj = 0;
+            for (mu::varmap_type::const_iterator v = vars.begin();
+                 v != vars.end(); ++v, ++jj){
+                bulk->parser.DefineVar(v->first, &bulk->buf[jj * n]);
+            }
+            bulk->parser.SetExpr(g->first);
+            for (unsigned int kk = 0; kk < n; ++kk){
+                Func *f = reinterpret_cast< Func * >(
+                    Eref(elm, members[kk]).data());
+                jj = 0;
+                for (mu::varmap_type::const_iterator v = vars.begin();
+                     v != vars.end(); ++v, ++jj){
+                    bulk->src[jj * n + kk] =
+                        memberVars[kk].find(v->first)->second;
+                }
+                bulk->versions[kk] = f->_exprVersion;
+            }
+        } catch (mu::Parser::exception_type &err){
+            _showError(err);
+            delete bulk;
+            continue;
+        }
+        for (unsigned int kk = 0; kk < n; ++kk){
+            reinterpret_cast< Func * >(
+                Eref(elm, members[kk]).data())->_bulkMember = true;
+        }
+        leader->_bulk = bulk;
+    }
+}
+
+/**
+   Gathers the variables of the group into the buffer, evaluates them all
+   in one pass and sends out the results. Members whose expression has
+   changed since the group was made are evaluated on their own.
+ */
+void Func::_processBulk(const Eref &e)
+{
+    FuncBulk *bulk = _bulk;
+    Element *elm = e.element();
+    unsigned int n = bulk->members.size();
+    unsigned int numVars = bulk->buf.size() / n;
+    for (unsigned int kk = 0; kk < n; ++kk){
+        Func *f = reinterpret_cast< Func * >(
+            Eref(elm, bulk->members[kk]).data());
+        bulk->funcs[kk] = f;
+        if (f->_exprVersion != bulk->versions[kk]){
+            continue;
+        }
+        for (unsigned int jj = 0; jj < numVars; ++jj){
+            bulk->buf[jj * n + kk] = *bulk->src[jj * n + kk];
+        }
+    }
+    try{
+        bulk->parser.Eval(&bulk->results[0], n);
+    } catch (mu::Parser::exception_type &err){
+        _showError(err);
+        return;
+    }
+    for (unsigned int kk = 0; kk < n; ++kk){
+        Func *f = bulk->funcs[kk];
+        if (!f->_valid){
+            continue;
+        }
+        Eref er(elm, bulk->members[kk]);
+        if (f->_mode & 1){
+            if (f->_exprVersion == bulk->versions[kk]){
+                valueOut()->send(er, bulk->results[kk]);
+            } else {
+                valueOut()->send(er, f->getValue());
+            }
+        }
+        if (f->_mode & 2){
+            derivativeOut()->send(er, f->getDerivative());
+        }
+    }
+}
 // 
 // Func.cpp ends here
@@ -55,11 +55,19 @@
  */
 double *_addVar(const char *name, void *data);
 
+class FuncBulk;
+
 class Func
 {
   public:
     static const int VARMAX;
     Func();
+    /**
+       Copies make their own parser and variables, with the values of
+       the original, so that the copies of a Func are independent.
+     */
+    Func(const Func& other);
+    Func& operator=(const Func& other);
     ~Func();
     void setExpr(string expr);
     string getExpr() const;
@@ -82,6 +90,10 @@ class Func
     void setMode(unsigned int mode);
     unsigned int getMode() const;
 
+    // get/set bulk evaluation
+    void setUseBulk(bool value);
+    bool getUseBulk() const;
+
     void setX(double value);
     double getX() const;
 
@@ -110,6 +122,19 @@ protected:
     mutable bool _valid;
     void _clearBuffer();
     void _showError(mu::Parser::exception_type &e) const;
+
+    /// True if this entry is to be evaluated in bulk with its array.
+    bool _useBulk;
+    /// Incremented whenever the expression, and so the variables, change.
+    unsigned int _exprVersion;
+    /// True if this entry is evaluated by the leader of its bulk group.
+    bool _bulkMember;
+    /// True from reinit until the bulk groups are made again.
+    bool _bulkStale;
+    /// Shared parser and buffers of the bulk group, owned by its leader.
+    FuncBulk *_bulk;
+    void _buildBulkGroups(const Eref& e);
+    void _processBulk(const Eref& e);
 };
 #endif
 
@@ -82,7 +82,37 @@ const Cinfo * HDF5DataWriter::initCinfo()
       "proc",
       "Shared message to receive process and reinit",
       processShared, sizeof( processShared ) / sizeof( Finfo* ));
+  static ValueFinfo< HDF5DataWriter, unsigned int > flushLimit(
+      "flushLimit",
+      "Number of samples held for each table before they are written to"
+      " file. Larger values give fewer and larger writes.",
+      &HDF5DataWriter::setFlushLimit,
+      &HDF5DataWriter::getFlushLimit);
+  static ValueFinfo< HDF5DataWriter, bool > useBackgroundFlush(
+      "useBackgroundFlush",
+      "If true, the data is written to file by a separate thread, so that"
+      " the simulation does not wait for the disk. The flush and close"
+      " calls wait till all the data is written.",
+      &HDF5DataWriter::setUseBackgroundFlush,
+      &HDF5DataWriter::getUseBackgroundFlush);
+  static ValueFinfo< HDF5DataWriter, string > layout(
+      "layout",
+      "How the data is arranged in the file. With \"separate\", the default,"
+      " each table gets its own 1-D dataset. With \"population\", all the"
+      " tables go into a single 2-D [time x table] dataset called `data`,"
+      " with one row per time step, and the paths of the tables in a"
+      " dataset called `sources`. Both are in a group named by the path of"
+      " this writer. The tables should all be on the same clock. If some"
+      " have fewer samples than others at the end of a run, their columns"
+      " are filled up with NaN, and the number of samples so filled is"
+      " kept in the `numPadded` attribute of `data`. Can only be set"
+      " before any data has been received.",
+      &HDF5DataWriter::setLayout,
+      &HDF5DataWriter::getLayout);
   static Finfo * finfos[] = {
+    &flushLimit,
+    &useBackgroundFlush,
+    &layout,
     requestOut(),
     clear(),
     recvDataBuf(),        
@@ -103,9 +133,10 @@ const Cinfo * HDF5DataWriter::initCinfo()
     "\n"
     "However Table inside Table is considered a pathological case and is"
     " not handled.\n"
-    "At every process call it writes the contents of the tables to the file"
-    " and clears the table vectors. You can explicitly force writing of the"
-    " data via the `flush` function."
+    "At every process call it collects the contents of the tables and"
+    " clears the table vectors. The data of each table is written to file"
+    " once `flushLimit` samples have built up. You can explicitly force"
+    " writing of the data via the `flush` function."
   };
 
 	static Dinfo< HDF5DataWriter > dinfo;
@@ -121,25 +152,106 @@ const Cinfo * HDF5DataWriter::initCinfo()
 
 static const Cinfo * hdf5dataWriterCinfo = HDF5DataWriter::initCinfo();
 
-HDF5DataWriter::HDF5DataWriter()
+/// HDF5 is not thread safe, so all calls to it from here take this.
+static pthread_mutex_t hdf5Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Slot of the blocks holding rows for the population dataset.
+static const unsigned int POPULATION = ~0U;
+
+HDF5DataWriter::HDF5DataWriter():
+        flushLimit_(CHUNK_SIZE),
+        useBackgroundFlush_(false),
+        layout_("separate"),
+        popDataset_(-1),
+        popStart_(0),
+        numPadded_(0),
+        writerRunning_(false),
+        quit_(false),
+        busy_(false)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&workCond_, NULL);
+    pthread_cond_init(&doneCond_, NULL);
+}
+
+HDF5DataWriter::HDF5DataWriter(const HDF5DataWriter& other):
+        HDF5WriterBase(other),
+        flushLimit_(other.flushLimit_),
+        useBackgroundFlush_(other.useBackgroundFlush_),
+        layout_(other.layout_),
+        popDataset_(-1),
+        popStart_(0),
+        numPadded_(0),
+        writerRunning_(false),
+        quit_(false),
+        busy_(false)
 {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&workCond_, NULL);
+    pthread_cond_init(&doneCond_, NULL);
+}
+
+HDF5DataWriter& HDF5DataWriter::operator=(const HDF5DataWriter& other)
+{
+    HDF5WriterBase::operator=(other);
+    flushLimit_ = other.flushLimit_;
+    useBackgroundFlush_ = other.useBackgroundFlush_;
+    layout_ = other.layout_;
+    return *this;
 }
 
 HDF5DataWriter::~HDF5DataWriter()
 {
-    if (filehandle_ < 0){
-      return;
+    close();
+    stopWriter();
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&workCond_);
+    pthread_cond_destroy(&doneCond_);
+}
+
+void HDF5DataWriter::setFlushLimit(unsigned int limit)
+{
+    if (limit == 0){
+        limit = 1;
     }
-    this->flush();
-    for (map < string, hid_t >::iterator ii = nodemap_.begin(); ii != nodemap_.end(); ++ii){
-        if (ii->second >= 0){
-            herr_t status = H5Dclose(ii->second);
-            if (status < 0){
-  	        cerr << "Warning: closing dataset for " << ii->first << ", returned status = " << status << endl;
-            }
-        }
+    flushLimit_ = limit;
+}
+
+unsigned int HDF5DataWriter::getFlushLimit() const
+{
+    return flushLimit_;
+}
+
+void HDF5DataWriter::setUseBackgroundFlush(bool value)
+{
+    if (!value){
+        stopWriter();
     }
-    filehandle_ = -1;
+    useBackgroundFlush_ = value;
+}
+
+bool HDF5DataWriter::getUseBackgroundFlush() const
+{
+    return useBackgroundFlush_;
+}
+
+void HDF5DataWriter::setLayout(string layout)
+{
+    std::transform(layout.begin(), layout.end(), layout.begin(), ::tolower);
+    if (layout != "separate" && layout != "population"){
+        cerr << "Error: HDF5DataWriter::setLayout: layout must be \"separate\" or \"population\", not \"" << layout << "\"" << endl;
+        return;
+    }
+    if (slotPath_.size() > 0){
+        cerr << "Error: HDF5DataWriter::setLayout: cannot change the layout after data has been received." << endl;
+        return;
+    }
+    layout_ = layout;
+}
+
+string HDF5DataWriter::getLayout() const
+{
+    return layout_;
 }
 
 void HDF5DataWriter::flush()
@@ -148,64 +260,434 @@ void HDF5DataWriter::flush()
         cerr << "HDF5DataWriter::flush() - Filehandle invalid. Cannot write data." << endl;
         return;
     }
-    for (map < string, vector < double > >::iterator ii = datamap_.begin(); ii != datamap_.end(); ++ ii){
-        hid_t dataset = nodemap_[ii->first];
-        if (dataset < 0){
-            dataset = get_dataset(ii->first);
-            nodemap_[ii->first] = dataset;
-        }
-        herr_t status = appendToDataset(dataset, ii->second);
-        if (status < 0){
-            cerr << "Warning: appending data for object " << ii->first << " returned status " << status << endl;                
+    if (layout_ == "population"){
+        handOffRows(1);
+    } else {
+        for (unsigned int ii = 0; ii < buffer_.size(); ++ii){
+            if (buffer_[ii].size() > 0){
+                handOff(ii);
+            }
         }
-        ii->second.clear();        
     }
+    drain();
+    pthread_mutex_lock(&hdf5Mutex);
     H5Fflush(filehandle_, H5F_SCOPE_LOCAL);
+    pthread_mutex_unlock(&hdf5Mutex);
 }
-        
+
+void HDF5DataWriter::close()
+{
+    if (filehandle_ < 0){
+        return;
+    }
+    if (layout_ == "population"){
+        handOffRows(1, true);
+    }
+    flush();
+    stopWriter();
+    if (numPadded_ > 0){
+        cerr << "Warning: HDF5DataWriter: the tables had different numbers of samples, " << numPadded_ << " samples were written as NaN." << endl;
+        writePadded();
+        numPadded_ = 0;
+    }
+    clearSlots();
+    pthread_mutex_lock(&hdf5Mutex);
+    HDF5WriterBase::close();
+    pthread_mutex_unlock(&hdf5Mutex);
+}
+
 /**
-   Write data to datasets in HDF5 file. Clear all data in the table
-   objects associated with this object. */
+   Collect data from the table objects associated with this object, and
+   clear them. Write out the data of any table that has reached the
+   flushLimit. */
 void HDF5DataWriter::process(const Eref & e, ProcPtr p)
 {
     if (filehandle_ < 0){
         return;
     }
-    // cout << "HDF5DataWriter::process: currentTime=" << p->currTime << endl;
     requestOut()->send(e, recvDataBuf()->getFid());
-    for (map<string, vector < double > >:: iterator data_it = datamap_.begin(); data_it != datamap_.end(); ++data_it){        
-        string path = data_it->first;
-        // if (data_it->second.size() >= flushLimit_){
-        map < string, hid_t >::iterator node_it = nodemap_.find(path);
-        assert (node_it != nodemap_.end());
-        if (node_it->second < 0){
-            nodemap_[path] = get_dataset(path);
-        }
-        herr_t status = appendToDataset(nodemap_[path], data_it->second);
-        if (status < 0){
-            cerr << "Warning: appending data for object " << data_it->first << " returned status " << status << endl;                
+    if (layout_ == "population"){
+        handOffRows(flushLimit_);
+        return;
+    }
+    for (unsigned int ii = 0; ii < buffer_.size(); ++ii){
+        if (buffer_[ii].size() >= flushLimit_){
+            handOff(ii);
         }
-        data_it->second.clear();
-    }    
+    }
 }
 
 void HDF5DataWriter::reinit(const Eref & e, ProcPtr p)
 {
-  // TODO: It will be preferable to initialize datamap_ and nodemap_
+  // TODO: It will be preferable to initialize the slots
   // here. But is there a way to figure out what tables are connected
   // to this object at this point? Subha, 2012-11-13
     if (filename_.empty()){
         filename_ = "moose_output.h5";
     }
-    if (filehandle_ < 0){      
-      openFile();      
+    popPath_ = e.objId().path();
+    if (filehandle_ < 0){
+      pthread_mutex_lock(&hdf5Mutex);
+      openFile();
+      pthread_mutex_unlock(&hdf5Mutex);
+    } else {
+      // Leftovers from the last run, padded so they do not run into
+      // the rows of this one.
+      if (layout_ == "population"){
+          handOffRows(1, true);
+      }
+      flush();
+    }
+}
+
+unsigned int HDF5DataWriter::getSlot(ObjId src)
+{
+    map< ObjId, unsigned int >::iterator ii = slots_.find(src);
+    if (ii != slots_.end()){
+        return ii->second;
+    }
+    string path = src.path();
+    if (layout_ == "population" && popSources_.size() > 0){
+        cerr << "Warning: HDF5DataWriter: " << path << " started sending data after the population was written, ignoring it." << endl;
+    }
+    // The writer thread reads the slot tables under hdf5Mutex, and
+    // growing them may move them.
+    pthread_mutex_lock(&hdf5Mutex);
+    unsigned int slot = slotPath_.size();
+    slotPath_.push_back(path);
+    slotDataset_.push_back(-1);
+    pthread_mutex_unlock(&hdf5Mutex);
+    slots_[src] = slot;
+    buffer_.push_back(vector< double >());
+    buffer_.back().reserve(flushLimit_);
+    return slot;
+}
+
+void HDF5DataWriter::handOff(unsigned int slot)
+{
+    if (!useBackgroundFlush_){
+        writeSlot(slot, buffer_[slot]);
+        buffer_[slot].clear();
+        return;
+    }
+    if (!writerRunning_){
+        startWriter();
+    }
+    pthread_mutex_lock(&mutex_);
+    pending_.push_back(Block());
+    pending_.back().slot = slot;
+    pending_.back().data.swap(buffer_[slot]);
+    if (spare_.size() > 0){
+        buffer_[slot].swap(spare_.back());
+        spare_.pop_back();
+    }
+    pthread_cond_signal(&workCond_);
+    pthread_mutex_unlock(&mutex_);
+    buffer_[slot].clear();
+    buffer_[slot].reserve(flushLimit_);
+}
+
+void HDF5DataWriter::writeSlot(unsigned int slot, const vector< double >& data)
+{
+    pthread_mutex_lock(&hdf5Mutex);
+    if (slotDataset_[slot] < 0){
+        slotDataset_[slot] = get_dataset(slotPath_[slot]);
+        nodemap_[slotPath_[slot]] = slotDataset_[slot];
+        if (slotDataset_[slot] < 0){
+            cerr << "Warning: could not create data set for " << slotPath_[slot] << endl;
+        }
+    }
+    herr_t status = appendToDataset(slotDataset_[slot], data);
+    if (status < 0){
+        cerr << "Warning: appending data for object " << slotPath_[slot] << " returned status " << status << endl;
+    }
+    pthread_mutex_unlock(&hdf5Mutex);
+}
+
+void HDF5DataWriter::clearSlots()
+{
+    pthread_mutex_lock(&hdf5Mutex);
+    for (unsigned int ii = 0; ii < slotDataset_.size(); ++ii){
+        if (slotDataset_[ii] >= 0){
+            herr_t status = H5Dclose(slotDataset_[ii]);
+            if (status < 0){
+                cerr << "Warning: closing dataset for " << slotPath_[ii] << ", returned status = " << status << endl;
+            }
+        }
+    }
+    if (popDataset_ >= 0){
+        H5Dclose(popDataset_);
+        popDataset_ = -1;
+    }
+    slotPath_.clear();
+    slotDataset_.clear();
+    nodemap_.clear();
+    pthread_mutex_unlock(&hdf5Mutex);
+    popSources_.clear();
+    popStart_ = 0;
+    slots_.clear();
+    buffer_.clear();
+}
+
+void HDF5DataWriter::handOffRows(unsigned int minRows, bool pad)
+{
+    if (popSources_.size() == 0){
+        // Fix the set of sources.
+        popSources_ = slotPath_;
+    }
+    unsigned int num = popSources_.size();
+    if (num == 0){
+        return;
+    }
+    unsigned int rows = buffer_[0].size();
+    unsigned int maxRows = rows;
+    for (unsigned int ii = 1; ii < num; ++ii){
+        rows = min(rows, (unsigned int)buffer_[ii].size());
+        maxRows = max(maxRows, (unsigned int)buffer_[ii].size());
+    }
+    rows = (pad ? maxRows : rows) - popStart_;
+    if (rows == 0 || rows < minRows){
+        return;
+    }
+
+    vector< double > packed;
+    if (useBackgroundFlush_){
+        pthread_mutex_lock(&mutex_);
+        if (spare_.size() > 0){
+            packed.swap(spare_.back());
+            spare_.pop_back();
+        }
+        pthread_mutex_unlock(&mutex_);
+    }
+    packed.resize(rows * num);
+    unsigned long left = 0;
+    for (unsigned int ii = 0; ii < num; ++ii){
+        const vector< double >& buf = buffer_[ii];
+        unsigned int have = min(rows, (unsigned int)buf.size() - popStart_);
+        for (unsigned int jj = 0; jj < have; ++jj){
+            packed[jj * num + ii] = buf[popStart_ + jj];
+        }
+        for (unsigned int jj = have; jj < rows; ++jj){
+            packed[jj * num + ii] = numeric_limits< double >::quiet_NaN();
+        }
+        numPadded_ += rows - have;
+        left += buf.size() - popStart_ - have;
+    }
+    popStart_ += rows;
+    // The sent rows are only cut off the buffers once no more is left
+    // behind them than was sent, so each sample is moved about once.
+    if (left <= (unsigned long)popStart_ * num){
+        for (unsigned int ii = 0; ii < num; ++ii){
+            vector< double >& buf = buffer_[ii];
+            buf.erase(buf.begin(), buf.begin() + min(popStart_, (unsigned int)buf.size()));
+        }
+        popStart_ = 0;
+    }
+
+    if (!useBackgroundFlush_){
+        writeRows(packed);
+        return;
+    }
+    if (!writerRunning_){
+        startWriter();
+        if (!writerRunning_){
+            writeRows(packed);
+            return;
+        }
+    }
+    pthread_mutex_lock(&mutex_);
+    pending_.push_back(Block());
+    pending_.back().slot = POPULATION;
+    pending_.back().data.swap(packed);
+    pthread_cond_signal(&workCond_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void HDF5DataWriter::writePadded()
+{
+    pthread_mutex_lock(&hdf5Mutex);
+    if (popDataset_ >= 0){
+        long value = numPadded_;
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr = H5Aexists(popDataset_, "numPadded") > 0 ?
+                H5Aopen(popDataset_, "numPadded", H5P_DEFAULT) :
+                H5Acreate2(popDataset_, "numPadded", H5T_NATIVE_LONG, space, H5P_DEFAULT, H5P_DEFAULT);
+        if (attr < 0 || H5Awrite(attr, H5T_NATIVE_LONG, &value) < 0){
+            cerr << "Warning: could not record the padding of population " << popPath_ << endl;
+        }
+        if (attr >= 0){
+            H5Aclose(attr);
+        }
+        H5Sclose(space);
+    }
+    pthread_mutex_unlock(&hdf5Mutex);
+}
+
+void HDF5DataWriter::writeRows(const vector< double >& data)
+{
+    pthread_mutex_lock(&hdf5Mutex);
+    if (popDataset_ < 0 && !create_population()){
+        pthread_mutex_unlock(&hdf5Mutex);
+        return;
+    }
+    herr_t status = -1;
+    hid_t filespace = H5Dget_space(popDataset_);
+    hsize_t dims[2];
+    if (filespace >= 0){
+        H5Sget_simple_extent_dims(filespace, dims, NULL);
+        H5Sclose(filespace);
+        hsize_t count[2] = {data.size() / dims[1], dims[1]};
+        hsize_t start[2] = {dims[0], 0};
+        dims[0] += count[0];
+        status = H5Dset_extent(popDataset_, dims);
+        if (status >= 0){
+            filespace = H5Dget_space(popDataset_);
+            hid_t memspace = H5Screate_simple(2, count, NULL);
+            H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL, count, NULL);
+            status = H5Dwrite(popDataset_, H5T_NATIVE_DOUBLE, memspace, filespace, H5P_DEFAULT, &data[0]);
+            H5Sclose(memspace);
+            H5Sclose(filespace);
+        }
+    }
+    pthread_mutex_unlock(&hdf5Mutex);
+    if (status < 0){
+        cerr << "Warning: appending data for population " << popPath_ << " returned status " << status << endl;
     }
 }
 
+/**
+   Create the 2-D dataset for the population, chunked by whole rows,
+   and the dataset of source paths. */
+bool HDF5DataWriter::create_population()
+{
+    hid_t group = get_group(popPath_);
+    if (group < 0){
+        return false;
+    }
+    hsize_t num = popSources_.size();
+    hsize_t dims[2] = {0, num};
+    hsize_t maxdims[2] = {H5S_UNLIMITED, num};
+    hsize_t chunk_dims[2] = {max((hsize_t)1, chunkSize_ / num), num};
+    hid_t chunk_params = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(chunk_params, 2, chunk_dims);
+    if (compressor_ == "zlib"){
+        H5Pset_deflate(chunk_params, compression_);
+    } else if (compressor_ == "szip"){
+        unsigned sz_opt_mask = H5_SZIP_NN_OPTION_MASK;
+        H5Pset_szip(chunk_params, sz_opt_mask, HDF5WriterBase::CHUNK_SIZE);
+    }
+    hid_t dataspace = H5Screate_simple(2, dims, maxdims);
+    popDataset_ = H5Dcreate2(group, "data", H5T_NATIVE_DOUBLE, dataspace, H5P_DEFAULT, chunk_params, H5P_DEFAULT);
+    H5Sclose(dataspace);
+    H5Pclose(chunk_params);
+
+    // The paths of the sources, as fixed length strings.
+    size_t len = 1;
+    for (unsigned int ii = 0; ii < num; ++ii){
+        len = max(len, popSources_[ii].length() + 1);
+    }
+    vector< char > names(num * len, '\0');
+    for (unsigned int ii = 0; ii < num; ++ii){
+        copy(popSources_[ii].begin(), popSources_[ii].end(), names.begin() + ii * len);
+    }
+    hid_t strtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(strtype, len);
+    dataspace = H5Screate_simple(1, &num, NULL);
+    hid_t sources = H5Dcreate2(group, "sources", strtype, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (sources >= 0){
+        H5Dwrite(sources, strtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, &names[0]);
+        H5Dclose(sources);
+    }
+    H5Sclose(dataspace);
+    H5Tclose(strtype);
+    if (group != filehandle_){
+        H5Gclose(group);
+    }
+    if (popDataset_ < 0 || sources < 0){
+        cerr << "Error: could not create the population datasets under " << popPath_ << endl;
+        return false;
+    }
+    return true;
+}
+
+void HDF5DataWriter::startWriter()
+{
+    quit_ = false;
+    int ret = pthread_create(&writer_, NULL, &HDF5DataWriter::writerLoop, this);
+    if (ret != 0){
+        cerr << "Warning: HDF5DataWriter: could not start writer thread, writing in foreground." << endl;
+        useBackgroundFlush_ = false;
+        return;
+    }
+    writerRunning_ = true;
+}
+
+void HDF5DataWriter::stopWriter()
+{
+    if (!writerRunning_){
+        return;
+    }
+    pthread_mutex_lock(&mutex_);
+    quit_ = true;
+    pthread_cond_signal(&workCond_);
+    pthread_mutex_unlock(&mutex_);
+    pthread_join(writer_, NULL);
+    writerRunning_ = false;
+    spare_.clear();
+}
+
+void HDF5DataWriter::drain()
+{
+    if (!writerRunning_){
+        return;
+    }
+    pthread_mutex_lock(&mutex_);
+    while (pending_.size() > 0 || busy_){
+        pthread_cond_wait(&doneCond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+void* HDF5DataWriter::writerLoop(void* self)
+{
+    HDF5DataWriter* w = reinterpret_cast< HDF5DataWriter* >(self);
+    Block block;
+    pthread_mutex_lock(&w->mutex_);
+    while (true){
+        while (w->pending_.size() == 0 && !w->quit_){
+            pthread_cond_wait(&w->workCond_, &w->mutex_);
+        }
+        if (w->pending_.size() == 0){
+            break; // Only quit once everything is written.
+        }
+        block.slot = w->pending_.front().slot;
+        block.data.swap(w->pending_.front().data);
+        w->pending_.pop_front();
+        w->busy_ = true;
+        pthread_mutex_unlock(&w->mutex_);
+
+        if (block.slot == POPULATION){
+            w->writeRows(block.data);
+        } else {
+            w->writeSlot(block.slot, block.data);
+        }
+        block.data.clear();
+
+        pthread_mutex_lock(&w->mutex_);
+        w->spare_.push_back(vector< double >());
+        w->spare_.back().swap(block.data);
+        w->busy_ = false;
+        pthread_cond_broadcast(&w->doneCond_);
+    }
+    pthread_mutex_unlock(&w->mutex_);
+    return NULL;
+}
+
 /**
    Traverse the path of an object in HDF5 file, checking existence of
-   groups in the path and creating them if required.  */
-hid_t HDF5DataWriter::get_dataset(string path)
+   groups in the path and creating them if required. Returns the last
+   group, which the caller must close unless it is the file. */
+hid_t HDF5DataWriter::get_group(string path)
 {
     if (filehandle_ < 0){
         return -1;
@@ -218,7 +700,7 @@ hid_t HDF5DataWriter::get_dataset(string path)
     tokenize(path, "/", path_tokens);
     hid_t prev_id = filehandle_;
     hid_t id = -1;
-    for ( unsigned int ii = 0; ii < path_tokens.size()-1; ++ii ){
+    for ( unsigned int ii = 0; ii < path_tokens.size(); ++ii ){
         // check if object exists
         htri_t exists = H5Lexists(prev_id, path_tokens[ii].c_str(), H5P_DEFAULT);
         if (exists > 0){
@@ -246,16 +728,32 @@ hid_t HDF5DataWriter::get_dataset(string path)
         }
         prev_id = id;
     }
-    string name = path_tokens[path_tokens.size()-1];
-    htri_t exists = H5Lexists(prev_id, name.c_str(), H5P_DEFAULT);
+    return prev_id;
+}
+
+/**
+   Open the dataset for the object at path, creating it and the groups
+   above it if required. */
+hid_t HDF5DataWriter::get_dataset(string path)
+{
+    string::size_type pos = path.rfind('/');
+    string name = path.substr(pos + 1);
+    hid_t parent_id = get_group(path.substr(0, pos));
+    if (parent_id < 0){
+        return -1;
+    }
+    htri_t exists = H5Lexists(parent_id, name.c_str(), H5P_DEFAULT);
     hid_t dataset_id = -1;
     if (exists > 0){
-        dataset_id = H5Dopen2(prev_id, name.c_str(), H5P_DEFAULT);
+        dataset_id = H5Dopen2(parent_id, name.c_str(), H5P_DEFAULT);
     } else if (exists == 0){
-        dataset_id = create_dataset(prev_id, name);
+        dataset_id = create_dataset(parent_id, name);
     } else {
         cerr << "Error: H5Lexists returned " << exists << " for path \"" << path << "\"" << endl;
     }
+    if (parent_id != filehandle_){
+        H5Gclose(parent_id);
+    }
     return dataset_id;
 }
 
@@ -316,34 +814,16 @@ herr_t HDF5DataWriter::appendToDataset(hid_t dataset_id, const vector< double >&
 void HDF5DataWriter::recvData(const Eref&e, 
 				ObjId src, const double* start, unsigned int num )
 {
-    string path = src.path();
-    if (nodemap_.find(path) == nodemap_.end()){
-        // first time call, initialize entries in map
-        hid_t dataid =  get_dataset(path);
-        if (dataid < 0){
-            cerr << "Warning: could not create data set for " << path << endl;
-        }
-        nodemap_[path] = dataid;
-        datamap_[path] = vector<double>();
+    unsigned int slot = getSlot(src);
+    if (popSources_.size() > 0 && slot >= popSources_.size()){
+        SetGet0::set(src, "clearVec");
+        return;
     }
-    const double * end = start + num;
-    // append only the new data. old_size is guaranteed to be 0 on
-    // write and the table vecs will also be cleared.
-    datamap_[path].insert(datamap_[path].end(), start, end);
+    vector< double >& buf = buffer_[slot];
+    // append only the new data. The table vecs are cleared below.
+    buf.insert(buf.end(), start, start + num);
 
     SetGet0::set(src, "clearVec"); //Unsure what this is for.
-	
-// #ifndef NDEBUG
-//     // debug leftover entries coming from table
-//     cout << "HDF5DataWriter::recvData: vec_size=" << vec_size << endl;
-//     cout << "HDF5DataWriter::recvData: dataSize=" << pb.dataSize() << endl;
-//     cout << "HDF5DataWriter::recvData: numEntries=" << pb.numEntries()  << endl;
-//     cout << "HDF5DataWriter::recvData: size=" << pb.size() << endl;
-//     cout << "HDF5DataWriter::recvData: data()" << endl;
-//     for (int ii = 0; ii <= vec_size; ++ii){
-//         cout << ii << "\t" << pb.data()[ii] << endl;
-//     }
-// #endif
 }
         
 #endif // USE_HDF5
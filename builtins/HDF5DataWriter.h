@@ -19,9 +19,10 @@
 // 
 // Specialization of HDF5WriterBase to save Table objects in
 // MOOSE. The table can be regular table or Stimulus table. The data
-// is appended to an existing dataset at each process step. An
-// explicit writing is also allowed via the flush command.  As soon as
-// the data from a table is written to file, the table is cleared.
+// is collected from the tables at each process step and cleared from
+// them. It is written out to the dataset for each table once
+// flushLimit samples have built up, optionally on a separate thread.
+// An explicit writing is also allowed via the flush command.
 // 
 
 // Change log:
@@ -32,29 +33,122 @@
 // Code:
 #ifdef USE_HDF5
 #ifndef _HDF5DATAWRITER_H
+#define _HDF5DATAWRITER_H
 
+#include <deque>
+#include <pthread.h>
 #include "HDF5WriterBase.h"
 
 class HDF5DataWriter: public HDF5WriterBase
 {
   public:
     HDF5DataWriter();
+    /// Copies only the settings, the copy has its own buffers and thread.
+    HDF5DataWriter(const HDF5DataWriter& other);
+    HDF5DataWriter& operator=(const HDF5DataWriter& other);
     virtual ~HDF5DataWriter();
     void setFlushLimit(unsigned int limit);
     unsigned int getFlushLimit() const;
-    // void flush();
+    void setUseBackgroundFlush(bool value);
+    bool getUseBackgroundFlush() const;
+    void setLayout(string layout);
+    string getLayout() const;
     void process(const Eref &e, ProcPtr p);
     void reinit(const Eref &e, ProcPtr p);
     void recvData(const Eref& e, ObjId src, const double* start, unsigned int num );
     virtual void flush();
+    virtual void close();
     static const Cinfo* initCinfo();
   protected:
+    /// Number of samples buffered for each source before it is written.
     unsigned int flushLimit_;
-    // Maps the paths of data sources to vectors storing the data locally
-    map <string, vector <double> > datamap_;
+    /// If true, the writes are done by a separate thread.
+    bool useBackgroundFlush_;
+    /**
+     * "separate" for one 1-D dataset per source, or "population" for
+     * a single 2-D [time x source] dataset for all sources, with the
+     * paths of the sources in a second dataset.
+     */
+    string layout_;
+
+    /// Each data source has a slot, in the order it was first seen.
+    map< ObjId, unsigned int > slots_;
+    /**
+     * Path of the dataset for each slot. This and slotDataset_ are
+     * read by the writer thread, so they only change under the HDF5
+     * lock.
+     */
+    vector< string > slotPath_;
+    /// Dataset for each slot, -1 till it is opened.
+    vector< hid_t > slotDataset_;
+    /// Samples held for each slot, preallocated to flushLimit_.
+    vector< vector< double > > buffer_;
+
+    /// Returns the slot for src, assigning one on first sight.
+    unsigned int getSlot(ObjId src);
+    /// Sends the buffered data of the slot to be written.
+    void handOff(unsigned int slot);
+    /// Writes data to the dataset of the slot. Takes the HDF5 lock.
+    void writeSlot(unsigned int slot, const vector< double >& data);
+    /// Closes the datasets and forgets the slots.
+    void clearSlots();
+
+    ////////////////////////////////////////////////////////////////
+    // Population layout. The set of sources is fixed when the first
+    // rows are sent to be written, later sources are ignored.
+    ////////////////////////////////////////////////////////////////
+    /// Packs the rows for which all sources have data, and sends them
+    /// if there are at least minRows. With pad, the sources that are
+    /// short of the longest one are filled up with NaN, so that all
+    /// the rows go.
+    void handOffRows(unsigned int minRows, bool pad = false);
+    /// Records numPadded_ on the population dataset.
+    void writePadded();
+    /// Writes packed rows to the population dataset.
+    void writeRows(const vector< double >& data);
+    /// Creates the population datasets under the writer's own path.
+    bool create_population();
+    /// Path of the writer, under which the population is written.
+    string popPath_;
+    /// Paths of the sources in the population, one per column.
+    vector< string > popSources_;
+    hid_t popDataset_;
+    /// Rows at the front of the buffers that have already been sent.
+    unsigned int popStart_;
+    /// Samples filled with NaN because the sources got out of step.
+    unsigned long numPadded_;
+
+    hid_t get_group(string path);
     hid_t get_dataset(string path);
     hid_t create_dataset(hid_t parent, string name);
     herr_t appendToDataset(hid_t dataset, const vector<double>& data);
+
+    ////////////////////////////////////////////////////////////////
+    // Background writing. Full buffers are queued as blocks, and the
+    // writer thread writes them in order, and returns the emptied
+    // vectors to the spares for reuse.
+    ////////////////////////////////////////////////////////////////
+    struct Block {
+        unsigned int slot;
+        vector< double > data;
+    };
+    void startWriter();
+    /// Waits till the queue is written, and then stops the thread.
+    void stopWriter();
+    /// Waits till the queue is written.
+    void drain();
+    static void* writerLoop(void* self);
+
+    deque< Block > pending_;
+    vector< vector< double > > spare_;
+    pthread_t writer_;
+    bool writerRunning_;
+    bool quit_;
+    /// True while the writer thread is writing a block.
+    bool busy_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t workCond_;
+    pthread_cond_t doneCond_;
 };
 #endif // _HDF5DATAWRITER_H
 #endif // USE_HDF5
@@ -14,7 +14,12 @@
 #include "Arith.h"
 #include "TableBase.h"
 #include "Table.h"
+#include "Func.h"
 #include <queue>
+#ifdef USE_HDF5
+#include "hdf5.h"
+#include "HDF5DataWriter.h"
+#endif
 
 #include "../shell/Shell.h"
 
@@ -264,6 +269,152 @@ void testTable()
 	cout << "." << flush;
 }
 
+#ifdef USE_HDF5
+/**
+ * Feeds data to an HDF5DataWriter in small pieces, with the writes done
+ * by the background thread, and checks that it all comes out in order.
+ */
+void testHDF5DataWriter()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	const char* fname = "test_hdf5datawriter.h5";
+	ObjId tabid = shell->doCreate( "Table", ObjId(), "h5tab", 1 );
+	ObjId wid = shell->doCreate( "HDF5DataWriter", ObjId(), "h5w", 1 );
+	Field< string >::set( wid, "filename", fname );
+	Field< unsigned int >::set( wid, "mode", H5F_ACC_TRUNC );
+	Field< unsigned int >::set( wid, "flushLimit", 10 );
+	Field< bool >::set( wid, "useBackgroundFlush", true );
+	HDF5DataWriter* w = reinterpret_cast< HDF5DataWriter* >(
+		wid.eref().data() );
+	ProcInfo p;
+	w->reinit( wid.eref(), &p );
+	assert( Field< bool >::get( wid, "isOpen" ) );
+
+	unsigned int num = 0;
+	for ( unsigned int i = 0; i < 20; ++i ) {
+		double data[7];
+		for ( unsigned int j = 0; j < 7; ++j )
+			data[j] = num++;
+		w->recvData( wid.eref(), tabid, data, 7 );
+		w->process( wid.eref(), &p );
+	}
+	SetGet0::set( wid, "close" );
+	assert( !Field< bool >::get( wid, "isOpen" ) );
+
+	hid_t file = H5Fopen( fname, H5F_ACC_RDONLY, H5P_DEFAULT );
+	assert( file >= 0 );
+	hid_t dataset = H5Dopen2( file, "h5tab[0]", H5P_DEFAULT );
+	assert( dataset >= 0 );
+	hid_t space = H5Dget_space( dataset );
+	assert( H5Sget_simple_extent_npoints( space ) == num );
+	vector< double > ret( num );
+	herr_t status = H5Dread( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+		H5P_DEFAULT, &ret[0] );
+	assert( status >= 0 );
+	for ( unsigned int i = 0; i < num; ++i )
+		assert( doubleEq( ret[i], i ) );
+	H5Sclose( space );
+	H5Dclose( dataset );
+	H5Fclose( file );
+	remove( fname );
+
+	shell->doDelete( wid );
+	shell->doDelete( tabid );
+	cout << "." << flush;
+}
+
+/**
+ * Writes three tables as a population, in the foreground and in the
+ * background, and checks the 2-D dataset and the index of sources.
+ * The first table runs ahead of the others, and ends up with more
+ * samples, which must be padded out with NaN.
+ */
+void testHDF5Population()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	const char* fname = "test_hdf5population.h5";
+	const unsigned int numTabs = 3;
+	const unsigned int numRows = 25;
+	const unsigned int extra = 2;
+	ObjId tabid = shell->doCreate( "Table", ObjId(), "h5pop", numTabs );
+	for ( unsigned int background = 0; background < 2; ++background ) {
+		ObjId wid = shell->doCreate( "HDF5DataWriter", ObjId(), "h5w", 1 );
+		Field< string >::set( wid, "filename", fname );
+		Field< unsigned int >::set( wid, "mode", H5F_ACC_TRUNC );
+		Field< unsigned int >::set( wid, "flushLimit", 4 );
+		Field< bool >::set( wid, "useBackgroundFlush", background );
+		Field< string >::set( wid, "layout", "population" );
+		assert( Field< string >::get( wid, "layout" ) == "population" );
+		HDF5DataWriter* w = reinterpret_cast< HDF5DataWriter* >(
+			wid.eref().data() );
+		ProcInfo p;
+		w->reinit( wid.eref(), &p );
+
+		// The first table sends all its samples at the start, and the
+		// others 5 per step, so rows go out in 5s.
+		for ( unsigned int i = 0; i < numRows; i += 5 ) {
+			for ( unsigned int j = 0; j < numTabs; ++j ) {
+				if ( j == 0 && i > 0 )
+					continue;
+				unsigned int n = ( j == 0 ) ? numRows + extra : 5;
+				vector< double > data( n );
+				for ( unsigned int k = 0; k < n; ++k )
+					data[k] = ( i + k ) * 10 + j;
+				w->recvData( wid.eref(), ObjId( tabid.id, j ), &data[0], n );
+			}
+			w->process( wid.eref(), &p );
+		}
+		SetGet0::set( wid, "close" );
+
+		hid_t file = H5Fopen( fname, H5F_ACC_RDONLY, H5P_DEFAULT );
+		assert( file >= 0 );
+		hid_t dataset = H5Dopen2( file, "h5w[0]/data", H5P_DEFAULT );
+		assert( dataset >= 0 );
+		hid_t space = H5Dget_space( dataset );
+		hsize_t dims[2];
+		H5Sget_simple_extent_dims( space, dims, NULL );
+		assert( dims[0] == numRows + extra && dims[1] == numTabs );
+		vector< double > ret( dims[0] * numTabs );
+		H5Dread( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+			H5P_DEFAULT, &ret[0] );
+		for ( unsigned int i = 0; i < dims[0]; ++i ) {
+			for ( unsigned int j = 0; j < numTabs; ++j ) {
+				double x = ret[ i * numTabs + j ];
+				if ( i < numRows || j == 0 )
+					assert( doubleEq( x, i * 10 + j ) );
+				else
+					assert( x != x ); // NaN
+			}
+		}
+		hid_t attr = H5Aopen( dataset, "numPadded", H5P_DEFAULT );
+		assert( attr >= 0 );
+		long numPadded = 0;
+		H5Aread( attr, H5T_NATIVE_LONG, &numPadded );
+		assert( numPadded == extra * ( numTabs - 1 ) );
+		H5Aclose( attr );
+		H5Sclose( space );
+		H5Dclose( dataset );
+
+		dataset = H5Dopen2( file, "h5w[0]/sources", H5P_DEFAULT );
+		assert( dataset >= 0 );
+		hid_t type = H5Dget_type( dataset );
+		size_t len = H5Tget_size( type );
+		vector< char > names( len * numTabs );
+		H5Dread( dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &names[0] );
+		for ( unsigned int j = 0; j < numTabs; ++j )
+			assert( string( &names[ j * len ] ) ==
+				ObjId( tabid.id, j ).path() );
+		H5Tclose( type );
+		H5Dclose( dataset );
+		H5Fclose( file );
+		remove( fname );
+		shell->doDelete( wid );
+	}
+	shell->doDelete( tabid );
+	cout << "." << flush;
+}
+#endif // USE_HDF5
+
 /**
  * Tests capacity to send a request for a field value to an object
  */
@@ -321,10 +472,119 @@ void testGetMsg()
 	
 }
 
+/**
+ * Checks that copies of a Func are independent, and that the bulk
+ * evaluation of a Func array gives the same outputs as evaluating each
+ * entry on its own, including for entries that leave their group or
+ * have variables left over from an earlier expression.
+ */
+void testFuncBulk()
+{
+	Func a;
+	a.setExpr( "x + 1" );
+	a.setX( 2 );
+	Func b( a );
+	b.setX( 5 );
+	assert( doubleEq( a.getValue(), 3.0 ) );
+	assert( doubleEq( b.getValue(), 6.0 ) );
+
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	unsigned int size = 10;
+	Id fid = shell->doCreate( "Func", Id(), "func", size );
+	Id aid = shell->doCreate( "Arith", Id(), "arith", size );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		ObjId f( fid, i );
+		// Entries 0 and 6 keep a variable q from an earlier expression.
+		if ( i == 0 || i == 6 )
+			Field< string >::set( f, "expr", "q + x" );
+		Field< string >::set( f, "expr", i == 3 ? "x - y" : "x * 2 + y" );
+		Field< bool >::set( f, "useBulk", i != 5 );
+		Field< double >::set( f, "x", i );
+		Field< double >::set( f, "y", 10.0 - i );
+	}
+	ObjId mid = shell->doAddMsg( "OneToOne", fid, "valueOut", aid, "arg1" );
+	assert( !mid.bad() );
+	shell->doUseClock( "/func", "process", 0 );
+	shell->doSetClock( 0, 1.0 );
+	shell->doReinit();
+	shell->doStart( 1 );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		double v = Field< double >::get( ObjId( aid, i ), "arg1Value" );
+		if ( i == 3 )
+			assert( doubleEq( v, 2.0 * i - 10.0 ) );
+		else
+			assert( doubleEq( v, i + 10.0 ) );
+	}
+
+	// Entry 2 leaves its group until the next reinit.
+	Field< string >::set( ObjId( fid, 2 ), "expr", "x * 3" );
+	Field< double >::set( ObjId( fid, 2 ), "x", 2.0 );
+	Field< double >::set( ObjId( fid, 4 ), "x", 100.0 );
+	shell->doStart( 1 );
+	double v = Field< double >::get( ObjId( aid, 2 ), "arg1Value" );
+	assert( doubleEq( v, 6.0 ) );
+	v = Field< double >::get( ObjId( aid, 4 ), "arg1Value" );
+	assert( doubleEq( v, 206.0 ) );
+
+	// With Clock threads the bulk array is kept in one group.
+	Id clock( 1 );
+	Clock* cdata = reinterpret_cast< Clock* >( clock.eref().data() );
+	Field< unsigned int >::set( clock, "numThreads", 3 );
+	shell->doReinit();
+	assert( cdata->groupStart_.size() == 1 );
+	assert( cdata->groupStart_[0].size() == 2 );
+	shell->doStart( 1 );
+	v = Field< double >::get( ObjId( aid, 2 ), "arg1Value" );
+	assert( doubleEq( v, 6.0 ) );
+	v = Field< double >::get( ObjId( aid, 4 ), "arg1Value" );
+	assert( doubleEq( v, 206.0 ) );
+	Field< unsigned int >::set( clock, "numThreads", 1 );
+	shell->doDelete( fid );
+
+	// Only the scheduled entries are grouped, and the first of them
+	// need not be the first entry. Here the old groups are led by
+	// entry 0, which is then taken off the clock.
+	fid = shell->doCreate( "Func", Id(), "func", 4 );
+	for ( unsigned int i = 0; i < 4; ++i ) {
+		ObjId f( fid, i );
+		Field< string >::set( f, "expr", "x + 1" );
+		Field< bool >::set( f, "useBulk", true );
+		Field< double >::set( f, "x", i );
+	}
+	mid = shell->doAddMsg( "OneToOne", fid, "valueOut", aid, "arg1" );
+	assert( !mid.bad() );
+	shell->doUseClock( "/func", "process", 0 );
+	shell->doReinit();
+	shell->doStart( 1 );
+	vector< ObjId > all( 1, ObjId( fid ) );
+	Shell::dropClockMsgs( all, "process" );
+	for ( unsigned int i = 2; i < 4; ++i ) {
+		mid = shell->doAddMsg( "Single", clock, "proc0", 
+			ObjId( fid, i ), "proc" );
+		assert( !mid.bad() );
+		Field< double >::set( ObjId( fid, i ), "x", 10.0 * i );
+	}
+	shell->doReinit();
+	shell->doStart( 1 );
+	for ( unsigned int i = 2; i < 4; ++i ) {
+		v = Field< double >::get( ObjId( aid, i ), "arg1Value" );
+		assert( doubleEq( v, 10.0 * i + 1.0 ) );
+	}
+
+	shell->doDelete( fid );
+	shell->doDelete( aid );
+	cout << "." << flush;
+}
+
 void testBuiltins()
 {
 	testArith();
 	testTable();
+	testFuncBulk();
+#ifdef USE_HDF5
+	testHDF5DataWriter();
+	testHDF5Population();
+#endif
 }
 
 void testBuiltinsProcess()
@@ -0,0 +1,164 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cassert>
+#include <string>
+#include <iostream>
+using namespace std;
+
+#include "SparseMatrix.h"
+#include "DiffBatch.h"
+
+DiffBatch::DiffBatch()
+	: numVoxels_( 0 ), numColumns_( 0 )
+{;}
+
+void DiffBatch::clear()
+{
+	numVoxels_ = 0;
+	numColumns_ = 0;
+	opFrom_.clear();
+	opTo_.clear();
+	opCoeff_.clear();
+	diagVal_.clear();
+	n_.clear();
+	nOld_.clear();
+}
+
+bool DiffBatch::matches( const vector< Triplet< double > >& ops ) const
+{
+	if ( numColumns_ == 0 )
+		return true;
+	if ( ops.size() != opFrom_.size() )
+		return false;
+	for ( unsigned int i = 0; i < ops.size(); ++i )
+		if ( ops[i].b_ != opFrom_[i] || ops[i].c_ != opTo_[i] )
+			return false;
+	return true;
+}
+
+/**
+ * Repacks the arrays with one more column. This is only done at
+ * build time, so the cost of the copy does not matter.
+ */
+static void addToInterleaved( vector< double >& vec, unsigned int numRows,
+	unsigned int numColumns, const vector< double >& col )
+{
+	assert( vec.size() == numRows * numColumns );
+	assert( col.size() == numRows );
+	vector< double > old( numRows * ( numColumns + 1 ) );
+	old.swap( vec );
+	for ( unsigned int i = 0; i < numRows; ++i ) {
+		copy( old.begin() + i * numColumns,
+			old.begin() + ( i + 1 ) * numColumns,
+			vec.begin() + i * ( numColumns + 1 ) );
+		vec[ i * ( numColumns + 1 ) + numColumns ] = col[i];
+	}
+}
+
+unsigned int DiffBatch::addColumn( const vector< Triplet< double > >& ops,
+	const vector< double >& diagVal, const vector< double >& n )
+{
+	assert( matches( ops ) );
+	assert( diagVal.size() == n.size() );
+	if ( numColumns_ == 0 ) {
+		numVoxels_ = n.size();
+		opFrom_.resize( ops.size() );
+		opTo_.resize( ops.size() );
+		for ( unsigned int i = 0; i < ops.size(); ++i ) {
+			opFrom_[i] = ops[i].b_;
+			opTo_[i] = ops[i].c_;
+		}
+	}
+	assert( n.size() == numVoxels_ );
+	vector< double > coeff( ops.size() );
+	for ( unsigned int i = 0; i < ops.size(); ++i )
+		coeff[i] = ops[i].a_;
+	addToInterleaved( opCoeff_, ops.size(), numColumns_, coeff );
+	addToInterleaved( diagVal_, numVoxels_, numColumns_, diagVal );
+	addToInterleaved( n_, numVoxels_, numColumns_, n );
+	return numColumns_++;
+}
+
+void DiffBatch::advance()
+{
+	const unsigned int nc = numColumns_;
+	if ( nc == 0 )
+		return;
+	double* n = &n_[0];
+	const double* coeff = opCoeff_.empty() ? 0 : &opCoeff_[0];
+	for ( unsigned int i = 0; i < opFrom_.size(); ++i ) {
+		const double* from = n + opFrom_[i] * nc;
+		double* to = n + opTo_[i] * nc;
+		const double* a = coeff + i * nc;
+		for ( unsigned int j = 0; j < nc; ++j )
+			to[j] -= from[j] * a[j];
+	}
+
+	const double* d = &diagVal_[0];
+	const unsigned int size = n_.size();
+	for ( unsigned int i = 0; i < size; ++i )
+		n[i] *= d[i];
+}
+
+void DiffBatch::advanceCrankNicolson()
+{
+	nOld_ = n_;
+	advance();
+	const unsigned int size = n_.size();
+	for ( unsigned int i = 0; i < size; ++i )
+		n_[i] = 2.0 * n_[i] - nOld_[i];
+}
+
+unsigned int DiffBatch::getNumColumns() const
+{
+	return numColumns_;
+}
+
+unsigned int DiffBatch::getNumVoxels() const
+{
+	return numVoxels_;
+}
+
+double DiffBatch::getN( unsigned int vox, unsigned int col ) const
+{
+	assert( vox < numVoxels_ && col < numColumns_ );
+	return n_[ vox * numColumns_ + col ];
+}
+
+void DiffBatch::setN( unsigned int vox, unsigned int col, double value )
+{
+	assert( vox < numVoxels_ && col < numColumns_ );
+	n_[ vox * numColumns_ + col ] = value;
+}
+
+vector< double > DiffBatch::getNvec( unsigned int col ) const
+{
+	assert( col < numColumns_ );
+	vector< double > ret( numVoxels_ );
+	for ( unsigned int i = 0; i < numVoxels_; ++i )
+		ret[i] = n_[ i * numColumns_ + col ];
+	return ret;
+}
+
+void DiffBatch::setNvec( unsigned int col, const vector< double >& n )
+{
+	assert( col < numColumns_ );
+	assert( n.size() == numVoxels_ );
+	for ( unsigned int i = 0; i < numVoxels_; ++i )
+		n_[ i * numColumns_ + col ] = n[i];
+}
+
+double* DiffBatch::getRow( unsigned int vox )
+{
+	assert( vox < numVoxels_ );
+	return &n_[ vox * numColumns_ ];
+}
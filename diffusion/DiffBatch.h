@@ -0,0 +1,90 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _DIFF_BATCH_H
+#define _DIFF_BATCH_H
+
+/**
+ * Does the diffusion step for many pools at once. All the pools on a
+ * mesh have the same sparsity pattern, so the elimination visits the
+ * same (from, to) voxel pairs in the same order for each of them, and
+ * only the coefficients differ. The DiffBatch keeps one copy of the
+ * pattern, and stores the coefficients and the 'n' of all its pools
+ * interleaved by voxel, as [voxel][column]. The sweep then goes once
+ * through the pattern, and for each entry does a short contiguous
+ * loop over the columns, which the compiler can vectorize.
+ *
+ * The arithmetic for each column is exactly that of
+ * DiffPoolVec::advance, so the results are identical.
+ */
+class DiffBatch
+{
+	public:
+		DiffBatch();
+
+		/// Removes all columns.
+		void clear();
+
+		/**
+		 * True if the ops follow the pattern of the batch, or the
+		 * batch is empty.
+		 */
+		bool matches( const vector< Triplet< double > >& ops ) const;
+
+		/**
+		 * Adds a pool as a new column, and returns the column index.
+		 * The ops must match the pattern.
+		 */
+		unsigned int addColumn( const vector< Triplet< double > >& ops,
+			const vector< double >& diagVal, const vector< double >& n );
+
+		/// Advances all columns by one timestep.
+		void advance();
+
+		/**
+		 * Advances all columns by a Crank-Nicolson step of twice the
+		 * dt that the ops were built for. If M = I - (dt/2).A is the
+		 * matrix that advance() solves, the Crank-Nicolson update
+		 * M^-1 ( I + (dt/2).A ) n is just 2 M^-1 n - n, so this is
+		 * one ordinary step plus a blend with the old values. It is
+		 * second order in time, whereas advance() is first order.
+		 */
+		void advanceCrankNicolson();
+
+		unsigned int getNumColumns() const;
+		unsigned int getNumVoxels() const;
+
+		double getN( unsigned int vox, unsigned int col ) const;
+		void setN( unsigned int vox, unsigned int col, double value );
+		vector< double > getNvec( unsigned int col ) const;
+		void setNvec( unsigned int col, const vector< double >& n );
+
+		/**
+		 * Returns the 'n' of all columns in the voxel, as a
+		 * contiguous array. Other solvers may work on it in place.
+		 */
+		double* getRow( unsigned int vox );
+
+	private:
+		unsigned int numVoxels_;
+		unsigned int numColumns_;
+		/// Pattern of the elimination: n[to] -= n[from] * coeff
+		vector< unsigned int > opFrom_;
+		vector< unsigned int > opTo_;
+		/// Coefficient of op i for column j is at i * numColumns_ + j
+		vector< double > opCoeff_;
+		/// Diagonal of voxel i for column j is at i * numColumns_ + j
+		vector< double > diagVal_;
+		/// 'n' of voxel i for column j is at i * numColumns_ + j
+		vector< double > n_;
+		/// Workspace for the Crank-Nicolson step.
+		vector< double > nOld_;
+};
+
+#endif // _DIFF_BATCH_H
@@ -62,6 +62,11 @@ void DiffPoolVec::setNvec( const vector< double >& vec )
 	n_ = vec;
 }
 
+double* DiffPoolVec::getNvecPtr()
+{
+	return n_.empty() ? 0 : &n_[0];
+}
+
 double DiffPoolVec::getDiffConst() const
 {
 	return diffConst_;
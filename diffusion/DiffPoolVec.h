@@ -41,6 +41,9 @@ class DiffPoolVec
 		const vector< double >& getNvec() const; 
 		/// Used by parent solver to manipulate 'n'
 		void setNvec( const vector< double >& n ); 
+		/// Used by parent solver to give views of 'n' in place.
+		/// Returns 0 if there are no voxels.
+		double* getNvecPtr();
 		void setOps( const vector< Triplet< double > >& ops_, 
 				const vector< double >& diagVal_ ); /// Assign operations.
 
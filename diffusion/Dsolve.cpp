@@ -12,6 +12,7 @@
 #include "KinSparseMatrix.h"
 #include "ZombiePoolInterface.h"
 #include "DiffPoolVec.h"
+#include "DiffBatch.h"
 #include "FastMatrixElim.h"
 #include "Dsolve.h"
 #include "../mesh/Boundary.h"
@@ -19,6 +20,8 @@
 #include "../mesh/ChemCompt.h"
 #include "../mesh/MeshCompt.h"
 
+static const unsigned int NOT_BATCHED = ~0U;
+
 const Cinfo* Dsolve::initCinfo()
 {
 		///////////////////////////////////////////////////////
@@ -117,7 +120,9 @@ Dsolve::Dsolve()
 	: numTotPools_( 0 ),
 		numLocalPools_( 0 ),
 		poolStartIndex_( 0 ),
-		numVoxels_( 0 )
+		numVoxels_( 0 ),
+		dt_( 0.0 ),
+		isCoupled_( false )
 {;}
 
 Dsolve::~Dsolve()
@@ -132,6 +137,8 @@ void Dsolve::setNvec( unsigned int pool, vector< double > vec )
 	if ( pool < pools_.size() ) {
 		if ( vec.size() != pools_[pool].getNumVoxels() ) {
 			cout << "Warning: Dsolve::setNvec: pool index out of range\n";
+		} else if ( batchColumn_[ pool ] != NOT_BATCHED ) {
+			batch_.setNvec( batchColumn_[ pool ], vec );
 		} else {
 			pools_[ pool ].setNvec( vec );
 		}
@@ -141,30 +148,95 @@ void Dsolve::setNvec( unsigned int pool, vector< double > vec )
 vector< double > Dsolve::getNvec( unsigned int pool ) const
 {
 	static vector< double > ret;
-	if ( pool <  pools_.size() )
+	if ( pool <  pools_.size() ) {
+		if ( batchColumn_[ pool ] != NOT_BATCHED )
+			return batch_.getNvec( batchColumn_[ pool ] );
 		return pools_[pool].getNvec();
+	}
 
 	cout << "Warning: Dsolve::setNvec: pool index out of range\n";
 	return ret;
 }
 
+double* Dsolve::getNvecView( unsigned int pool,
+	unsigned int& size, unsigned int& stride )
+{
+	size = 0;
+	stride = 1;
+	if ( pool >= pools_.size() )
+		return 0;
+	size = pools_[ pool ].getNumVoxels();
+	if ( size == 0 )
+		return 0;
+	if ( batchColumn_[ pool ] != NOT_BATCHED ) {
+		stride = batch_.getNumColumns();
+		return batch_.getRow( 0 ) + batchColumn_[ pool ];
+	}
+	double* ret = pools_[ pool ].getNvecPtr();
+	if ( ret == 0 )
+		size = 0;
+	return ret;
+}
+
+void Dsolve::getState( vector< double >& s ) const
+{
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		vector< double > n = getNvec( i );
+		s.insert( s.end(), n.begin(), n.end() );
+		for ( unsigned int j = 0; j < pools_[i].getNumVoxels(); ++j )
+			s.push_back( pools_[i].getNinit( j ) );
+	}
+}
+
+bool Dsolve::setState( const double* s, unsigned int size )
+{
+	unsigned int total = 0;
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		total += 2 * pools_[i].getNumVoxels();
+	if ( size != total )
+		return false;
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		unsigned int n = pools_[i].getNumVoxels();
+		setNvec( i, vector< double >( s, s + n ) );
+		for ( unsigned int j = 0; j < n; ++j )
+			pools_[i].setNinit( j, s[ n + j ] );
+		s += 2 * n;
+	}
+	return true;
+}
+
 //////////////////////////////////////////////////////////////
 // Process operations.
 //////////////////////////////////////////////////////////////
 void Dsolve::process( const Eref& e, ProcPtr p )
 {
-	for ( vector< DiffPoolVec >::iterator 
-					i = pools_.begin(); i != pools_.end(); ++i ) {
-		i->advance( p->dt );
+	if ( !isCoupled_ )
+		advance();
+}
+
+void Dsolve::advance()
+{
+	batch_.advance();
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		if ( batchColumn_[i] == NOT_BATCHED )
+			pools_[i].advance( dt_ );
 	}
 }
 
+void Dsolve::advanceCrankNicolson()
+{
+	batch_.advanceCrankNicolson();
+}
+
 void Dsolve::reinit( const Eref& e, ProcPtr p )
 {
+	if ( isCoupled_ )
+		return;
 	build( p->dt );
-	for ( vector< DiffPoolVec >::iterator 
-					i = pools_.begin(); i != pools_.end(); ++i ) {
-		i->reinit();
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		pools_[i].reinit();
+		if ( batchColumn_[i] != NOT_BATCHED )
+			batch_.setNvec( batchColumn_[i], pools_[i].getNvec() );
 	}
 }
 //////////////////////////////////////////////////////////////
@@ -202,6 +274,24 @@ Id Dsolve::getCompartment() const
 {
 	return compartment_;
 }
+
+void Dsolve::setCoupled( bool v )
+{
+	isCoupled_ = v;
+}
+
+bool Dsolve::isCoupled() const
+{
+	return isCoupled_;
+}
+
+double* Dsolve::getNrow( unsigned int voxel )
+{
+	if ( batch_.getNumColumns() != pools_.size() || pools_.size() == 0 ||
+			voxel >= batch_.getNumVoxels() )
+		return 0;
+	return batch_.getRow( voxel );
+}
 /////////////////////////////////////////////////////////////
 // Solver building
 //////////////////////////////////////////////////////////////
@@ -223,15 +313,34 @@ void Dsolve::build( double dt )
 {
 	const MeshCompt* m = reinterpret_cast< const MeshCompt* >( 
 						compartment_.eref().data() );
+	unbatch();
+	dt_ = dt;
 	// For now start with local pools only.
 	if ( stoich_ != Id() )
 		numLocalPools_ = Field< unsigned int >::get( stoich_, "numAllPools" );
 	else
 		numLocalPools_ = 1;
+	numTotPools_ = numLocalPools_;
 	pools_.resize( numLocalPools_ );
+	batchColumn_.assign( numLocalPools_, NOT_BATCHED );
 	unsigned int numVoxels = m->getNumEntries();
 
+	// Pools that do not diffuse have no matrix. They get the ops of
+	// the first pool that does, with zero coefficients, so that they
+	// fit in the batch and keep their place in the pool order.
+	vector< vector< Triplet< double > > > fops( numLocalPools_ );
+	vector< vector< double > > diagVal( numLocalPools_ );
+	vector< bool > isStatic( numLocalPools_, false );
+	unsigned int firstMoving = numLocalPools_;
 	for ( unsigned int i = 0; i < numLocalPools_; ++i ) {
+		pools_[i].setNumVoxels( numVoxels_ );
+		if ( pools_[i].getDiffConst() < 1e-18 && 
+				fabs( pools_[i].getMotorConst() ) < 1e-12 ) {
+			isStatic[i] = true;
+			continue;
+		}
+		if ( firstMoving == numLocalPools_ )
+			firstMoving = i;
 		bool debugFlag = false;
 		FastMatrixElim elim( numVoxels, numVoxels );
 		elim.buildForDiffusion( m->getParentVoxel(), m->getVoxelVolume(), 
@@ -250,17 +359,39 @@ void Dsolve::build( double dt )
 		if ( pools_[i].getMotorConst() == 0 )
 			assert( elim.isSymmetric() );
 		vector< unsigned int > diagIndex;
-		vector< double > diagVal;
-		vector< Triplet< double > > fops;
 
-		pools_[i].setNumVoxels( numVoxels_ );
-		elim.buildForwardElim( diagIndex, fops );
-		elim.buildBackwardSub( diagIndex, fops, diagVal );
-		elim.opsReorder( lookupOldRowsFromNew, fops, diagVal );
-		pools_[i].setOps( fops, diagVal );
+		elim.buildForwardElim( diagIndex, fops[i] );
+		elim.buildBackwardSub( diagIndex, fops[i], diagVal[i] );
+		elim.opsReorder( lookupOldRowsFromNew, fops[i], diagVal[i] );
 		if (debugFlag )
 			elim.print();
 	}
+
+	for ( unsigned int i = 0; i < numLocalPools_; ++i ) {
+		if ( isStatic[i] ) {
+			if ( firstMoving < numLocalPools_ )
+				fops[i] = fops[ firstMoving ];
+			for ( unsigned int j = 0; j < fops[i].size(); ++j )
+				fops[i][j].a_ = 0.0;
+			diagVal[i].assign( numVoxels_, 1.0 );
+		}
+		if ( batch_.matches( fops[i] ) )
+			batchColumn_[i] = 
+				batch_.addColumn( fops[i], diagVal[i], pools_[i].getNvec() );
+		else
+			pools_[i].setOps( fops[i], diagVal[i] );
+		vector< Triplet< double > >().swap( fops[i] );
+	}
+}
+
+void Dsolve::unbatch()
+{
+	for ( unsigned int i = 0; i < batchColumn_.size(); ++i ) {
+		if ( batchColumn_[i] != NOT_BATCHED && i < pools_.size() )
+			pools_[i].setNvec( batch_.getNvec( batchColumn_[i] ) );
+	}
+	batchColumn_.assign( pools_.size(), NOT_BATCHED );
+	batch_.clear();
 }
 
 /////////////////////////////////////////////////////////////
@@ -292,17 +423,26 @@ unsigned int Dsolve::convertIdToPoolIndex( const Eref& e ) const
 void Dsolve::setN( const Eref& e, double v )
 {
 	unsigned int vox = e.dataIndex();
-	if ( vox < numVoxels_ )
-		pools_[ convertIdToPoolIndex( e ) ].setN( vox, v );
-	else 
+	if ( vox < numVoxels_ ) {
+		unsigned int pool = convertIdToPoolIndex( e );
+		if ( batchColumn_[ pool ] != NOT_BATCHED )
+			batch_.setN( vox, batchColumn_[ pool ], v );
+		else
+			pools_[ pool ].setN( vox, v );
+	} else {
 		cout << "Warning: Dsolve::setN: Eref out of range\n";
+	}
 }
 
 double Dsolve::getN( const Eref& e ) const
 {
 	unsigned int vox = e.dataIndex();
-	if ( vox <  numVoxels_ )
-		return pools_[ convertIdToPoolIndex( e ) ].getN( vox );
+	if ( vox <  numVoxels_ ) {
+		unsigned int pool = convertIdToPoolIndex( e );
+		if ( batchColumn_[ pool ] != NOT_BATCHED )
+			return batch_.getN( vox, batchColumn_[ pool ] );
+		return pools_[ pool ].getN( vox );
+	}
 	cout << "Warning: Dsolve::getN: Eref out of range\n";
 	return 0.0;
 }
@@ -342,7 +482,9 @@ void Dsolve::setNumPools( unsigned int numPoolSpecies )
 	numLocalPools_ = numPoolSpecies;
 	poolStartIndex_ = 0;
 
+	unbatch();
 	pools_.resize( numLocalPools_ );
+	batchColumn_.assign( numLocalPools_, NOT_BATCHED );
 	for ( unsigned int i = 0 ; i < numLocalPools_; ++i ) {
 		pools_[i].setNumVoxels( numVoxels_ );
 		// pools_[i].setId( reversePoolMap_[i] );
@@ -25,6 +25,10 @@
  * system put each DiffPoolVec on a suitable node for balancing.
  * Some DiffPoolVecs are for molecules that don't diffuse. These
  * simply have an empty opvec.
+ * The pools whose opvecs share the elimination pattern, which is
+ * normally all of them, are moved into a single DiffBatch that
+ * advances them together. Their 'n' then lives in the DiffBatch, and
+ * the DiffPoolVec keeps the rest of the pool data.
  */
 class Dsolve: public ZombiePoolInterface
 {
@@ -47,6 +51,23 @@ class Dsolve: public ZombiePoolInterface
 		vector< double > getNvec( unsigned int pool ) const;
 		void setNvec( unsigned int pool, vector< double > vec );
 
+		/**
+		 * Returns the 'n' of the pool in place, without a copy. Voxel
+		 * i is at index i * stride, and size is the number of voxels.
+		 * Returns 0 if the pool is out of range. The array is valid
+		 * until the solver is rebuilt, which every reinit does.
+		 */
+		double* getNvecView( unsigned int pool,
+			unsigned int& size, unsigned int& stride );
+
+		/**
+		 * Appends the 'n' and 'nInit' of all pools to s, for a
+		 * checkpoint. setState reads them back, and returns false
+		 * without changing anything if the size does not match.
+		 */
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
 		//////////////////////////////////////////////////////////////////
 		// Dest Finfos
 		//////////////////////////////////////////////////////////////////
@@ -75,6 +96,31 @@ class Dsolve: public ZombiePoolInterface
 		// all the stoich and compartment stuff is assigned.
 		void build( double dt );
 
+		/// Advances all pools by the dt given to build.
+		void advance();
+
+		/**
+		 * Advances the batched pools by a Crank-Nicolson step of twice
+		 * the dt given to build. Used by a coupled Ksolve, for which
+		 * all pools are in the batch.
+		 */
+		void advanceCrankNicolson();
+
+		/**
+		 * Returns the 'n' of all pools in the voxel, in pool order, as
+		 * a contiguous array that can be worked on in place. Returns 0
+		 * unless every pool is in the batch.
+		 */
+		double* getNrow( unsigned int voxel );
+
+		/**
+		 * When coupled, the Dsolve is driven by a Ksolve, which calls
+		 * build and advanceCrankNicolson itself. The process and reinit calls
+		 * then do nothing.
+		 */
+		void setCoupled( bool v );
+		bool isCoupled() const;
+
 		/**
 		 * Utility func for debugging: Prints N_ matrix
 		 */
@@ -90,8 +136,22 @@ class Dsolve: public ZombiePoolInterface
 		unsigned int numLocalPools_;
 		unsigned int poolStartIndex_;
 		unsigned int numVoxels_;
+		/// Timestep used to build the elimination ops.
+		double dt_;
 		vector< DiffPoolVec > pools_;
 
+		/// Pools that are advanced together.
+		DiffBatch batch_;
+
+		/// Column of each pool in the batch_, or ~0 if not batched.
+		vector< unsigned int > batchColumn_;
+
+		/// Copies the 'n' of batched pools back to their DiffPoolVecs.
+		void unbatch();
+
+		/// True if a Ksolve is driving this Dsolve.
+		bool isCoupled_;
+
 		/// smallest Id value for pools managed by Dsolve. Used for lookup.
 		unsigned int poolMapStart_;
 
@@ -22,6 +22,8 @@ using namespace std;
 #include "header.h"
 #include "../basecode/SparseMatrix.h"
 #include "FastMatrixElim.h"
+#include "DiffPoolVec.h"
+#include "DiffBatch.h"
 #include "../shell/Shell.h"
 
 
@@ -408,6 +410,94 @@ void testCylDiffn()
 	cout << "." << flush;
 }
 
+/**
+ * Builds the diffusion ops for a branched set of voxels, as the Dsolve
+ * does.
+ */
+static void buildDiffOps( const vector< unsigned int >& parentVoxel,
+	double diffConst, double motorConst, double dt,
+	vector< Triplet< double > >& fops, vector< double >& diagVal )
+{
+	unsigned int numVoxels = parentVoxel.size();
+	vector< double > vol( numVoxels, 1.0e-18 );
+	vector< double > area( numVoxels, 1.0e-12 );
+	vector< double > len( numVoxels, 1.0e-6 );
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vol[i] *= 1.0 + 0.1 * i;
+		area[i] *= 1.0 + 0.05 * i;
+	}
+	FastMatrixElim elim( numVoxels, numVoxels );
+	elim.buildForDiffusion( parentVoxel, vol, area, len,
+		diffConst, motorConst, dt );
+	vector< unsigned int > lookupOldRowsFromNew;
+	elim.hinesReorder( parentVoxel, lookupOldRowsFromNew );
+	vector< unsigned int > diagIndex;
+	fops.clear();
+	elim.buildForwardElim( diagIndex, fops );
+	elim.buildBackwardSub( diagIndex, fops, diagVal );
+	elim.opsReorder( lookupOldRowsFromNew, fops, diagVal );
+}
+
+/**
+ * The DiffBatch must give exactly the same results as advancing each
+ * DiffPoolVec on its own.
+ */
+void testDiffBatch()
+{
+	// A soma with two branches, one of them forking again.
+	const unsigned int numVoxels = 12;
+	unsigned int pa[] = { ~0U, 0, 1, 2, 3, 0, 5, 6, 4, 8, 4, 10 };
+	vector< unsigned int > parentVoxel( pa, pa + numVoxels );
+	double diffConst[] = { 1e-12, 2e-13, 5e-12, 1e-12 };
+	double motorConst[] = { 0, 0, 0, 1e-7 };
+	const unsigned int numPools = 4;
+	double dt = 0.1;
+
+	DiffBatch batch;
+	vector< DiffPoolVec > pools( numPools );
+	pools[0].setNumVoxels( 0 );
+	assert( pools[0].getNvecPtr() == 0 );
+	vector< Triplet< double > > fops;
+	vector< double > diagVal;
+	for ( unsigned int i = 0; i < numPools; ++i ) {
+		buildDiffOps( parentVoxel, diffConst[i], motorConst[i], dt,
+			fops, diagVal );
+		assert( batch.matches( fops ) );
+		pools[i].setNumVoxels( numVoxels );
+		for ( unsigned int j = 0; j < numVoxels; ++j )
+			pools[i].setN( j, ( i + 1 ) * ( j % 3 ) );
+		pools[i].setOps( fops, diagVal );
+		assert( batch.addColumn( fops, diagVal, pools[i].getNvec() ) == i );
+	}
+	assert( batch.getNumColumns() == numPools );
+	assert( batch.getNumVoxels() == numVoxels );
+	assert( pools[0].getNvecPtr() == &pools[0].getNvec()[0] );
+
+	// A different tree has a different pattern.
+	vector< unsigned int > linear( numVoxels );
+	for ( unsigned int i = 0; i < numVoxels; ++i )
+		linear[i] = i - 1;
+	buildDiffOps( linear, 1e-12, 0, dt, fops, diagVal );
+	assert( !batch.matches( fops ) );
+
+	for ( unsigned int t = 0; t < 100; ++t ) {
+		batch.advance();
+		for ( unsigned int i = 0; i < numPools; ++i )
+			pools[i].advance( dt );
+	}
+	for ( unsigned int i = 0; i < numPools; ++i ) {
+		vector< double > n = batch.getNvec( i );
+		double tot = 0.0;
+		for ( unsigned int j = 0; j < numVoxels; ++j ) {
+			assert( n[j] == pools[i].getN( j ) );
+			assert( batch.getN( j, i ) == n[j] );
+			tot += n[j];
+		}
+		assert( tot > 0.0 );
+	}
+	cout << "." << flush;
+}
+
 void testCellDiffn()
 {
 	Id makeCompt( Id parentCompt, Id parentObj,
@@ -533,6 +623,7 @@ void testDiffusion()
 	testSorting();
 	testFastMatrixElim();
 	testSetDiffusionAndTransport();
+	testDiffBatch();
 	testCylDiffn();
 	// breaks at this point. testCellDiffn();
 }
@@ -0,0 +1,1257 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include <queue>
+#include <set>
+#include "../shell/Shell.h"
+#include "../msg/OneToAllMsg.h"
+#include "../scheduling/Clock.h"
+#include "../shell/Wildcard.h"
+#include "../biophysics/Compartment.h"
+#include "../biophysics/ChanBase.h"
+#include "../biophysics/HHGate.h"
+#include "../biophysics/HHChannel.h"
+#include "../biophysics/CaConc.h"
+#include "HSolve.h"
+#include "ZombieCompartment.h"
+#include "ZombieHHChannel.h"
+#include "ZombieCaConc.h"
+
+using namespace moose;
+
+static const unsigned int NONE = ~0U;
+static const double EPSILON = 1.0e-10;
+
+/// How the channel current adds to the activation of a CaConc.
+enum CaInputMode { CA_CURRENT, CA_INCREASE, CA_DECREASE };
+
+const Cinfo* HSolve::initCinfo()
+{
+		///////////////////////////////////////////////////////
+		// Field definitions
+		///////////////////////////////////////////////////////
+		static ValueFinfo< HSolve, string > target(
+			"target",
+			"Path of the model to be solved. All the Compartments on "
+			"the path are taken over, along with the HHChannels and "
+			"CaConcs attached to them. Reassigning the target releases "
+			"the previous model.",
+			&HSolve::setTarget,
+			&HSolve::getTarget
+		);
+		static ValueFinfo< HSolve, double > dt(
+			"dt",
+			"Timestep. Reset to the dt of the clock driving the "
+			"HSolve on reinit.",
+			&HSolve::setDt,
+			&HSolve::getDt
+		);
+		static ReadOnlyValueFinfo< HSolve, unsigned int > numCompartments(
+			"numCompartments",
+			"Number of compartments handled by the solver.",
+			&HSolve::getNumCompartments
+		);
+		static ReadOnlyValueFinfo< HSolve, unsigned int > numChannels(
+			"numChannels",
+			"Number of HHChannels handled by the solver.",
+			&HSolve::getNumChannels
+		);
+		static ReadOnlyValueFinfo< HSolve, unsigned int > numCaConcs(
+			"numCaConcs",
+			"Number of CaConcs handled by the solver.",
+			&HSolve::getNumCaConcs
+		);
+		///////////////////////////////////////////////////////
+		// DestFinfo definitions
+		///////////////////////////////////////////////////////
+		static DestFinfo process( "process",
+			"Handles process call",
+			new ProcOpFunc< HSolve >( &HSolve::process ) );
+		static DestFinfo reinit( "reinit",
+			"Handles reinit call",
+			new ProcOpFunc< HSolve >( &HSolve::reinit ) );
+		///////////////////////////////////////////////////////
+		// Shared definitions
+		///////////////////////////////////////////////////////
+		static Finfo* procShared[] = {
+			&process, &reinit
+		};
+		static SharedFinfo proc( "proc",
+			"Shared message for process and reinit",
+			procShared, sizeof( procShared ) / sizeof( const Finfo* )
+		);
+
+	static Finfo* hsolveFinfos[] =
+	{
+		&target,			// Value
+		&dt,				// Value
+		&numCompartments,	// ReadOnlyValue
+		&numChannels,		// ReadOnlyValue
+		&numCaConcs,		// ReadOnlyValue
+		&proc,				// SharedFinfo
+	};
+
+	static string doc[] =
+	{
+		"Name", "HSolve",
+		"Author", "Upi Bhalla",
+		"Description", "Implicit Hines solver for branched neuronal "
+		"models. Takes over the Compartments, HHChannels and CaConcs "
+		"on its target path.",
+	};
+	static Dinfo< HSolve > dinfo;
+	static  Cinfo hsolveCinfo(
+		"HSolve",
+		Neutral::initCinfo(),
+		hsolveFinfos,
+		sizeof(hsolveFinfos)/sizeof(Finfo *),
+		&dinfo,
+		doc,
+		sizeof( doc ) / sizeof( string )
+	);
+
+	return &hsolveCinfo;
+}
+
+static const Cinfo* hsolveCinfo = HSolve::initCinfo();
+
+//////////////////////////////////////////////////////////////
+// Class definitions
+//////////////////////////////////////////////////////////////
+
+HSolve::HSolve()
+	: dt_( 50.0e-6 )
+{;}
+
+/**
+ * A copy, as made when the element is copied, does not share the
+ * zombies of the original. It starts with no target, so that the two
+ * do not both advance, and release, the same model.
+ */
+HSolve::HSolve( const HSolve& other )
+	: dt_( other.dt_ )
+{;}
+
+HSolve& HSolve::operator=( const HSolve& other )
+{
+	if ( this != &other ) {
+		unzombify();
+		target_ = "";
+		dt_ = other.dt_;
+	}
+	return *this;
+}
+
+/// Hands the model back, so that no zombie is left calling in here.
+HSolve::~HSolve()
+{
+	unzombify();
+}
+
+//////////////////////////////////////////////////////////////
+// Field Access functions
+//////////////////////////////////////////////////////////////
+
+void HSolve::setTarget( string path )
+{
+	unzombify();
+	target_ = path;
+	if ( path == "" )
+		return;
+	if ( !setup() )
+		target_ = "";
+}
+
+string HSolve::getTarget() const
+{
+	return target_;
+}
+
+void HSolve::setDt( double dt )
+{
+	if ( dt <= 0.0 ) {
+		cout << "Warning: HSolve::setDt: dt must be positive\n";
+		return;
+	}
+	dt_ = dt;
+	updatePassive();
+}
+
+double HSolve::getDt() const
+{
+	return dt_;
+}
+
+unsigned int HSolve::getNumCompartments() const
+{
+	return compartmentId_.size();
+}
+
+unsigned int HSolve::getNumChannels() const
+{
+	return channelId_.size();
+}
+
+unsigned int HSolve::getNumCaConcs() const
+{
+	return caConcId_.size();
+}
+
+void HSolve::getState( vector< double >& s ) const
+{
+	const vector< double >* v[] = { &Vm_, &Im_, &state_, &Gk_, &Ik_,
+		&Ca_, &c_ };
+	for ( unsigned int i = 0; i < sizeof( v ) / sizeof( v[0] ); ++i )
+		s.insert( s.end(), v[i]->begin(), v[i]->end() );
+}
+
+bool HSolve::setState( const double* s, unsigned int size )
+{
+	vector< double >* v[] = { &Vm_, &Im_, &state_, &Gk_, &Ik_, &Ca_, &c_ };
+	unsigned int num = sizeof( v ) / sizeof( v[0] );
+	unsigned int total = 0;
+	for ( unsigned int i = 0; i < num; ++i )
+		total += v[i]->size();
+	if ( size != total )
+		return false;
+	for ( unsigned int i = 0; i < num; ++i ) {
+		copy( s, s + v[i]->size(), v[i]->begin() );
+		s += v[i]->size();
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////
+// Setup
+//////////////////////////////////////////////////////////////
+
+/// Returns the ObjIds and dest function names at the end of a msg.
+static void getTargets( const ObjId& src, const string& srcField,
+	vector< ObjId >& tgt, vector< string >& func )
+{
+	const SrcFinfo* sf = dynamic_cast< const SrcFinfo* >(
+		src.element()->cinfo()->findFinfo( srcField ) );
+	assert( sf );
+	src.element()->getMsgTargetAndFunctions( src.dataIndex, sf, tgt, func );
+	// None of the targets are FieldElements, and some msgs do not fill
+	// in the fieldIndex.
+	for ( vector< ObjId >::iterator i = tgt.begin(); i != tgt.end(); ++i )
+		i->fieldIndex = 0;
+}
+
+bool HSolve::setup()
+{
+	vector< ObjId > compts;
+	wildcardFind( target_ + "/##[ISA=Compartment]", compts );
+	ObjId self( target_ );
+	if ( !self.bad() && self.element()->cinfo()->isA( "Compartment" ) )
+		compts.push_back( self );
+	if ( compts.size() == 0 ) {
+		cout << "Warning: HSolve::setup: no compartments found on '" <<
+			target_ << "'\n";
+		return false;
+	}
+
+	map< Id, unsigned int > numFound;
+	for ( vector< ObjId >::iterator
+			i = compts.begin(); i != compts.end(); ++i ) {
+		if ( i->element()->cinfo()->isA( "SymCompartment" ) ) {
+			cout << "Warning: HSolve::setup: " << i->path() <<
+				": SymCompartments are not handled\n";
+			return false;
+		}
+		numFound[ i->id ]++;
+	}
+	for ( map< Id, unsigned int >::iterator
+			i = numFound.begin(); i != numFound.end(); ++i ) {
+		if ( i->second != i->first.element()->numData() ) {
+			cout << "Warning: HSolve::setup: only part of " <<
+				i->first.path() << " is on the target\n";
+			return false;
+		}
+	}
+
+	if ( !buildTrees( compts ) )
+		return false;
+	findChannels();
+	zombify();
+	return true;
+}
+
+bool HSolve::buildTrees( const vector< ObjId >& compts )
+{
+	map< ObjId, unsigned int > index;
+	for ( unsigned int i = 0; i < compts.size(); ++i )
+		index[ compts[i] ] = i;
+
+	// Each neighbour of a compartment, with the compartment whose Ra
+	// sets the conductance between them. The receiver of an axialOut
+	// message uses its own Ra, and so does the sender of raxialOut.
+	vector< map< unsigned int, unsigned int > > nbr( compts.size() );
+	for ( unsigned int i = 0; i < compts.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( compts[i], "axialOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			map< ObjId, unsigned int >::iterator k = index.find( tgt[j] );
+			if ( k == index.end() ) {
+				cout << "Warning: HSolve::setup: " << tgt[j].path() <<
+					" is not on the target\n";
+				return false;
+			}
+			nbr[i][ k->second ] = k->second;
+			nbr[ k->second ][i] = k->second;
+		}
+		getTargets( compts[i], "raxialOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			map< ObjId, unsigned int >::iterator k = index.find( tgt[j] );
+			if ( k == index.end() ) {
+				cout << "Warning: HSolve::setup: " << tgt[j].path() <<
+					" is not on the target\n";
+				return false;
+			}
+			nbr[i][ k->second ] = i;
+			nbr[ k->second ][i] = i;
+		}
+	}
+
+	// Breadth-first from a root in each tree, then reverse so that each
+	// child comes before its parent.
+	vector< unsigned int > order;
+	vector< unsigned int > parent( compts.size(), NONE );
+	vector< unsigned int > raSource( compts.size(), NONE );
+	vector< bool > seen( compts.size(), false );
+	for ( unsigned int root = 0; root < compts.size(); ++root ) {
+		if ( seen[ root ] )
+			continue;
+		queue< unsigned int > q;
+		q.push( root );
+		seen[ root ] = true;
+		while ( !q.empty() ) {
+			unsigned int i = q.front();
+			q.pop();
+			order.push_back( i );
+			for ( map< unsigned int, unsigned int >::iterator
+					j = nbr[i].begin(); j != nbr[i].end(); ++j ) {
+				if ( j->first == parent[i] )
+					continue;
+				if ( seen[ j->first ] ) {
+					cout << "Warning: HSolve::setup: loop in the "
+						"compartments at " << compts[ j->first ].path() <<
+						"\n";
+					return false;
+				}
+				seen[ j->first ] = true;
+				parent[ j->first ] = i;
+				raSource[ j->first ] = j->second;
+				q.push( j->first );
+			}
+		}
+	}
+	reverse( order.begin(), order.end() );
+
+	vector< unsigned int > hinesIndex( compts.size() );
+	for ( unsigned int i = 0; i < order.size(); ++i )
+		hinesIndex[ order[i] ] = i;
+
+	unsigned int n = compts.size();
+	compartmentId_.resize( n );
+	parent_.assign( n, NONE );
+	raSource_.assign( n, NONE );
+	for ( unsigned int i = 0; i < n; ++i ) {
+		unsigned int old = order[i];
+		compartmentId_[i] = compts[ old ];
+		if ( parent[ old ] != NONE ) {
+			parent_[i] = hinesIndex[ parent[ old ] ];
+			raSource_[i] = hinesIndex[ raSource[ old ] ];
+			assert( parent_[i] > i );
+		}
+	}
+	return true;
+}
+
+/// Returns true if every entry of each Element is in the set.
+static bool isWholeElement( Id id, const set< ObjId >& found )
+{
+	for ( unsigned int i = 0; i < id.element()->numData(); ++i )
+		if ( found.find( ObjId( id, i ) ) == found.end() )
+			return false;
+	return true;
+}
+
+void HSolve::findChannels()
+{
+	// Candidate channels, on the compartments in Hines order.
+	vector< ObjId > chans;
+	vector< unsigned int > chanCompt;
+	set< ObjId > chanSet;
+	set< Id > badChans;
+	for ( unsigned int i = 0; i < compartmentId_.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( compartmentId_[i], "VmOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			if ( tgt[j].element()->cinfo() != HHChannel::initCinfo() )
+				continue;
+			if ( chanSet.find( tgt[j] ) != chanSet.end() ) {
+				// Several compartments on one channel.
+				badChans.insert( tgt[j].id );
+				continue;
+			}
+			chans.push_back( tgt[j] );
+			chanCompt.push_back( i );
+			chanSet.insert( tgt[j] );
+		}
+	}
+
+	// Candidate CaConcs are those fed by the channels.
+	set< ObjId > poolSet;
+	for ( unsigned int i = 0; i < chans.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( chans[i], "IkOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			if ( tgt[j].element()->cinfo() == CaConc::initCinfo() &&
+				( func[j] == "current" || func[j] == "increase" ||
+				  func[j] == "decrease" ) )
+				poolSet.insert( tgt[j] );
+			else
+				badChans.insert( chans[i].id );
+		}
+	}
+	set< Id > poolElms;
+	for ( set< ObjId >::iterator
+			i = poolSet.begin(); i != poolSet.end(); ++i )
+		if ( isWholeElement( i->id, poolSet ) )
+			poolElms.insert( i->id );
+
+	// A channel can only be taken over if the CaConcs it feeds are.
+	for ( unsigned int i = 0; i < chans.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( chans[i], "IkOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j )
+			if ( poolElms.find( tgt[j].id ) == poolElms.end() )
+				badChans.insert( chans[i].id );
+	}
+	set< Id > chanElms;
+	for ( unsigned int i = 0; i < chans.size(); ++i )
+		if ( badChans.find( chans[i].id ) == badChans.end() &&
+			isWholeElement( chans[i].id, chanSet ) )
+			chanElms.insert( chans[i].id );
+
+	////////////////////////////////////////////////////////////////
+	// Now lay out the data.
+	////////////////////////////////////////////////////////////////
+	caConcId_.clear();
+	for ( set< ObjId >::iterator
+			i = poolSet.begin(); i != poolSet.end(); ++i )
+		if ( poolElms.find( i->id ) != poolElms.end() )
+			caConcId_.push_back( *i );
+	map< ObjId, unsigned int > poolIndex;
+	for ( unsigned int i = 0; i < caConcId_.size(); ++i )
+		poolIndex[ caConcId_[i] ] = i;
+
+	unsigned int n = compartmentId_.size();
+	channelId_.clear();
+	chanCompt_.clear();
+	chanStart_.assign( 1, 0 );
+	for ( unsigned int i = 0; i < chans.size(); ++i ) {
+		if ( chanElms.find( chans[i].id ) == chanElms.end() )
+			continue;
+		while ( chanStart_.size() <= chanCompt[i] )
+			chanStart_.push_back( channelId_.size() );
+		channelId_.push_back( chans[i] );
+		chanCompt_.push_back( chanCompt[i] );
+	}
+	while ( chanStart_.size() <= n )
+		chanStart_.push_back( channelId_.size() );
+	map< ObjId, unsigned int > chanIndex;
+	for ( unsigned int i = 0; i < channelId_.size(); ++i )
+		chanIndex[ channelId_[i] ] = i;
+
+	caInputChannel_.clear();
+	caInputPool_.clear();
+	caInputMode_.clear();
+	chanCaConc_.assign( channelId_.size(), NONE );
+	for ( unsigned int i = 0; i < channelId_.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( channelId_[i], "IkOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			caInputChannel_.push_back( i );
+			caInputPool_.push_back( poolIndex[ tgt[j] ] );
+			if ( func[j] == "increase" )
+				caInputMode_.push_back( CA_INCREASE );
+			else if ( func[j] == "decrease" )
+				caInputMode_.push_back( CA_DECREASE );
+			else
+				caInputMode_.push_back( CA_CURRENT );
+		}
+	}
+
+	// The CaConcs send conc to the channels directly, and the rest
+	// by message.
+	externalConcOut_.clear();
+	for ( unsigned int i = 0; i < caConcId_.size(); ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( caConcId_[i], "concOut", tgt, func );
+		bool isExternal = false;
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			map< ObjId, unsigned int >::iterator k = chanIndex.find( tgt[j] );
+			if ( k != chanIndex.end() && func[j] == "concen" )
+				chanCaConc_[ k->second ] = i;
+			else
+				isExternal = true;
+		}
+		if ( isExternal )
+			externalConcOut_.push_back( i );
+	}
+
+	// Likewise for Vm from the compartments.
+	externalVmOut_.clear();
+	for ( unsigned int i = 0; i < n; ++i ) {
+		vector< ObjId > tgt;
+		vector< string > func;
+		getTargets( compartmentId_[i], "VmOut", tgt, func );
+		for ( unsigned int j = 0; j < tgt.size(); ++j ) {
+			if ( chanIndex.find( tgt[j] ) == chanIndex.end() ) {
+				externalVmOut_.push_back( i );
+				break;
+			}
+		}
+	}
+
+	zombieChannels_.assign( chanElms.begin(), chanElms.end() );
+	zombieCaConcs_.assign( poolElms.begin(), poolElms.end() );
+	set< Id > comptElms;
+	for ( unsigned int i = 0; i < n; ++i )
+		comptElms.insert( compartmentId_[i].id );
+	zombieCompartments_.assign( comptElms.begin(), comptElms.end() );
+}
+
+/**
+ * Swaps the class of all entries on the Element, keeping the fields
+ * of the Base class which both the old and new classes derive from.
+ */
+template< class Base > static void swapClass( Id id, const Cinfo* zClass )
+{
+	Element* elm = id.element();
+	unsigned int start = elm->localDataStart();
+	unsigned int num = elm->numLocalData();
+	vector< Base > orig;
+	orig.reserve( num );
+	for ( unsigned int i = 0; i < num; ++i ) {
+		Eref er( elm, i + start );
+		orig.push_back( *reinterpret_cast< const Base* >( er.data() ) );
+	}
+	elm->zombieSwap( zClass );
+	for ( unsigned int i = 0; i < num; ++i ) {
+		Eref er( elm, i + start );
+		*reinterpret_cast< Base* >( er.data() ) = orig[i];
+	}
+}
+
+void HSolve::findClockTicks( const vector< Id >& elist,
+	const string& dest, const string& field )
+{
+	const Cinfo* clockCinfo = Clock::initCinfo();
+	for ( vector< Id >::const_iterator
+			i = elist.begin(); i != elist.end(); ++i ) {
+		const Element* elm = i->element();
+		const DestFinfo* df = dynamic_cast< const DestFinfo* >(
+			elm->cinfo()->findFinfo( dest ) );
+		if ( !df )
+			continue;
+		vector< ObjId > caller;
+		elm->getInputMsgs( caller, df->getFid() );
+		for ( unsigned int j = 0; j < caller.size(); ++j ) {
+			const Element* src = Msg::getMsg( caller[j] )->e1();
+			if ( src->id() != Id( 1 ) )
+				continue;
+			vector< pair< BindIndex, FuncId > > fields;
+			src->getFieldsOfOutgoingMsg( caller[j], fields );
+			for ( unsigned int k = 0; k < fields.size(); ++k ) {
+				if ( fields[k].second != df->getFid() )
+					continue;
+				const Finfo* sf = clockCinfo->getSrcFinfo( fields[k].first );
+				for ( unsigned int t = 0; ; ++t ) {
+					stringstream ss;
+					ss << "process" << t;
+					const Finfo* tf = clockCinfo->findFinfo( ss.str() );
+					if ( !tf )
+						break;
+					if ( sf == tf ) {
+						schedId_.push_back( *i );
+						schedField_.push_back( field );
+						schedTick_.push_back( t );
+					}
+				}
+			}
+		}
+	}
+}
+
+void HSolve::zombify()
+{
+	for ( vector< Id >::iterator
+			i = zombieCompartments_.begin();
+			i != zombieCompartments_.end(); ++i )
+		swapClass< Compartment >( *i, ZombieCompartment::initCinfo() );
+	for ( vector< Id >::iterator
+			i = zombieChannels_.begin(); i != zombieChannels_.end(); ++i )
+		swapClass< HHChannel >( *i, ZombieHHChannel::initCinfo() );
+	for ( vector< Id >::iterator
+			i = zombieCaConcs_.begin(); i != zombieCaConcs_.end(); ++i )
+		swapClass< CaConc >( *i, ZombieCaConc::initCinfo() );
+
+	// The solver does the work of all these now. The ticks are kept so
+	// that unzombify can hand the work back.
+	findClockTicks( zombieCompartments_, "initProc", "init" );
+	findClockTicks( zombieCompartments_, "process", "proc" );
+	findClockTicks( zombieChannels_, "process", "proc" );
+	findClockTicks( zombieCaConcs_, "process", "proc" );
+	vector< ObjId > unsched( compartmentId_ );
+	Shell::dropClockMsgs( unsched, "initProc" );
+	unsched.insert( unsched.end(), channelId_.begin(), channelId_.end() );
+	unsched.insert( unsched.end(), caConcId_.begin(), caConcId_.end() );
+	Shell::dropClockMsgs( unsched, "process" );
+
+	unsigned int n = compartmentId_.size();
+	Vm_.resize( n );
+	Cm_.resize( n );
+	Em_.resize( n );
+	Rm_.resize( n );
+	Ra_.resize( n );
+	initVm_.resize( n );
+	inject_.resize( n );
+	injectVarying_.assign( n, 0.0 );
+	externalGk_.assign( n, 0.0 );
+	externalGkEk_.assign( n, 0.0 );
+	Im_.assign( n, 0.0 );
+	Ga_.assign( n, 0.0 );
+	passiveDiag_.resize( n );
+	diag_.resize( n );
+	rhs_.resize( n );
+	VMid_.resize( n );
+	for ( unsigned int i = 0; i < n; ++i ) {
+		ZombieCompartment* zc = reinterpret_cast< ZombieCompartment* >(
+			compartmentId_[i].data() );
+		Vm_[i] = zc->Compartment::getVm();
+		Cm_[i] = zc->getCm();
+		Em_[i] = zc->getEm();
+		Rm_[i] = zc->getRm();
+		Ra_[i] = zc->getRa();
+		initVm_[i] = zc->getInitVm();
+		inject_[i] = zc->Compartment::getInject();
+		zc->setSolver( this, i );
+	}
+	for ( unsigned int i = 0; i < n; ++i )
+		if ( parent_[i] != NONE )
+			Ga_[i] = 1.0 / Ra_[ raSource_[i] ];
+
+	unsigned int numChans = channelId_.size();
+	Gbar_.resize( numChans );
+	Ek_.resize( numChans );
+	Gk_.assign( numChans, 0.0 );
+	Ik_.assign( numChans, 0.0 );
+	chanConc_.resize( numChans );
+	gateIndex_.assign( 3 * numChans, NONE );
+	gateChan_.clear();
+	gate_.clear();
+	gatePower_.clear();
+	gateInstant_.clear();
+	gateUsesConc_.clear();
+	gateInited_.clear();
+	state_.clear();
+	for ( unsigned int i = 0; i < numChans; ++i ) {
+		Eref er = channelId_[i].eref();
+		ZombieHHChannel* zc =
+			reinterpret_cast< ZombieHHChannel* >( er.data() );
+		Gbar_[i] = zc->getGbar();
+		Ek_[i] = zc->getEk();
+		chanConc_[i] = zc->conc_;
+		double power[] = { zc->Xpower_, zc->Ypower_, zc->Zpower_ };
+		const HHGate* gate[] = {
+			zc->getXgate( 0 ), zc->getYgate( 0 ), zc->getZgate( 0 ) };
+		double state[] = {
+			zc->HHChannel::getX(), zc->HHChannel::getY(),
+			zc->HHChannel::getZ() };
+		bool inited[] = { zc->xInited_, zc->yInited_, zc->zInited_ };
+		for ( unsigned int k = 0; k < 3; ++k ) {
+			if ( power[k] <= 0.0 )
+				continue;
+			assert( gate[k] );
+			gateIndex_[ 3 * i + k ] = gate_.size();
+			gateChan_.push_back( i );
+			gate_.push_back( gate[k] );
+			gatePower_.push_back( power[k] );
+			gateInstant_.push_back( zc->getInstant() & ( 1 << k ) );
+			gateUsesConc_.push_back( k == 2 && zc->getUseConcentration() );
+			gateInited_.push_back( inited[k] );
+			state_.push_back( state[k] );
+		}
+		zc->setSolver( this, i );
+	}
+	batchGates();
+
+	unsigned int numPools = caConcId_.size();
+	Ca_.resize( numPools );
+	CaBasal_.resize( numPools );
+	tau_.resize( numPools );
+	B_.resize( numPools );
+	ceiling_.resize( numPools );
+	floor_.resize( numPools );
+	c_.assign( numPools, 0.0 );
+	caDecay_.resize( numPools );
+	activation_.assign( numPools, 0.0 );
+	for ( unsigned int i = 0; i < numPools; ++i ) {
+		ZombieCaConc* zc = reinterpret_cast< ZombieCaConc* >(
+			caConcId_[i].data() );
+		Ca_[i] = zc->CaConc::getCa();
+		CaBasal_[i] = zc->getCaBasal();
+		tau_[i] = zc->getTau();
+		B_[i] = zc->getB();
+		ceiling_[i] = zc->getCeiling();
+		floor_[i] = zc->getFloor();
+		c_[i] = Ca_[i] - CaBasal_[i];
+		zc->setSolver( this, i );
+	}
+	updatePassive();
+}
+
+/**
+ * True if the element is still there to be handed back. When a whole
+ * tree is deleted, the zombies may go before, or along with, the solver.
+ */
+static bool isLive( Id id )
+{
+	Element* elm = id.element();
+	return elm && !elm->isDoomed();
+}
+
+void HSolve::unzombify()
+{
+	// Leave the current state in the original objects.
+	for ( unsigned int i = 0; i < compartmentId_.size(); ++i ) {
+		if ( !isLive( compartmentId_[i].id ) )
+			continue;
+		ZombieCompartment* zc = reinterpret_cast< ZombieCompartment* >(
+			compartmentId_[i].data() );
+		zc->Compartment::setVm( Vm_[i] );
+	}
+	for ( unsigned int i = 0; i < channelId_.size(); ++i ) {
+		if ( !isLive( channelId_[i].id ) )
+			continue;
+		ZombieHHChannel* zc = reinterpret_cast< ZombieHHChannel* >(
+			channelId_[i].data() );
+		unsigned int* g = &gateIndex_[ 3 * i ];
+		if ( g[0] != NONE )
+			zc->HHChannel::setX( state_[ g[0] ] );
+		if ( g[1] != NONE )
+			zc->HHChannel::setY( state_[ g[1] ] );
+		if ( g[2] != NONE )
+			zc->HHChannel::setZ( state_[ g[2] ] );
+		zc->ChanBase::setGk( Gk_[i] );
+		zc->ChanBase::setIk( Ik_[i] );
+	}
+	for ( unsigned int i = 0; i < caConcId_.size(); ++i ) {
+		if ( !isLive( caConcId_[i].id ) )
+			continue;
+		ZombieCaConc* zc = reinterpret_cast< ZombieCaConc* >(
+			caConcId_[i].data() );
+		zc->CaConc::setCa( Ca_[i] );
+	}
+	for ( vector< Id >::iterator
+			i = zombieCompartments_.begin();
+			i != zombieCompartments_.end(); ++i )
+		if ( isLive( *i ) )
+			swapClass< Compartment >( *i, Compartment::initCinfo() );
+	for ( vector< Id >::iterator
+			i = zombieChannels_.begin(); i != zombieChannels_.end(); ++i )
+		if ( isLive( *i ) )
+			swapClass< HHChannel >( *i, HHChannel::initCinfo() );
+	for ( vector< Id >::iterator
+			i = zombieCaConcs_.begin(); i != zombieCaConcs_.end(); ++i )
+		if ( isLive( *i ) )
+			swapClass< CaConc >( *i, CaConc::initCinfo() );
+	// Put back the clock messages that zombify dropped.
+	Shell* shell = reinterpret_cast< Shell* >( ObjId().data() );
+	for ( unsigned int i = 0; i < schedId_.size(); ++i ) {
+		if ( !isLive( schedId_[i] ) )
+			continue;
+		vector< ObjId > list( 1, schedId_[i] );
+		shell->addClockMsgs( list, schedField_[i], schedTick_[i],
+			OneToAllMsg::numMsg() );
+	}
+	schedId_.clear();
+	schedField_.clear();
+	schedTick_.clear();
+	zombieCompartments_.clear();
+	zombieChannels_.clear();
+	zombieCaConcs_.clear();
+	compartmentId_.clear();
+	channelId_.clear();
+	caConcId_.clear();
+	chanStart_.assign( 1, 0 );
+	batchStart_.clear();
+	externalVmOut_.clear();
+	externalConcOut_.clear();
+	caInputChannel_.clear();
+	caInputPool_.clear();
+	caInputMode_.clear();
+}
+
+void HSolve::updatePassive()
+{
+	unsigned int n = compartmentId_.size();
+	for ( unsigned int i = 0; i < n; ++i )
+		passiveDiag_[i] = 2.0 * Cm_[i] / dt_ + 1.0 / Rm_[i];
+	for ( unsigned int i = 0; i < n; ++i ) {
+		if ( parent_[i] != NONE ) {
+			passiveDiag_[i] += Ga_[i];
+			passiveDiag_[ parent_[i] ] += Ga_[i];
+		}
+	}
+	for ( unsigned int i = 0; i < caConcId_.size(); ++i )
+		caDecay_[i] = exp( -dt_ / tau_[i] );
+}
+
+//////////////////////////////////////////////////////////////
+// Process operations.
+//////////////////////////////////////////////////////////////
+
+/// Raises the gate state to its power, avoiding pow for the usual cases
+static inline double takePower( double x, double p )
+{
+	if ( p == 1.0 )
+		return x;
+	if ( p == 2.0 )
+		return x * x;
+	if ( p == 3.0 )
+		return x * x * x;
+	if ( p == 4.0 ) {
+		x *= x;
+		return x * x;
+	}
+	return pow( x, p );
+}
+
+void HSolve::process( const Eref& e, ProcPtr p )
+{
+	if ( compartmentId_.size() == 0 )
+		return;
+	if ( p->dt != dt_ ) {
+		dt_ = p->dt;
+		updatePassive();
+	}
+	advanceChannels( dt_ );
+	advanceVm();
+	advanceCalcium();
+	sendExternal();
+}
+
+void HSolve::reinit( const Eref& e, ProcPtr p )
+{
+	if ( compartmentId_.size() == 0 )
+		return;
+	dt_ = p->dt;
+	updatePassive();
+
+	Vm_ = initVm_;
+	Im_.assign( Im_.size(), 0.0 );
+	injectVarying_.assign( injectVarying_.size(), 0.0 );
+	externalGk_.assign( externalGk_.size(), 0.0 );
+	externalGkEk_.assign( externalGkEk_.size(), 0.0 );
+
+	Ca_ = CaBasal_;
+	c_.assign( c_.size(), 0.0 );
+	activation_.assign( activation_.size(), 0.0 );
+
+	// Gates go to their steady state, as in the HHChannel.
+	lookupGates();
+	for ( unsigned int j = 0; j < gate_.size(); ++j ) {
+		if ( gateB_[j] < EPSILON ) {
+			cout << "Warning: HSolve::reinit: B value for " <<
+				channelId_[ gateChan_[j] ].path() <<
+				" is ~0. Check gate tables\n";
+			continue;
+		}
+		if ( !gateInited_[j] )
+			state_[j] = gateA_[j] / gateB_[j];
+	}
+	updateConductances();
+	for ( unsigned int i = 0; i < channelId_.size(); ++i )
+		Ik_[i] = Gk_[i] * ( Ek_[i] - Vm_[ chanCompt_[i] ] );
+	sendExternal();
+}
+
+void HSolve::batchGates()
+{
+	unsigned int numGates = gate_.size();
+	vector< pair< pair< const HHGate*, int >, unsigned int > > key(
+		numGates );
+	for ( unsigned int j = 0; j < numGates; ++j ) {
+		int flags = ( gateInstant_[j] ? 1 : 0 ) + ( gateUsesConc_[j] ? 2 : 0 );
+		key[j] = make_pair( make_pair( gate_[j], flags ), j );
+	}
+	sort( key.begin(), key.end() );
+
+	vector< unsigned int > newIndex( numGates );
+	for ( unsigned int j = 0; j < numGates; ++j )
+		newIndex[ key[j].second ] = j;
+	for ( vector< unsigned int >::iterator
+			i = gateIndex_.begin(); i != gateIndex_.end(); ++i )
+		if ( *i != NONE )
+			*i = newIndex[ *i ];
+
+	vector< unsigned int > chan( numGates );
+	vector< const HHGate* > gate( numGates );
+	vector< double > power( numGates );
+	vector< bool > instant( numGates );
+	vector< bool > usesConc( numGates );
+	vector< bool > inited( numGates );
+	vector< double > state( numGates );
+	batchStart_.clear();
+	for ( unsigned int j = 0; j < numGates; ++j ) {
+		unsigned int old = key[j].second;
+		chan[j] = gateChan_[ old ];
+		gate[j] = gate_[ old ];
+		power[j] = gatePower_[ old ];
+		instant[j] = gateInstant_[ old ];
+		usesConc[j] = gateUsesConc_[ old ];
+		inited[j] = gateInited_[ old ];
+		state[j] = state_[ old ];
+		if ( j == 0 || key[j].first != key[j - 1].first )
+			batchStart_.push_back( j );
+	}
+	batchStart_.push_back( numGates );
+	gateChan_.swap( chan );
+	gate_.swap( gate );
+	gatePower_.swap( power );
+	gateInstant_.swap( instant );
+	gateUsesConc_.swap( usesConc );
+	gateInited_.swap( inited );
+	state_.swap( state );
+	gateInput_.resize( numGates );
+	gateA_.resize( numGates );
+	gateB_.resize( numGates );
+}
+
+void HSolve::lookupGates()
+{
+	for ( unsigned int b = 0; b + 1 < batchStart_.size(); ++b ) {
+		unsigned int start = batchStart_[b];
+		unsigned int end = batchStart_[b + 1];
+		if ( gateUsesConc_[ start ] ) {
+			for ( unsigned int j = start; j < end; ++j ) {
+				unsigned int c = gateChan_[j];
+				gateInput_[j] = ( chanCaConc_[c] == NONE ) ?
+					chanConc_[c] : Ca_[ chanCaConc_[c] ];
+			}
+		} else {
+			for ( unsigned int j = start; j < end; ++j )
+				gateInput_[j] = Vm_[ chanCompt_[ gateChan_[j] ] ];
+		}
+		gate_[ start ]->lookupBothArray( &gateInput_[ start ],
+			&gateA_[ start ], &gateB_[ start ], end - start );
+	}
+}
+
+void HSolve::updateConductances()
+{
+	for ( unsigned int i = 0; i < channelId_.size(); ++i ) {
+		double g = Gbar_[i];
+		for ( unsigned int k = 0; k < 3; ++k ) {
+			unsigned int j = gateIndex_[ 3 * i + k ];
+			if ( j != NONE )
+				g *= takePower( state_[j], gatePower_[j] );
+		}
+		Gk_[i] = g;
+	}
+}
+
+void HSolve::advanceChannels( double dt )
+{
+	lookupGates();
+	for ( unsigned int b = 0; b + 1 < batchStart_.size(); ++b ) {
+		unsigned int start = batchStart_[b];
+		unsigned int n = batchStart_[b + 1] - start;
+		double* state = &state_[ start ];
+		const double* A = &gateA_[ start ];
+		const double* B = &gateB_[ start ];
+		if ( gateInstant_[ start ] ) {
+			for ( unsigned int j = 0; j < n; ++j )
+				state[j] = A[j] / B[j];
+		} else {
+			// Same as HHChannel::integrate.
+			for ( unsigned int j = 0; j < n; ++j ) {
+				if ( B[j] > EPSILON ) {
+					double x = exp( -B[j] * dt );
+					state[j] = state[j] * x + ( A[j] / B[j] ) * ( 1.0 - x );
+				} else {
+					state[j] += A[j] * dt;
+				}
+			}
+		}
+	}
+	updateConductances();
+}
+
+/**
+ * Crank-Nicolson: a backward Euler step of dt/2 gives VMid, the Vm at
+ * the middle of the step, and then Vm( t + dt ) = 2 VMid - Vm( t ).
+ */
+void HSolve::advanceVm()
+{
+	unsigned int n = compartmentId_.size();
+	for ( unsigned int i = 0; i < n; ++i ) {
+		double G = externalGk_[i];
+		double GE = externalGkEk_[i];
+		for ( unsigned int j = chanStart_[i]; j < chanStart_[i+1]; ++j ) {
+			G += Gk_[j];
+			GE += Gk_[j] * Ek_[j];
+		}
+		diag_[i] = passiveDiag_[i] + G;
+		rhs_[i] = 2.0 * Cm_[i] / dt_ * Vm_[i] + Em_[i] / Rm_[i] + GE +
+			inject_[i] + injectVarying_[i];
+	}
+
+	// Each child comes before its parent, so eliminating in order only
+	// touches the parent.
+	for ( unsigned int i = 0; i < n; ++i ) {
+		unsigned int p = parent_[i];
+		if ( p != NONE ) {
+			double f = Ga_[i] / diag_[i];
+			diag_[p] -= f * Ga_[i];
+			rhs_[p] += f * rhs_[i];
+		}
+	}
+	for ( unsigned int i = n; i > 0; --i ) {
+		unsigned int k = i - 1;
+		double v = rhs_[k];
+		if ( parent_[k] != NONE )
+			v += Ga_[k] * VMid_[ parent_[k] ];
+		VMid_[k] = v / diag_[k];
+	}
+
+	for ( unsigned int i = 0; i < n; ++i ) {
+		Vm_[i] = 2.0 * VMid_[i] - Vm_[i];
+		Im_[i] = injectVarying_[i];
+	}
+	for ( unsigned int i = 0; i < n; ++i ) {
+		unsigned int p = parent_[i];
+		if ( p != NONE ) {
+			double I = Ga_[i] * ( Vm_[p] - Vm_[i] );
+			Im_[i] += I;
+			Im_[p] -= I;
+		}
+	}
+	for ( unsigned int i = 0; i < channelId_.size(); ++i )
+		Ik_[i] = Gk_[i] * ( Ek_[i] - VMid_[ chanCompt_[i] ] );
+
+	injectVarying_.assign( n, 0.0 );
+	externalGk_.assign( n, 0.0 );
+	externalGkEk_.assign( n, 0.0 );
+}
+
+void HSolve::advanceCalcium()
+{
+	for ( unsigned int i = 0; i < caInputChannel_.size(); ++i ) {
+		double I = Ik_[ caInputChannel_[i] ];
+		if ( caInputMode_[i] == CA_INCREASE )
+			I = fabs( I );
+		else if ( caInputMode_[i] == CA_DECREASE )
+			I = -fabs( I );
+		activation_[ caInputPool_[i] ] += I;
+	}
+	// Same as the CaConc.
+	for ( unsigned int i = 0; i < caConcId_.size(); ++i ) {
+		double x = caDecay_[i];
+		double Ca = CaBasal_[i] + c_[i] * x +
+			( B_[i] * activation_[i] * tau_[i] ) * ( 1.0 - x );
+		if ( ceiling_[i] > 0.0 && Ca > ceiling_[i] )
+			Ca = ceiling_[i];
+		else if ( Ca < floor_[i] )
+			Ca = floor_[i];
+		Ca_[i] = Ca;
+		c_[i] = Ca - CaBasal_[i];
+		activation_[i] = 0.0;
+	}
+}
+
+void HSolve::sendExternal()
+{
+	for ( vector< unsigned int >::iterator
+			i = externalVmOut_.begin(); i != externalVmOut_.end(); ++i )
+		Compartment::VmOut()->send( compartmentId_[ *i ].eref(),
+			Vm_[ *i ] );
+	for ( vector< unsigned int >::iterator
+			i = externalConcOut_.begin(); i != externalConcOut_.end(); ++i )
+		CaConc::concOut()->send( caConcId_[ *i ].eref(), Ca_[ *i ] );
+}
+
+//////////////////////////////////////////////////////////////
+// Zombie interface
+//////////////////////////////////////////////////////////////
+
+void HSolve::setVm( unsigned int compt, double Vm )
+{
+	Vm_[ compt ] = Vm;
+}
+
+double HSolve::getVm( unsigned int compt ) const
+{
+	return Vm_[ compt ];
+}
+
+void HSolve::setEm( unsigned int compt, double Em )
+{
+	Em_[ compt ] = Em;
+}
+
+void HSolve::setCm( unsigned int compt, double Cm )
+{
+	Cm_[ compt ] = Cm;
+	updatePassive();
+}
+
+void HSolve::setRm( unsigned int compt, double Rm )
+{
+	Rm_[ compt ] = Rm;
+	updatePassive();
+}
+
+void HSolve::setRa( unsigned int compt, double Ra )
+{
+	Ra_[ compt ] = Ra;
+	for ( unsigned int i = 0; i < raSource_.size(); ++i )
+		if ( raSource_[i] == compt )
+			Ga_[i] = 1.0 / Ra;
+	updatePassive();
+}
+
+double HSolve::getIm( unsigned int compt ) const
+{
+	return Im_[ compt ];
+}
+
+void HSolve::setInject( unsigned int compt, double inject )
+{
+	inject_[ compt ] = inject;
+}
+
+void HSolve::setInitVm( unsigned int compt, double initVm )
+{
+	initVm_[ compt ] = initVm;
+}
+
+void HSolve::addInject( unsigned int compt, double current )
+{
+	injectVarying_[ compt ] += current;
+}
+
+void HSolve::addExternalChannel( unsigned int compt, double Gk, double Ek )
+{
+	externalGk_[ compt ] += Gk;
+	externalGkEk_[ compt ] += Gk * Ek;
+}
+
+void HSolve::setGbar( unsigned int chan, double Gbar )
+{
+	Gbar_[ chan ] = Gbar;
+}
+
+void HSolve::setEk( unsigned int chan, double Ek )
+{
+	Ek_[ chan ] = Ek;
+}
+
+void HSolve::setGk( unsigned int chan, double Gk )
+{
+	Gk_[ chan ] = Gk;
+}
+
+double HSolve::getGk( unsigned int chan ) const
+{
+	return Gk_[ chan ];
+}
+
+double HSolve::getIk( unsigned int chan ) const
+{
+	return Ik_[ chan ];
+}
+
+void HSolve::setGateState( unsigned int chan, unsigned int gate,
+	double state )
+{
+	unsigned int j = gateIndex_[ 3 * chan + gate ];
+	if ( j == NONE )
+		return; // The HHChannel also ignores the power when unused.
+	state_[j] = state;
+	gateInited_[j] = true;
+}
+
+double HSolve::getGateState( unsigned int chan, unsigned int gate ) const
+{
+	unsigned int j = gateIndex_[ 3 * chan + gate ];
+	if ( j == NONE )
+		return 0.0;
+	return state_[j];
+}
+
+void HSolve::setChannelConc( unsigned int chan, double conc )
+{
+	chanConc_[ chan ] = conc;
+}
+
+void HSolve::setCa( unsigned int pool, double Ca )
+{
+	Ca_[ pool ] = Ca;
+	c_[ pool ] = Ca - CaBasal_[ pool ];
+}
+
+double HSolve::getCa( unsigned int pool ) const
+{
+	return Ca_[ pool ];
+}
+
+void HSolve::setCaBasal( unsigned int pool, double CaBasal )
+{
+	CaBasal_[ pool ] = CaBasal;
+	c_[ pool ] = Ca_[ pool ] - CaBasal;
+}
+
+void HSolve::setTau( unsigned int pool, double tau )
+{
+	tau_[ pool ] = tau;
+	caDecay_[ pool ] = exp( -dt_ / tau );
+}
+
+void HSolve::setB( unsigned int pool, double B )
+{
+	B_[ pool ] = B;
+}
+
+void HSolve::setCeiling( unsigned int pool, double ceiling )
+{
+	ceiling_[ pool ] = ceiling;
+}
+
+void HSolve::setFloor( unsigned int pool, double floor )
+{
+	floor_[ pool ] = floor;
+}
+
+void HSolve::addCaActivation( unsigned int pool, double I )
+{
+	activation_[ pool ] += I;
+}
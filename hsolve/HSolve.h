@@ -0,0 +1,300 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _HSOLVE_H
+#define _HSOLVE_H
+
+/**
+ * The HSolve is an implicit solver for branched neuronal models, using
+ * the method of Hines (1984). It takes over (zombifies) the
+ * Compartments, HHChannels and CaConcs of the model under its target
+ * path, and keeps all their state in flat arrays. The membrane
+ * potentials are advanced with Crank-Nicolson, which is stable for
+ * any dt, in O(N) per step for N compartments.
+ *
+ * The compartments are numbered so that every child comes before its
+ * parent. The matrix then has one off-diagonal term per compartment,
+ * for its parent, and Gaussian elimination of a leaf-to-root ordering
+ * makes no fill-in. A model may hold several cells, each is just
+ * another tree.
+ *
+ * There are no messages between the zombified objects. Objects the
+ * HSolve does not handle, such as SynChans and SpikeGens, keep running
+ * on their own. Their channel currents and injection messages come in
+ * through the zombies, and the HSolve sends out Vm and Ca to them on
+ * each step.
+ *
+ * Changes to fields such as Rm or Gbar go through the zombies to the
+ * solver. Changes to the structure of the model, such as adding a
+ * channel, need the target to be assigned again.
+ */
+class HSolve
+{
+	public:
+		HSolve();
+		HSolve( const HSolve& other );
+		HSolve& operator=( const HSolve& other );
+		~HSolve();
+
+		//////////////////////////////////////////////////////////////////
+		// Field assignment stuff
+		//////////////////////////////////////////////////////////////////
+		/// Assigns the path of the model, and sets up the solver for it.
+		void setTarget( string path );
+		string getTarget() const;
+		void setDt( double dt );
+		double getDt() const;
+		unsigned int getNumCompartments() const;
+		unsigned int getNumChannels() const;
+		unsigned int getNumCaConcs() const;
+
+		/**
+		 * Appends Vm, Im, the gate states, Gk, Ik and Ca to s, for a
+		 * checkpoint. setState reads them back, and returns false
+		 * without changing anything if the size does not match.
+		 */
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
+		//////////////////////////////////////////////////////////////////
+		// Dest Finfos
+		//////////////////////////////////////////////////////////////////
+		void process( const Eref& e, ProcPtr p );
+		void reinit( const Eref& e, ProcPtr p );
+
+		//////////////////////////////////////////////////////////////////
+		// Interface for the ZombieCompartment. The index is that of the
+		// compartment in the solver.
+		//////////////////////////////////////////////////////////////////
+		void setVm( unsigned int compt, double Vm );
+		double getVm( unsigned int compt ) const;
+		void setEm( unsigned int compt, double Em );
+		void setCm( unsigned int compt, double Cm );
+		void setRm( unsigned int compt, double Rm );
+		/// Updates the axial conductances that use this Ra.
+		void setRa( unsigned int compt, double Ra );
+		double getIm( unsigned int compt ) const;
+		void setInject( unsigned int compt, double inject );
+		void setInitVm( unsigned int compt, double initVm );
+		/// Adds current for this timestep only, from an injectMsg.
+		void addInject( unsigned int compt, double current );
+		/// Adds conductance for this timestep, from an unsolved channel.
+		void addExternalChannel( unsigned int compt, double Gk, double Ek );
+
+		//////////////////////////////////////////////////////////////////
+		// Interface for the ZombieHHChannel. The gate is 0, 1 or 2 for
+		// the X, Y and Z gates.
+		//////////////////////////////////////////////////////////////////
+		void setGbar( unsigned int chan, double Gbar );
+		void setEk( unsigned int chan, double Ek );
+		void setGk( unsigned int chan, double Gk );
+		double getGk( unsigned int chan ) const;
+		double getIk( unsigned int chan ) const;
+		void setGateState( unsigned int chan, unsigned int gate,
+			double state );
+		double getGateState( unsigned int chan, unsigned int gate ) const;
+		/// Assigns the conc used by a gate, from an unsolved source.
+		void setChannelConc( unsigned int chan, double conc );
+
+		//////////////////////////////////////////////////////////////////
+		// Interface for the ZombieCaConc.
+		//////////////////////////////////////////////////////////////////
+		void setCa( unsigned int pool, double Ca );
+		double getCa( unsigned int pool ) const;
+		void setCaBasal( unsigned int pool, double CaBasal );
+		void setTau( unsigned int pool, double tau );
+		void setB( unsigned int pool, double B );
+		void setCeiling( unsigned int pool, double ceiling );
+		void setFloor( unsigned int pool, double floor );
+		/// Adds to the activation for this timestep, from unsolved sources
+		void addCaActivation( unsigned int pool, double I );
+
+		//////////////////////////////////////////////////////////////////
+		static const Cinfo* initCinfo();
+
+	private:
+		//////////////////////////////////////////////////////////////////
+		// Setup
+		//////////////////////////////////////////////////////////////////
+		/**
+		 * Finds the compartments under the target, builds the trees,
+		 * finds the channels and CaConcs, and zombifies everything.
+		 * Returns false without changing anything if the model is not
+		 * one the HSolve can handle.
+		 */
+		bool setup();
+
+		/**
+		 * Orders the compartments so that each child comes before
+		 * its parent, and fills in the parent_ and Ga_ arrays.
+		 */
+		bool buildTrees( const vector< ObjId >& compts );
+
+		/**
+		 * Finds the HHChannels and CaConcs that the solver takes over.
+		 * An Element is only taken over if all its entries belong to
+		 * the model. Channels that are left out keep running on their
+		 * own, as for SynChans.
+		 */
+		void findChannels();
+
+		/// Takes over the objects, and loads their fields.
+		void zombify();
+
+		/// Restores the original classes of all the zombies.
+		void unzombify();
+
+		/// Elements taken over by the solver.
+		vector< Id > zombieCompartments_;
+		vector< Id > zombieChannels_;
+		vector< Id > zombieCaConcs_;
+
+		/**
+		 * Clock messages dropped from the zombies, as the Element, its
+		 * shared field ("init" or "proc") and the tick, so that
+		 * unzombify can schedule them again.
+		 */
+		vector< Id > schedId_;
+		vector< string > schedField_;
+		vector< unsigned int > schedTick_;
+		/// Records the ticks that call dest on the Elements in elist.
+		void findClockTicks( const vector< Id >& elist,
+			const string& dest, const string& field );
+
+		/// Recomputes the parts of the matrix that depend on dt.
+		void updatePassive();
+
+		//////////////////////////////////////////////////////////////////
+		// Calculations
+		//////////////////////////////////////////////////////////////////
+		/// Sorts the gates into batches that share an HHGate.
+		void batchGates();
+		/// Fills in gateA_ and gateB_ for all gates at the current Vm.
+		void lookupGates();
+		/// Computes Gk of all channels from the gate states.
+		void updateConductances();
+		/// Updates the gates and conductances of all channels.
+		void advanceChannels( double dt );
+		/// Solves the Hines matrix to advance Vm by one step.
+		void advanceVm();
+		/// Updates the CaConcs using the channel currents.
+		void advanceCalcium();
+		/// Sends Vm and Ca to the objects not handled by the solver.
+		void sendExternal();
+
+		string target_;
+		double dt_;
+
+		//////////////////////////////////////////////////////////////////
+		// Compartments, in order of their Hines index.
+		//////////////////////////////////////////////////////////////////
+		vector< ObjId > compartmentId_;
+		vector< double > Vm_;
+		vector< double > Cm_;
+		vector< double > Em_;
+		vector< double > Rm_;
+		vector< double > Ra_;
+		vector< double > initVm_;
+		vector< double > inject_;
+		/// Sum of the injectMsg currents for this step.
+		vector< double > injectVarying_;
+		/// Sum of the Gk and Gk.Ek from unsolved channels for this step.
+		vector< double > externalGk_;
+		vector< double > externalGkEk_;
+		/// Axial plus injected current in the last step, for getIm.
+		vector< double > Im_;
+
+		/// Index of the parent compartment, or ~0 for a root.
+		vector< unsigned int > parent_;
+		/// Axial conductance to the parent compartment.
+		vector< double > Ga_;
+		/// Compartment whose Ra sets Ga_.
+		vector< unsigned int > raSource_;
+		/// Diagonal terms from Cm, Rm and the axial conductances.
+		vector< double > passiveDiag_;
+		/// Workspace for the elimination.
+		vector< double > diag_;
+		vector< double > rhs_;
+		/// Vm at the middle of the step, t + dt/2.
+		vector< double > VMid_;
+		/// Compartments that have targets for VmOut outside the solver.
+		vector< unsigned int > externalVmOut_;
+
+		//////////////////////////////////////////////////////////////////
+		// Channels, grouped by compartment.
+		//////////////////////////////////////////////////////////////////
+		vector< ObjId > channelId_;
+		/// Channels of compartment i are chanStart_[i] to chanStart_[i+1]
+		vector< unsigned int > chanStart_;
+		vector< unsigned int > chanCompt_;
+		vector< double > Gbar_;
+		vector< double > Ek_;
+		vector< double > Gk_;
+		vector< double > Ik_;
+		/// Conc from an unsolved source, used for conc-dependent gates.
+		vector< double > chanConc_;
+		/// CaConc feeding conc to each channel, or ~0 to use chanConc_.
+		vector< unsigned int > chanCaConc_;
+
+		/**
+		 * The gates of all channels, sorted so that gates using the
+		 * same HHGate tables are together. Batch b runs from
+		 * batchStart_[b] to batchStart_[b+1], and its gates share the
+		 * HHGate, instant flag and choice of Vm or conc. Each batch is
+		 * done with one lookupBothArray call and one tight loop, so
+		 * that large numbers of identical channels cost little more
+		 * than the arithmetic. gateIndex_[3*c + k] locates gate k
+		 * (X, Y, Z) of channel c, or is ~0 if there is no such gate.
+		 */
+		vector< unsigned int > batchStart_;
+		vector< unsigned int > gateIndex_;
+		vector< unsigned int > gateChan_;
+		vector< const HHGate* > gate_;
+		vector< double > gatePower_;
+		vector< bool > gateInstant_;
+		/// True if the gate depends on conc rather than Vm.
+		vector< bool > gateUsesConc_;
+		/// True if the state was assigned, so reinit should keep it.
+		vector< bool > gateInited_;
+		vector< double > state_;
+		/// Workspace for the batched lookup: Vm or conc in, A and B out.
+		vector< double > gateInput_;
+		vector< double > gateA_;
+		vector< double > gateB_;
+
+		//////////////////////////////////////////////////////////////////
+		// CaConcs
+		//////////////////////////////////////////////////////////////////
+		vector< ObjId > caConcId_;
+		vector< double > Ca_;
+		vector< double > CaBasal_;
+		vector< double > tau_;
+		vector< double > B_;
+		vector< double > ceiling_;
+		vector< double > floor_;
+		/// Ca - CaBasal, as in the CaConc.
+		vector< double > c_;
+		/// exp( -dt / tau ), so that the step needs no exp.
+		vector< double > caDecay_;
+		vector< double > activation_;
+		/// CaConcs that have targets for concOut outside the solver.
+		vector< unsigned int > externalConcOut_;
+
+		/**
+		 * Each channel current going to a CaConc is multiplied by the
+		 * factor and added to its activation. The factor is 1 for the
+		 * current message, and +/-1 with the absolute value of the
+		 * current for increase and decrease.
+		 */
+		vector< unsigned int > caInputChannel_;
+		vector< unsigned int > caInputPool_;
+		vector< int > caInputMode_;
+};
+
+#endif // _HSOLVE_H
@@ -0,0 +1,126 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../biophysics/CaConc.h"
+#include "../biophysics/HHGate.h"
+#include "HSolve.h"
+#include "ZombieCaConc.h"
+
+const Cinfo* ZombieCaConc::initCinfo()
+{
+	static string doc[] =
+	{
+		"Name", "ZombieCaConc",
+		"Author", "Upi Bhalla",
+		"Description", "CaConc taken over by the HSolve.",
+	};
+	static Dinfo< ZombieCaConc > dinfo;
+	static Cinfo zombieCaConcCinfo(
+		"ZombieCaConc",
+		CaConc::initCinfo(),
+		0,
+		0,
+		&dinfo,
+		doc,
+		sizeof( doc ) / sizeof( string )
+	);
+
+	return &zombieCaConcCinfo;
+}
+
+static const Cinfo* zombieCaConcCinfo = ZombieCaConc::initCinfo();
+
+ZombieCaConc::ZombieCaConc()
+	: hsolve_( 0 ), index_( 0 )
+{;}
+
+void ZombieCaConc::setSolver( HSolve* hsolve, unsigned int index )
+{
+	hsolve_ = hsolve;
+	index_ = index;
+}
+
+//////////////////////////////////////////////////////////////
+// Field Definitions
+//////////////////////////////////////////////////////////////
+
+void ZombieCaConc::setCa( double val )
+{
+	CaConc::setCa( val );
+	hsolve_->setCa( index_, val );
+}
+
+double ZombieCaConc::getCa() const
+{
+	return hsolve_->getCa( index_ );
+}
+
+void ZombieCaConc::setCaBasal( double val )
+{
+	CaConc::setCaBasal( val );
+	hsolve_->setCaBasal( index_, val );
+}
+
+void ZombieCaConc::setTau( double val )
+{
+	CaConc::setTau( val );
+	hsolve_->setTau( index_, val );
+}
+
+void ZombieCaConc::setB( double val )
+{
+	CaConc::setB( val );
+	hsolve_->setB( index_, val );
+}
+
+void ZombieCaConc::setCeiling( double val )
+{
+	CaConc::setCeiling( val );
+	hsolve_->setCeiling( index_, val );
+}
+
+void ZombieCaConc::setFloor( double val )
+{
+	CaConc::setFloor( val );
+	hsolve_->setFloor( index_, val );
+}
+
+//////////////////////////////////////////////////////////////
+// MsgDest Definitions
+//////////////////////////////////////////////////////////////
+
+// The HSolve does these.
+void ZombieCaConc::reinit( const Eref& e, ProcPtr info )
+{;}
+
+void ZombieCaConc::process( const Eref& e, ProcPtr info )
+{;}
+
+// Currents from channels in the solver do not come this way, only
+// currents from other sources.
+void ZombieCaConc::current( double I )
+{
+	hsolve_->addCaActivation( index_, I );
+}
+
+void ZombieCaConc::currentFraction( double I, double fraction )
+{
+	hsolve_->addCaActivation( index_, I * fraction );
+}
+
+void ZombieCaConc::increase( double I )
+{
+	hsolve_->addCaActivation( index_, fabs( I ) );
+}
+
+void ZombieCaConc::decrease( double I )
+{
+	hsolve_->addCaActivation( index_, -fabs( I ) );
+}
@@ -0,0 +1,50 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _ZOMBIE_CACONC_H
+#define _ZOMBIE_CACONC_H
+
+/**
+ * This class is used by the HSolve to take over from regular CaConcs
+ * that get current from the channels in the solver.
+ */
+class ZombieCaConc: public CaConc
+{
+	public:
+		ZombieCaConc();
+
+		/// Assigns the solver, and the index of this CaConc in it.
+		void setSolver( HSolve* hsolve, unsigned int index );
+
+		//////////////////////////////////////////////////////////////////
+		// These functions override the virtual equivalents from the
+		// CaConc.
+		//////////////////////////////////////////////////////////////////
+		void setCa( double val );
+		double getCa() const;
+		void setCaBasal( double val );
+		void setTau( double val );
+		void setB( double val );
+		void setCeiling( double val );
+		void setFloor( double val );
+
+		void reinit( const Eref& e, ProcPtr info );
+		void process( const Eref& e, ProcPtr info );
+		void current( double I );
+		void currentFraction( double I, double fraction );
+		void increase( double I );
+		void decrease( double I );
+
+		static const Cinfo* initCinfo();
+	private:
+		HSolve* hsolve_;
+		unsigned int index_;
+};
+
+#endif // _ZOMBIE_CACONC_H
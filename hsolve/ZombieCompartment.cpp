@@ -0,0 +1,147 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../randnum/randnum.h"
+#include "../biophysics/Compartment.h"
+#include "../biophysics/HHGate.h"
+#include "HSolve.h"
+#include "ZombieCompartment.h"
+
+using namespace moose;
+
+const Cinfo* ZombieCompartment::initCinfo()
+{
+	static string doc[] =
+	{
+		"Name", "ZombieCompartment",
+		"Author", "Upi Bhalla",
+		"Description", "Compartment taken over by the HSolve.",
+	};
+	static Dinfo< ZombieCompartment > dinfo;
+	static Cinfo zombieCompartmentCinfo(
+		"ZombieCompartment",
+		Compartment::initCinfo(),
+		0,
+		0,
+		&dinfo,
+		doc,
+		sizeof( doc ) / sizeof( string )
+	);
+
+	return &zombieCompartmentCinfo;
+}
+
+static const Cinfo* zombieCompartmentCinfo =
+	ZombieCompartment::initCinfo();
+
+ZombieCompartment::ZombieCompartment()
+	: hsolve_( 0 ), index_( 0 )
+{;}
+
+void ZombieCompartment::setSolver( HSolve* hsolve, unsigned int index )
+{
+	hsolve_ = hsolve;
+	index_ = index;
+}
+
+//////////////////////////////////////////////////////////////
+// Field Definitions
+//////////////////////////////////////////////////////////////
+
+// The fields are also kept in the Compartment, so that they can be
+// restored if the HSolve lets go of the compartment.
+void ZombieCompartment::setVm( double Vm )
+{
+	Compartment::setVm( Vm );
+	hsolve_->setVm( index_, Vm );
+}
+
+double ZombieCompartment::getVm() const
+{
+	return hsolve_->getVm( index_ );
+}
+
+void ZombieCompartment::setEm( double Em )
+{
+	Compartment::setEm( Em );
+	hsolve_->setEm( index_, Compartment::getEm() );
+}
+
+void ZombieCompartment::setCm( double Cm )
+{
+	Compartment::setCm( Cm ); // Checks the range.
+	hsolve_->setCm( index_, Compartment::getCm() );
+}
+
+void ZombieCompartment::setRm( double Rm )
+{
+	Compartment::setRm( Rm );
+	hsolve_->setRm( index_, Compartment::getRm() );
+}
+
+void ZombieCompartment::setRa( double Ra )
+{
+	Compartment::setRa( Ra );
+	hsolve_->setRa( index_, Compartment::getRa() );
+}
+
+double ZombieCompartment::getIm() const
+{
+	return hsolve_->getIm( index_ );
+}
+
+void ZombieCompartment::setInject( double inject )
+{
+	Compartment::setInject( inject );
+	hsolve_->setInject( index_, inject );
+}
+
+void ZombieCompartment::setInitVm( double initVm )
+{
+	Compartment::setInitVm( initVm );
+	hsolve_->setInitVm( index_, initVm );
+}
+
+//////////////////////////////////////////////////////////////
+// MsgDest Definitions
+//////////////////////////////////////////////////////////////
+
+// The HSolve does all of these.
+void ZombieCompartment::process( const Eref& e, ProcPtr p )
+{;}
+
+void ZombieCompartment::innerReinit( const Eref& e, ProcPtr p )
+{;}
+
+void ZombieCompartment::innerInitProc( const Eref& e, ProcPtr p )
+{;}
+
+void ZombieCompartment::handleChannel( double Gk, double Ek )
+{
+	hsolve_->addExternalChannel( index_, Gk, Ek );
+}
+
+// Only other compartments send these, and they are all zombies too.
+void ZombieCompartment::handleRaxial( double Ra, double Vm )
+{;}
+
+void ZombieCompartment::handleAxial( double Vm )
+{;}
+
+void ZombieCompartment::injectMsg( double current )
+{
+	hsolve_->addInject( index_, current );
+}
+
+void ZombieCompartment::randInject( double prob, double current )
+{
+	if ( mtrand() < prob * hsolve_->getDt() )
+		hsolve_->addInject( index_, current );
+}
@@ -0,0 +1,57 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _ZOMBIE_COMPARTMENT_H
+#define _ZOMBIE_COMPARTMENT_H
+
+/**
+ * This class is used by the HSolve to take over from regular
+ * Compartments. It keeps a copy of the fields of the original, so that
+ * everything the HSolve does not care about, like the coordinates,
+ * works as before. The fields used in the calculations are passed on
+ * to the HSolve. The messages between compartments are not used.
+ */
+class ZombieCompartment: public moose::Compartment
+{
+	public:
+		ZombieCompartment();
+
+		/// Assigns the solver, and the index of this compartment in it.
+		void setSolver( HSolve* hsolve, unsigned int index );
+
+		//////////////////////////////////////////////////////////////////
+		// These functions override the virtual equivalents from the
+		// Compartment.
+		//////////////////////////////////////////////////////////////////
+		void setVm( double Vm );
+		double getVm() const;
+		void setEm( double Em );
+		void setCm( double Cm );
+		void setRm( double Rm );
+		void setRa( double Ra );
+		double getIm() const;
+		void setInject( double inject );
+		void setInitVm( double initVm );
+
+		void process( const Eref& e, ProcPtr p );
+		void innerReinit( const Eref& e, ProcPtr p );
+		void innerInitProc( const Eref& e, ProcPtr p );
+		void handleChannel( double Gk, double Ek );
+		void handleRaxial( double Ra, double Vm );
+		void handleAxial( double Vm );
+		void injectMsg( double current );
+		void randInject( double prob, double current );
+
+		static const Cinfo* initCinfo();
+	private:
+		HSolve* hsolve_;
+		unsigned int index_;
+};
+
+#endif // _ZOMBIE_COMPARTMENT_H
@@ -0,0 +1,131 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../biophysics/ChanBase.h"
+#include "../biophysics/HHGate.h"
+#include "../biophysics/HHChannel.h"
+#include "HSolve.h"
+#include "ZombieHHChannel.h"
+
+const Cinfo* ZombieHHChannel::initCinfo()
+{
+	static string doc[] =
+	{
+		"Name", "ZombieHHChannel",
+		"Author", "Upi Bhalla",
+		"Description", "HHChannel taken over by the HSolve.",
+	};
+	static Dinfo< ZombieHHChannel > dinfo;
+	static Cinfo zombieHHChannelCinfo(
+		"ZombieHHChannel",
+		HHChannel::initCinfo(),
+		0,
+		0,
+		&dinfo,
+		doc,
+		sizeof( doc ) / sizeof( string )
+	);
+
+	return &zombieHHChannelCinfo;
+}
+
+static const Cinfo* zombieHHChannelCinfo = ZombieHHChannel::initCinfo();
+
+ZombieHHChannel::ZombieHHChannel()
+	: hsolve_( 0 ), index_( 0 )
+{;}
+
+void ZombieHHChannel::setSolver( HSolve* hsolve, unsigned int index )
+{
+	hsolve_ = hsolve;
+	index_ = index;
+}
+
+//////////////////////////////////////////////////////////////
+// Field Definitions
+//////////////////////////////////////////////////////////////
+
+void ZombieHHChannel::setGbar( double Gbar )
+{
+	ChanBase::setGbar( Gbar );
+	hsolve_->setGbar( index_, Gbar );
+}
+
+void ZombieHHChannel::setEk( double Ek )
+{
+	ChanBase::setEk( Ek );
+	hsolve_->setEk( index_, Ek );
+}
+
+void ZombieHHChannel::setGk( double Gk )
+{
+	hsolve_->setGk( index_, Gk );
+}
+
+double ZombieHHChannel::getGk() const
+{
+	return hsolve_->getGk( index_ );
+}
+
+double ZombieHHChannel::getIk() const
+{
+	return hsolve_->getIk( index_ );
+}
+
+void ZombieHHChannel::setX( double X )
+{
+	hsolve_->setGateState( index_, 0, X );
+}
+
+double ZombieHHChannel::getX() const
+{
+	return hsolve_->getGateState( index_, 0 );
+}
+
+void ZombieHHChannel::setY( double Y )
+{
+	hsolve_->setGateState( index_, 1, Y );
+}
+
+double ZombieHHChannel::getY() const
+{
+	return hsolve_->getGateState( index_, 1 );
+}
+
+void ZombieHHChannel::setZ( double Z )
+{
+	hsolve_->setGateState( index_, 2, Z );
+}
+
+double ZombieHHChannel::getZ() const
+{
+	return hsolve_->getGateState( index_, 2 );
+}
+
+//////////////////////////////////////////////////////////////
+// MsgDest Definitions
+//////////////////////////////////////////////////////////////
+
+// The HSolve does all of these.
+void ZombieHHChannel::process( const Eref& e, ProcPtr p )
+{;}
+
+void ZombieHHChannel::reinit( const Eref& e, ProcPtr p )
+{;}
+
+void ZombieHHChannel::handleVm( double Vm )
+{;}
+
+// Conc from a CaConc in the solver does not come this way, only conc
+// from other sources.
+void ZombieHHChannel::handleConc( double conc )
+{
+	hsolve_->setChannelConc( index_, conc );
+}
@@ -0,0 +1,57 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _ZOMBIE_HHCHANNEL_H
+#define _ZOMBIE_HHCHANNEL_H
+
+/**
+ * This class is used by the HSolve to take over from regular
+ * HHChannels. The gates stay where they are, and the solver uses their
+ * lookup tables directly. The state variables, conductance and current
+ * are in the HSolve.
+ */
+class ZombieHHChannel: public HHChannel
+{
+	// The HSolve reads the initialization flags of the gates.
+	friend class HSolve;
+
+	public:
+		ZombieHHChannel();
+
+		/// Assigns the solver, and the index of this channel in it.
+		void setSolver( HSolve* hsolve, unsigned int index );
+
+		//////////////////////////////////////////////////////////////////
+		// These functions override the virtual equivalents from the
+		// HHChannel and ChanBase.
+		//////////////////////////////////////////////////////////////////
+		void setGbar( double Gbar );
+		void setEk( double Ek );
+		void setGk( double Gk );
+		double getGk() const;
+		double getIk() const;
+		void setX( double X );
+		double getX() const;
+		void setY( double Y );
+		double getY() const;
+		void setZ( double Z );
+		double getZ() const;
+
+		void process( const Eref& e, ProcPtr p );
+		void reinit( const Eref& e, ProcPtr p );
+		void handleVm( double Vm );
+		void handleConc( double conc );
+
+		static const Cinfo* initCinfo();
+	private:
+		HSolve* hsolve_;
+		unsigned int index_;
+};
+
+#endif // _ZOMBIE_HHCHANNEL_H
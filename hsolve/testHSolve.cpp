@@ -0,0 +1,277 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../shell/Shell.h"
+#include "../biophysics/Compartment.h"
+#include "../biophysics/ChanBase.h"
+#include "../biophysics/HHGate.h"
+#include "../biophysics/HHChannel.h"
+#include "../biophysics/CaConc.h"
+#include "HSolve.h"
+
+static const double EREST = -0.07;
+
+/**
+ * Same as testCompartmentProcess, but with the cable in the HSolve.
+ * The cable goes to the steady state Vm = Vm0 * exp( -x/lambda ).
+ */
+void testHSolvePassive()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	unsigned int size = 100;
+	double Rm = 1.0;
+	double Ra = 0.01;
+	double Cm = 1.0;
+	double dt = 0.01;
+	double runtime = 10;
+	double lambda = sqrt( Rm / Ra );
+
+	Id nid = shell->doCreate( "Neutral", Id(), "cable", 1 );
+	Id cid = shell->doCreate( "Compartment", nid, "compt", size );
+	Field< double >::setRepeat( cid, "initVm", 0.0 );
+	Field< double >::setRepeat( cid, "inject", 0 );
+	Field< double >::set( ObjId( cid, 0 ), "inject", 1.0 );
+	Field< double >::setRepeat( cid, "Rm", Rm );
+	Field< double >::setRepeat( cid, "Ra", Ra );
+	Field< double >::setRepeat( cid, "Cm", Cm );
+	Field< double >::setRepeat( cid, "Em", 0 );
+	Field< double >::setRepeat( cid, "Vm", 0 );
+	ObjId mid = shell->doAddMsg( "Diagonal", ObjId( cid ), "axialOut",
+		ObjId( cid ), "handleAxial" );
+	assert( !mid.bad() );
+	mid = shell->doAddMsg( "Diagonal", ObjId( cid ), "raxialOut",
+		ObjId( cid ), "handleRaxial" );
+	assert( !mid.bad() );
+	Field< int >::set( mid, "stride", -1 );
+
+	shell->doUseClock( "/cable/compt", "init", 0 );
+	shell->doUseClock( "/cable/compt", "process", 1 );
+
+	Id hsolve = shell->doCreate( "HSolve", nid, "hsolve", 1 );
+	Field< string >::set( hsolve, "target", "/cable" );
+	assert( Field< string >::get( hsolve, "target" ) == "/cable" );
+	assert( Field< unsigned int >::get( hsolve, "numCompartments" ) ==
+		size );
+	assert( cid.element()->cinfo()->name() == "ZombieCompartment" );
+	shell->doUseClock( "/cable/hsolve", "proc", 1 );
+
+	// Large steps are fine, the method is implicit.
+	shell->doSetClock( 0, dt * 10 );
+	shell->doSetClock( 1, dt * 10 );
+	shell->doReinit();
+	shell->doStart( runtime );
+
+	double Vmax = Field< double >::get( ObjId( cid, 0 ), "Vm" );
+	double delta = 0.0;
+	for ( unsigned int i = 0; i < size; i++ ) {
+		double Vm = Field< double >::get( ObjId( cid, i ), "Vm" );
+		double x = Vmax * exp( - static_cast< double >( i ) / lambda );
+		delta += ( Vm - x ) * ( Vm - x );
+	}
+	assert( delta < 1.0e-5 );
+
+	// Handing back the model leaves the state in the compartments.
+	Field< string >::set( hsolve, "target", "" );
+	assert( cid.element()->cinfo()->name() == "Compartment" );
+	assert( doubleEq( Field< double >::get( ObjId( cid, 0 ), "Vm" ),
+		Vmax ) );
+	assert( doubleEq( Field< double >::get( ObjId( cid, 0 ), "Rm" ), Rm ) );
+
+	// The compartments are back on their clock ticks, so without the
+	// inject the cable runs down on its own.
+	Field< double >::set( ObjId( cid, 0 ), "inject", 0.0 );
+	shell->doStart( 1.0 );
+	double Vm = Field< double >::get( ObjId( cid, 0 ), "Vm" );
+	assert( Vm < 0.9 * Vmax );
+
+	shell->doDelete( nid );
+	cout << "." << flush;
+}
+
+static void setupGate( Id chan, const string& gate, double* p )
+{
+	vector< double > parms( p, p + 10 );
+	parms.push_back( 150 );
+	parms.push_back( -0.1 );
+	parms.push_back( 0.05 );
+	Id gateId( chan.path() + "/" + gate );
+	assert( gateId != Id() );
+	SetGet1< vector< double > >::set( gateId, "setupAlpha", parms );
+	Field< bool >::set( gateId, "useInterpolation", 1 );
+}
+
+/**
+ * Makes a squid compartment on a short passive cable, with a CaConc
+ * driven by the K current. Returns the parent.
+ */
+static Id makeSquidCable( const string& name )
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id nid = shell->doCreate( "Neutral", Id(), name, 1 );
+	Id soma = shell->doCreate( "Compartment", nid, "soma", 1 );
+	Id dend = shell->doCreate( "Compartment", nid, "dend", 3 );
+	Id na = shell->doCreate( "HHChannel", soma, "Na", 1 );
+	Id k = shell->doCreate( "HHChannel", soma, "K", 1 );
+	Id ca = shell->doCreate( "CaConc", soma, "Ca", 1 );
+
+	Field< double >::set( soma, "Cm", 0.007854e-6 );
+	Field< double >::set( soma, "Ra", 7639.44e3 );
+	Field< double >::set( soma, "Rm", 424.4e3 );
+	Field< double >::set( soma, "Em", EREST + 0.010613 );
+	Field< double >::set( soma, "inject", 0.1e-6 );
+	Field< double >::set( soma, "initVm", EREST );
+	Field< double >::setRepeat( dend, "Cm", 0.007854e-6 );
+	Field< double >::setRepeat( dend, "Ra", 7639.44e3 );
+	Field< double >::setRepeat( dend, "Rm", 424.4e3 );
+	Field< double >::setRepeat( dend, "Em", EREST );
+	Field< double >::setRepeat( dend, "initVm", EREST );
+
+	// soma -> dend[0] -> dend[1] -> dend[2]
+	ObjId mid = shell->doAddMsg( "Single", ObjId( soma ), "axial",
+		ObjId( dend, 0 ), "raxial" );
+	assert( !mid.bad() );
+	mid = shell->doAddMsg( "Diagonal", ObjId( dend ), "axialOut",
+		ObjId( dend ), "handleAxial" );
+	assert( !mid.bad() );
+	mid = shell->doAddMsg( "Diagonal", ObjId( dend ), "raxialOut",
+		ObjId( dend ), "handleRaxial" );
+	Field< int >::set( mid, "stride", -1 );
+
+	mid = shell->doAddMsg( "Single", ObjId( soma ), "channel",
+		ObjId( na ), "channel" );
+	assert( !mid.bad() );
+	mid = shell->doAddMsg( "Single", ObjId( soma ), "channel",
+		ObjId( k ), "channel" );
+	assert( !mid.bad() );
+	mid = shell->doAddMsg( "Single", ObjId( k ), "IkOut",
+		ObjId( ca ), "current" );
+	assert( !mid.bad() );
+
+	Field< double >::set( na, "Gbar", 0.94248e-3 );
+	Field< double >::set( na, "Ek", EREST + 0.115 );
+	Field< double >::set( na, "Xpower", 3.0 );
+	Field< double >::set( na, "Ypower", 1.0 );
+	Field< double >::set( k, "Gbar", 0.282743e-3 );
+	Field< double >::set( k, "Ek", EREST - 0.012 );
+	Field< double >::set( k, "Xpower", 4.0 );
+
+	double m[] = { 0.1e6 * ( EREST + 0.025 ), -0.1e6, -1,
+		-( EREST + 0.025 ), -0.01, 4e3, 0, 0, -EREST, 0.018 };
+	double h[] = { 70, 0, 0, -EREST, 0.02,
+		1e3, 0, 1, -( EREST + 0.03 ), -0.01 };
+	double n[] = { 1e4 * ( 0.01 + EREST ), -1e4, -1.0,
+		-( EREST + 0.01 ), -0.01, 0.125e3, 0, 0, -EREST, 0.08 };
+	setupGate( na, "gateX", m );
+	setupGate( na, "gateY", h );
+	setupGate( k, "gateX", n );
+
+	Field< double >::set( ca, "CaBasal", 1e-4 );
+	Field< double >::set( ca, "tau", 0.002 );
+	Field< double >::set( ca, "B", 1e3 );
+
+	shell->doUseClock( "/" + name + "/#[ISA=Compartment]", "init", 0 );
+	shell->doUseClock( "/" + name + "/#[ISA=Compartment]", "process", 1 );
+	shell->doUseClock( "/" + name + "/soma/#", "process", 2 );
+	return nid;
+}
+
+/**
+ * Runs a squid model with and without the HSolve, and compares Vm and
+ * Ca. The HSolve uses Crank-Nicolson and the objects use exponential
+ * Euler, so the match is only to within the error of the methods.
+ */
+void testHSolveSquid()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	double dt = 1.0e-6;
+	unsigned int numSteps = 100;
+	double runtime = 0.01;
+	Id ref = makeSquidCable( "ref" );
+	Id sq = makeSquidCable( "squid" );
+
+	Id hsolve = shell->doCreate( "HSolve", sq, "hsolve", 1 );
+	Field< string >::set( hsolve, "target", "/squid" );
+	assert( Field< unsigned int >::get( hsolve, "numCompartments" ) == 4 );
+	assert( Field< unsigned int >::get( hsolve, "numChannels" ) == 2 );
+	assert( Field< unsigned int >::get( hsolve, "numCaConcs" ) == 1 );
+	assert( Id( "/squid/soma/K" ).element()->cinfo()->name() ==
+		"ZombieHHChannel" );
+	assert( Id( "/squid/soma/Ca" ).element()->cinfo()->name() ==
+		"ZombieCaConc" );
+	shell->doUseClock( "/squid/hsolve", "proc", 1 );
+
+	// Field changes go through to the solver.
+	Field< double >::set( Id( "/squid/soma/Na" ), "Gbar", 0.94248e-3 );
+
+	shell->doSetClock( 0, dt );
+	shell->doSetClock( 1, dt );
+	shell->doSetClock( 2, dt );
+	shell->doReinit();
+	double maxV = -1.0;
+	double delta = 0.0;
+	double caDelta = 0.0;
+	for ( unsigned int i = 0; i < numSteps; ++i ) {
+		shell->doStart( runtime / numSteps );
+		double x = Field< double >::get( Id( "/ref/soma" ), "Vm" );
+		double y = Field< double >::get( Id( "/squid/soma" ), "Vm" );
+		delta += ( x - y ) * ( x - y );
+		if ( maxV < y )
+			maxV = y;
+		x = Field< double >::get( Id( "/ref/soma/Ca" ), "Ca" );
+		y = Field< double >::get( Id( "/squid/soma/Ca" ), "Ca" );
+		caDelta += ( x - y ) * ( x - y ) / ( x * x );
+	}
+	assert( maxV > 0.0 ); // It fires.
+	assert( sqrt( delta / numSteps ) < 1.0e-3 );
+	assert( sqrt( caDelta / numSteps ) < 1.0e-2 );
+
+	// The batched lookup matches the single one, in and out of range.
+	const HHGate* gate = reinterpret_cast< const HHGate* >(
+		ObjId( "/ref/soma/K/gateX" ).data() );
+	vector< double > v;
+	for ( double x = -0.12; x < 0.07; x += 0.0007 )
+		v.push_back( x );
+	vector< double > A( v.size() );
+	vector< double > B( v.size() );
+	gate->lookupBothArray( &v[0], &A[0], &B[0], v.size() );
+	for ( unsigned int i = 0; i < v.size(); ++i ) {
+		double a = 0.0;
+		double b = 0.0;
+		gate->lookupBoth( v[i], &a, &b );
+		assert( a == A[i] && b == B[i] );
+	}
+
+	// Deleting the solver hands the model back with its current state.
+	Id na( "/squid/soma/Na" );
+	double naX = Field< double >::get( na, "X" );
+	double naY = Field< double >::get( na, "Y" );
+	double naGk = Field< double >::get( na, "Gk" );
+	double somaVm = Field< double >::get( Id( "/squid/soma" ), "Vm" );
+	assert( naGk > 0.0 );
+	shell->doDelete( hsolve );
+	assert( na.element()->cinfo()->name() == "HHChannel" );
+	assert( Id( "/squid/soma" ).element()->cinfo()->name() ==
+		"Compartment" );
+	assert( doubleEq( Field< double >::get( na, "X" ), naX ) );
+	assert( doubleEq( Field< double >::get( na, "Y" ), naY ) );
+	assert( doubleEq( Field< double >::get( na, "Gk" ), naGk ) );
+	assert( doubleEq( Field< double >::get( Id( "/squid/soma" ), "Vm" ),
+		somaVm ) );
+
+	shell->doDelete( ref );
+	shell->doDelete( sq );
+	cout << "." << flush;
+}
+
+void testHSolve()
+{
+	testHSolvePassive();
+	testHSolveSquid();
+}
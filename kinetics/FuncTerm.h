@@ -19,6 +19,8 @@ class FuncTerm
 		/**
 		 * This computes the value. The time t is an argument needed by
 		 * some peculiar functions.
+		 * Must be safe to call concurrently from several threads, as the
+		 * multithreaded Ksolve evaluates different voxels in parallel.
 		 */
 		virtual double operator() ( const double* S, double t ) const = 0;
 
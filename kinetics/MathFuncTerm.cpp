@@ -14,10 +14,17 @@
 using namespace std;
 */
 #include "header.h"
+#include <pthread.h>
 #include "MathFunc.h"
 #include "FuncTerm.h"
 #include "MathFuncTerm.h"
 
+/**
+ * MathFunc::op keeps its working stack in the MathFunc, so calls from
+ * different threads must be serialized.
+ */
+static pthread_mutex_t mathFuncMutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 double MathTerm::operator() ( const double* S, double t ) const
 {
@@ -25,7 +32,10 @@ double MathTerm::operator() ( const double* S, double t ) const
 	for( vector< unsigned int >::const_iterator i = args_.begin(); 
 		i != args_.end(); i++ )
 		args.push_back( S[ *i ] );
-	return func_->op( args );
+	pthread_mutex_lock( &mathFuncMutex );
+	double ret = func_->op( args );
+	pthread_mutex_unlock( &mathFuncMutex );
+	return ret;
 }
 
 unsigned int MathTerm::getReactants( vector< unsigned int >& molIndex )
@@ -50,7 +60,10 @@ double MathTimeTerm::operator() ( const double* S, double t ) const
 	for( vector< unsigned int >::const_iterator i = args_.begin(); 
 		i != args_.end(); i++ )
 		args.push_back( S[ *i ] );
-	return func_->op( args );
+	pthread_mutex_lock( &mathFuncMutex );
+	double ret = func_->op( args );
+	pthread_mutex_unlock( &mathFuncMutex );
+	return ret;
 }
 
 unsigned int MathTimeTerm::getReactants( vector< unsigned int >& molIndex )
@@ -8,6 +8,7 @@
 **********************************************************************/
 
 #include <fstream>
+#include <set>
 #include "header.h"
 #include "../shell/Shell.h"
 
@@ -110,11 +111,16 @@ Id ReadCspace::readModelString( const string& model,
 	string temp = model.substr( pos + 1 );
 	pos = temp.find_first_of( " 	\n" );
 	
+	vector< string > entries;
 	for (unsigned long i = 0 ; i < temp.length() && i < pos; i += 5 ) {
-		build( temp.c_str() + i );
+		entries.push_back( temp.substr( i, 4 ) );
 		if ( temp[ i + 4 ] != '|' )
 			break;
 	}
+	makeBulkElements( entries );
+	for ( unsigned int i = 0; i < entries.size(); ++i )
+		build( entries[i].c_str() );
+	bulkReacs_.clear();
 
 	parms_.insert( parms_.begin(), molparms_.begin(), molparms_.end() );
 
@@ -223,7 +229,14 @@ void ReadCspace::expandReaction( const char* name, int nm1 )
 		return;
 	int i;
 
-	Id reacId = s->doCreate( "Reac", compt_, name, 1 );
+	Id reacId;
+	map< string, Id >::iterator bi = bulkReacs_.find( name );
+	if ( bi != bulkReacs_.end() ) {
+		reacId = bi->second;
+		bulkReacs_.erase( bi );
+	} else {
+		reacId = s->doCreate( "Reac", compt_, name, 1 );
+	}
 	
 	// A is always a substrate
 	for (i = 0; i < nm1; i++ ) {
@@ -293,8 +306,6 @@ void ReadCspace::build( const char* name )
 
 void ReadCspace::makeMolecule( char name )
 {
-	static Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
-
 	if ( name == 'X' ) // silently ignore it, as it is a legal state
 		return;
 	if ( name < 'a' || name > 'z' ) {
@@ -310,18 +321,51 @@ void ReadCspace::makeMolecule( char name )
 					molseq_.end() )
 			molseq_.push_back( index - 1 );
 
-	for ( unsigned int i = mol_.size(); i < index; i++ ) {
+	makeMolecules( index );
+}
+
+void ReadCspace::makeMolecules( unsigned int num )
+{
+	static Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+
+	vector< string > names;
+	for ( unsigned int i = mol_.size(); i < num; i++ ) {
 		string molname("");
 		molname += 'a' + i;
-		/*
-		stringstream ss( "a" );
-		ss << i ;
-		string molname = ss.str();
-		*/
-		Id temp = s->doCreate( "Pool", compt_, molname, 1 );
-		mol_.push_back( temp );
-		molparms_.push_back( DEFAULT_CONC );
+		names.push_back( molname );
+	}
+	if ( names.size() == 0 )
+		return;
+	vector< Id > temp = s->doCreateMany( "Pool", compt_, names );
+	assert( temp.size() == names.size() );
+	mol_.insert( mol_.end(), temp.begin(), temp.end() );
+	molparms_.resize( mol_.size(), DEFAULT_CONC );
+}
+
+void ReadCspace::makeBulkElements( const vector< string >& entries )
+{
+	static Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+
+	char last = 'a' - 1;
+	set< string > reacNames;
+	for ( unsigned int i = 0; i < entries.size(); ++i ) {
+		const string& name = entries[i];
+		if ( name.length() < 4 )
+			continue;
+		for ( unsigned int j = 1; j < 4; ++j )
+			if ( name[j] >= 'a' && name[j] <= 'z' && name[j] > last )
+				last = name[j];
+		if ( !( name[0] == 'C' || name[0] == 'D' || name[0] >= 'J' ) )
+			reacNames.insert( name );
 	}
+	makeMolecules( 1 + last - 'a' );
+
+	// A name repeated in the model is left for doCreate to report.
+	bulkReacs_.clear();
+	vector< string > names( reacNames.begin(), reacNames.end() );
+	vector< Id > ids = s->doCreateMany( "Reac", compt_, names );
+	for ( unsigned int i = 0; i < ids.size(); ++i )
+		bulkReacs_[ names[i] ] = ids[i];
 }
 
 void ReadCspace::deployParameters( )
@@ -332,28 +376,49 @@ void ReadCspace::deployParameters( )
 		cerr << "ReadCspace::deployParameters: Error: # of parms mismatch\n";
 		return;
 	}
+	// The parameters are gathered into columns, one for each field, 
+	// and each column is assigned in a single call.
+	vector< ObjId > mols( mol_.begin(), mol_.end() );
+	vector< double > concInit( mol_.size() );
 	for ( i = 0; i < mol_.size(); i++ ) {
 		// SetField(mol_[ i ], "volscale", volscale );
 		// SetField(mol_[ molseq_[i] ], "ninit", parms_[ i ] );
 
 		// Parameters are in micromolar, but the conc units are millimolar.
-		Field< double >::set( mol_[i], "concInit", parms_[i] *  1e-3 );
+		concInit[i] = parms_[i] * 1e-3;
 	}
+	Field< double >::setMany( mols, "concInit", concInit );
+
+	vector< ObjId > reacs;
+	vector< double > kf;
+	vector< double > kb;
+	vector< ObjId > enzs;
+	vector< double > k3;
+	vector< double > k2;
+	vector< double > Km;
 	for ( j = 0; j < reac_.size(); j++ ) {
 		if ( reac_[ j ].element()->cinfo()->isA( "Reac" ) ) {
-			Field< double >::set( reac_[j], "Kf", parms_[i++] );
-			Field< double >::set( reac_[j], "Kb", parms_[i++] );
+			reacs.push_back( reac_[j] );
+			kf.push_back( parms_[i++] );
+			kb.push_back( parms_[i++] );
 		} else {
-			Field< double >::set( reac_[j], "k3", parms_[i] );
-			Field< double >::set( reac_[j], "k2", 4.0 * parms_[i++] );
+			enzs.push_back( reac_[j] );
+			k3.push_back( parms_[i] );
+			k2.push_back( 4.0 * parms_[i++] );
 			// Again, note that conc units in MOOSE are millimolar, so we
 			// need to convert from the CSPACE micromolar units.
-			Field< double >::set( reac_[j], "Km", parms_[i++] * 1e-3 );
+			Km.push_back( parms_[i++] * 1e-3 );
 			vector< Id > cplx( 0 );
 			Neutral::children( reac_[j].eref(), cplx );
 			assert( cplx.size() == 1 );
 		}
 	}
+	Field< double >::setMany( reacs, "Kf", kf );
+	Field< double >::setMany( reacs, "Kb", kb );
+	// Km goes last, as setting it recomputes k1 from k2 and k3.
+	Field< double >::setMany( enzs, "k3", k3 );
+	Field< double >::setMany( enzs, "k2", k2 );
+	Field< double >::setMany( enzs, "Km", Km );
 }
 
 void ReadCspace::testReadModel( )
@@ -100,6 +100,17 @@ class ReadCspace
 		void testReadModel( );
 
 		void makeMolecule( char name ); 
+
+		/// Makes the molecules up to number num, all in one call.
+		void makeMolecules( unsigned int num );
+
+		/**
+		 * Makes all the molecules and the reactions named in the
+		 * topology entries with one doCreateMany each, before the
+		 * entries are built one by one. The enzymes are left to
+		 * expandEnzyme, as they sit under their own molecules.
+		 */
+		void makeBulkElements( const vector< string >& entries );
 		
 	private:
 		static const double SCALE;
@@ -118,6 +129,8 @@ class ReadCspace
 		vector< unsigned int > molseq_;
 		// Just a list of reactions and enzymes, in order of occurrence
 		vector< Id > reac_;
+		// Reactions made by makeBulkElements, by name.
+		map< string, Id > bulkReacs_;
 		// All the model parameters. First are the mol concs, then rates
 		vector< double > parms_;
 		// Temporary storage for default molecular concs.
@@ -113,7 +113,6 @@ void ReadKkit::setMoveOntoCompartment( bool v )
 Id  makeStandardElements( Id pa, const string& modelname )
 {
 	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
-	cout << " kkit read " << pa << " " << modelname << " "<< MooseGlobal;
 	Id mgr = shell->doCreate( "Neutral", pa, modelname, 1, MooseGlobal );
 	Id kinetics = 
 		shell->doCreate( "CubeMesh", mgr, "kinetics", 1,  MooseGlobal );
@@ -238,6 +237,7 @@ void ReadKkit::innerRead( ifstream& fin )
 	string::size_type pos;
 	bool clearLine = 1;
 	ParseMode parseMode = INIT;
+	vector< string > dataLines;
 
 	while ( getline( fin, temp ) ) {
 		lineNum_++;
@@ -288,7 +288,7 @@ void ReadKkit::innerRead( ifstream& fin )
 		}
 
 		if ( parseMode == DATA )
-				readData( line );
+				dataLines.push_back( line );
 		else if ( parseMode == INIT ) {
 				parseMode = readInit( line );
 		}
@@ -307,6 +307,117 @@ void ReadKkit::innerRead( ifstream& fin )
 			" PlotDt = " << plotdt_ <<
 			endl;
 			*/
+	// The data lines are gathered first so that the objects that come
+	// in large numbers can be made in bulk before the lines are read.
+	makeBulkElements( dataLines );
+	for ( unsigned int i = 0; i < dataLines.size(); ++i )
+		readData( dataLines[i] );
+	bulkIds_.clear();
+	flushFields();
+}
+
+string ReadKkit::bulkClass( const vector< string >& args ) const
+{
+	if ( args.size() < 3 || args[0] != "simundump" )
+		return "";
+	// The maps are only filled in by simobjdump, so use find.
+	map< string, int >::const_iterator i;
+	if ( args[1] == "group" )
+		return "Neutral";
+	if ( args[1] == "kreac" )
+		return "Reac";
+	if ( args[1] == "kpool" ) {
+		i = poolMap_.find( "slave_enable" );
+		if ( i == poolMap_.end() || i->second >= ( int )args.size() )
+			return "";
+		int slaveEnable = atoi( args[ i->second ].c_str() );
+		return ( slaveEnable & 4 ) ? "BufPool" : "Pool";
+	}
+	if ( args[1] == "kenz" ) {
+		i = enzMap_.find( "usecomplex" );
+		if ( i == enzMap_.end() || i->second >= ( int )args.size() )
+			return "";
+		bool isMM = atoi( args[ i->second ].c_str() );
+		return isMM ? "MMenz" : "Enz";
+	}
+	return "";
+}
+
+void ReadKkit::makeBulkElements( const vector< string >& lines )
+{
+	// depth -> ( parent path, class ) -> names
+	typedef map< pair< string, string >, vector< string > > Siblings;
+	map< unsigned int, Siblings > levels;
+	for ( unsigned int i = 0; i < lines.size(); ++i ) {
+		vector< string > argv;
+		chopLine( lines[i], argv ); 
+		if ( argv.size() == 0 )
+			continue;
+		if ( argv[0] == "simobjdump" ) {
+			objdump( argv );
+			continue;
+		}
+		string type = bulkClass( argv );
+		if ( type == "" )
+			continue;
+		string head;
+		string clean = cleanPath( argv[2] );
+		string tail = pathTail( clean, head );
+		unsigned int depth = count( clean.begin(), clean.end(), '/' );
+		levels[ depth ][ make_pair( head, type ) ].push_back( tail );
+	}
+
+	bulkIds_.clear();
+	for ( map< unsigned int, Siblings >::iterator 
+		i = levels.begin(); i != levels.end(); ++i ) {
+		for ( Siblings::iterator j = i->second.begin(); 
+			j != i->second.end(); ++j ) {
+			Id pa = shell_->doFind( j->first.first ).id;
+			if ( pa == Id() )
+				continue;
+			// If a name is taken, nothing is made here and the build
+			// function reports it through doCreate.
+			vector< Id > ids = shell_->doCreateMany( j->first.second, 
+				pa, j->second );
+			for ( unsigned int k = 0; k < ids.size(); ++k )
+				bulkIds_[ make_pair( pa, j->second[k] ) ] = ids[k];
+		}
+	}
+}
+
+Id ReadKkit::makeElement( const string& type, Id pa, const string& tail )
+{
+	map< pair< Id, string >, Id >::iterator i = 
+		bulkIds_.find( make_pair( pa, tail ) );
+	if ( i != bulkIds_.end() ) {
+		Id ret = i->second;
+		bulkIds_.erase( i );
+		return ret;
+	}
+	return shell_->doCreate( type, pa, tail, 1 );
+}
+
+void ReadKkit::queueField( Id id, const string& field, double value )
+{
+	unsigned int i = find( queuedFields_.begin(), queuedFields_.end(), 
+		field ) - queuedFields_.begin();
+	if ( i == queuedFields_.size() ) {
+		queuedFields_.push_back( field );
+		queuedObjs_.resize( i + 1 );
+		queuedValues_.resize( i + 1 );
+	}
+	queuedObjs_[i].push_back( id );
+	queuedValues_[i].push_back( value );
+}
+
+void ReadKkit::flushFields()
+{
+	for ( unsigned int i = 0; i < queuedFields_.size(); ++i )
+		Field< double >::setMany( queuedObjs_[i], queuedFields_[i], 
+			queuedValues_[i] );
+	queuedFields_.clear();
+	queuedObjs_.clear();
+	queuedValues_.clear();
 }
 
 ReadKkit::ParseMode ReadKkit::readInit( const string& line )
@@ -540,15 +651,15 @@ Id ReadKkit::buildReac( const vector< string >& args )
 	// So we convert all the Kfs and Kbs in the entire system after
 	// the model has been created, once we know the order of each reac.
 
-	Id reac = shell_->doCreate( "Reac", pa, tail, 1 );
+	Id reac = makeElement( "Reac", pa, tail );
 	reacIds_[ clean.substr( 10 ) ] = reac; 
 	// Here is another hack: The native values stored in the reac are
 	// Kf and Kb, in conc units. However the 'clean' values from kkit
 	// are the number values numKf and numKb. In the 
 	// function convertReacRatesToNumUnits we take the numKf and numKb and
 	// do proper conc scaling.
-	Field< double >::set( reac, "Kf", kf );
-	Field< double >::set( reac, "Kb", kb );
+	queueField( reac, "Kf", kf );
+	queueField( reac, "Kb", kb );
 
 	Id info = buildInfo( reac, reacMap_, args );
 	numReacs_++;
@@ -738,7 +849,7 @@ Id ReadKkit::buildEnz( const vector< string >& args )
 	 */
 
 	if ( isMM ) {
-		Id enz = shell_->doCreate( "MMenz", pa, tail, 1 );
+		Id enz = makeElement( "MMenz", pa, tail );
 		assert( enz != Id () );
 		string mmEnzPath = clean.substr( 10 );
 		mmEnzIds_[ mmEnzPath ] = enz; 
@@ -746,13 +857,13 @@ Id ReadKkit::buildEnz( const vector< string >& args )
 		assert( k1 > EPSILON );
 		double Km = ( k2 + k3 ) / k1;
 
-		Field< double >::set( enz, "Km", Km );
-		Field< double >::set( enz, "kcat", k3 );
+		queueField( enz, "Km", Km );
+		queueField( enz, "kcat", k3 );
 		Id info = buildInfo( enz, enzMap_, args );
 		numMMenz_++;
 		return enz;
 	} else {
-		Id enz = shell_->doCreate( "Enz", pa, tail, 1 );
+		Id enz = makeElement( "Enz", pa, tail );
 		// double parentVol = Field< double >::get( pa, "volume" );
 		assert( enz != Id () );
 		string enzPath = clean.substr( 10 );
@@ -760,9 +871,9 @@ Id ReadKkit::buildEnz( const vector< string >& args )
 
 		// Need to figure out what to do about these. Perhaps it is OK
 		// to do this assignments in raw #/cell units.
-		Field< double >::set( enz, "k3", k3 );
-		Field< double >::set( enz, "k2", k2 );
-		Field< double >::set( enz, "k1", k1 );
+		queueField( enz, "k3", k3 );
+		queueField( enz, "k2", k2 );
+		queueField( enz, "k1", k1 );
 
 		string cplxName = tail + "_cplx";
 		string cplxPath = enzPath + "/" + cplxName;
@@ -770,7 +881,7 @@ Id ReadKkit::buildEnz( const vector< string >& args )
 		assert( cplx != Id () );
 		poolIds_[ cplxPath ] = cplx; 
 		// Field< double >::set( cplx, "nInit", nComplexInit );
-		Field< double >::set( cplx, "nInit", nComplexInit );
+		queueField( cplx, "nInit", nComplexInit );
 
 		// Use this later to assign mesh entries to enz cplx.
 		enzCplxMols_.push_back( pair< Id, Id >(  pa, cplx ) );
@@ -806,8 +917,8 @@ Id ReadKkit::buildInfo( Id parent,
 	double x = atof( args[ m[ "x" ] ].c_str() );
 	double y = atof( args[ m[ "y" ] ].c_str() );
 
-	Field< double >::set( info, "x", x );
-	Field< double >::set( info, "y", y );
+	queueField( info, "x", x );
+	queueField( info, "y", y );
 	Field< string >::set( info, "color", args[ m[ "xtree_fg_req" ] ] );
 	Field< string >::set( info, "textColor", 
 		args[ m[ "xtree_textfg_req" ] ] );
@@ -822,7 +933,7 @@ Id ReadKkit::buildGroup( const vector< string >& args )
 
 	Id pa = shell_->doFind( head ).id;
 	assert( pa != Id() );
-	Id group = shell_->doCreate( "Neutral", pa, tail, 1 );
+	Id group = makeElement( "Neutral", pa, tail );
 	assert( group != Id() );
 	Id info = buildInfo( group, groupMap_, args );
 
@@ -866,11 +977,11 @@ Id ReadKkit::buildPool( const vector< string >& args )
 
 	Id pool;
 	if ( slaveEnable == 0 ) {
-		pool = shell_->doCreate( "Pool", pa, tail, 1 );
+		pool = makeElement( "Pool", pa, tail );
 	} else if ( slaveEnable & 4 ) {
-		pool = shell_->doCreate( "BufPool", pa, tail, 1 );
+		pool = makeElement( "BufPool", pa, tail );
 	} else {
-		pool = shell_->doCreate( "Pool", pa, tail, 1 );
+		pool = makeElement( "Pool", pa, tail );
 		/*
 		cout << "ReadKkit::buildPool: Unknown slave_enable flag '" << 
 			slaveEnable << "' on " << clean << "\n";
@@ -881,8 +992,8 @@ Id ReadKkit::buildPool( const vector< string >& args )
 	// skip the 10 chars of "/kinetics/"
 	poolIds_[ clean.substr( 10 ) ] = pool; 
 
-	Field< double >::set( pool, "nInit", nInit );
-	Field< double >::set( pool, "diffConst", diffConst );
+	queueField( pool, "nInit", nInit );
+	queueField( pool, "diffConst", diffConst );
 	// SetGet1< double >::set( pool, "setVolume", vol );
 	separateVols( pool, vol );
 	poolVols_[pool] = vol;
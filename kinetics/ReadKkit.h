@@ -176,6 +176,41 @@ class ReadKkit
 		 */
 		string cleanPath( const string& path ) const;
 
+		/**
+		 * Queues a field value for the object. The build functions
+		 * queue their parameters rather than setting them one by one,
+		 * and innerRead assigns each field as a single column with
+		 * flushFields once the whole file has been read.
+		 */
+		void queueField( Id id, const string& field, double value );
+
+		/// Assigns and clears the queued field values.
+		void flushFields();
+
+		/**
+		 * Returns the MOOSE class that the simundump line in args
+		 * builds, for the groups, pools, reacs and enzymes, which are
+		 * the objects that come in large numbers under one parent.
+		 * Returns an empty string for everything else.
+		 */
+		string bulkClass( const vector< string >& args ) const;
+
+		/**
+		 * Makes the groups, pools, reacs and enzymes dumped in the data
+		 * lines with one doCreateMany for each parent and class, a
+		 * level of the tree at a time so that the parents are there
+		 * first. The build functions then pick them up through
+		 * makeElement when the lines are read in order.
+		 */
+		void makeBulkElements( const vector< string >& lines );
+
+		/**
+		 * Returns the object of the given class and name under pa made
+		 * by makeBulkElements, or makes it with doCreate if there is
+		 * none.
+		 */
+		Id makeElement( const string& type, Id pa, const string& tail );
+
 	private:
 		string basePath_; /// Base path into which entire kkit model will go
 		Id baseId_; /// Base Id onto which entire kkit model will go.
@@ -249,6 +284,18 @@ class ReadKkit
 
 		map< Id, double > poolVols_; // Need for enz complexes.
 
+		/**
+		 * Columns of queued field values, kept in the order the fields
+		 * were first queued so that each object sees its fields set in
+		 * the same order as before.
+		 */
+		vector< string > queuedFields_;
+		vector< vector< ObjId > > queuedObjs_;
+		vector< vector< double > > queuedValues_;
+
+		/// Objects made by makeBulkElements, by parent and name.
+		map< pair< Id, string >, Id > bulkIds_;
+
 		Shell* shell_;
 
 		static const double EPSILON;
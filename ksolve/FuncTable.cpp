@@ -0,0 +1,60 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "FuncTerm.h"
+#include "SumTotalTerm.h"
+#include "FuncTable.h"
+
+FuncTable::FuncTable()
+{;}
+
+unsigned int FuncTable::size() const
+{
+	return kind_.size();
+}
+
+void FuncTable::build( const vector< FuncTerm* >& funcs )
+{
+	kind_.clear();
+	molStart_.assign( 1, 0 );
+	mol_.clear();
+	other_.clear();
+
+	for ( unsigned int i = 0; i < funcs.size(); ++i ) {
+		assert( funcs[i] );
+		if ( typeid( *funcs[i] ) == typeid( SumTotalTerm ) ) {
+			vector< unsigned int > molIndex;
+			funcs[i]->getReactants( molIndex );
+			kind_.push_back( SUM );
+			mol_.insert( mol_.end(), molIndex.begin(), molIndex.end() );
+			other_.push_back( 0 );
+		} else {
+			kind_.push_back( OTHER );
+			other_.push_back( funcs[i] );
+		}
+		molStart_.push_back( mol_.size() );
+	}
+}
+
+void FuncTable::compute( const double* S, double t, double* ret ) const
+{
+	const unsigned int* mol = mol_.empty() ? 0 : &mol_[0];
+	for ( unsigned int i = 0; i < kind_.size(); ++i ) {
+		if ( kind_[i] == SUM ) {
+			double sum = 0.0;
+			for ( unsigned int k = molStart_[i]; k < molStart_[i + 1]; ++k )
+				sum += S[ mol[k] ];
+			ret[i] = sum;
+		} else {
+			ret[i] = (*other_[i])( S, t );
+		}
+		assert( !isnan( ret[i] ) );
+	}
+}
@@ -0,0 +1,58 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _FUNC_TABLE_H
+#define _FUNC_TABLE_H
+
+class FuncTerm;
+
+/**
+ * Flattened form of the vector< FuncTerm* > in the Stoich, used to
+ * compute all the function pools in one loop without a virtual call per
+ * term. Like the RateTable, it is built once when the model is set up.
+ * Each FuncTerm becomes one operation in a flat program: a SumTotalTerm
+ * becomes a SUM over a range of a shared array of pool indices, and any
+ * other FuncTerm falls back to the virtual operator().
+ *
+ * The operations are run in the order of the FuncTerms, and each result
+ * is stored before the next one is computed, so a function of another
+ * function pool sees the same value as it would from the FuncTerms.
+ */
+class FuncTable
+{
+	public:
+		FuncTable();
+
+		/// Lowers the funcs into the flat program.
+		void build( const vector< FuncTerm* >& funcs );
+
+		/// Returns number of func terms. Zero if not yet built.
+		unsigned int size() const;
+
+		/**
+		 * Computes each func in turn at the pool numbers S and time t,
+		 * into ret, which must have size() entries. The ret may point
+		 * into S, as it does in the Stoich. The results are identical
+		 * to calling FuncTerm::operator() on each entry.
+		 */
+		void compute( const double* S, double t, double* ret ) const;
+
+	private:
+		enum Kind { SUM, OTHER };
+		vector< unsigned char > kind_;
+
+		/// Operands of func i are mol_[ molStart_[i] ] to mol_[ molStart_[i+1] ]
+		vector< unsigned int > molStart_;
+		vector< unsigned int > mol_;
+
+		/// Everything else: ret[i] = (*other_[i])( S, t )
+		vector< const FuncTerm* > other_;
+};
+
+#endif // _FUNC_TABLE_H
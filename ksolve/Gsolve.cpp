@@ -7,14 +7,21 @@
 ** See the file COPYING.LIB for the full notice.
 **********************************************************************/
 #include "header.h"
+#include "ThreadPool.h"
 
 #include "VoxelPoolsBase.h"
 #include "ZombiePoolInterface.h"
 
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
+#include "../randnum/randnum.h"
+#include "../randnum/RandomStream.h"
+#include "PropensitySelector.h"
 #include "GssaSystem.h"
 #include "Stoich.h"
 #include "GssaVoxelPools.h"
@@ -23,6 +30,31 @@
 
 const unsigned int OFFNODE = ~0;
 
+/**
+ * Advances one block of voxels on each thread of the Gsolve ThreadPool.
+ */
+class GsolveAdvanceJob: public ThreadJob
+{
+	public:
+		GsolveAdvanceJob( Gsolve* gsolve, unsigned int numVoxels, 
+			ProcPtr p )
+			: gsolve_( gsolve ), numVoxels_( numVoxels ), p_( p )
+		{;}
+
+		void runThread( unsigned int threadIndex, unsigned int numThreads )
+		{
+			unsigned int begin;
+			unsigned int end;
+			ThreadPool::partition( numVoxels_, threadIndex, numThreads,
+				begin, end );
+			gsolve_->advanceVoxels( begin, end, p_ );
+		}
+	private:
+		Gsolve* gsolve_;
+		unsigned int numVoxels_;
+		ProcPtr p_;
+};
+
 const Cinfo* Gsolve::initCinfo()
 {
 		///////////////////////////////////////////////////////
@@ -49,6 +81,19 @@ const Cinfo* Gsolve::initCinfo()
 			&Gsolve::setNvec,
 			&Gsolve::getNvec
 		);
+		static LookupValueFinfo< 
+				Gsolve, unsigned int, vector< double > > rateScale(
+			"rateScale",
+			"Factor for each rate term of the Stoich, by which the "
+			"reaction velocities in a voxel are multiplied. Index "
+			"specifies which voxel. Lets the voxels of one solver run "
+			"replicas of the model with different rates, for example "
+			"for a parameter sweep. Assigning an empty vector restores "
+			"the rates of the Stoich. See Stoich::rateIndex for the rate "
+			"terms of each reaction.",
+			&Gsolve::setRateScale,
+			&Gsolve::getRateScale
+		);
 		static ValueFinfo< Gsolve, unsigned int > numAllVoxels(
 			"numAllVoxels",
 			"Number of voxels in the entire reac-diff system, "
@@ -80,6 +125,44 @@ const Cinfo* Gsolve::initCinfo()
 			&Gsolve::getRandInit
 		);
 
+		static ValueFinfo< Gsolve, string > method(
+			"method",
+			"Method used to pick the next reaction to fire. Options are: "
+			"linear: Scans through all reactions on every event. This is "
+			"the default, and is best for small reaction systems. "
+			"tree: Keeps a binary tree of sums of reaction propensities, "
+			"so each event costs time proportional to log of the "
+			"number of reactions. "
+			"cr: Composition-rejection, in which reactions are grouped "
+			"by their propensity. Each event costs nearly constant time, "
+			"so this is best for systems with thousands of reactions.",
+			&Gsolve::setMethod,
+			&Gsolve::getMethod
+		);
+
+		static ValueFinfo< Gsolve, unsigned int > numThreads(
+			"numThreads",
+			"Number of threads used to advance the voxels. The voxels "
+			"are split into contiguous blocks, one per thread. Each "
+			"voxel has its own random number stream, so results are "
+			"identical to the single-threaded calculation. "
+			"Defaults to 1.",
+			&Gsolve::setNumThreads,
+			&Gsolve::getNumThreads
+		);
+
+		static ValueFinfo< Gsolve, long > seed(
+			"seed",
+			"Seed for the random numbers. Each voxel has its own stream "
+			"of random numbers, made from the seed and the voxel index, "
+			"so that results do not depend on the order in which voxels "
+			"are computed. If zero, which is the default, a fresh seed "
+			"is taken from the global random number generator on each "
+			"reinit. The global generator is set by moose.seed.",
+			&Gsolve::setSeed,
+			&Gsolve::getSeed
+		);
+
 		///////////////////////////////////////////////////////
 		// DestFinfo definitions
 		///////////////////////////////////////////////////////
@@ -110,8 +193,12 @@ const Cinfo* Gsolve::initCinfo()
 		&numAllVoxels,		// ReadOnlyValue
 		&numPools,			// Value
 		&proc,				// SharedFinfo
+		&rateScale,			// LookupValue
 		// Here we put new fields that were not there in the Ksolve. 
 		&useRandInit,		// Value
+		&method,			// Value
+		&seed,				// Value
+		&numThreads,		// Value
 	};
 	
 	static Dinfo< Gsolve > dinfo;
@@ -203,9 +290,54 @@ void Gsolve::setNvec( unsigned int voxel, vector< double > nVec )
 		double* s = pools_[voxel].varS();
 		for ( unsigned int i = 0; i < nVec.size(); ++i )
 			s[i] = nVec[i];
+		if ( sys_.isReady )
+			pools_[voxel].refreshAtot( &sys_ );
 	}
 }
 
+vector< double > Gsolve::getRateScale( unsigned int voxel ) const
+{
+	static vector< double > dummy;
+	if ( voxel < pools_.size() )
+		return pools_[ voxel ].getRateScale();
+	return dummy;
+}
+
+void Gsolve::setRateScale( unsigned int voxel, vector< double > scale )
+{
+	if ( voxel < pools_.size() ) {
+		unsigned int numRates = stoichPtr_ ? stoichPtr_->getNumRates() : 0;
+		if ( scale.size() > 0 && scale.size() != numRates ) {
+			cout << "Warning: Gsolve::setRateScale: size mismatch ( " <<
+				scale.size() << ", " << numRates << ")\n";
+			return;
+		}
+		pools_[ voxel ].setRateScale( scale );
+		if ( sys_.isReady )
+			pools_[ voxel ].refreshAtot( &sys_ );
+	}
+}
+
+void Gsolve::getState( vector< double >& s ) const
+{
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		pools_[i].getState( s );
+}
+
+bool Gsolve::setState( const double* s, unsigned int size )
+{
+	unsigned int total = 0;
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		total += pools_[i].stateSize();
+	if ( size != total )
+		return false;
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		pools_[i].setState( s, &sys_ );
+		s += pools_[i].stateSize();
+	}
+	return true;
+}
+
 bool Gsolve::getRandInit() const
 {
 	return sys_.useRandInit;
@@ -216,6 +348,60 @@ void Gsolve::setRandInit( bool val )
 	sys_.useRandInit = val;
 }
 
+string Gsolve::getMethod() const
+{
+	switch ( sys_.selectMethod ) {
+		case PropensitySelector::TREE:
+			return "tree";
+		case PropensitySelector::COMPOSITION_REJECTION:
+			return "cr";
+		default:
+			return "linear";
+	}
+}
+
+void Gsolve::setMethod( string v )
+{
+	for( string::iterator i = v.begin(); i != v.end(); ++i )
+		*i = tolower( *i );
+
+	PropensitySelector::Method m = PropensitySelector::LINEAR;
+	if ( v == "tree" ) {
+		m = PropensitySelector::TREE;
+	} else if ( v == "cr" ) {
+		m = PropensitySelector::COMPOSITION_REJECTION;
+	} else if ( v != "linear" ) {
+		cout << "Warning: Gsolve::setMethod( " << v << 
+			" ):\n Method must be one of linear, tree, or cr. "
+			"Using linear\n";
+	}
+	sys_.selectMethod = m;
+	for ( vector< GssaVoxelPools >::iterator 
+					i = pools_.begin(); i != pools_.end(); ++i ) {
+		i->setSelectMethod( m );
+	}
+}
+
+void Gsolve::setNumThreads( unsigned int num )
+{
+	threads_.setNumThreads( num );
+}
+
+unsigned int Gsolve::getNumThreads() const
+{
+	return threads_.getNumThreads();
+}
+
+long Gsolve::getSeed() const
+{
+	return sys_.seed;
+}
+
+void Gsolve::setSeed( long seed )
+{
+	sys_.seed = seed;
+}
+
 //////////////////////////////////////////////////////////////
 // Process operations.
 //////////////////////////////////////////////////////////////
@@ -223,10 +409,22 @@ void Gsolve::process( const Eref& e, ProcPtr p )
 {
 	if ( !stoichPtr_ )
 		return;
-	for ( vector< GssaVoxelPools >::iterator 
-					i = pools_.begin(); i != pools_.end(); ++i ) {
-		i->advance( p, &sys_ );
+	// The voxels only interact through the messages and field 
+	// assignments that are delivered between timesteps, so each 
+	// thread can run its block of voxels without any locking.
+	if ( threads_.getNumThreads() == 1 || pools_.size() < 2 ) {
+		advanceVoxels( 0, pools_.size(), p );
+		return;
 	}
+	GsolveAdvanceJob job( this, pools_.size(), p );
+	threads_.run( &job );
+}
+
+void Gsolve::advanceVoxels( unsigned int begin, unsigned int end, 
+				ProcPtr p )
+{
+	for ( unsigned int i = begin; i < end; ++i )
+		pools_[i].advance( p, &sys_ );
 }
 
 void Gsolve::reinit( const Eref& e, ProcPtr p )
@@ -236,9 +434,12 @@ void Gsolve::reinit( const Eref& e, ProcPtr p )
 	if ( !sys_.isReady )
 		rebuildGssaSystem();
 	
-	for ( vector< GssaVoxelPools >::iterator 
-					i = pools_.begin(); i != pools_.end(); ++i ) {
-		i->reinit( &sys_ );
+	unsigned long seed = sys_.seed;
+	if ( seed == 0 )
+		seed = genrand_int32();
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		pools_[i].setRandomSeed( seed, startVoxel_ + i );
+		pools_[i].reinit( &sys_ );
 	}
 }
 //////////////////////////////////////////////////////////////
@@ -417,8 +618,11 @@ unsigned int Gsolve::getVoxelIndex( const Eref& e ) const
 void Gsolve::setN( const Eref& e, double v )
 {
 	unsigned int vox = getVoxelIndex( e );
-	if ( vox != OFFNODE )
+	if ( vox != OFFNODE ) {
 		pools_[vox].setN( getPoolIndex( e ), v );
+		if ( sys_.isReady )
+			pools_[vox].refreshAtot( &sys_ );
+	}
 }
 
 double Gsolve::getN( const Eref& e ) const
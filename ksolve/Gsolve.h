@@ -40,12 +40,45 @@ class Gsolve: public ZombiePoolInterface
 		/// Returns the vector of pool Num at the specified voxel.
 		vector< double > getNvec( unsigned int voxel) const;
 		void setNvec( unsigned int voxel, vector< double > vec );
+
+		/// Returns the rate scale factors of the specified voxel.
+		vector< double > getRateScale( unsigned int voxel ) const;
+		/**
+		 * Assigns the rate scale factors of the voxel, one for each
+		 * rate term of the Stoich, or none.
+		 */
+		void setRateScale( unsigned int voxel, vector< double > scale );
+
+		/**
+		 * Appends the pool Num and Ninit, the time of the next event
+		 * and the random number state of all voxels to s, for a
+		 * checkpoint. setState reads them back, and returns false
+		 * without changing anything if the size does not match.
+		 */
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
+		/**
+		 * Assigns the number of threads used to advance the voxels.
+		 * The voxels are split into contiguous blocks, one per thread.
+		 * Each voxel has its own random number stream, so the results
+		 * are identical to the single-threaded calculation.
+		 */
+		void setNumThreads( unsigned int num );
+		unsigned int getNumThreads() const;
 		//////////////////////////////////////////////////////////////////
 		// Dest Finfos
 		//////////////////////////////////////////////////////////////////
 		void process( const Eref& e, ProcPtr p );
 		void reinit( const Eref& e, ProcPtr p );
 
+		/**
+		 * Advances voxels [begin, end) through one timestep. Called
+		 * on each thread by process.
+		 */
+		void advanceVoxels( unsigned int begin, unsigned int end, 
+				ProcPtr p );
+
 		//////////////////////////////////////////////////////////////////
 		// Solver setup functions
 		//////////////////////////////////////////////////////////////////
@@ -85,6 +118,16 @@ class Gsolve: public ZombiePoolInterface
 		/// Flag: set true if randomized round to integers is to be done.
 		void setRandInit( bool val );
 
+		/// Returns the method used to pick reactions.
+		string getMethod() const;
+		/// Assigns method used to pick reactions: linear, tree, or cr.
+		void setMethod( string method );
+
+		/// Returns seed for random numbers. Zero means a fresh seed.
+		long getSeed() const;
+		/// Assigns seed for random numbers.
+		void setSeed( long seed );
+
 		//////////////////////////////////////////////////////////////////
 		static const Cinfo* initCinfo();
 	private:
@@ -109,6 +152,9 @@ class Gsolve: public ZombiePoolInterface
 
 		/// Utility ptr used to help Pool Id lookups by the Ksolve.
 		Stoich* stoichPtr_;
+
+		/// Worker threads used to advance voxels in parallel.
+		ThreadPool threads_;
 };
 
 #endif	// _GSOLVE_H
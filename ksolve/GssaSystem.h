@@ -20,7 +20,8 @@ class GssaSystem
 {
 	public: 
 		GssaSystem()
-			: stoich( 0 ), useRandInit( true ), isReady( false )
+			: stoich( 0 ), useRandInit( true ), isReady( false ),
+			selectMethod( PropensitySelector::LINEAR ), seed( 0 )
 		{;}
 		vector< vector< unsigned int > > dependency;
 		vector< vector< unsigned int > > dependentMathExpn;
@@ -47,6 +48,19 @@ class GssaSystem
 		 * Flag: True when all initialization is done.
 		 */
 		bool isReady;
+
+		/**
+		 * Method used by each voxel to pick the next reaction.
+		 * See PropensitySelector.
+		 */
+		PropensitySelector::Method selectMethod;
+
+		/**
+		 * Seed for the random number streams of the voxels. Each voxel
+		 * has its own stream, indexed by the voxel number. If zero, a
+		 * seed is taken from mtrand on each reinit.
+		 */
+		long seed;
 };
 
 #endif	// _GSSA_SYSTEM_H
@@ -8,31 +8,18 @@
 **********************************************************************/
 #include "header.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
 #include "Stoich.h"
+#include "../randnum/RandomStream.h"
+#include "PropensitySelector.h"
 #include "GssaSystem.h"
 #include "VoxelPoolsBase.h"
 #include "GssaVoxelPools.h"
-#include "../randnum/randnum.h"
-
-/**
- * The SAFETY_FACTOR Protects against the total propensity exceeding
- * the cumulative
- * sum of propensities, atot. We do a lot of adding and subtracting of
- * dependency terms from atot. Roundoff error will eventually cause
- * this to drift from the true sum. To guarantee that we never lose
- * the propensity of the last reaction, this safety factor scales the
- * first calculation of atot to be slightly larger. Periodically this
- * will cause the reaction picking step to exceed the last reaction 
- * index. This is safe, we just pick another random number.  
- * This will happen rather infrequently.
- * That is also a good time to update the cumulative sum.
- * A double should have >15 digits, so cumulative error will be much
- * smaller than this.
- */
-const double SAFETY_FACTOR = 1.0 + 1.0e-9;
 
 //////////////////////////////////////////////////////////////
 // Class definitions
@@ -67,43 +54,44 @@ void GssaVoxelPools::updateDependentRates(
 {
 	for ( vector< unsigned int >::const_iterator
 			i = deps.begin(); i != deps.end(); ++i ) {
-		atot_ -= v_[ *i ];
-		// atot_ += ( v[ *i ] = ( *rates_[ *i ] )( S() );
-		atot_ += ( v_[ *i ] = stoich->getReacVelocity( *i, S() ) );
+		// The selector keeps track of the total propensity, atot.
+		double v = stoich->getReacVelocity( *i, S() );
+		if ( rateScale() )
+			v *= rateScale()[ *i ];
+		selector_.update( *i, v );
 	}
 }
 
-unsigned int GssaVoxelPools::pickReac() const
+unsigned int GssaVoxelPools::pickReac()
 {
-	// double r =  gsl_rng_uniform( rng ) * atot_;
-	double r = mtrand() * atot_;
-	double sum = 0.0;
-
-	// This is an inefficient way to do it. Can easily get to 
-	// log time or thereabouts by doing one or two levels of 
-	// subsidiary tables. Too many levels causes slow-down because
-	// of overhead in managing the tree. 
-	// Slepoy, Thompson and Plimpton 2008
-	// report a linear time version.
-	for ( vector< double >::const_iterator 
-			i = v_.begin(); i != v_.end(); ++i ) {
-		if ( r < ( sum += *i ) )
-			return static_cast< unsigned int >( i - v_.begin() );
-	}
-	return v_.size();
+	// The linear scan is fine for small systems. For big ones the
+	// selector can use a sum-tree or composition-rejection instead.
+	// Slepoy, Thompson and Plimpton 2008.
+	return selector_.pick( rng_ );
 }
 
 void GssaVoxelPools::setNumReac( unsigned int n )
 {
-	v_.clear();
-	v_.resize( n, 0.0 );
+	selector_.setSize( n );
+}
+
+void GssaVoxelPools::setSelectMethod( PropensitySelector::Method method )
+{
+	selector_.setMethod( method );
+}
+
+void GssaVoxelPools::setRandomSeed( unsigned long seed, 
+				unsigned long stream )
+{
+	rng_.setSeed( seed, stream );
 }
 
 void GssaVoxelPools::advance( const ProcInfo* p, const GssaSystem* g )
 {
 	double nextt = p->currTime;
 	while ( t_ < nextt ) {
-		if ( atot_ <= 0.0 ) { // reac system is stuck, will not advance.
+		// reac system is stuck, will not advance.
+		if ( selector_.total() <= 0.0 ) {
 			t_ = nextt;
 			return;
 		}
@@ -111,25 +99,20 @@ void GssaVoxelPools::advance( const ProcInfo* p, const GssaSystem* g )
 		if ( rindex >= g->stoich->getNumRates() ) {
 			// probably cumulative roundoff error here. 
 			// Recalculate atot to avoid, and redo.
-			g->stoich->updateReacVelocities( S(), v_ );
-			atot_ = 0;
-			for ( vector< double >::const_iterator 
-					i = v_.begin(); i != v_.end(); ++i )
-				atot_ += *i;
-			atot_ *= SAFETY_FACTOR;
+			updatePropensities( g->stoich );
+			selector_.rebuild();
+			continue;
 		}
 
 		g->transposeN.fireReac( rindex, Svec() );
 		updateDependentMathExpn( g, rindex );
 		// atot_ = g->updateDependentRates( atot_, rinidex );
 		updateDependentRates( g->dependency[ rindex ], g->stoich );
-		// double r = gsl_rng_uniform( rng );
-		double r = mtrand();
+		double r = rng_.uniform();
 		while ( r <= 0.0 ) {
-			// r = gsl_rng_uniform( rng )
-			r = mtrand();
+			r = rng_.uniform();
 		}
-		t_ -= ( 1.0 / atot_ ) * log( r );
+		t_ -= ( 1.0 / selector_.total() ) * log( r );
 	}
 }
 
@@ -146,8 +129,7 @@ void GssaVoxelPools::reinit( const GssaSystem* g )
 		for ( unsigned int i = 0; i < numVarPools; ++i ) {
 			double base = floor( n[i] );
 			double frac = n[i] - base;
-			// if ( gsl_rng_uniform( rng ) > frac )
-			if ( mtrand() > frac )
+			if ( rng_.uniform() > frac )
 				n[i] = base;
 			else
 				n[i] = base + 1.0;
@@ -160,11 +142,55 @@ void GssaVoxelPools::reinit( const GssaSystem* g )
 	t_ = 0.0;
 	// vector< double > yprime( g->stoich->getNumAllPools(), 0.0 );
 				// i = yprime.begin(); i != yprime.end(); ++i )
-	g->stoich->updateReacVelocities( S(), v_ );
-	atot_ = 0;
-	for ( vector< double >::const_iterator 
-		i = v_.begin(); i != v_.end(); ++i ) {
-		atot_ += *i;
-	}
-	atot_ *= SAFETY_FACTOR;
+	updatePropensities( g->stoich );
+	selector_.setMethod( g->selectMethod ); // Also rebuilds the sums.
+}
+
+void GssaVoxelPools::refreshAtot( const GssaSystem* g )
+{
+	updatePropensities( g->stoich );
+	selector_.rebuild();
+}
+
+void GssaVoxelPools::updatePropensities( const Stoich* stoich )
+{
+	vector< double >& a = selector_.propensities();
+	stoich->updateReacVelocities( S(), a );
+	if ( rateScale() )
+		for ( unsigned int i = 0; i < a.size(); ++i )
+			a[i] *= rateScale()[i];
+}
+
+void GssaVoxelPools::getState( vector< double >& s ) const
+{
+	s.insert( s.end(), S(), S() + size() );
+	s.insert( s.end(), Sinit(), Sinit() + size() );
+	s.push_back( t_ );
+	// The random number state goes in as raw bits.
+	uint64_t key;
+	uint64_t counter;
+	rng_.getState( key, counter );
+	s.resize( s.size() + 2 );
+	memcpy( &s[ s.size() - 2 ], &key, sizeof( double ) );
+	memcpy( &s[ s.size() - 1 ], &counter, sizeof( double ) );
+}
+
+void GssaVoxelPools::setState( const double* s, const GssaSystem* g )
+{
+	unsigned int n = size();
+	copy( s, s + n, varS() );
+	copy( s + n, s + 2 * n, varSinit() );
+	t_ = s[ 2 * n ];
+	uint64_t key;
+	uint64_t counter;
+	memcpy( &key, s + 2 * n + 1, sizeof( double ) );
+	memcpy( &counter, s + 2 * n + 2, sizeof( double ) );
+	rng_.setState( key, counter );
+	if ( g->isReady )
+		refreshAtot( g );
+}
+
+unsigned int GssaVoxelPools::stateSize() const
+{
+	return 2 * size() + 3;
 }
@@ -26,8 +26,16 @@ class GssaVoxelPools: public VoxelPoolsBase
 				const GssaSystem* g, unsigned int rindex );
 		void updateDependentRates( 
 			const vector< unsigned int >& deps, const Stoich* stoich );
-		unsigned int pickReac() const;
+		unsigned int pickReac();
 		void setNumReac( unsigned int n );
+		/// Changes the method used to pick reactions.
+		void setSelectMethod( PropensitySelector::Method method );
+		/**
+		 * Restarts the random number stream of this voxel. The stream
+		 * index should be the global index of the voxel, so that each
+		 * voxel gets the same numbers however the voxels are split up.
+		 */
+		void setRandomSeed( unsigned long seed, unsigned long stream );
 
 		void advance( const ProcInfo* p, const GssaSystem* g );
 		/**
@@ -35,23 +43,42 @@ class GssaVoxelPools: public VoxelPoolsBase
 		 */
 		void reinit( const GssaSystem* g );
 
-	private:
-		/// Time at which next event will occur.
-		double t_; 
+		/**
+		 * Recomputes all the propensities from the current pool
+		 * numbers. Needed whenever the numbers are assigned directly
+		 * rather than by firing reactions.
+		 */
+		void refreshAtot( const GssaSystem* g );
 
 		/**
-		 * Total propensity of all the reactions in the system
+		 * Appends S, Sinit, the time of the next event and the random
+		 * number state to s, for a checkpoint. There are stateSize()
+		 * entries.
 		 */
-		double atot_;
+		void getState( vector< double >& s ) const;
+		/// Reads back the entries written by getState.
+		void setState( const double* s, const GssaSystem* g );
+		unsigned int stateSize() const;
 
+	private:
+		/**
+		 * Computes all the propensities from the current pool numbers,
+		 * scaled by the rate scale of the voxel. Does not touch the sums.
+		 */
+		void updatePropensities( const Stoich* stoich );
 
-		/** 
-		 * State vector of reaction velocities. Only a subset are
+		/// Time at which next event will occur.
+		double t_; 
+
+		/**
+		 * Holds the state vector of reaction velocities, that is, the
+		 * propensities, and their sums. Only a subset are
 		 * recalculated on each step.
 		 */
-		vector< double > v_; 
+		PropensitySelector selector_;
 
-		// Possibly we should put independent RNGS, so save one here.
+		/// Independent random number stream for this voxel.
+		RandomStream rng_;
 };
 
 #endif	// _GSSA_VOXEL_POOLS_H
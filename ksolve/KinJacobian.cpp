@@ -0,0 +1,221 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include <set>
+#include "header.h"
+#include "RateTerm.h"
+#include "SparseMatrix.h"
+#include "KinSparseMatrix.h"
+#include "KinJacobian.h"
+
+/// Pivots smaller than this are taken as a singular matrix.
+static const double SINGULAR_PIVOT = 1e-12;
+
+KinJacobian::KinJacobian()
+	: size_( 0 )
+{;}
+
+unsigned int KinJacobian::size() const
+{
+	return size_;
+}
+
+unsigned int KinJacobian::numEntries() const
+{
+	return colIndex_.size();
+}
+
+const vector< unsigned int >& KinJacobian::rowStart() const
+{
+	return rowStart_;
+}
+
+const vector< unsigned int >& KinJacobian::colIndex() const
+{
+	return colIndex_;
+}
+
+/// Returns the entry of column col in the row. The entry must exist.
+static unsigned int findEntry( const vector< unsigned int >& rowStart,
+	const vector< unsigned int >& colIndex, unsigned int row,
+	unsigned int col )
+{
+	vector< unsigned int >::const_iterator begin =
+		colIndex.begin() + rowStart[ row ];
+	vector< unsigned int >::const_iterator end =
+		colIndex.begin() + rowStart[ row + 1 ];
+	vector< unsigned int >::const_iterator i =
+		lower_bound( begin, end, col );
+	assert( i != end && *i == col );
+	return i - colIndex.begin();
+}
+
+void KinJacobian::build( const vector< RateTerm* >& rates,
+	const KinSparseMatrix& N, unsigned int numVarPools )
+{
+	size_ = numVarPools;
+	unsigned int numRates = rates.size();
+
+	// The pools that each rate depends on.
+	vector< vector< unsigned int > > reactants( numRates );
+	for ( unsigned int r = 0; r < numRates; ++r ) {
+		vector< unsigned int > molIndex;
+		rates[r]->getReactants( molIndex );
+		set< unsigned int > mols;
+		for ( unsigned int j = 0; j < molIndex.size(); ++j )
+			if ( molIndex[j] < size_ )
+				mols.insert( molIndex[j] );
+		reactants[r].assign( mols.begin(), mols.end() );
+	}
+
+	// Pattern of the Jacobian: row i has column j if some rate that
+	// changes pool i depends on pool j. The diagonal is always there.
+	vector< set< unsigned int > > pattern( size_ );
+	vector< vector< unsigned int > > rowReacs( size_ );
+	vector< vector< int > > rowCoeffs( size_ );
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		pattern[i].insert( i );
+		N.getRow( i, rowCoeffs[i], rowReacs[i] );
+		for ( unsigned int q = 0; q < rowReacs[i].size(); ++q ) {
+			const vector< unsigned int >& mols = reactants[ rowReacs[i][q] ];
+			pattern[i].insert( mols.begin(), mols.end() );
+		}
+	}
+
+	// Symbolic factorisation. Eliminating column k from row i brings in
+	// the columns of row k to the right of k. These are all larger than
+	// k, so they are visited later in the same scan of row i.
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		set< unsigned int >& row = pattern[i];
+		for ( set< unsigned int >::iterator k = row.begin();
+				k != row.end() && *k < i; ++k ) {
+			set< unsigned int >::const_iterator j = pattern[ *k ].upper_bound( *k );
+			row.insert( j, pattern[ *k ].end() );
+		}
+	}
+
+	rowStart_.assign( 1, 0 );
+	colIndex_.clear();
+	diag_.resize( size_ );
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		for ( set< unsigned int >::iterator j = pattern[i].begin();
+				j != pattern[i].end(); ++j ) {
+			if ( *j == i )
+				diag_[i] = colIndex_.size();
+			colIndex_.push_back( *j );
+		}
+		rowStart_.push_back( colIndex_.size() );
+	}
+
+	// Terms of the Jacobian, gathered by rate so that each partial
+	// derivative is computed once.
+	vector< vector< unsigned int > > reacRows( numRates );
+	vector< vector< int > > reacCoeffs( numRates );
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		for ( unsigned int q = 0; q < rowReacs[i].size(); ++q ) {
+			reacRows[ rowReacs[i][q] ].push_back( i );
+			reacCoeffs[ rowReacs[i][q] ].push_back( rowCoeffs[i][q] );
+		}
+	}
+	termRate_.clear();
+	termMol_.clear();
+	termStart_.assign( 1, 0 );
+	termEntry_.clear();
+	termCoeff_.clear();
+	for ( unsigned int r = 0; r < numRates; ++r ) {
+		if ( reacRows[r].size() == 0 )
+			continue;
+		for ( unsigned int j = 0; j < reactants[r].size(); ++j ) {
+			termRate_.push_back( r );
+			termMol_.push_back( reactants[r][j] );
+			for ( unsigned int q = 0; q < reacRows[r].size(); ++q ) {
+				termEntry_.push_back( findEntry( rowStart_, colIndex_,
+					reacRows[r][q], reactants[r][j] ) );
+				termCoeff_.push_back( reacCoeffs[r][q] );
+			}
+			termStart_.push_back( termEntry_.size() );
+		}
+	}
+
+	// Elimination sequence, row by row. Row k is complete by the time
+	// it is used to eliminate column k from the later row i.
+	elimEntry_.clear();
+	elimPivot_.clear();
+	elimStart_.assign( 1, 0 );
+	updTarget_.clear();
+	updSource_.clear();
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		for ( unsigned int e = rowStart_[i]; e < diag_[i]; ++e ) {
+			unsigned int k = colIndex_[e];
+			elimEntry_.push_back( e );
+			elimPivot_.push_back( diag_[k] );
+			for ( unsigned int q = diag_[k] + 1; q < rowStart_[k + 1]; ++q ){
+				updTarget_.push_back( findEntry( rowStart_, colIndex_,
+					i, colIndex_[q] ) );
+				updSource_.push_back( q );
+			}
+			elimStart_.push_back( updTarget_.size() );
+		}
+	}
+}
+
+void KinJacobian::compute( const vector< RateTerm* >& rates,
+	const double* S, double* jac, const double* scale ) const
+{
+	for ( unsigned int e = 0; e < colIndex_.size(); ++e )
+		jac[e] = 0.0;
+	for ( unsigned int t = 0; t < termRate_.size(); ++t ) {
+		double d = rates[ termRate_[t] ]->partial( S, termMol_[t] );
+		if ( scale )
+			d *= scale[ termRate_[t] ];
+		if ( d == 0.0 )
+			continue;
+		for ( unsigned int q = termStart_[t]; q < termStart_[t + 1]; ++q )
+			jac[ termEntry_[q] ] += termCoeff_[q] * d;
+	}
+}
+
+bool KinJacobian::factor( const double* jac, double scale, double* lu )
+	const
+{
+	for ( unsigned int e = 0; e < colIndex_.size(); ++e )
+		lu[e] = -scale * jac[e];
+	for ( unsigned int i = 0; i < size_; ++i )
+		lu[ diag_[i] ] += 1.0;
+
+	for ( unsigned int m = 0; m < elimEntry_.size(); ++m ) {
+		double pivot = lu[ elimPivot_[m] ];
+		if ( !( fabs( pivot ) > SINGULAR_PIVOT ) )
+			return false;
+		double l = lu[ elimEntry_[m] ] /= pivot;
+		for ( unsigned int q = elimStart_[m]; q < elimStart_[m + 1]; ++q )
+			lu[ updTarget_[q] ] -= l * lu[ updSource_[q] ];
+	}
+	for ( unsigned int i = 0; i < size_; ++i )
+		if ( !( fabs( lu[ diag_[i] ] ) > SINGULAR_PIVOT ) )
+			return false;
+	return true;
+}
+
+void KinJacobian::solve( const double* lu, double* x ) const
+{
+	for ( unsigned int i = 0; i < size_; ++i ) {
+		double sum = x[i];
+		for ( unsigned int e = rowStart_[i]; e < diag_[i]; ++e )
+			sum -= lu[e] * x[ colIndex_[e] ];
+		x[i] = sum;
+	}
+	for ( unsigned int i = size_; i > 0; --i ) {
+		unsigned int r = i - 1;
+		double sum = x[r];
+		for ( unsigned int e = diag_[r] + 1; e < rowStart_[r + 1]; ++e )
+			sum -= lu[e] * x[ colIndex_[e] ];
+		x[r] = sum / lu[ diag_[r] ];
+	}
+}
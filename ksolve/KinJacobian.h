@@ -0,0 +1,116 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _KIN_JACOBIAN_H
+#define _KIN_JACOBIAN_H
+
+class RateTerm;
+class KinSparseMatrix;
+
+/**
+ * Sparse Jacobian of the reaction system, d( N.v )/dS, taken
+ * analytically from the stoichiometry matrix N and the partial
+ * derivatives of the RateTerms. Only the variable pools are
+ * differentiated: buffered and function pools are held constant.
+ *
+ * The entries are stored row by row, with sorted column indices, and
+ * the pattern already includes the fill-in of the LU factorisation of
+ * I - scale * J without pivoting, so that the Jacobian, and the LU
+ * factors made from it, share one array layout. As in the
+ * FastMatrixElim, the elimination is reduced to a flat sequence of
+ * operations when the pattern is built, so that each factorisation is
+ * a single pass through precomputed indices.
+ *
+ * The KinJacobian holds only the pattern. The values live in arrays of
+ * numEntries() doubles owned by the caller, so that each voxel can
+ * keep its own.
+ */
+class KinJacobian
+{
+	public:
+		KinJacobian();
+
+		/**
+		 * Builds the pattern of the Jacobian of the first numVarPools
+		 * rows of N.v with respect to the first numVarPools pools, the
+		 * fill-in for the LU factors, and the elimination sequence.
+		 * Must be called again if the reactions change.
+		 */
+		void build( const vector< RateTerm* >& rates,
+			const KinSparseMatrix& N, unsigned int numVarPools );
+
+		/// Returns the number of rows. Zero if not yet built.
+		unsigned int size() const;
+
+		/// Returns the number of entries, including the fill-in.
+		unsigned int numEntries() const;
+
+		/// Start of each row in the entries, with a final end entry.
+		const vector< unsigned int >& rowStart() const;
+
+		/// Column index of each entry.
+		const vector< unsigned int >& colIndex() const;
+
+		/**
+		 * Computes the Jacobian at the pool numbers S into jac, which
+		 * must have numEntries() entries. The rates must be those that
+		 * the pattern was built from. If scale is given, the terms of
+		 * each rate are multiplied by scale[ rate index ].
+		 */
+		void compute( const vector< RateTerm* >& rates, const double* S,
+			double* jac, const double* scale = 0 ) const;
+
+		/**
+		 * Makes the LU factors of I - scale * jac into lu. Returns
+		 * false if a pivot vanishes, in which case the caller should
+		 * try a smaller scale, that is, a smaller timestep.
+		 */
+		bool factor( const double* jac, double scale, double* lu ) const;
+
+		/**
+		 * Solves ( I - scale * jac ) x = b in place, using the factors
+		 * from factor. x holds b on entry and has size() entries.
+		 */
+		void solve( const double* lu, double* x ) const;
+
+	private:
+		/// Number of rows, that is, of variable pools.
+		unsigned int size_;
+
+		/// Start of each row, with one extra entry for the end.
+		vector< unsigned int > rowStart_;
+		vector< unsigned int > colIndex_;
+
+		/// Entry of the diagonal term on each row.
+		vector< unsigned int > diag_;
+
+		/**
+		 * Each term is the partial derivative of one rate with respect
+		 * to one pool. Each term adds, scaled by the stoichiometry,
+		 * into the entries from termStart_[i] to termStart_[i + 1].
+		 */
+		vector< unsigned int > termRate_;
+		vector< unsigned int > termMol_;
+		vector< unsigned int > termStart_;
+		vector< unsigned int > termEntry_;
+		vector< double > termCoeff_;
+
+		/**
+		 * Elimination sequence. For each multiplier, the entry it
+		 * is computed in, the diagonal entry it divides by, and the
+		 * range of updates lu[ updTarget_ ] -= l * lu[ updSource_ ].
+		 */
+		vector< unsigned int > elimEntry_;
+		vector< unsigned int > elimPivot_;
+		vector< unsigned int > elimStart_;
+		vector< unsigned int > updTarget_;
+		vector< unsigned int > updSource_;
+};
+
+#endif // _KIN_JACOBIAN_H
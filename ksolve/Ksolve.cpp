@@ -7,6 +7,7 @@
 ** See the file COPYING.LIB for the full notice.
 **********************************************************************/
 #include "header.h"
+#include "ThreadPool.h"
 #ifdef USE_GSL
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_matrix.h>
@@ -19,15 +20,46 @@
 #include "ZombiePoolInterface.h"
 
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
 #include "Stoich.h"
+#include "../diffusion/DiffPoolVec.h"
+#include "../diffusion/DiffBatch.h"
+#include "../diffusion/Dsolve.h"
 
 #include "Ksolve.h"
 
 const unsigned int OFFNODE = ~0;
 
+/**
+ * Advances one block of voxels on each thread of the Ksolve ThreadPool.
+ */
+class KsolveAdvanceJob: public ThreadJob
+{
+	public:
+		KsolveAdvanceJob( Ksolve* ksolve, unsigned int numVoxels, 
+			ProcPtr p )
+			: ksolve_( ksolve ), numVoxels_( numVoxels ), p_( p )
+		{;}
+
+		void runThread( unsigned int threadIndex, unsigned int numThreads )
+		{
+			unsigned int begin;
+			unsigned int end;
+			ThreadPool::partition( numVoxels_, threadIndex, numThreads,
+				begin, end );
+			ksolve_->advanceVoxels( begin, end, p_ );
+		}
+	private:
+		Ksolve* ksolve_;
+		unsigned int numVoxels_;
+		ProcPtr p_;
+};
+
 const Cinfo* Ksolve::initCinfo()
 {
 		///////////////////////////////////////////////////////
@@ -54,6 +86,19 @@ const Cinfo* Ksolve::initCinfo()
 			&Ksolve::setNvec,
 			&Ksolve::getNvec
 		);
+		static LookupValueFinfo< 
+				Ksolve, unsigned int, vector< double > > rateScale(
+			"rateScale",
+			"Factor for each rate term of the Stoich, by which the "
+			"reaction velocities in a voxel are multiplied. Index "
+			"specifies which voxel. Lets the voxels of one solver run "
+			"replicas of the model with different rates, for example "
+			"for a parameter sweep. Assigning an empty vector restores "
+			"the rates of the Stoich. See Stoich::rateIndex for the rate "
+			"terms of each reaction.",
+			&Ksolve::setRateScale,
+			&Ksolve::getRateScale
+		);
 		static ValueFinfo< Ksolve, unsigned int > numAllVoxels(
 			"numAllVoxels",
 			"Number of voxels in the entire reac-diff system, "
@@ -70,6 +115,85 @@ const Cinfo* Ksolve::initCinfo()
 			&Ksolve::getNumPools
 		);
 
+		static ValueFinfo< Ksolve, unsigned int > numThreads(
+			"numThreads",
+			"Number of threads used to advance the voxels. The voxels "
+			"are split into contiguous blocks, one per thread. Results "
+			"are identical to the single-threaded calculation. "
+			"Defaults to 1.",
+			&Ksolve::setNumThreads,
+			&Ksolve::getNumThreads
+		);
+
+		static ValueFinfo< Ksolve, Id > dsolve (
+			"dsolve",
+			"Diffusion solver coupled to this Ksolve. When assigned, "
+			"the Ksolve advances reaction and diffusion together using "
+			"Strang splitting, with half a step of diffusion on either "
+			"side of each reaction step. Both solvers then share the "
+			"pool numbers. The Dsolve must use the same Stoich and "
+			"have as many voxels as the Ksolve, and should not be "
+			"scheduled on its own.",
+			&Ksolve::setDsolve,
+			&Ksolve::getDsolve
+		);
+
+		static ValueFinfo< Ksolve, string > method (
+			"method",
+			"Integration method. The GSL methods are rk5 (the default), "
+			"rk4, rk2, rkck, rk8, and the implicit methods rk4imp, bsimp "
+			"and msbdf, which use the analytic Jacobian of the reaction "
+			"system. rosenbrock is a built-in, L-stable, second order "
+			"implicit method for stiff systems. It uses the sparse "
+			"Jacobian, and does not need GSL.",
+			&Ksolve::setMethod,
+			&Ksolve::getMethod
+		);
+
+		static ValueFinfo< Ksolve, double > epsAbs (
+			"epsAbs",
+			"Absolute error tolerance of the integration, in molecules. "
+			"Until it is set this is 1e6 for the GSL methods, which "
+			"leaves them to epsRel, and 1e-3 for rosenbrock, whose step "
+			"control needs a real bound on small pools.",
+			&Ksolve::setEpsAbs,
+			&Ksolve::getEpsAbs
+		);
+
+		static ValueFinfo< Ksolve, double > epsRel (
+			"epsRel",
+			"Relative error tolerance of the integration.",
+			&Ksolve::setEpsRel,
+			&Ksolve::getEpsRel
+		);
+
+		static ValueFinfo< Ksolve, bool > reuseJacobian (
+			"reuseJacobian",
+			"For the rosenbrock method: keep the Jacobian from step to "
+			"step, recomputing it only when a step fails, and keep its "
+			"factors until the step size changes. The method stays "
+			"second order with the older Jacobian. This saves a lot of "
+			"work on stiff models, which settle to steps of the full "
+			"dt. Rate changes during a run may take a few steps to be "
+			"seen by the Jacobian. Defaults to false.",
+			&Ksolve::setReuseJacobian,
+			&Ksolve::getReuseJacobian
+		);
+
+		static ReadOnlyValueFinfo< Ksolve, unsigned int > numRateEvals (
+			"numRateEvals",
+			"Number of evaluations of the rates, summed over all voxels, "
+			"since the last reinit.",
+			&Ksolve::getNumRateEvals
+		);
+
+		static ReadOnlyValueFinfo< Ksolve, unsigned int > numJacobianEvals(
+			"numJacobianEvals",
+			"Number of evaluations of the Jacobian, summed over all "
+			"voxels, since the last reinit.",
+			&Ksolve::getNumJacobianEvals
+		);
+
 		///////////////////////////////////////////////////////
 		// DestFinfo definitions
 		///////////////////////////////////////////////////////
@@ -97,8 +221,17 @@ const Cinfo* Ksolve::initCinfo()
 		&stoich,			// Value
 		&numLocalVoxels,	// ReadOnlyValue
 		&nVec,				// LookupValue
+		&rateScale,			// LookupValue
 		&numAllVoxels,		// ReadOnlyValue
 		&numPools,			// Value
+		&numThreads,		// Value
+		&dsolve,			// Value
+		&method,			// Value
+		&epsAbs,			// Value
+		&epsRel,			// Value
+		&reuseJacobian,		// Value
+		&numRateEvals,		// ReadOnlyValue
+		&numJacobianEvals,	// ReadOnlyValue
 		&proc,				// SharedFinfo
 	};
 	
@@ -125,11 +258,21 @@ Ksolve::Ksolve()
 		pools_( 1 ),
 		startVoxel_( 0 ),
 		stoich_(),
-		stoichPtr_( 0 )
+		stoichPtr_( 0 ),
+		isCoupled_( false ),
+		method_( "rk5" ),
+		epsAbs_( 0.0 ),
+		epsRel_( 1e-6 ),
+		reuseJacobian_( false )
 {;}
 
+/// Lets the Dsolve run on its own again.
 Ksolve::~Ksolve()
-{;}
+{
+	Dsolve* d = dsolvePtr();
+	if ( d )
+		d->setCoupled( false );
+}
 
 //////////////////////////////////////////////////////////////
 // Field Access functions
@@ -170,7 +313,8 @@ vector< double > Ksolve::getNvec( unsigned int voxel) const
 {
 	static vector< double > dummy;
 	if ( voxel < pools_.size() ) {
-		return const_cast< VoxelPools* >( &( pools_[ voxel ] ) )->Svec();
+		const double* s = voxelS( voxel );
+		return vector< double >( s, s + pools_[ voxel ].size() );
 	}
 	return dummy;
 }
@@ -183,11 +327,179 @@ void Ksolve::setNvec( unsigned int voxel, vector< double > nVec )
 				nVec.size() << ", " << pools_[voxel].size() << ")\n";
 			return;
 		}
-		double* s = pools_[voxel].varS();
+		double* s = voxelS( voxel );
 		for ( unsigned int i = 0; i < nVec.size(); ++i )
 			s[i] = nVec[i];
 	}
 }
+
+vector< double > Ksolve::getRateScale( unsigned int voxel ) const
+{
+	static vector< double > dummy;
+	if ( voxel < pools_.size() )
+		return pools_[ voxel ].getRateScale();
+	return dummy;
+}
+
+void Ksolve::setRateScale( unsigned int voxel, vector< double > scale )
+{
+	if ( voxel < pools_.size() ) {
+		unsigned int numRates = stoichPtr_ ? stoichPtr_->getNumRates() : 0;
+		if ( scale.size() > 0 && scale.size() != numRates ) {
+			cout << "Warning: Ksolve::setRateScale: size mismatch ( " <<
+				scale.size() << ", " << numRates << ")\n";
+			return;
+		}
+		pools_[ voxel ].setRateScale( scale );
+	}
+}
+
+double* Ksolve::getNvecView( unsigned int voxel, unsigned int& size )
+{
+	size = 0;
+	if ( voxel >= pools_.size() )
+		return 0;
+	size = pools_[ voxel ].size();
+	return voxelS( voxel );
+}
+
+void Ksolve::getState( vector< double >& s ) const
+{
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		unsigned int n = pools_[i].size();
+		const double* S = voxelS( i );
+		s.insert( s.end(), S, S + n );
+		s.insert( s.end(), pools_[i].Sinit(), pools_[i].Sinit() + n );
+	}
+}
+
+bool Ksolve::setState( const double* s, unsigned int size )
+{
+	unsigned int total = 0;
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		total += 2 * pools_[i].size();
+	if ( size != total )
+		return false;
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		unsigned int n = pools_[i].size();
+		copy( s, s + n, voxelS( i ) );
+		copy( s + n, s + 2 * n, pools_[i].varSinit() );
+		s += 2 * n;
+	}
+	return true;
+}
+
+void Ksolve::setNumThreads( unsigned int num )
+{
+	threads_.setNumThreads( num );
+}
+
+unsigned int Ksolve::getNumThreads() const
+{
+	return threads_.getNumThreads();
+}
+
+void Ksolve::setDsolve( Id dsolve )
+{
+	if ( dsolve != Id() && !dsolve.element()->cinfo()->isA( "Dsolve" ) ) {
+		cout << "Warning: Ksolve::setDsolve: " << dsolve.path() <<
+			" is not a Dsolve\n";
+		return;
+	}
+	// Take back the pool numbers from the old Dsolve.
+	if ( isCoupled_ ) {
+		for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+			const double* s = voxelS( i );
+			copy( s, s + pools_[i].size(), pools_[i].varS() );
+		}
+	}
+	Dsolve* d = dsolvePtr();
+	if ( d )
+		d->setCoupled( false );
+	isCoupled_ = false;
+	dsolve_ = dsolve;
+	d = dsolvePtr();
+	if ( d )
+		d->setCoupled( true );
+}
+
+Id Ksolve::getDsolve() const
+{
+	return dsolve_;
+}
+
+void Ksolve::setMethod( string method )
+{
+	if ( method == "rk5" || method == "rk4" || method == "rk2" ||
+		method == "rkck" || method == "rk8" || method == "rk4imp" ||
+		method == "bsimp" || method == "msbdf" || method == "rosenbrock" ){
+		method_ = method;
+		setupVoxelMethod();
+	} else {
+		cout << "Warning: Ksolve::setMethod: '" << method <<
+			"' not known, using '" << method_ << "'\n";
+	}
+}
+
+string Ksolve::getMethod() const
+{
+	return method_;
+}
+
+void Ksolve::setEpsAbs( double epsAbs )
+{
+	if ( epsAbs > 0.0 ) {
+		epsAbs_ = epsAbs;
+		setupVoxelMethod();
+	}
+}
+
+double Ksolve::getEpsAbs() const
+{
+	if ( epsAbs_ > 0.0 )
+		return epsAbs_;
+	return ( method_ == "rosenbrock" ) ? 1e-3 : 1e6;
+}
+
+void Ksolve::setEpsRel( double epsRel )
+{
+	if ( epsRel > 0.0 ) {
+		epsRel_ = epsRel;
+		setupVoxelMethod();
+	}
+}
+
+double Ksolve::getEpsRel() const
+{
+	return epsRel_;
+}
+
+void Ksolve::setReuseJacobian( bool reuse )
+{
+	reuseJacobian_ = reuse;
+	setupVoxelMethod();
+}
+
+bool Ksolve::getReuseJacobian() const
+{
+	return reuseJacobian_;
+}
+
+unsigned int Ksolve::getNumRateEvals() const
+{
+	unsigned int ret = 0;
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		ret += pools_[i].getNumRateEvals();
+	return ret;
+}
+
+unsigned int Ksolve::getNumJacobianEvals() const
+{
+	unsigned int ret = 0;
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		ret += pools_[i].getNumJacobianEvals();
+	return ret;
+}
 /*
 void Ksolve::setNumAllVoxels( unsigned int numVoxels )
 {
@@ -235,18 +547,107 @@ void Ksolve::setNumAllVoxels( unsigned int numVoxels )
 //////////////////////////////////////////////////////////////
 void Ksolve::process( const Eref& e, ProcPtr p )
 {
-	for ( vector< VoxelPools >::iterator 
-					i = pools_.begin(); i != pools_.end(); ++i ) {
-		i->advance( p );
+	Dsolve* d = 0;
+	if ( isCoupled_ ) {
+		d = dsolvePtr();
+		if ( !d ) {
+			cout << "Warning: Ksolve::process: the Dsolve" <<
+				" has gone. Diffusion is off, and the pools go back to"
+				" their values at the last reinit.\n";
+			isCoupled_ = false;
+		}
+	}
+	if ( d )
+		d->advanceCrankNicolson();
+	if ( threads_.getNumThreads() == 1 || pools_.size() < 2 ) {
+		advanceVoxels( 0, pools_.size(), p );
+	} else {
+		KsolveAdvanceJob job( this, pools_.size(), p );
+		threads_.run( &job );
 	}
+	if ( d )
+		d->advanceCrankNicolson();
 }
 
+void Ksolve::advanceVoxels( unsigned int begin, unsigned int end, 
+				ProcPtr p )
+{
+	for ( unsigned int i = begin; i < end; ++i )
+		pools_[i].advance( p, voxelS( i ) );
+}
+
+/**
+ * When there is a Dsolve, builds it for the half steps of diffusion,
+ * and moves the initial pool numbers into it. Each half step is done by
+ * Crank-Nicolson, which works from ops built for half its own dt, so
+ * that the splitting as a whole is second order.
+ */
 void Ksolve::reinit( const Eref& e, ProcPtr p )
 {
 	for ( vector< VoxelPools >::iterator 
 					i = pools_.begin(); i != pools_.end(); ++i ) {
 		i->reinit();
 	}
+	isCoupled_ = false;
+	Dsolve* d = dsolvePtr();
+	if ( !d )
+		return;
+	// The Dsolve is left to run on its own unless it matches.
+	d->setCoupled( false );
+	if ( Field< Id >::get( dsolve_, "stoich" ) != stoich_ ) {
+		cout << "Warning: Ksolve::reinit: Dsolve " << dsolve_.path() <<
+			" does not use the same Stoich. Diffusion is off.\n";
+		return;
+	}
+	d->build( p->dt / 4.0 );
+	for ( unsigned int i = 0; i < pools_.size(); ++i ) {
+		if ( d->getNrow( i ) == 0 || 
+				d->getNumPools() != pools_[i].size() ) {
+			cout << "Warning: Ksolve::reinit: Dsolve " << dsolve_.path() <<
+				" does not match the voxels or pools. Diffusion is off.\n";
+			return;
+		}
+	}
+	for ( unsigned int i = 0; i < pools_.size(); ++i )
+		copy( pools_[i].S(), pools_[i].S() + pools_[i].size(),
+			d->getNrow( i ) );
+	d->setCoupled( true );
+	isCoupled_ = true;
+}
+
+/**
+ * Looks up the Dsolve on each call rather than keeping a pointer, so
+ * that deleting it cannot leave the Ksolve working on freed memory.
+ * Returns 0 if there is none, or it is being deleted.
+ */
+Dsolve* Ksolve::dsolvePtr() const
+{
+	if ( dsolve_ == Id() )
+		return 0;
+	Element* elm = dsolve_.element();
+	if ( !elm || elm->isDoomed() || !elm->cinfo()->isA( "Dsolve" ) )
+		return 0;
+	return reinterpret_cast< Dsolve* >( dsolve_.eref().data() );
+}
+
+double* Ksolve::voxelS( unsigned int voxel )
+{
+	if ( isCoupled_ ) {
+		Dsolve* d = dsolvePtr();
+		if ( d )
+			return d->getNrow( voxel );
+	}
+	return pools_[ voxel ].varS();
+}
+
+const double* Ksolve::voxelS( unsigned int voxel ) const
+{
+	if ( isCoupled_ ) {
+		Dsolve* d = dsolvePtr();
+		if ( d )
+			return d->getNrow( voxel );
+	}
+	return pools_[ voxel ].S();
 }
 //////////////////////////////////////////////////////////////
 // Solver ops
@@ -273,14 +674,14 @@ void Ksolve::setN( const Eref& e, double v )
 {
 	unsigned int vox = getVoxelIndex( e );
 	if ( vox != OFFNODE )
-		pools_[vox].setN( getPoolIndex( e ), v );
+		voxelS( vox )[ getPoolIndex( e ) ] = v;
 }
 
 double Ksolve::getN( const Eref& e ) const
 {
 	unsigned int vox = getVoxelIndex( e );
 	if ( vox != OFFNODE )
-		return pools_[vox].getN( getPoolIndex( e ) );
+		return voxelS( vox )[ getPoolIndex( e ) ];
 	return 0.0;
 }
 
@@ -312,23 +713,47 @@ double Ksolve::getDiffConst( const Eref& e ) const
 void Ksolve::setNumPools( unsigned int numPoolSpecies )
 {
 	assert( stoichPtr_ );
+	unsigned int numVoxels = pools_.size();
+	for ( unsigned int i = 0 ; i < numVoxels; ++i )
+		pools_[i].resizeArrays( numPoolSpecies );
+	setupVoxelMethod();
+}
+
+void Ksolve::setupVoxelMethod()
+{
+	if ( !stoichPtr_ )
+		return;
 	OdeSystem ode;
+	ode.method = method_;
+	ode.epsAbs = getEpsAbs();
+	ode.epsRel = epsRel_;
+	ode.reuseJacobian = reuseJacobian_;
 #ifdef USE_GSL
 	ode.gslSys.function = &VoxelPools::gslFunc;
-   	ode.gslSys.jacobian = 0;
+   	ode.gslSys.jacobian = &VoxelPools::gslJacobian;
 	ode.gslSys.dimension = stoichPtr_->getNumAllPools();
-	// This cast is needed because the C interface for GSL doesn't 
-	// use const void here.
-   	ode.gslSys.params = const_cast< Stoich* >( stoichPtr_ );
-	if ( ode.method == "rk5" ) {
+	// Each VoxelPools points params at itself in setStoich, so that
+	// gslFunc can find its own rate workspace.
+   	ode.gslSys.params = 0;
+	if ( method_ == "rk4" )
+		ode.gslStep = gsl_odeiv2_step_rk4;
+	else if ( method_ == "rk2" )
+		ode.gslStep = gsl_odeiv2_step_rk2;
+	else if ( method_ == "rkck" )
+		ode.gslStep = gsl_odeiv2_step_rkck;
+	else if ( method_ == "rk8" )
+		ode.gslStep = gsl_odeiv2_step_rk8pd;
+	else if ( method_ == "rk4imp" )
+		ode.gslStep = gsl_odeiv2_step_rk4imp;
+	else if ( method_ == "bsimp" )
+		ode.gslStep = gsl_odeiv2_step_bsimp;
+	else if ( method_ == "msbdf" )
+		ode.gslStep = gsl_odeiv2_step_msbdf;
+	else
 		ode.gslStep = gsl_odeiv2_step_rkf45;
-	}
 #endif
-	unsigned int numVoxels = pools_.size();
-	for ( unsigned int i = 0 ; i < numVoxels; ++i ) {
-		pools_[i].resizeArrays( numPoolSpecies );
+	for ( unsigned int i = 0 ; i < pools_.size(); ++i )
 		pools_[i].setStoich( stoichPtr_, &ode );
-	}
 }
 
 unsigned int Ksolve::getNumPools() const
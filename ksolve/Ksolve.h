@@ -11,6 +11,18 @@
 #define _KSOLVE_H
 
 class Stoich;
+class Dsolve;
+
+/**
+ * The Ksolve integrates the reactions in each voxel with GSL.
+ *
+ * A Dsolve on the same Stoich may be coupled to the Ksolve, which then
+ * does reaction and diffusion together with Strang splitting: a half
+ * step of diffusion, a full step of reaction, and another half step of
+ * diffusion. The pool numbers are then held in one place, the batch
+ * array of the Dsolve, and the reaction works on each voxel of it in
+ * place. The Dsolve should not be scheduled separately.
+ */
 class Ksolve: public ZombiePoolInterface
 {
 	public: 
@@ -40,15 +52,96 @@ class Ksolve: public ZombiePoolInterface
 		/// Returns the vector of pool Num at the specified voxel.
 		vector< double > getNvec( unsigned int voxel) const;
 		void setNvec( unsigned int voxel, vector< double > vec );
+
+		/// Returns the rate scale factors of the specified voxel.
+		vector< double > getRateScale( unsigned int voxel ) const;
+		/**
+		 * Assigns the rate scale factors of the voxel, one for each
+		 * rate term of the Stoich, or none.
+		 */
+		void setRateScale( unsigned int voxel, vector< double > scale );
+
+		/**
+		 * Returns the pool Num at the voxel in place, without a copy,
+		 * and puts the number of pools in size. Returns 0 if the voxel
+		 * is out of range. The array is valid until the voxels or the
+		 * stoich are assigned again. If a Dsolve is coupled, the array
+		 * is in its storage, and is only valid until its next reinit.
+		 */
+		double* getNvecView( unsigned int voxel, unsigned int& size );
+
+		/**
+		 * Appends the pool Num and Ninit of all voxels to s, for a
+		 * checkpoint. setState reads them back, and returns false
+		 * without changing anything if the size does not match.
+		 */
+		void getState( vector< double >& s ) const;
+		bool setState( const double* s, unsigned int size );
+
+		/**
+		 * Assigns the number of threads used to advance the voxels.
+		 * The voxels are split into contiguous blocks, one per thread.
+		 * Each voxel is integrated independently, so the results are
+		 * identical to the single-threaded calculation.
+		 */
+		void setNumThreads( unsigned int num );
+		unsigned int getNumThreads() const;
+
+		/**
+		 * Assigns the Dsolve to couple to this Ksolve. Assigning an
+		 * empty Id uncouples it.
+		 */
+		void setDsolve( Id dsolve );
+		Id getDsolve() const;
+
+		/**
+		 * Assigns the integration method. The GSL methods are rk5 (the
+		 * default), rk4, rk2, rkck, rk8, and the implicit rk4imp, bsimp
+		 * and msbdf, which use the analytic Jacobian. The rosenbrock
+		 * method is built in, and works without GSL.
+		 */
+		void setMethod( string method );
+		string getMethod() const;
+
+		void setEpsAbs( double epsAbs );
+		double getEpsAbs() const;
+		void setEpsRel( double epsRel );
+		double getEpsRel() const;
+
+		void setReuseJacobian( bool reuse );
+		bool getReuseJacobian() const;
+
+		/// Rate evaluations, summed over voxels, since the last reinit.
+		unsigned int getNumRateEvals() const;
+
+		/// Jacobian evaluations, summed over voxels, since the last reinit.
+		unsigned int getNumJacobianEvals() const;
 		//////////////////////////////////////////////////////////////////
 		// Dest Finfos
 		//////////////////////////////////////////////////////////////////
 		void process( const Eref& e, ProcPtr p );
 		void reinit( const Eref& e, ProcPtr p );
 
+		/**
+		 * Advances voxels [begin, end) through one timestep. Called
+		 * on each thread by process.
+		 */
+		void advanceVoxels( unsigned int begin, unsigned int end, 
+				ProcPtr p );
+
 		//////////////////////////////////////////////////////////////////
 		// Solver interface functions
 		//////////////////////////////////////////////////////////////////
+		/**
+		 * Returns the pool numbers of the voxel. These are in the
+		 * Dsolve when coupled, otherwise in the VoxelPools.
+		 */
+		double* voxelS( unsigned int voxel );
+		const double* voxelS( unsigned int voxel ) const;
+
+		/// The coupled Dsolve, or 0 if there is none.
+		Dsolve* dsolvePtr() const;
+
 		unsigned int getPoolIndex( const Eref& e ) const;
 		unsigned int getVoxelIndex( const Eref& e ) const;
 		
@@ -93,6 +186,30 @@ class Ksolve: public ZombiePoolInterface
 
 		/// Utility ptr used to help Pool Id lookups by the Ksolve.
 		const Stoich* stoichPtr_;
+
+		/// Worker threads used to advance voxels in parallel.
+		ThreadPool threads_;
+
+		/// Diffusion solver coupled to this one, if any.
+		Id dsolve_;
+
+		/**
+		 * True once reinit has found the Dsolve to match the Ksolve, so
+		 * that the pool numbers are in the Dsolve.
+		 */
+		bool isCoupled_;
+
+		/// Integration method and its settings, passed to each voxel.
+		string method_;
+		double epsAbs_; // Zero until set, for the default of the method.
+		double epsRel_;
+		bool reuseJacobian_;
+
+		/**
+		 * Sets up the integration method in every voxel. Called when
+		 * the pools or the method change.
+		 */
+		void setupVoxelMethod();
 };
 
 #endif	// _KSOLVE_H
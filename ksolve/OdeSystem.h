@@ -16,9 +16,14 @@ class OdeSystem {
 				: method( "rk5" ),
 					initStepSize( 1 ),
 					epsAbs( 1e6 ),
-					epsRel( 1e-6 )
+					epsRel( 1e-6 ),
+					reuseJacobian( false )
 		{;}
 
+		/**
+		 * One of the GSL steppers, or "rosenbrock" for the built-in
+		 * implicit method, which does not need GSL.
+		 */
 		string method;
 		// GSL stuff
 #ifdef USE_GSL
@@ -29,6 +34,13 @@ class OdeSystem {
 
 		double epsAbs; // Absolute error
 		double epsRel; // Relative error
+
+		/**
+		 * For the rosenbrock method: keep the Jacobian across steps
+		 * and recompute it only when a step fails, and keep its LU
+		 * factors until the step size changes.
+		 */
+		bool reuseJacobian;
 };
 
 #endif // _ODE_SYSTEM_H
@@ -0,0 +1,273 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "../randnum/RandomStream.h"
+#include "PropensitySelector.h"
+
+/**
+ * The SAFETY_FACTOR Protects against the total propensity exceeding
+ * the cumulative
+ * sum of propensities, atot. We do a lot of adding and subtracting of
+ * dependency terms from atot. Roundoff error will eventually cause
+ * this to drift from the true sum. To guarantee that we never lose
+ * the propensity of the last reaction, this safety factor scales the
+ * first calculation of atot to be slightly larger. Periodically this
+ * will cause the reaction picking step to exceed the last reaction
+ * index. This is safe, we just pick another random number.
+ * This will happen rather infrequently.
+ * That is also a good time to update the cumulative sum.
+ * A double should have >15 digits, so cumulative error will be much
+ * smaller than this.
+ */
+const double SAFETY_FACTOR = 1.0 + 1.0e-9;
+
+/**
+ * The incrementally maintained sums are recomputed after this many
+ * updates, or 16 times the number of reactions if that is larger,
+ * so that the cost of the rebuild stays small compared to the updates.
+ */
+const unsigned int MIN_RESYNC_INTERVAL = 100000;
+
+/**
+ * The LINEAR atot is also recomputed when it falls below this fraction
+ * of its value at the last rebuild. Otherwise the roundoff left over
+ * from subtracting large propensities, and the safety margin itself,
+ * would be large compared to what remains.
+ */
+const double MIN_ATOT_FRACTION = 1.0e-3;
+
+const unsigned int NO_GROUP = ~0U;
+
+PropensitySelector::PropensitySelector()
+	:
+		method_( LINEAR ),
+		numUpdates_( 0 ),
+		atot_( 0.0 ),
+		rebuildAtot_( 0.0 ),
+		treeOffset_( 1 )
+{;}
+
+void PropensitySelector::setMethod( Method method )
+{
+	method_ = method;
+	rebuild();
+}
+
+PropensitySelector::Method PropensitySelector::getMethod() const
+{
+	return method_;
+}
+
+void PropensitySelector::setSize( unsigned int n )
+{
+	v_.assign( n, 0.0 );
+	rebuild();
+}
+
+unsigned int PropensitySelector::size() const
+{
+	return v_.size();
+}
+
+vector< double >& PropensitySelector::propensities()
+{
+	return v_;
+}
+
+void PropensitySelector::rebuild()
+{
+	unsigned int n = v_.size();
+	numUpdates_ = 0;
+
+	atot_ = 0.0;
+	for ( vector< double >::const_iterator
+			i = v_.begin(); i != v_.end(); ++i )
+		atot_ += *i;
+	atot_ *= SAFETY_FACTOR;
+	rebuildAtot_ = atot_;
+
+	tree_.clear();
+	groupSum_.clear();
+	groupBound_.clear();
+	groupMembers_.clear();
+	groupOfExponent_.clear();
+	groupOf_.clear();
+	posInGroup_.clear();
+
+	if ( method_ == TREE ) {
+		treeOffset_ = 1;
+		while ( treeOffset_ < n )
+			treeOffset_ *= 2;
+		tree_.assign( 2 * treeOffset_, 0.0 );
+		for ( unsigned int i = 0; i < n; ++i )
+			tree_[ treeOffset_ + i ] = v_[i];
+		for ( unsigned int k = treeOffset_ - 1; k > 0; --k )
+			tree_[k] = tree_[ 2 * k ] + tree_[ 2 * k + 1 ];
+	} else if ( method_ == COMPOSITION_REJECTION ) {
+		groupOf_.assign( n, NO_GROUP );
+		posInGroup_.assign( n, 0 );
+		for ( unsigned int i = 0; i < n; ++i )
+			updateGroup( i, 0.0, v_[i] );
+	}
+}
+
+unsigned int PropensitySelector::findGroup( int exponent )
+{
+	map< int, unsigned int >::iterator pos =
+			groupOfExponent_.find( exponent );
+	if ( pos != groupOfExponent_.end() )
+		return pos->second;
+	unsigned int g = groupSum_.size();
+	groupOfExponent_[ exponent ] = g;
+	groupSum_.push_back( 0.0 );
+	groupBound_.push_back( ldexp( 1.0, exponent ) );
+	groupMembers_.resize( g + 1 );
+	return g;
+}
+
+void PropensitySelector::updateGroup( unsigned int i,
+				double oldA, double a )
+{
+	unsigned int oldG = groupOf_[i];
+	unsigned int g = NO_GROUP;
+	if ( a > 0.0 ) {
+		int exponent;
+		frexp( a, &exponent ); // a lies in [2^(exponent-1), 2^exponent)
+		g = findGroup( exponent );
+	}
+	if ( g == oldG ) {
+		if ( g != NO_GROUP )
+			groupSum_[g] += a - oldA;
+		return;
+	}
+	if ( oldG != NO_GROUP ) { // Swap the last member into the hole.
+		vector< unsigned int >& members = groupMembers_[ oldG ];
+		unsigned int last = members.back();
+		members[ posInGroup_[i] ] = last;
+		posInGroup_[ last ] = posInGroup_[i];
+		members.pop_back();
+		if ( members.empty() ) // Don't let roundoff leave a residue.
+			groupSum_[ oldG ] = 0.0;
+		else
+			groupSum_[ oldG ] -= oldA;
+	}
+	if ( g != NO_GROUP ) {
+		posInGroup_[i] = groupMembers_[g].size();
+		groupMembers_[g].push_back( i );
+		groupSum_[g] += a;
+	}
+	groupOf_[i] = g;
+}
+
+void PropensitySelector::update( unsigned int i, double a )
+{
+	assert( i < v_.size() );
+	double oldA = v_[i];
+	v_[i] = a;
+	if ( method_ == TREE ) {
+		unsigned int k = treeOffset_ + i;
+		tree_[k] = a;
+		for ( k /= 2; k > 0; k /= 2 )
+			tree_[k] = tree_[ 2 * k ] + tree_[ 2 * k + 1 ];
+		return;
+	}
+	if ( method_ == COMPOSITION_REJECTION ) {
+		updateGroup( i, oldA, a );
+	} else {
+		atot_ += a - oldA;
+		if ( atot_ < rebuildAtot_ * MIN_ATOT_FRACTION ) {
+			rebuild();
+			return;
+		}
+	}
+
+	if ( ++numUpdates_ > MIN_RESYNC_INTERVAL &&
+					numUpdates_ > 16 * v_.size() )
+		rebuild();
+}
+
+double PropensitySelector::total() const
+{
+	if ( method_ == TREE )
+		return tree_[1];
+	if ( method_ == COMPOSITION_REJECTION ) {
+		double ret = 0.0;
+		for ( vector< double >::const_iterator
+				i = groupSum_.begin(); i != groupSum_.end(); ++i )
+			ret += *i;
+		return ret;
+	}
+	return atot_;
+}
+
+unsigned int PropensitySelector::pick( RandomStream& rng ) const
+{
+	double r = rng.uniform();
+	if ( method_ == TREE )
+		return pickTree( r );
+	if ( method_ == COMPOSITION_REJECTION )
+		return pickCR( r, rng );
+	return pickLinear( r );
+}
+
+unsigned int PropensitySelector::pickLinear( double r ) const
+{
+	r *= atot_;
+	double sum = 0.0;
+	for ( vector< double >::const_iterator
+			i = v_.begin(); i != v_.end(); ++i ) {
+		if ( r < ( sum += *i ) )
+			return static_cast< unsigned int >( i - v_.begin() );
+	}
+	return v_.size();
+}
+
+unsigned int PropensitySelector::pickTree( double r ) const
+{
+	r *= tree_[1];
+	unsigned int k = 1;
+	while ( k < treeOffset_ ) {
+		k *= 2;
+		if ( r >= tree_[k] ) {
+			r -= tree_[k];
+			++k;
+		}
+	}
+	unsigned int i = k - treeOffset_;
+	// Roundoff can put us on an empty leaf, including the padding.
+	if ( i >= v_.size() || v_[i] <= 0.0 )
+		return v_.size();
+	return i;
+}
+
+unsigned int PropensitySelector::pickCR( double r, 
+				RandomStream& rng ) const
+{
+	r *= total();
+	for ( unsigned int g = 0; g < groupSum_.size(); ++g ) {
+		if ( r < groupSum_[g] ) {
+			const vector< unsigned int >& members = groupMembers_[g];
+			if ( members.empty() )
+				return v_.size();
+			// Every member is above half the bound, so on average
+			// this takes fewer than two tries.
+			for ( ; ; ) {
+				unsigned int j = static_cast< unsigned int >(
+						rng.uniform() * members.size() );
+				if ( j >= members.size() )
+					j = members.size() - 1;
+				if ( rng.uniform() * groupBound_[g] < v_[ members[j] ] )
+					return members[j];
+			}
+		}
+		r -= groupSum_[g];
+	}
+	return v_.size();
+}
@@ -0,0 +1,118 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _PROPENSITY_SELECTOR_H
+#define _PROPENSITY_SELECTOR_H
+
+/**
+ * Holds the propensities of all reactions in a GSSA voxel, and picks
+ * the next reaction to fire with probability proportional to its
+ * propensity. Three methods are available:
+ *
+ * LINEAR: Cumulative scan over all propensities. O(n) per pick, O(1)
+ * per update. Best for small systems.
+ *
+ * TREE: Binary sum-tree over the propensities. Each internal node holds
+ * the sum of its two children. O(log n) per pick and per update.
+ *
+ * COMPOSITION_REJECTION: Propensities are binned into groups by their
+ * power of two (Slepoy, Thompson and Plimpton 2008). A group is picked
+ * by a scan over the few group sums, and then a reaction within the
+ * group by rejection sampling, which accepts at least half the time.
+ * Close to O(1) per pick and per update.
+ *
+ * The LINEAR and COMPOSITION_REJECTION methods keep their sums by
+ * adding and subtracting changes. To stop roundoff from accumulating,
+ * the sums are recomputed from scratch every so many updates, and
+ * also whenever the LINEAR total falls far below its last value.
+ * The TREE recomputes each node from its children, so it does not
+ * drift.
+ */
+class PropensitySelector
+{
+	public:
+		enum Method { LINEAR, TREE, COMPOSITION_REJECTION };
+
+		PropensitySelector();
+
+		/// Assigns the method, and rebuilds the sums for it.
+		void setMethod( Method method );
+		Method getMethod() const;
+
+		/// Assigns the number of reactions. All propensities are zeroed.
+		void setSize( unsigned int n );
+		unsigned int size() const;
+
+		/**
+		 * Direct access to the propensity vector, so that all of them
+		 * can be assigned in one go. rebuild() must be called after
+		 * any change made this way.
+		 */
+		vector< double >& propensities();
+
+		/// Recomputes all the sums from the propensities.
+		void rebuild();
+
+		/// Assigns the propensity of reaction i, and updates the sums.
+		void update( unsigned int i, double a );
+
+		/// Returns total propensity of all reactions.
+		double total() const;
+
+		/**
+		 * Picks a reaction using random numbers from rng.
+		 * Returns size() if roundoff makes the pick fall off the end,
+		 * in which case the caller should rebuild() and try again.
+		 * The COMPOSITION_REJECTION method draws further random
+		 * numbers as needed.
+		 */
+		unsigned int pick( RandomStream& rng ) const;
+
+	private:
+		unsigned int pickLinear( double r ) const;
+		unsigned int pickTree( double r ) const;
+		unsigned int pickCR( double r, RandomStream& rng ) const;
+
+		/// Updates the group entries for CR when reaction i changes.
+		void updateGroup( unsigned int i, double oldA, double a );
+		/// Finds or makes the CR group for propensities below 2^exponent
+		unsigned int findGroup( int exponent );
+
+		Method method_;
+
+		/// Propensity of each reaction.
+		vector< double > v_;
+
+		/// Number of incremental updates since the last rebuild.
+		unsigned int numUpdates_;
+
+		/// LINEAR: Total propensity, scaled by a safety factor.
+		double atot_;
+		/// LINEAR: Value of atot_ at the last rebuild.
+		double rebuildAtot_;
+
+		/**
+		 * TREE: Node 1 is the root, node k has children 2k and 2k+1.
+		 * The leaves start at treeOffset_, which is a power of 2.
+		 */
+		vector< double > tree_;
+		unsigned int treeOffset_;
+
+		/// CR: Reactions with zero propensity are in no group.
+		vector< double > groupSum_;
+		vector< double > groupBound_;
+		vector< vector< unsigned int > > groupMembers_;
+		map< int, unsigned int > groupOfExponent_;
+		/// CR: Group of each reaction, ~0U if none.
+		vector< unsigned int > groupOf_;
+		/// CR: Position of each reaction in its groupMembers_ entry.
+		vector< unsigned int > posInGroup_;
+};
+
+#endif // _PROPENSITY_SELECTOR_H
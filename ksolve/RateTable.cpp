@@ -0,0 +1,176 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "RateTerm.h"
+#include "RateTable.h"
+
+RateTable::RateTable()
+{;}
+
+unsigned int RateTable::size() const
+{
+	return fwdKind_.size();
+}
+
+bool RateTable::addHalf( unsigned int rateIndex, const ZeroOrder* half,
+				double sign )
+{
+	vector< unsigned int > molIndex;
+	if ( typeid( *half ) == typeid( FirstOrder ) ) {
+		half->getReactants( molIndex );
+		assert( molIndex.size() == 1 );
+		firstRate_.push_back( rateIndex );
+		firstSub_.push_back( molIndex[0] );
+		firstK_.push_back( sign * half->getR1() );
+		return true;
+	}
+	if ( typeid( *half ) == typeid( SecondOrder ) ) {
+		half->getReactants( molIndex );
+		assert( molIndex.size() == 2 );
+		secondRate_.push_back( rateIndex );
+		secondSub1_.push_back( molIndex[0] );
+		secondSub2_.push_back( molIndex[1] );
+		secondK_.push_back( sign * half->getR1() );
+		return true;
+	}
+	return false;
+}
+
+/// Returns true if the half reaction can go into the flat tables.
+static bool isFlatHalf( const ZeroOrder* half )
+{
+	return ( typeid( *half ) == typeid( FirstOrder ) ||
+		typeid( *half ) == typeid( SecondOrder ) );
+}
+
+void RateTable::build( const vector< RateTerm* >& rates )
+{
+	unsigned int numRates = rates.size();
+	fwdKind_.assign( numRates, NONE );
+	fwdIndex_.assign( numRates, 0 );
+	revKind_.assign( numRates, NONE );
+	revIndex_.assign( numRates, 0 );
+	firstRate_.clear(); firstSub_.clear(); firstK_.clear();
+	secondRate_.clear(); secondSub1_.clear(); secondSub2_.clear();
+	secondK_.clear();
+	mmRate_.clear(); mmSub_.clear(); mmEnz_.clear();
+	mmKm_.clear(); mmKcat_.clear();
+	otherRate_.clear(); other_.clear();
+
+	for ( unsigned int i = 0; i < numRates; ++i ) {
+		const RateTerm* rt = rates[i];
+		if ( rt == 0 ) // Can happen while the model is being built.
+			continue;
+		const BidirectionalReaction* bi =
+				dynamic_cast< const BidirectionalReaction* >( rt );
+		const ZeroOrder* zo = dynamic_cast< const ZeroOrder* >( rt );
+		if ( bi && isFlatHalf( bi->getForward() ) &&
+						isFlatHalf( bi->getBackward() ) ) {
+			fwdKind_[i] = ( typeid( *bi->getForward() ) ==
+				typeid( FirstOrder ) ) ? FIRST : SECOND;
+			fwdIndex_[i] = ( fwdKind_[i] == FIRST ) ?
+					firstRate_.size() : secondRate_.size();
+			addHalf( i, bi->getForward(), 1.0 );
+
+			revKind_[i] = ( typeid( *bi->getBackward() ) ==
+				typeid( FirstOrder ) ) ? FIRST : SECOND;
+			revIndex_[i] = ( revKind_[i] == FIRST ) ?
+					firstRate_.size() : secondRate_.size();
+			addHalf( i, bi->getBackward(), -1.0 );
+		} else if ( zo && isFlatHalf( zo ) ) {
+			fwdKind_[i] = ( typeid( *zo ) == typeid( FirstOrder ) ) ?
+					FIRST : SECOND;
+			fwdIndex_[i] = ( fwdKind_[i] == FIRST ) ?
+					firstRate_.size() : secondRate_.size();
+			addHalf( i, zo, 1.0 );
+		} else if ( typeid( *rt ) == typeid( MMEnzyme1 ) ) {
+			vector< unsigned int > molIndex;
+			rt->getReactants( molIndex );
+			assert( molIndex.size() == 2 );
+			fwdKind_[i] = MM1;
+			fwdIndex_[i] = mmRate_.size();
+			mmRate_.push_back( i );
+			mmEnz_.push_back( molIndex[0] );
+			mmSub_.push_back( molIndex[1] );
+			mmKm_.push_back( rt->getR1() );
+			mmKcat_.push_back( rt->getR2() );
+		} else {
+			fwdKind_[i] = OTHER;
+			fwdIndex_[i] = otherRate_.size();
+			otherRate_.push_back( i );
+			other_.push_back( rt );
+		}
+	}
+}
+
+void RateTable::update( unsigned int rateIndex, const RateTerm* rate )
+{
+	if ( rateIndex >= fwdKind_.size() )
+		return; // Table not yet built. build() will load all the rates.
+	unsigned int j = fwdIndex_[ rateIndex ];
+	switch ( fwdKind_[ rateIndex ] ) {
+		case FIRST:
+			firstK_[j] = rate->getR1();
+		break;
+		case SECOND:
+			secondK_[j] = rate->getR1();
+		break;
+		case MM1:
+			mmKm_[j] = rate->getR1();
+			mmKcat_[j] = rate->getR2();
+		break;
+		default: // OTHER terms are evaluated directly.
+		break;
+	}
+	j = revIndex_[ rateIndex ];
+	switch ( revKind_[ rateIndex ] ) {
+		case FIRST:
+			firstK_[j] = -rate->getR2();
+		break;
+		case SECOND:
+			secondK_[j] = -rate->getR2();
+		break;
+		default:
+		break;
+	}
+}
+
+void RateTable::computeVelocities( const double* S, double* v ) const
+{
+	unsigned int numRates = fwdKind_.size();
+	for ( unsigned int i = 0; i < numRates; ++i )
+		v[i] = 0.0;
+
+	unsigned int n = firstRate_.size();
+	const unsigned int* rate = n ? &firstRate_[0] : 0;
+	const unsigned int* sub = n ? &firstSub_[0] : 0;
+	const double* k = n ? &firstK_[0] : 0;
+	for ( unsigned int i = 0; i < n; ++i )
+		v[ rate[i] ] += k[i] * S[ sub[i] ];
+
+	n = secondRate_.size();
+	rate = n ? &secondRate_[0] : 0;
+	sub = n ? &secondSub1_[0] : 0;
+	const unsigned int* sub2 = n ? &secondSub2_[0] : 0;
+	k = n ? &secondK_[0] : 0;
+	for ( unsigned int i = 0; i < n; ++i )
+		v[ rate[i] ] += k[i] * S[ sub[i] ] * S[ sub2[i] ];
+
+	n = mmRate_.size();
+	for ( unsigned int i = 0; i < n; ++i ) {
+		double s = S[ mmSub_[i] ];
+		v[ mmRate_[i] ] = ( mmKcat_[i] * s * S[ mmEnz_[i] ] ) /
+				( mmKm_[i] + s );
+	}
+
+	n = otherRate_.size();
+	for ( unsigned int i = 0; i < n; ++i )
+		v[ otherRate_[i] ] = (*other_[i])( S );
+}
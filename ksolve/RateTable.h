@@ -0,0 +1,85 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _RATE_TABLE_H
+#define _RATE_TABLE_H
+
+/**
+ * Flattened form of the vector< RateTerm* > in the Stoich, used to
+ * compute all the reaction velocities without a virtual call per term.
+ * The common rate terms (FirstOrder, SecondOrder and MMEnzyme1, and
+ * BidirectionalReactions built from FirstOrder and SecondOrder halves)
+ * are sorted by type into struct-of-arrays tables, each evaluated in
+ * its own tight loop. The reverse half of a BidirectionalReaction is
+ * stored with a negated rate so that it simply adds into the velocity.
+ * Any other RateTerm falls back to the virtual operator().
+ *
+ * The RateTerms remain the reference copy of the rate constants.
+ * Whenever a rate is assigned in the Stoich, the table must be told
+ * about it through update().
+ */
+class RateTable
+{
+	public:
+		RateTable();
+
+		/// Sorts the rates into the flat tables.
+		void build( const vector< RateTerm* >& rates );
+
+		/// Reloads the rate constants for the specified rate term.
+		void update( unsigned int rateIndex, const RateTerm* rate );
+
+		/// Returns number of rate terms. Zero if not yet built.
+		unsigned int size() const;
+
+		/**
+		 * Computes the velocity of each reaction into v, which must
+		 * have size() entries. The results are identical to
+		 * calling the RateTerm::operator() on each entry.
+		 */
+		void computeVelocities( const double* S, double* v ) const;
+
+	private:
+		/// Adds the flattened form of a half reaction into the table.
+		bool addHalf( unsigned int rateIndex, const ZeroOrder* half,
+						double sign );
+
+		/// Kind of each table entry, used to locate it for update.
+		enum Kind { NONE, FIRST, SECOND, MM1, OTHER };
+
+		/// Where each rate term went. Up to two entries per rate term.
+		vector< unsigned char > fwdKind_;
+		vector< unsigned int > fwdIndex_;
+		vector< unsigned char > revKind_;
+		vector< unsigned int > revIndex_;
+
+		/// v[ firstRate_[i] ] += firstK_[i] * S[ firstSub_[i] ]
+		vector< unsigned int > firstRate_;
+		vector< unsigned int > firstSub_;
+		vector< double > firstK_;
+
+		/// v[ secondRate_[i] ] += secondK_[i] * S[ sub1 ] * S[ sub2 ]
+		vector< unsigned int > secondRate_;
+		vector< unsigned int > secondSub1_;
+		vector< unsigned int > secondSub2_;
+		vector< double > secondK_;
+
+		/// v[ mmRate_[i] ] = kcat * S[ sub ] * S[ enz ] / ( Km + S[ sub ] )
+		vector< unsigned int > mmRate_;
+		vector< unsigned int > mmSub_;
+		vector< unsigned int > mmEnz_;
+		vector< double > mmKm_;
+		vector< double > mmKcat_;
+
+		/// Everything else: v[ otherRate_[i] ] = (*other_[i])( S )
+		vector< unsigned int > otherRate_;
+		vector< const RateTerm* > other_;
+};
+
+#endif // _RATE_TABLE_H
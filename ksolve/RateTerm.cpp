@@ -42,3 +42,32 @@ double StochNOrder::operator() ( const double* S ) const {
 	}
 	return ret;
 }
+
+/**
+ * Each factor of the rate is S less the number of earlier occurrences of
+ * the same substrate, so each has a derivative of one with respect to its
+ * own substrate.
+ */
+double StochNOrder::partial( const double* S, unsigned int molIndex ) const
+{
+	vector< double > y( v_.size() );
+	unsigned int lasty = 0;
+	for ( unsigned int i = 0; i < v_.size(); ++i ) {
+		if ( i > 0 && lasty == v_[i] )
+			y[i] = y[i - 1] - 1.0;
+		else
+			y[i] = S[ v_[i] ];
+		lasty = v_[i];
+	}
+	double ret = 0.0;
+	for ( unsigned int i = 0; i < v_.size(); ++i ) {
+		if ( v_[i] != molIndex )
+			continue;
+		double term = k_;
+		for ( unsigned int j = 0; j < v_.size(); ++j )
+			if ( j != i )
+				term *= y[j];
+		ret += term;
+	}
+	return ret;
+}
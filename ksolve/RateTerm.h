@@ -23,6 +23,14 @@ class RateTerm
 		/// Computes the rate. The argument is the molecule array.
 		virtual double operator() ( const double* S ) const = 0;
 
+		/**
+		 * Computes the partial derivative of the rate with respect to
+		 * the molecule S[ molIndex ]. Used to build the Jacobian for
+		 * the implicit integration methods.
+		 */
+		virtual double partial( const double* S, unsigned int molIndex )
+			const = 0;
+
 		/**
 		 * Assign the rates.
 		 */
@@ -138,6 +146,16 @@ class MMEnzyme1: public MMEnzymeBase
 			return ( kcat_ * S[ sub_ ] * S[ enz_ ] ) / ( Km_ + S[ sub_ ] );
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			double denom = Km_ + S[ sub_ ];
+			double ret = 0.0;
+			if ( molIndex == enz_ )
+				ret += kcat_ * S[ sub_ ] / denom;
+			if ( molIndex == sub_ )
+				ret += kcat_ * S[ enz_ ] * Km_ / ( denom * denom );
+			return ret;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex.resize( 2 );
 			molIndex[0] = enz_;
@@ -166,6 +184,16 @@ class MMEnzyme: public MMEnzymeBase
 			return ( sub * kcat_ * S[ enz_ ] ) / ( Km_ + sub );
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			double sub = (*substrates_)( S );
+			double denom = Km_ + sub;
+			double ret = kcat_ * S[ enz_ ] * Km_ / ( denom * denom ) *
+				substrates_->partial( S, molIndex );
+			if ( molIndex == enz_ )
+				ret += kcat_ * sub / denom;
+			return ret;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			substrates_->getReactants( molIndex );
 			molIndex.insert( molIndex.begin(), enz_ );
@@ -184,6 +212,10 @@ class ExternReac: public RateTerm
 			double ret = 0.0;
 			return ret;
 		}
+
+		double partial( const double* S, unsigned int molIndex ) const {
+			return 0.0;
+		}
 		void setRates( double k1, double k2 ) {
 			; // Dummy function to keep compiler happy
 		}
@@ -216,6 +248,10 @@ class ZeroOrder: public RateTerm
 			return k_;
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			return 0.0;
+		}
+
 		void setK( double k ) {
 			assert( !isnan( k ) );
 			if ( k >= 0.0 )
@@ -274,6 +310,10 @@ class Flux: public ZeroOrder
 			return k_ * S[ y_ ];
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			return ( molIndex == y_ ) ? k_ : 0.0;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex.resize( 0 );
 			return 0;
@@ -301,6 +341,10 @@ class FirstOrder: public ZeroOrder
 			return k_ * S[ y_ ];
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			return ( molIndex == y_ ) ? k_ : 0.0;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex.resize( 1 );
 			molIndex[0] = y_;
@@ -330,6 +374,15 @@ class SecondOrder: public ZeroOrder
 			return k_ * S[ y1_ ] * S[ y2_ ];
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			double ret = 0.0;
+			if ( molIndex == y1_ )
+				ret += k_ * S[ y2_ ];
+			if ( molIndex == y2_ )
+				ret += k_ * S[ y1_ ];
+			return ret;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex.resize( 2 );
 			molIndex[0] = y1_;
@@ -370,6 +423,12 @@ class StochSecondOrderSingleSubstrate: public ZeroOrder
 			return k_ * ( y - 1 ) * y;
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			if ( molIndex == y_ )
+				return k_ * ( 2.0 * S[ y_ ] - 1.0 );
+			return 0.0;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex.resize( 2 );
 			molIndex[0] = y_;
@@ -405,6 +464,21 @@ class NOrder: public ZeroOrder
 			return ret;
 		}
 
+		/// Sums the products of the other terms, for each occurrence.
+		double partial( const double* S, unsigned int molIndex ) const {
+			double ret = 0.0;
+			for ( unsigned int i = 0; i < v_.size(); ++i ) {
+				if ( v_[i] != molIndex )
+					continue;
+				double term = k_;
+				for ( unsigned int j = 0; j < v_.size(); ++j )
+					if ( j != i )
+						term *= S[ v_[j] ];
+				ret += term;
+			}
+			return ret;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			molIndex = v_;
 			return v_.size();
@@ -436,6 +510,8 @@ class StochNOrder: public NOrder
 		StochNOrder( double k, vector< unsigned int > v );
 
 		double operator() ( const double* S ) const;
+
+		double partial( const double* S, unsigned int molIndex ) const;
 };
 
 extern class ZeroOrder* 
@@ -461,6 +537,11 @@ class BidirectionalReaction: public RateTerm
 			return (*forward_)( S ) - (*backward_)( S );
 		}
 
+		double partial( const double* S, unsigned int molIndex ) const {
+			return forward_->partial( S, molIndex ) - 
+				backward_->partial( S, molIndex );
+		}
+
 		void setRates( double kf, double kb ) {
 			forward_->setK( kf );
 			backward_->setK( kb );
@@ -482,6 +563,16 @@ class BidirectionalReaction: public RateTerm
 			return backward_->getR1();
 		}
 
+		/// Used by the RateTable to flatten the reaction
+		const ZeroOrder* getForward() const {
+			return forward_;
+		}
+
+		/// Used by the RateTable to flatten the reaction
+		const ZeroOrder* getBackward() const {
+			return backward_;
+		}
+
 		unsigned int getReactants( vector< unsigned int >& molIndex ) const{
 			forward_->getReactants( molIndex );
 			unsigned int ret = molIndex.size();
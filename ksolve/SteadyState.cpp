@@ -15,16 +15,22 @@
  * If you want to find multiple stable states, it is best to do this
  * in Python as it gives a lot of flexibility in working out how to
  * find steady states.
- * Likewise, if you want to carry out a dose-response calculation.
+ * A dose-response calculation over the level of a buffered pool can be
+ * done by the scan function, which follows the steady state from one
+ * point to the next.
  */
 
 #include "header.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "Stoich.h"
 #include "../randnum/randnum.h"
+#include "ThreadPool.h"
 
 #ifdef USE_GSL
 #include <gsl/gsl_errno.h>
@@ -73,6 +79,30 @@ struct reac_info
 #endif
 };
 
+/**
+ * Splits the points of a scan into contiguous blocks, one per thread,
+ * so that each point can start from the solution of the one before.
+ */
+class SteadyStateScanJob: public ThreadJob
+{
+	public:
+		SteadyStateScanJob( SteadyState* ss, unsigned int numPoints )
+			: ss_( ss ), numPoints_( numPoints )
+		{;}
+
+		void runThread( unsigned int threadIndex, unsigned int numThreads )
+		{
+			unsigned int begin;
+			unsigned int end;
+			ThreadPool::partition( numPoints_, threadIndex, numThreads,
+				begin, end );
+			ss_->scanPoints( begin, end );
+		}
+	private:
+		SteadyState* ss_;
+		unsigned int numPoints_;
+};
+
 const Cinfo* SteadyState::initCinfo()
 {
 	/**
@@ -193,6 +223,73 @@ const Cinfo* SteadyState::initCinfo()
 			"Eigenvalues computed for steady state",
 			&SteadyState::getEigenvalue
 		);
+		static ValueFinfo< SteadyState, Id > scanPool( 
+			"scanPool", 
+			"Buffered pool whose concentration is stepped by the scan. "
+			"Must be one of the pools handled by the stoich.",
+			&SteadyState::setScanPool,
+			&SteadyState::getScanPool
+		);
+		static ValueFinfo< SteadyState, double > scanStart( 
+			"scanStart", 
+			"Concentration of the scanPool at the first point of the scan",
+			&SteadyState::setScanStart,
+			&SteadyState::getScanStart
+		);
+		static ValueFinfo< SteadyState, double > scanEnd( 
+			"scanEnd", 
+			"Concentration of the scanPool at the last point of the scan",
+			&SteadyState::setScanEnd,
+			&SteadyState::getScanEnd
+		);
+		static ValueFinfo< SteadyState, unsigned int > numScanPoints( 
+			"numScanPoints", 
+			"Number of evenly spaced points in the scan",
+			&SteadyState::setNumScanPoints,
+			&SteadyState::getNumScanPoints
+		);
+		static ValueFinfo< SteadyState, unsigned int > numThreads( 
+			"numThreads", 
+			"Number of threads used by the scan. The points are split "
+			"into contiguous blocks, one per thread. Within a block each "
+			"point starts from the solution of the one before, so the "
+			"scan is best run with blocks of many points.",
+			&SteadyState::setNumThreads,
+			&SteadyState::getNumThreads
+		);
+		static ReadOnlyValueFinfo< SteadyState, vector< double > > 
+				scanValues( 
+			"scanValues", 
+			"Concentration of the scanPool at each point of the last scan",
+			&SteadyState::getScanValues
+		);
+		static ReadOnlyValueFinfo< SteadyState, vector< unsigned int > > 
+				scanStateType( 
+			"scanStateType", 
+			"stateType at each point of the last scan",
+			&SteadyState::getScanStateType
+		);
+		static ReadOnlyValueFinfo< SteadyState, vector< unsigned int > > 
+				scanSolutionStatus( 
+			"scanSolutionStatus", 
+			"solutionStatus at each point of the last scan",
+			&SteadyState::getScanSolutionStatus
+		);
+		static ReadOnlyLookupValueFinfo< 
+				SteadyState, unsigned int, vector< double > > scanNvec( 
+			"scanNvec",
+			"Numbers of the variable pools at the steady state of each "
+			"point of the last scan. Empty if none was found.",
+			&SteadyState::getScanNvec
+		);
+		static ReadOnlyLookupValueFinfo< 
+				SteadyState, unsigned int, vector< double > > 
+				scanEigenvalues( 
+			"scanEigenvalues",
+			"Real parts of the eigenvalues of the Jacobian at each point "
+			"of the last scan",
+			&SteadyState::getScanEigenvalues
+		);
 		///////////////////////////////////////////////////////
 		// MsgDest definitions
 		///////////////////////////////////////////////////////
@@ -217,6 +314,13 @@ const Cinfo* SteadyState::initCinfo()
 			"Utility function to show the matrices derived for the calculations on the reaction system. Shows the Nr, gamma, and total matrices",
 			new OpFunc0< SteadyState >( &SteadyState::showMatrices )
 		);
+		static DestFinfo scan( "scan", 
+			"Finds the steady state for each point of the scan of the "
+			"scanPool concentration, with its eigenvalues and stateType. "
+			"Leaves the state of the solver unchanged. The conservation "
+			"totals are those of the current state, unless assigned.",
+			new OpFunc0< SteadyState >( &SteadyState::scan )
+		);
 		static DestFinfo randomInit( "randomInit", 
 			"Generate random initial conditions consistent with the mass"
 			"conservation rules. Typically invoked in order to scan"
@@ -249,11 +353,22 @@ const Cinfo* SteadyState::initCinfo()
 			&solutionStatus,		// ReadOnlyValue
 			&total,					// LookupValue
 			&eigenvalues,			// ReadOnlyLookupValue
+			&scanPool,				// Value
+			&scanStart,				// Value
+			&scanEnd,				// Value
+			&numScanPoints,			// Value
+			&numThreads,			// Value
+			&scanValues,			// ReadOnlyValue
+			&scanStateType,			// ReadOnlyValue
+			&scanSolutionStatus,	// ReadOnlyValue
+			&scanNvec,				// ReadOnlyLookupValue
+			&scanEigenvalues,		// ReadOnlyLookupValue
 			&setupMatrix,			// DestFinfo
 			&settle,				// DestFinfo
 			&resettle,				// DestFinfo
 			&showMatrices,			// DestFinfo
 			&randomInit,			// DestFinfo
+			&scan,					// DestFinfo
 
 
 	};
@@ -269,7 +384,7 @@ const Cinfo* SteadyState::initCinfo()
  "If you want to find multiple stable states, use the MultiStable object,"
  "which operates a SteadyState object to find multiple states."
 	"If you want to carry out a dose-response calculation, use the "
- 	"DoseResponse object."
+ 	"scan function."
  	"If you want to follow a stable state in phase space, use the "
 	"StateTrajectory object. "
 	};
@@ -316,7 +431,12 @@ SteadyState::SteadyState()
 		nPosEigenvalues_( 0 ),
 		stateType_( 0 ),
 		solutionStatus_( 0 ),
-		numFailed_( 0 )
+		numFailed_( 0 ),
+		scanPool_(),
+		scanStart_( 0.0 ),
+		scanEnd_( 0.0 ),
+		numScanPoints_( 10 ),
+		scanPoolIndex_( 0 )
 {
 	;
 }
@@ -439,6 +559,76 @@ double SteadyState::getEigenvalue( const unsigned int i ) const
 	return 0.0;
 }
 
+void SteadyState::setScanPool( Id pool ) {
+	scanPool_ = pool;
+}
+
+Id SteadyState::getScanPool() const {
+	return scanPool_;
+}
+
+void SteadyState::setScanStart( double conc ) {
+	scanStart_ = conc;
+}
+
+double SteadyState::getScanStart() const {
+	return scanStart_;
+}
+
+void SteadyState::setScanEnd( double conc ) {
+	scanEnd_ = conc;
+}
+
+double SteadyState::getScanEnd() const {
+	return scanEnd_;
+}
+
+void SteadyState::setNumScanPoints( unsigned int num ) {
+	numScanPoints_ = num;
+}
+
+unsigned int SteadyState::getNumScanPoints() const {
+	return numScanPoints_;
+}
+
+void SteadyState::setNumThreads( unsigned int num ) {
+	threads_.setNumThreads( num );
+}
+
+unsigned int SteadyState::getNumThreads() const {
+	return threads_.getNumThreads();
+}
+
+vector< double > SteadyState::getScanValues() const {
+	return scanValues_;
+}
+
+vector< unsigned int > SteadyState::getScanStateType() const {
+	return scanStateType_;
+}
+
+vector< unsigned int > SteadyState::getScanSolutionStatus() const {
+	return scanSolutionStatus_;
+}
+
+vector< double > SteadyState::getScanNvec( unsigned int i ) const
+{
+	if ( i < scanNvec_.size() )
+		return scanNvec_[i];
+	cout << "Warning: SteadyState::getScanNvec: index " << i <<
+			" out of range " << scanNvec_.size() << endl;
+	return vector< double >();
+}
+
+vector< double > SteadyState::getScanEigenvalues( unsigned int i ) const
+{
+	if ( i < scanEigenvalues_.size() )
+		return scanEigenvalues_[i];
+	cout << "Warning: SteadyState::getScanEigenvalues: index " << i <<
+			" out of range " << scanEigenvalues_.size() << endl;
+	return vector< double >();
+}
+
 ///////////////////////////////////////////////////
 // Dest function definitions
 ///////////////////////////////////////////////////
@@ -521,22 +711,18 @@ void SteadyState::setupSSmatrix()
 	vector< unsigned int > rowStart = Field< vector< unsigned int > >::get(
 					stoich_, "rowStart" );
 
-	cout << endl << endl;
 	for ( unsigned int i = 0; i < numVarPools_; ++i ) {
 		gsl_matrix_set (LU_, i, i + nReacs_, 1 );
 		unsigned int k = rowStart[i];
-		cout << endl << i << ":	";
 		for ( unsigned int j = 0; j < nReacs_; ++j ) {
 			double x = 0;
 			if ( j == colIndex[k] && k < rowStart[i+1] ) {
 				x = entry[k++];
 			}
-			cout << "	" << x;
 			gsl_matrix_set (N, i, j, x);
 			gsl_matrix_set (LU_, i, j, x );
 		}
 	}
-	cout << endl << endl;
 
 	rank_ = myGaussianDecomp( LU_ );
 
@@ -661,6 +847,33 @@ int iterate( const gsl_multiroot_fsolver_type* st, struct reac_info *ri,
 }
 #endif
 
+/**
+ * Counts the eigenvalues on either side of zero, and works out the
+ * stateType from them. Only the first rank of the eigenvalues can be
+ * nonzero, the rest come from the conservation laws.
+ */
+static unsigned int classifyEigenvalues( const vector< double >& eig,
+	unsigned int rank, unsigned int& nNeg, unsigned int& nPos )
+{
+	nNeg = 0;
+	nPos = 0;
+	for ( unsigned int i = 0; i < eig.size(); ++i ) {
+		nNeg += ( eig[i] < -SteadyState::EPSILON );
+		nPos += ( eig[i] > SteadyState::EPSILON );
+	}
+	if ( nNeg == rank ) 
+		return 0; // Stable
+	if ( nPos == rank ) // Never see it.
+		return 1; // Unstable
+	if ( nPos == 1 )
+		return 2; // Saddle
+	if ( nPos >= 2 )
+		return 3; // putative oscillatory
+	if ( nNeg == ( rank - 1) && nPos == 0 )
+		return 4; // one zero or unclassified eigenvalue. Messy.
+	return 5; // Other
+}
+
 void SteadyState::classifyState( const double* T )
 {
 #ifdef USE_GSL
@@ -723,30 +936,14 @@ void SteadyState::classifyState( const double* T )
 			status << endl;
 		solutionStatus_ = 2; // Steady state OK, eig classification failed
 	} else { // Eigenvalues are ready. Classify state.
-		nNegEigenvalues_ = 0;
-		nPosEigenvalues_ = 0;
 		for ( unsigned int i = 0; i < numVarPools_; ++i ) {
 			gsl_complex z = gsl_vector_complex_get( vec, i );
-			double r = GSL_REAL( z );
-			nNegEigenvalues_ += ( r < -EPSILON );
-			nPosEigenvalues_ += ( r > EPSILON );
-			eigenvalues_[i] = r;
+			eigenvalues_[i] = GSL_REAL( z );
 			// We have a problem here because numVarPools_ usually > rank
 			// This means we have several zero eigenvalues.
 		}
-
-		if ( nNegEigenvalues_ == rank_ ) 
-			stateType_ = 0; // Stable
-		else if ( nPosEigenvalues_ == rank_ ) // Never see it.
-			stateType_ = 1; // Unstable
-		else  if (nPosEigenvalues_ == 1)
-			stateType_ = 2; // Saddle
-		else if ( nPosEigenvalues_ >= 2 )
-			stateType_ = 3; // putative oscillatory
-		else if ( nNegEigenvalues_ == ( rank_ - 1) && nPosEigenvalues_ == 0 )
-			stateType_ = 4; // one zero or unclassified eigenvalue. Messy.
-		else
-			stateType_ = 5; // Other
+		stateType_ = classifyEigenvalues( eigenvalues_, rank_,
+			nNegEigenvalues_, nPosEigenvalues_ );
 	}
 
 	gsl_vector_complex_free( vec );
@@ -840,6 +1037,298 @@ void SteadyState::settle( bool forceSetup )
 #endif
 }
 
+//////////////////////////////////////////////////////////////////
+// Scans of steady states
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Solves A x = b in place by Gaussian elimination with partial
+ * pivoting. A is n by n, row by row. Returns false if A is singular.
+ */
+static bool solveDense( vector< double >& A, vector< double >& b,
+	unsigned int n )
+{
+	for ( unsigned int k = 0; k < n; ++k ) {
+		unsigned int p = k;
+		for ( unsigned int i = k + 1; i < n; ++i )
+			if ( fabs( A[ i * n + k ] ) > fabs( A[ p * n + k ] ) )
+				p = i;
+		if ( !( fabs( A[ p * n + k ] ) > 0.0 ) )
+			return false;
+		if ( p != k ) {
+			for ( unsigned int j = k; j < n; ++j )
+				swap( A[ k * n + j ], A[ p * n + j ] );
+			swap( b[k], b[p] );
+		}
+		for ( unsigned int i = k + 1; i < n; ++i ) {
+			double l = A[ i * n + k ] / A[ k * n + k ];
+			if ( l == 0.0 )
+				continue;
+			for ( unsigned int j = k + 1; j < n; ++j )
+				A[ i * n + j ] -= l * A[ k * n + j ];
+			b[i] -= l * b[k];
+		}
+	}
+	for ( unsigned int i = n; i > 0; --i ) {
+		unsigned int r = i - 1;
+		double sum = b[r];
+		for ( unsigned int j = r + 1; j < n; ++j )
+			sum -= A[ r * n + j ] * b[j];
+		b[r] = sum / A[ r * n + r ];
+	}
+	return true;
+}
+
+/**
+ * The scan sets up dense copies of the matrices from setupSSmatrix, so
+ * that the threads need nothing but the Stoich, whose rate and
+ * Jacobian calculations keep no state.
+ */
+void SteadyState::scan()
+{
+#ifdef USE_GSL
+	if ( !isInitialized_ ) {
+		cout << "Error: SteadyState object has not been initialized. No calculations done\n";
+		return;
+	}
+	if ( !isSetup_ )
+		setupSSmatrix();
+	if ( !isSetup_ ) {
+		cout << "Error: SteadyState::scan: unable to set up matrices\n";
+		return;
+	}
+	const Stoich* s = reinterpret_cast< const Stoich* >( 
+					stoich_.eref().data() );
+	unsigned int numBufPools = s->getNumBufPools();
+	if ( scanPool_ == Id() || 
+			!scanPool_.element()->cinfo()->isA( "PoolBase" ) ) {
+		cout << "Error: SteadyState::scan: scanPool is not a pool\n";
+		return;
+	}
+	scanPoolIndex_ = s->convertIdToPoolIndex( scanPool_ );
+	if ( scanPoolIndex_ < numVarPools_ || 
+			scanPoolIndex_ >= numVarPools_ + numBufPools ) {
+		cout << "Error: SteadyState::scan: scanPool " << 
+			scanPool_.path() << " is not a buffered pool\n";
+		return;
+	}
+
+	unsigned int n = numVarPools_;
+	unsigned int nConsv = numVarPools_ - rank_;
+	scanNr_.resize( rank_ * n );
+	for ( unsigned int i = 0; i < rank_; ++i )
+		for ( unsigned int j = 0; j < n; ++j )
+			scanNr_[ i * n + j ] = gsl_matrix_get( LU_, i, j + nReacs_ );
+	scanGamma_.resize( nConsv * n );
+	for ( unsigned int i = 0; i < nConsv; ++i )
+		for ( unsigned int j = 0; j < n; ++j )
+			scanGamma_[ i * n + j ] = gsl_matrix_get( gamma_, i, j );
+
+	Id ksolve = Field< Id >::get( stoich_, "poolInterface" );
+	scanS0_ = LookupField< unsigned int, vector< double > >::get(
+			ksolve,"nVec", 0 );
+	if ( scanS0_.size() != s->getNumAllPools() ) {
+		cout << "Error: SteadyState::scan: unable to get"
+				" pool numbers from ksolve.\n";
+		return;
+	}
+	if ( reassignTotal_ ) {
+		scanTotal_ = total_;
+	} else {
+		scanTotal_.assign( nConsv, 0.0 );
+		for ( unsigned int i = 0; i < nConsv; ++i )
+			for ( unsigned int j = 0; j < n; ++j )
+				scanTotal_[i] += scanGamma_[ i * n + j ] * scanS0_[j];
+	}
+
+	double vol = Field< double >::get( scanPool_, "volume" );
+	scanValues_.resize( numScanPoints_ );
+	scanN_.resize( numScanPoints_ );
+	for ( unsigned int k = 0; k < numScanPoints_; ++k ) {
+		double x = 0.0;
+		if ( numScanPoints_ > 1 )
+			x = static_cast< double >( k ) / ( numScanPoints_ - 1 );
+		scanValues_[k] = scanStart_ + x * ( scanEnd_ - scanStart_ );
+		scanN_[k] = scanValues_[k] * vol * NA;
+	}
+	scanNvec_.assign( numScanPoints_, vector< double >() );
+	scanEigenvalues_.assign( numScanPoints_, vector< double >() );
+	scanStateType_.assign( numScanPoints_, 5 );
+	scanSolutionStatus_.assign( numScanPoints_, 1 );
+
+	SteadyStateScanJob job( this, numScanPoints_ );
+	threads_.run( &job );
+#endif
+}
+
+void SteadyState::scanPoints( unsigned int begin, unsigned int end )
+{
+	const Stoich* s = reinterpret_cast< const Stoich* >( 
+					stoich_.eref().data() );
+	vector< double > S = scanS0_;
+	vector< double > good = scanS0_;
+	for ( unsigned int k = begin; k < end; ++k ) {
+		S[ scanPoolIndex_ ] = scanN_[k];
+		if ( solveScanPoint( s, S ) == 0 ) {
+			S = good; // Start the next point from the last solution.
+			continue;
+		}
+		scanNvec_[k].assign( S.begin(), S.begin() + numVarPools_ );
+		unsigned int stateType = 
+			classifyScanPoint( s, S, scanEigenvalues_[k] );
+		if ( stateType == ~0U ) {
+			scanSolutionStatus_[k] = 2; // Steady state OK, eig failed
+		} else {
+			scanSolutionStatus_[k] = 0;
+			scanStateType_[k] = stateType;
+		}
+		good = S;
+	}
+}
+
+/**
+ * The equations are those of ss_func: Nr.v = 0 for the independent
+ * rows, and gamma.S = T for the conservation laws. Nr is the first
+ * rank_ rows of the elimination applied to N, so Nr.v is found from
+ * the rates N.v of the Stoich, and its derivatives from the Jacobian
+ * of the Stoich.
+ */
+double SteadyState::scanResidual( const Stoich* s, vector< double >& S,
+	vector< double >& v, vector< double >& yprime, vector< double >& F )
+	const
+{
+	unsigned int n = numVarPools_;
+	s->updateFuncs( &S[0], 0 );
+	s->updateRates( &S[0], &yprime[0], v );
+	double norm = 0.0;
+	for ( unsigned int i = 0; i < rank_; ++i ) {
+		double f = 0.0;
+		for ( unsigned int j = 0; j < n; ++j )
+			f += scanNr_[ i * n + j ] * yprime[j];
+		F[i] = f;
+		norm += fabs( f );
+	}
+	for ( unsigned int i = 0; i < n - rank_; ++i ) {
+		double f = -scanTotal_[i];
+		for ( unsigned int j = 0; j < n; ++j )
+			f += scanGamma_[ i * n + j ] * S[j];
+		F[ i + rank_ ] = f;
+		norm += fabs( f );
+	}
+	return norm;
+}
+
+/**
+ * Damped Newton iteration. The step is halved until the residual falls,
+ * and pools that would go negative are set to zero. It has converged
+ * when no pool moves by more than convergenceCriterion of the largest.
+ */
+unsigned int SteadyState::solveScanPoint( const Stoich* s, 
+	vector< double >& S ) const
+{
+	unsigned int n = numVarPools_;
+	const KinJacobian& kj = s->getJacobian();
+	if ( n == 0 || kj.size() != n )
+		return 0;
+	const vector< unsigned int >& rowStart = kj.rowStart();
+	const vector< unsigned int >& colIndex = kj.colIndex();
+	vector< double > v;
+	vector< double > yprime( S.size() + s->getOffSolverPools().size() );
+	vector< double > F( n );
+	vector< double > trialF( n );
+	vector< double > jac( kj.numEntries() );
+	vector< double > A( n * n );
+	vector< double > dx( n );
+	vector< double > trial;
+
+	double norm = scanResidual( s, S, v, yprime, F );
+	for ( unsigned int iter = 1; iter <= maxIter_; ++iter ) {
+		if ( kj.numEntries() > 0 )
+			s->updateJacobian( &S[0], &jac[0] );
+		A.assign( n * n, 0.0 );
+		for ( unsigned int i = 0; i < rank_; ++i )
+			for ( unsigned int j = 0; j < n; ++j ) {
+				double m = scanNr_[ i * n + j ];
+				if ( m == 0.0 )
+					continue;
+				for ( unsigned int e = rowStart[j]; e < rowStart[j+1]; ++e )
+					A[ i * n + colIndex[e] ] += m * jac[e];
+			}
+		for ( unsigned int i = rank_; i < n; ++i )
+			for ( unsigned int j = 0; j < n; ++j )
+				A[ i * n + j ] = scanGamma_[ ( i - rank_ ) * n + j ];
+		for ( unsigned int i = 0; i < n; ++i )
+			dx[i] = -F[i];
+		if ( !solveDense( A, dx, n ) )
+			return 0;
+
+		double maxS = 0.0;
+		double maxDx = 0.0;
+		for ( unsigned int i = 0; i < n; ++i ) {
+			maxS = max( maxS, fabs( S[i] ) );
+			maxDx = max( maxDx, fabs( dx[i] ) );
+		}
+		bool isConverged = ( maxDx <= convergenceCriterion_ * maxS );
+
+		double lambda = 1.0;
+		bool isAccepted = false;
+		for ( unsigned int k = 0; k < 30 && !isAccepted; ++k ) {
+			trial = S;
+			for ( unsigned int i = 0; i < n; ++i )
+				trial[i] = max( 0.0, S[i] + lambda * dx[i] );
+			double trialNorm = scanResidual( s, trial, v, yprime, trialF );
+			if ( trialNorm < norm || isConverged ) {
+				S.swap( trial );
+				F.swap( trialF );
+				norm = trialNorm;
+				isAccepted = true;
+			}
+			lambda *= 0.5;
+		}
+		if ( !isAccepted )
+			return 0;
+		if ( isConverged )
+			return iter;
+	}
+	return 0;
+}
+
+unsigned int SteadyState::classifyScanPoint( const Stoich* s,
+	const vector< double >& S, vector< double >& eig ) const
+{
+#ifdef USE_GSL
+	unsigned int n = numVarPools_;
+	const KinJacobian& kj = s->getJacobian();
+	vector< double > jac( kj.numEntries() );
+	if ( kj.numEntries() > 0 )
+		s->updateJacobian( &S[0], &jac[0] );
+	gsl_matrix* J = gsl_matrix_calloc( n, n );
+	for ( unsigned int i = 0; i < kj.size(); ++i )
+		for ( unsigned int e = kj.rowStart()[i]; 
+						e < kj.rowStart()[i + 1]; ++e )
+			gsl_matrix_set( J, i, kj.colIndex()[e], jac[e] );
+
+	gsl_vector_complex* vec = gsl_vector_complex_alloc( n );
+	gsl_eigen_nonsymm_workspace* workspace = gsl_eigen_nonsymm_alloc( n );
+	int status = gsl_eigen_nonsymm( J, vec, workspace );
+	unsigned int ret = ~0U;
+	eig.assign( n, 0.0 );
+	if ( status == GSL_SUCCESS ) {
+		for ( unsigned int i = 0; i < n; ++i )
+			eig[i] = GSL_REAL( gsl_vector_complex_get( vec, i ) );
+		unsigned int nNeg;
+		unsigned int nPos;
+		ret = classifyEigenvalues( eig, rank_, nNeg, nPos );
+	}
+	gsl_vector_complex_free( vec );
+	gsl_matrix_free( J );
+	gsl_eigen_nonsymm_free( workspace );
+	return ret;
+#else
+	return ~0U;
+#endif
+}
+
 // Long section here of functions using GSL
 #ifdef USE_GSL
 int ss_func( const gsl_vector* x, void* params, gsl_vector* f )
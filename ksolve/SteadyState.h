@@ -43,6 +43,29 @@ class SteadyState
 		unsigned int getNposEigenvalues() const;
 		unsigned int getSolutionStatus() const;
 
+		/**
+		 * Fields for the scan. The concentration of the buffered pool
+		 * scanPool is stepped from scanStart to scanEnd, and the steady
+		 * state found at each of the numScanPoints.
+		 */
+		void setScanPool( Id pool );
+		Id getScanPool() const;
+		void setScanStart( double conc );
+		double getScanStart() const;
+		void setScanEnd( double conc );
+		double getScanEnd() const;
+		void setNumScanPoints( unsigned int num );
+		unsigned int getNumScanPoints() const;
+		void setNumThreads( unsigned int num );
+		unsigned int getNumThreads() const;
+
+		/// Results of the last scan, one entry per point.
+		vector< double > getScanValues() const;
+		vector< unsigned int > getScanStateType() const;
+		vector< unsigned int > getScanSolutionStatus() const;
+		vector< double > getScanNvec( unsigned int i ) const;
+		vector< double > getScanEigenvalues( unsigned int i ) const;
+
 		///////////////////////////////////////////////////
 		// Msg Dest function definitions
 		///////////////////////////////////////////////////
@@ -53,6 +76,18 @@ class SteadyState
 		void showMatricesFunc();
 		void showMatrices();
 		void randomizeInitialCondition( const Eref& e);
+
+		/**
+		 * Finds the steady state at each point of the scan, without
+		 * changing the state of the solver.
+		 */
+		void scan();
+
+		/**
+		 * Does points [begin, end) of the scan, each starting from the
+		 * solution of the one before. Called on each thread by scan.
+		 */
+		void scanPoints( unsigned int begin, unsigned int end );
 		static void assignY( double* S );
 		// static void randomInitFunc();
 		// void randomInit();
@@ -87,6 +122,32 @@ class SteadyState
 
 	private:
 		void setupSSmatrix();
+
+		/**
+		 * Newton iteration for the steady state of the variable pools
+		 * in S, starting from S, under the conservation totals of the
+		 * scan. Returns the number of iterations, or 0 if it failed.
+		 * Keeps no state, so the scan threads may call it concurrently.
+		 */
+		unsigned int solveScanPoint( const Stoich* s, vector< double >& S )
+			const;
+
+		/**
+		 * Puts the real parts of the eigenvalues of the Jacobian at S
+		 * into eig, and returns the stateType, or ~0U if the
+		 * eigenvalues could not be found.
+		 */
+		unsigned int classifyScanPoint( const Stoich* s,
+			const vector< double >& S, vector< double >& eig ) const;
+
+		/**
+		 * Computes the residual of the steady state equations at S
+		 * into F, using v and yprime as workspace. Returns the sum of
+		 * the magnitudes of the residuals.
+		 */
+		double scanResidual( const Stoich* s, vector< double >& S,
+			vector< double >& v, vector< double >& yprime,
+			vector< double >& F ) const;
 		
 		///////////////////////////////////////////////////
 		// Internal fields.
@@ -117,6 +178,34 @@ class SteadyState
 		unsigned int stateType_;
 		unsigned int solutionStatus_;
 		unsigned int numFailed_;
+
+		/// Scan parameters.
+		Id scanPool_;
+		double scanStart_;
+		double scanEnd_;
+		unsigned int numScanPoints_;
+		ThreadPool threads_;
+
+		/**
+		 * Set up by scan for the threads. The first rank_ rows of the
+		 * elimination of N, as applied to the rates, and the
+		 * conservation matrix gamma, each numVarPools_ wide, the
+		 * totals, the starting pool numbers, and the index and the
+		 * number of molecules of scanPool at each point.
+		 */
+		vector< double > scanNr_;
+		vector< double > scanGamma_;
+		vector< double > scanTotal_;
+		vector< double > scanS0_;
+		unsigned int scanPoolIndex_;
+		vector< double > scanN_;
+
+		/// Results of the scan.
+		vector< double > scanValues_;
+		vector< vector< double > > scanNvec_;
+		vector< vector< double > > scanEigenvalues_;
+		vector< unsigned int > scanStateType_;
+		vector< unsigned int > scanSolutionStatus_;
 };
 
 extern const Cinfo* initSteadyStateCinfo();
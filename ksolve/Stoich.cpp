@@ -14,6 +14,9 @@
 #include "EnzBase.h"
 #include "CplxEnzBase.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SumTotalTerm.h"
 #include "FuncBase.h"
@@ -74,6 +77,19 @@ const Cinfo* Stoich::initCinfo()
 			&Stoich::getNumRates
 		);
 
+		static ReadOnlyLookupValueFinfo< Stoich, Id, unsigned int >
+				rateIndex(
+			"rateIndex",
+			"Index of the first rate term of a reaction or enzyme, as "
+			"used by the rateScale of the solvers. A reaction has one "
+			"term, or two in the one-way mode of the Stoich, for the "
+			"forward and the backward halves. A Michaelis-Menten enzyme "
+			"has one term. An enzyme with a complex has two, for k1/k2 "
+			"and k3, or three in the one-way mode. Returns ~0 for "
+			"anything else.",
+			&Stoich::getRateIndex
+		);
+
 		// Stuff here for getting Stoichiometry matrix to manipulate in
 		// Python.
 		static ReadOnlyValueFinfo< Stoich, vector< int > >
@@ -124,6 +140,7 @@ const Cinfo* Stoich::initCinfo()
 		&numVarPools,		// ReadOnlyValue
 		&numAllPools,		// ReadOnlyValue
 		&numRates,			// ReadOnlyValue
+		&rateIndex,			// ReadOnlyLookupValue
 		&matrixEntry,		// ReadOnlyValue
 		&columnIndex,		// ReadOnlyValue
 		&rowStart,			// ReadOnlyValue
@@ -159,7 +176,8 @@ Stoich::Stoich()
 		numVarPoolsBytes_( 0 ),
 		numBufPools_( 0 ),
 		numFuncPools_( 0 ),
-		numReac_( 0 )
+		numReac_( 0 ),
+		rateVersion_( 0 )
 {;}
 
 Stoich::~Stoich()
@@ -245,6 +263,9 @@ void Stoich::setElist( const Eref& e, const vector< ObjId >& elist )
 	allocateObjMap( temp );
 	allocateModel( temp );
 	zombifyModel( e, temp );
+	buildRateTable();
+	buildJacobian();
+	buildFuncTable();
 }
 
 string Stoich::getPath( const Eref& e ) const
@@ -301,6 +322,17 @@ unsigned int Stoich::getNumRates() const
 	return rates_.size();
 }
 
+unsigned int Stoich::getRateIndex( Id id ) const
+{
+	if ( id.value() < objMapStart_ || 
+			id.value() - objMapStart_ >= objMap_.size() )
+		return ~0U;
+	const Cinfo* c = id.element()->cinfo();
+	if ( !( c->isA( "ReacBase" ) || c->isA( "EnzBase" ) ) )
+		return ~0U;
+	return convertIdToReacIndex( id );
+}
+
 const RateTerm* Stoich::rates( unsigned int i ) const
 {
 	assert( i < rates_.size() );
@@ -639,6 +671,34 @@ void Stoich::convertRatesToStochasticForm()
 			}
 		}
 	}
+	buildRateTable();
+}
+
+void Stoich::buildRateTable()
+{
+	rateTable_.build( rates_ );
+	++rateVersion_;
+}
+
+unsigned int Stoich::getRateVersion() const
+{
+	return rateVersion_;
+}
+
+void Stoich::setRateR1( unsigned int rateIndex, double v ) const
+{
+	assert( rateIndex < rates_.size() );
+	rates_[ rateIndex ]->setR1( v );
+	rateTable_.update( rateIndex, rates_[ rateIndex ] );
+	++rateVersion_;
+}
+
+void Stoich::setRateR2( unsigned int rateIndex, double v ) const
+{
+	assert( rateIndex < rates_.size() );
+	rates_[ rateIndex ]->setR2( v );
+	rateTable_.update( rateIndex, rates_[ rateIndex ] );
+	++rateVersion_;
 }
 
 const KinSparseMatrix& Stoich::getStoichiometryMatrix() const
@@ -646,6 +706,22 @@ const KinSparseMatrix& Stoich::getStoichiometryMatrix() const
 	return N_;
 }
 
+void Stoich::buildJacobian()
+{
+	jacobian_.build( rates_, N_, numVarPools_ );
+}
+
+const KinJacobian& Stoich::getJacobian() const
+{
+	return jacobian_;
+}
+
+void Stoich::updateJacobian( const double* s, double* jac,
+				const double* scale ) const
+{
+	jacobian_.compute( rates_, s, jac, scale );
+}
+
 //////////////////////////////////////////////////////////////
 // Model zombification functions
 //////////////////////////////////////////////////////////////
@@ -1045,7 +1121,7 @@ void Stoich::setReacKf( const Eref& e, double v ) const
 	double volScale = convertConcToNumRateUsingMesh( e, subOut, false );
 	unsigned int i = convertIdToReacIndex( e.id() );
 	if ( i != ~0U )
-		rates_[ i ]->setR1( v / volScale );
+		setRateR1( i, v / volScale );
 }
 
 /**
@@ -1077,9 +1153,9 @@ void Stoich::setReacKb( const Eref& e, double v ) const
 		return;
 
 	if ( useOneWay_ )
-		 rates_[ i + 1 ]->setR1( v / volScale);
+		 setRateR1( i + 1, v / volScale);
 	else
-		 rates_[ i ]->setR2( v / volScale );
+		 setRateR2( i, v / volScale );
 }
 
 void Stoich::setMMenzKm( const Eref& e, double v ) const
@@ -1088,9 +1164,8 @@ void Stoich::setMMenzKm( const Eref& e, double v ) const
 	static const SrcFinfo* subOut = dynamic_cast< const SrcFinfo* > (
 		zombieMMenzCinfo->findFinfo( "subOut" ) );
 	// Identify MMenz rate term
-	RateTerm* rt = rates_[ convertIdToReacIndex( e.id() ) ];
-	MMEnzymeBase* enz = dynamic_cast< MMEnzymeBase* >( rt );
-	assert( enz );
+	unsigned int rateIndex = convertIdToReacIndex( e.id() );
+	assert( dynamic_cast< MMEnzymeBase* >( rates_[ rateIndex ] ) );
 	// Identify MMenz Enzyme substrate. I would have preferred the parent,
 	// but that gets messy.
 	// unsigned int enzMolIndex = enz->getEnzIndex();
@@ -1104,7 +1179,7 @@ void Stoich::setMMenzKm( const Eref& e, double v ) const
 		return;
 	}
 	// Do scaling and assignment.
-	enz->setR1( v * vols[0] * NA );
+	setRateR1( rateIndex, v * vols[0] * NA );
 }
 
 double Stoich::getMMenzNumKm( const Eref& e ) const
@@ -1114,11 +1189,10 @@ double Stoich::getMMenzNumKm( const Eref& e ) const
 
 void Stoich::setMMenzKcat( const Eref& e, double v ) const
 {
-	RateTerm* rt = rates_[ convertIdToReacIndex( e.id() ) ];
-	MMEnzymeBase* enz = dynamic_cast< MMEnzymeBase* >( rt );
-	assert( enz );
+	unsigned int rateIndex = convertIdToReacIndex( e.id() );
+	assert( dynamic_cast< MMEnzymeBase* >( rates_[ rateIndex ] ) );
 
-	enz->setR2( v );
+	setRateR2( rateIndex, v );
 }
 
 double Stoich::getMMenzKcat( const Eref& e ) const
@@ -1136,23 +1210,23 @@ void Stoich::setEnzK1( const Eref& e, double v ) const
 
 	double volScale = convertConcToNumRateUsingMesh( e, subOut, true );
 
-	rates_[ convertIdToReacIndex( e.id() ) ]->setR1( v / volScale );
+	setRateR1( convertIdToReacIndex( e.id() ), v / volScale );
 }
 
 void Stoich::setEnzK2( const Eref& e, double v ) const
 {
 	if ( useOneWay_ )
-		rates_[ convertIdToReacIndex( e.id() ) + 1 ]->setR1( v );
+		setRateR1( convertIdToReacIndex( e.id() ) + 1, v );
 	else
-		rates_[ convertIdToReacIndex( e.id() ) ]->setR2( v );
+		setRateR2( convertIdToReacIndex( e.id() ), v );
 }
 
 void Stoich::setEnzK3( const Eref& e, double v ) const
 {
 	if ( useOneWay_ )
-		rates_[ convertIdToReacIndex( e.id() ) + 2 ]->setR1( v );
+		setRateR1( convertIdToReacIndex( e.id() ) + 2, v );
 	else
-		rates_[ convertIdToReacIndex( e.id() ) + 1 ]->setR1( v );
+		setRateR1( convertIdToReacIndex( e.id() ) + 1, v );
 }
 
 double Stoich::getEnzNumK1( const Eref& e ) const
@@ -1270,14 +1344,34 @@ const vector< Id >& Stoich::offSolverPoolMap( Id compt ) const
 void Stoich::updateRates( const double* s, double* yprime ) const
 {
 	vector< double > v( numReac_, 0.0 );
-	vector< double >::iterator j = v.begin();
+	updateRates( s, yprime, v );
+}
+
+/**
+ * This variant uses the workspace v provided by the caller, so it does
+ * no allocation once v has been sized. The velocities come from the
+ * flattened rateTable_ if it is ready, otherwise from the RateTerms.
+ */
+void Stoich::updateRates( const double* s, double* yprime,
+				vector< double >& v, const double* scale ) const
+{
 	assert( numReac_ == rates_.size() );
+	if ( v.size() != numReac_ )
+		v.resize( numReac_ );
 
-	for ( vector< RateTerm* >::const_iterator
-		i = rates_.begin(); i != rates_.end(); i++) {
-		*j++ = (**i)( s );
-		assert( !isnan( *( j-1 ) ) );
+	if ( rateTable_.size() == numReac_ && numReac_ > 0 ) {
+		rateTable_.computeVelocities( s, &v[0] );
+	} else {
+		vector< double >::iterator j = v.begin();
+		for ( vector< RateTerm* >::const_iterator
+			i = rates_.begin(); i != rates_.end(); i++) {
+			*j++ = (**i)( s );
+			assert( !isnan( *( j-1 ) ) );
+		}
 	}
+	if ( scale )
+		for ( unsigned int i = 0; i < numReac_; ++i )
+			v[i] *= scale[i];
 
 	for (unsigned int i = 0; i < numVarPools_ + offSolverPools_.size(); ++i)
 		*yprime++ = N_.computeRowRate( i , v );
@@ -1296,8 +1390,12 @@ void Stoich::updateReacVelocities( const double* s, vector< double >& v )
 	vector< RateTerm* >::const_iterator i;
 	v.clear();
 	v.resize( numReac_, 0.0 );
-	vector< double >::iterator j = v.begin();
 	assert( numReac_ == rates_.size() );
+	if ( rateTable_.size() == numReac_ && numReac_ > 0 ) {
+		rateTable_.computeVelocities( s, &v[0] );
+		return;
+	}
+	vector< double >::iterator j = v.begin();
 
 	for ( i = rates_.begin(); i != rates_.end(); i++) {
 		*j++ = (**i)( s );
@@ -1310,10 +1408,19 @@ double Stoich::getReacVelocity( unsigned int r, const double* s ) const
 	return rates_[r]->operator()( s );
 }
 
+void Stoich::buildFuncTable()
+{
+	funcTable_.build( funcs_ );
+}
+
 // s is the array of pools, S_[meshIndex][0]
 void Stoich::updateFuncs( double* s, double t ) const
 {
 	double* j = s + numVarPools_ + numBufPools_;
+	if ( funcTable_.size() == funcs_.size() && funcs_.size() > 0 ) {
+		funcTable_.compute( s, t, j );
+		return;
+	}
 
 	for ( vector< FuncTerm* >::const_iterator i = funcs_.begin();
 					i != funcs_.end(); ++i ) {
@@ -64,6 +64,12 @@ class Stoich
 		 */
 		unsigned int getNumRates() const;
 
+		/**
+		 * Returns the index of the first rate term of the reaction or
+		 * enzyme, or ~0U if it is not one handled by this Stoich.
+		 */
+		unsigned int getRateIndex( Id id ) const;
+
 		/**
 		 * Utility function to return # of core rates for reacs which are
 		 * entirely located on current compartment, including all reactants
@@ -96,6 +102,14 @@ class Stoich
 		 * off-solver pools, in offSolverReacs_ and offSolverPools_.
 		 */
 		void locateOffSolverReacs( Id myCompt, vector< Id >& elist );
+
+		/**
+		 * Assigns R1 or R2 of the specified rate term, and updates the
+		 * rate table to match. All changes to rate constants should
+		 * go through these.
+		 */
+		void setRateR1( unsigned int rateIndex, double v ) const;
+		void setRateR2( unsigned int rateIndex, double v ) const;
 	
 		/**
 		 * Builds the objMap vector, which maps all Ids to 
@@ -305,17 +319,45 @@ class Stoich
 
 		/// Another utility function, prints out all Kf, kf, Kb, kb.
 		void printRates() const;
+
+		/// Rebuilds the flattened rate table from the rates_ vector.
+		void buildRateTable();
+
+		/// Rebuilds the sparse Jacobian pattern from N_ and rates_.
+		void buildJacobian();
+
+		/// Rebuilds the flattened func table from the funcs_ vector.
+		void buildFuncTable();
 		//////////////////////////////////////////////////////////////////
 		// Utility funcs for numeric calculations
 		//////////////////////////////////////////////////////////////////
 
-		/// Updates the yprime array, rate of change of each molecule
+		/**
+		 * Updates the yprime array, rate of change of each molecule.
+		 * This and updateFuncs keep no state in the Stoich, so the 
+		 * Ksolve may call them concurrently from different threads,
+		 * each working on its own voxels.
+		 */
 		void updateRates( const double* s, double* yprime ) const;
+
+		/**
+		 * As above, but uses the caller's workspace v to hold the 
+		 * reaction velocities so that it does not allocate. This is
+		 * the version used in the inner loop of the solvers, which keep
+		 * one workspace per voxel. If scale is given, each velocity
+		 * is multiplied by its entry in scale, which has getNumRates()
+		 * entries.
+		 */
+		void updateRates( const double* s, double* yprime,
+						vector< double >& v, const double* scale = 0 ) const;
 		
 		/// Computes the velocity of each reaction, vel.
 		void updateReacVelocities( const double* s, vector< double >& vel ) const;
 
-		/// Updates the function values, within s.
+		/**
+		 * Updates the function values, within s. Re-entrant provided
+		 * the FuncTerms are.
+		 */
 		void updateFuncs( double* s, double t ) const;
 
 		/// Updates the rates for cross-compartment reactions.
@@ -330,6 +372,24 @@ class Stoich
 
 		/// Returns the stoich matrix. Used by gsolve.
 		const KinSparseMatrix& getStoichiometryMatrix() const;
+
+		/// Returns the Jacobian pattern. Used by the implicit methods.
+		const KinJacobian& getJacobian() const;
+
+		/**
+		 * Returns a count that goes up whenever a rate is assigned or
+		 * the rate table is rebuilt, so that the solvers can tell when
+		 * a Jacobian they hold on to is out of date.
+		 */
+		unsigned int getRateVersion() const;
+
+		/**
+		 * Computes the Jacobian of the variable pools at s into jac,
+		 * which has getJacobian().numEntries() entries. Keeps no state
+		 * in the Stoich, like updateRates, and takes the same scale.
+		 */
+		void updateJacobian( const double* s, double* jac,
+						const double* scale = 0 ) const;
 		//////////////////////////////////////////////////////////////////
 		// Access functions for cross-node reactions.
 		//////////////////////////////////////////////////////////////////
@@ -373,9 +433,24 @@ class Stoich
 		/// The RateTerms handle the update operations for reaction rate v_
 		vector< RateTerm* > rates_;
 
+		/**
+		 * Flattened copy of the rates_, used for fast evaluation.
+		 * Mutable because the rate assignment functions are const.
+		 */
+		mutable RateTable rateTable_;
+
+		/**
+		 * Pattern of the Jacobian d( N_.v )/dS of the variable pools,
+		 * with the fill-in and elimination sequence for its LU factors.
+		 */
+		KinJacobian jacobian_;
+
 		/// The FuncTerms handle mathematical ops on mol levels.
 		vector< FuncTerm* > funcs_;
 
+		/// Flattened copy of the funcs_, used for fast evaluation.
+		FuncTable funcTable_;
+
 		/// N_ is the stoichiometry matrix.
 		KinSparseMatrix N_;
 
@@ -440,6 +515,9 @@ class Stoich
 		 */
 		unsigned int numReac_;
 
+		/// Bumped on every change to the rates. See getRateVersion.
+		mutable unsigned int rateVersion_;
+
 		//////////////////////////////////////////////////////////////////
 		// Off-solver stuff
 		//////////////////////////////////////////////////////////////////
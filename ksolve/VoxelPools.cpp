@@ -17,6 +17,9 @@
 #include "VoxelPoolsBase.h"
 #include "VoxelPools.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
@@ -27,6 +30,19 @@
 //////////////////////////////////////////////////////////////
 
 VoxelPools::VoxelPools()
+	: 
+		stoichPtr_( 0 ),
+		useRosenbrock_( false ),
+		reuseJacobian_( false ),
+		initStepSize_( 1 ),
+		epsAbs_( 1e6 ),
+		epsRel_( 1e-6 ),
+		h_( 0.0 ),
+		luStep_( 0.0 ),
+		isJacobianCurrent_( false ),
+		rateVersion_( 0 ),
+		numRateEvals_( 0 ),
+		numJacobianEvals_( 0 )
 {
 #ifdef USE_GSL
 		driver_ = 0;
@@ -46,21 +62,75 @@ VoxelPools::~VoxelPools()
 //////////////////////////////////////////////////////////////
 void VoxelPools::setStoich( const Stoich* s, const OdeSystem* ode )
 {
+	stoichPtr_ = s;
+	v_.assign( s->getNumRates(), 0.0 );
+	useRosenbrock_ = ( ode->method == "rosenbrock" );
+	reuseJacobian_ = ode->reuseJacobian;
+	initStepSize_ = ode->initStepSize;
+	epsAbs_ = ode->epsAbs;
+	epsRel_ = ode->epsRel;
+	h_ = 0.0;
+	luStep_ = 0.0;
+	isJacobianCurrent_ = false;
 #ifdef USE_GSL
-	sys_ = ode->gslSys;
 	if ( driver_ )
 		gsl_odeiv2_driver_free( driver_ );
+	driver_ = 0;
+	if ( useRosenbrock_ )
+		return;
+	sys_ = ode->gslSys;
+	sys_.params = this;
 	driver_ = gsl_odeiv2_driver_alloc_y_new( 
 		&sys_, ode->gslStep, ode->initStepSize, 
 		ode->epsAbs, ode->epsRel );
 #endif
 }
 
+void VoxelPools::reinit()
+{
+	VoxelPoolsBase::reinit();
+	h_ = 0.0;
+	luStep_ = 0.0;
+	isJacobianCurrent_ = false;
+	numRateEvals_ = 0;
+	numJacobianEvals_ = 0;
+#ifdef USE_GSL
+	if ( driver_ )
+		gsl_odeiv2_driver_reset( driver_ );
+#endif
+}
+
+unsigned int VoxelPools::getNumRateEvals() const
+{
+	return numRateEvals_;
+}
+
+unsigned int VoxelPools::getNumJacobianEvals() const
+{
+	return numJacobianEvals_;
+}
+
+void VoxelPools::setRateScale( const vector< double >& scale )
+{
+	VoxelPoolsBase::setRateScale( scale );
+	luStep_ = 0.0;
+	isJacobianCurrent_ = false;
+}
+
 void VoxelPools::advance( const ProcInfo* p )
 {
+	advance( p, varS() );
+}
+
+void VoxelPools::advance( const ProcInfo* p, double* s )
+{
+	if ( useRosenbrock_ ) {
+		advanceRosenbrock( p, s );
+		return;
+	}
 #ifdef USE_GSL
 	double t = p->currTime - p->dt;
-	int status = gsl_odeiv2_driver_apply( driver_, &t, p->currTime, varS());
+	int status = gsl_odeiv2_driver_apply( driver_, &t, p->currTime, s );
 	if ( status != GSL_SUCCESS ) {
 		cout << "Error: VoxelPools::advance: GSL integration error at time "
 			 << t << "\n";
@@ -73,8 +143,10 @@ void VoxelPools::advance( const ProcInfo* p )
 int VoxelPools::gslFunc( double t, const double* y, double *dydt, 
 						void* params )
 {
-	Stoich* s = reinterpret_cast< Stoich* >( params );
+	VoxelPools* vp = reinterpret_cast< VoxelPools* >( params );
+	const Stoich* s = vp->stoichPtr_;
 	double* q = const_cast< double* >( y ); // Assign the func portion.
+	++vp->numRateEvals_;
 
 	// Assign the buffered pools
 	// Not possible because this is a static function
@@ -87,10 +159,147 @@ int VoxelPools::gslFunc( double t, const double* y, double *dydt,
 		*/
 
 	s->updateFuncs( q, t );
-	s->updateRates( y, dydt );
+	s->updateRates( y, dydt, vp->v_, vp->rateScale() );
 #ifdef USE_GSL
 	return GSL_SUCCESS;
 #else
 	return 0;
 #endif
 }
+
+// static func. The Jacobian for the implicit GSL methods.
+int VoxelPools::gslJacobian( double t, const double* y, double* dfdy,
+						double* dfdt, void* params )
+{
+	VoxelPools* vp = reinterpret_cast< VoxelPools* >( params );
+	const Stoich* s = vp->stoichPtr_;
+	const KinJacobian& kj = s->getJacobian();
+	unsigned int n = s->getNumAllPools();
+	++vp->numJacobianEvals_;
+	vp->jac_.resize( kj.numEntries() );
+	if ( kj.numEntries() > 0 )
+		s->updateJacobian( y, &vp->jac_[0], vp->rateScale() );
+	for ( unsigned int i = 0; i < n * n; ++i )
+		dfdy[i] = 0.0;
+	for ( unsigned int i = 0; i < n; ++i )
+		dfdt[i] = 0.0;
+	const vector< unsigned int >& rowStart = kj.rowStart();
+	const vector< unsigned int >& colIndex = kj.colIndex();
+	for ( unsigned int i = 0; i < kj.size(); ++i )
+		for ( unsigned int e = rowStart[i]; e < rowStart[i + 1]; ++e )
+			dfdy[ i * n + colIndex[e] ] = vp->jac_[e];
+#ifdef USE_GSL
+	return GSL_SUCCESS;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Each step solves
+ * ( I - gamma h J ) k1 = f( y )
+ * ( I - gamma h J ) k2 = f( y + h k1 ) - 2 k1
+ * and takes y + 1.5 h k1 + 0.5 h k2, with gamma = 1 + 1/sqrt(2).
+ * The difference from the first order y + h k1 is the error estimate,
+ * which is held within epsAbs + epsRel * |y| for each pool, as in GSL.
+ * Only the variable pools are in the Jacobian. The rows of the other
+ * pools are those of the identity, which is all they need as their
+ * rates are zero.
+ */
+void VoxelPools::advanceRosenbrock( const ProcInfo* p, double* s )
+{
+	static const double ros2Gamma = 1.0 + 1.0 / sqrt( 2.0 );
+	const KinJacobian& kj = stoichPtr_->getJacobian();
+	unsigned int n = stoichPtr_->getNumAllPools();
+	unsigned int nv = kj.size();
+	if ( jac_.size() != kj.numEntries() ) {
+		jac_.assign( kj.numEntries(), 0.0 );
+		lu_.assign( kj.numEntries(), 0.0 );
+		luStep_ = 0.0;
+		isJacobianCurrent_ = false;
+	}
+	// A reused Jacobian must not outlive a change of the rates.
+	if ( rateVersion_ != stoichPtr_->getRateVersion() ) {
+		rateVersion_ = stoichPtr_->getRateVersion();
+		luStep_ = 0.0;
+		isJacobianCurrent_ = false;
+	}
+	k1_.resize( n );
+	k2_.resize( n );
+	yNew_.resize( n );
+
+	double t = p->currTime - p->dt;
+	double tEnd = p->currTime;
+	double hMin = 1e-10 * p->dt;
+	if ( h_ <= 0.0 )
+		h_ = min( initStepSize_, p->dt );
+	bool haveJacobian = ( luStep_ > 0.0 );
+	while ( tEnd - t > hMin ) {
+		double h = min( h_, tEnd - t );
+		bool isTruncated = ( h < h_ );
+		if ( !isJacobianCurrent_ && ( !reuseJacobian_ || !haveJacobian ) ){
+			if ( nv > 0 )
+				stoichPtr_->updateJacobian( s, &jac_[0], rateScale() );
+			++numJacobianEvals_;
+			isJacobianCurrent_ = true;
+			haveJacobian = true;
+			luStep_ = 0.0;
+		}
+		if ( h != luStep_ ) {
+			if ( nv > 0 && !kj.factor( &jac_[0], ros2Gamma * h, &lu_[0] ) ) {
+				luStep_ = 0.0;
+				h_ = 0.5 * h;
+				if ( h_ < hMin )
+					break;
+				continue;
+			}
+			luStep_ = h;
+		}
+
+		gslFunc( t, s, &k1_[0], this );
+		if ( nv > 0 )
+			kj.solve( &lu_[0], &k1_[0] );
+		for ( unsigned int i = 0; i < n; ++i )
+			yNew_[i] = s[i] + h * k1_[i];
+		gslFunc( t + h, &yNew_[0], &k2_[0], this );
+		for ( unsigned int i = 0; i < n; ++i )
+			k2_[i] -= 2.0 * k1_[i];
+		if ( nv > 0 )
+			kj.solve( &lu_[0], &k2_[0] );
+
+		double err = 0.0;
+		for ( unsigned int i = 0; i < n; ++i ) {
+			yNew_[i] = s[i] + h * ( 1.5 * k1_[i] + 0.5 * k2_[i] );
+			double tol = epsAbs_ + epsRel_ * max( fabs( s[i] ), fabs( yNew_[i] ) );
+			double e = fabs( 0.5 * h * ( k1_[i] + k2_[i] ) ) / tol;
+			if ( e > err )
+				err = e;
+		}
+		double fac = ( err > 0.0 ) ? 0.9 / sqrt( err ) : 5.0;
+		fac = min( 5.0, max( 0.2, fac ) );
+		if ( err <= 1.0 ) {
+			copy( yNew_.begin(), yNew_.end(), s );
+			t += h;
+			// The Jacobian is now stale, but may still be reused.
+			isJacobianCurrent_ = false;
+			// Small increases in step are not worth a new factorisation.
+			if ( reuseJacobian_ && fac >= 1.0 && fac < 1.2 )
+				fac = 1.0;
+			if ( isTruncated )
+				h_ = max( h_, h * fac );
+			else
+				h_ = h * fac;
+		} else {
+			// Try again from the same point, with a fresh Jacobian.
+			h_ = h * fac;
+			haveJacobian = false;
+			if ( h_ < hMin )
+				break;
+		}
+	}
+	if ( tEnd - t > hMin ) {
+		cout << "Error: VoxelPools::advanceRosenbrock: step size underflow "
+			"at time " << t << "\n";
+		assert( 0 );
+	}
+}
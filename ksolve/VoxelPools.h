@@ -21,13 +21,91 @@ class VoxelPools: public VoxelPoolsBase
 		// Solver interface functions
 		//////////////////////////////////////////////////////////////////
 		void setStoich( const Stoich* stoich, const OdeSystem* ode );
+
+		/// Resets the pools to Sinit, and the integrator state.
+		void reinit();
+
 		void advance( const ProcInfo* p );
 
-		/// This is the function which evaluates the rates.
+		/**
+		 * Advances the pool numbers in s, rather than those held by
+		 * the VoxelPools. Used when the numbers are kept elsewhere,
+		 * as in a diffusion solver coupled to the Ksolve.
+		 */
+		void advance( const ProcInfo* p, double* s );
+
+		/**
+		 * This is the function which evaluates the rates. The params
+		 * argument is the VoxelPools.
+		 */
 		static int gslFunc( double t, const double* y, double *dydt, 
 						void* params );
 
+		/**
+		 * Dense Jacobian over all the pools, for the GSL implicit
+		 * methods, filled in from the sparse one of the Stoich.
+		 */
+		static int gslJacobian( double t, const double* y, double* dfdy,
+						double* dfdt, void* params );
+
+		/// Number of rate evaluations since the last reinit.
+		unsigned int getNumRateEvals() const;
+
+		/// Number of Jacobian evaluations since the last reinit.
+		unsigned int getNumJacobianEvals() const;
+
+		/// Also drops the Jacobian, which has the old scale in it.
+		void setRateScale( const vector< double >& scale );
+
 	private:
+		/**
+		 * Advances s from p->currTime - p->dt to p->currTime by the
+		 * second order, L-stable Rosenbrock method ROS2 of Verwer et
+		 * al., with its embedded first order solution for the step size
+		 * control. The linear systems use the sparse Jacobian of the
+		 * Stoich. ROS2 keeps its order with an inexact Jacobian, which
+		 * is what lets the Jacobian be reused across steps.
+		 */
+		void advanceRosenbrock( const ProcInfo* p, double* s );
+
+		/// The Stoich that computes the rates for this voxel.
+		const Stoich* stoichPtr_;
+
+		/**
+		 * Workspace for the reaction velocities, so that evaluating
+		 * the rates does not allocate. One per voxel so that voxels
+		 * can be advanced on different threads.
+		 */
+		vector< double > v_;
+
+		/// Integration settings, from the OdeSystem.
+		bool useRosenbrock_;
+		bool reuseJacobian_;
+		double initStepSize_;
+		double epsAbs_;
+		double epsRel_;
+
+		/// Rosenbrock step size, carried over from one advance to the next.
+		double h_;
+
+		/// Sparse Jacobian, and its LU factors for the step size luStep_.
+		vector< double > jac_;
+		vector< double > lu_;
+		double luStep_;
+
+		/// True if jac_ is up to date with the current pool numbers.
+		bool isJacobianCurrent_;
+
+		/// Rate version of the Stoich that jac_ was computed with.
+		unsigned int rateVersion_;
+
+		/// Rosenbrock workspace.
+		vector< double > k1_;
+		vector< double > k2_;
+		vector< double > yNew_;
+
+		unsigned int numRateEvals_;
+		unsigned int numJacobianEvals_;
 #ifdef USE_GSL
 		gsl_odeiv2_driver* driver_;
 		gsl_odeiv2_system sys_;
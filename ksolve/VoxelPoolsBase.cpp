@@ -105,3 +105,20 @@ double VoxelPoolsBase::getDiffConst( unsigned int i ) const
 		return 0;
 }
 
+void VoxelPoolsBase::setRateScale( const vector< double >& scale )
+{
+	rateScale_ = scale;
+}
+
+const vector< double >& VoxelPoolsBase::getRateScale() const
+{
+	return rateScale_;
+}
+
+const double* VoxelPoolsBase::rateScale() const
+{
+	if ( rateScale_.empty() )
+		return 0;
+	return &rateScale_[0];
+}
+
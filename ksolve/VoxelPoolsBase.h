@@ -70,6 +70,18 @@ class VoxelPoolsBase
 		void setDiffConst( unsigned int, double v );
 		double getDiffConst( unsigned int ) const;
 
+		/**
+		 * Assigns a factor for each rate term of the Stoich, by which
+		 * the reaction velocities in this voxel are multiplied. This
+		 * lets each voxel run a replica of the model with different
+		 * rates. An empty vector restores the rates of the Stoich.
+		 */
+		virtual void setRateScale( const vector< double >& scale );
+		const vector< double >& getRateScale() const;
+
+		/// Returns the rate scale factors, or 0 if there are none.
+		const double* rateScale() const;
+
 	private:
 		/**
 		 * 
@@ -95,6 +107,9 @@ class VoxelPoolsBase
 		 * molecules.
 		 */
 		vector< double > Sinit_;
+
+		/// Factor for each rate term in this voxel. Empty if none.
+		vector< double > rateScale_;
 };
 
 #endif	// _VOXEL_POOLS_BASE_H
@@ -11,6 +11,9 @@
 #include "ReacBase.h"
 #include "lookupVolumeFromMesh.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
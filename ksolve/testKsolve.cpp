@@ -9,10 +9,30 @@
 #include "header.h"
 #include "../shell/Shell.h"
 #include "RateTerm.h"
+#include "RateTable.h"
+#include "KinJacobian.h"
+#include "FuncTable.h"
 #include "FuncTerm.h"
+#include "SumTotalTerm.h"
 #include "SparseMatrix.h"
 #include "KinSparseMatrix.h"
 #include "Stoich.h"
+#include "../randnum/RandomStream.h"
+#include "PropensitySelector.h"
+#include "ThreadPool.h"
+#ifdef USE_GSL
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_odeiv2.h>
+#endif
+#include "OdeSystem.h"
+#include "VoxelPoolsBase.h"
+#include "VoxelPools.h"
+#include "ZombiePoolInterface.h"
+#include "../diffusion/DiffPoolVec.h"
+#include "../diffusion/DiffBatch.h"
+#include "../diffusion/Dsolve.h"
+#include "Ksolve.h"
 
 /**
  * Tab controlled by table
@@ -227,6 +247,177 @@ void testBuildStoich()
 	cout << "." << flush;
 }
 
+/**
+ * Checks that the flattened RateTable gives exactly the same reaction
+ * velocities as the RateTerms themselves.
+ */
+void testRateTable()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", 1 );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	// Change some rates after the build, to check the table follows.
+	Field< double >::set( Id( "/kinetics/r1" ), "Kb", 0.3 );
+	Field< double >::set( Id( "/kinetics/e2Pool/e2" ), "kcat", 2 );
+
+	const Stoich* sp = reinterpret_cast< const Stoich* >( 
+					stoich.eref().data() );
+	unsigned int n = sp->getNumAllPools();
+	vector< double > S( n );
+	for ( unsigned int i = 0; i < n; ++i )
+		S[i] = 1.0 + i * 0.37;
+	vector< double > v;
+	sp->updateReacVelocities( &S[0], v );
+	assert( v.size() == sp->getNumRates() );
+	for ( unsigned int i = 0; i < v.size(); ++i )
+		assert( v[i] == sp->getReacVelocity( i, &S[0] ) );
+
+	vector< double > yprime( n );
+	vector< double > yprime2( n );
+	vector< double > work;
+	sp->updateRates( &S[0], &yprime[0] );
+	sp->updateRates( &S[0], &yprime2[0], work );
+	assert( work.size() == sp->getNumRates() );
+	for ( unsigned int i = 0; i < n; ++i )
+		assert( yprime[i] == yprime2[i] );
+
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
+/**
+ * Checks that the flattened FuncTable gives exactly the same function
+ * pool values as the FuncTerms, including a function of a function.
+ */
+void testFuncTable()
+{
+	// S[3] = S[0] + S[1], then S[4] = S[3] + S[2] + S[0].
+	SumTotalTerm t0;
+	SumTotalTerm t1;
+	vector< unsigned int > mol( 2 );
+	mol[0] = 0;
+	mol[1] = 1;
+	t0.setReactants( mol );
+	mol[0] = 3;
+	mol[1] = 2;
+	mol.push_back( 0 );
+	t1.setReactants( mol );
+	vector< FuncTerm* > funcs( 2 );
+	funcs[0] = &t0;
+	funcs[1] = &t1;
+	FuncTable ft;
+	assert( ft.size() == 0 );
+	ft.build( funcs );
+	assert( ft.size() == 2 );
+	double S[5] = { 1.5, 2.25, 4.0, 0.0, 0.0 };
+	ft.compute( S, 0.0, S + 3 );
+	assert( S[3] == 3.75 );
+	assert( S[4] == 9.25 );
+
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", 1 );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+
+	const Stoich* sp = reinterpret_cast< const Stoich* >( 
+					stoich.eref().data() );
+	unsigned int n = sp->getNumAllPools();
+	unsigned int numFuncs = sp->getNumFuncs();
+	assert( numFuncs == 1 );
+	vector< double > S2( n );
+	for ( unsigned int i = 0; i < n; ++i )
+		S2[i] = 1.0 + i * 0.37;
+	vector< double > ref = S2;
+	sp->updateFuncs( &S2[0], 0.0 );
+	unsigned int j = sp->getNumVarPools() + sp->getNumBufPools();
+	for ( unsigned int i = 0; i < numFuncs; ++i )
+		ref[ j + i ] = (*sp->funcs( i ))( &ref[0], 0.0 );
+	for ( unsigned int i = 0; i < n; ++i )
+		assert( S2[i] == ref[i] );
+
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
+/**
+ * Checks the analytic Jacobian of the Stoich against finite differences
+ * of the rates, and the solution of I - scale * J against a dense
+ * multiply.
+ */
+void testKinJacobian()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", 1 );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+
+	const Stoich* sp = reinterpret_cast< const Stoich* >( 
+					stoich.eref().data() );
+	const KinJacobian& kj = sp->getJacobian();
+	unsigned int n = sp->getNumAllPools();
+	unsigned int nv = kj.size();
+	assert( nv == sp->getNumVarPools() );
+	assert( kj.rowStart().size() == nv + 1 );
+	vector< double > S( n );
+	for ( unsigned int i = 0; i < n; ++i )
+		S[i] = 100.0 + i * 37.0;
+	vector< double > jac( kj.numEntries() );
+	sp->updateJacobian( &S[0], &jac[0] );
+
+	vector< double > dense( nv * nv, 0.0 );
+	for ( unsigned int i = 0; i < nv; ++i )
+		for ( unsigned int e = kj.rowStart()[i]; e < kj.rowStart()[i+1]; ++e)
+			dense[ i * nv + kj.colIndex()[e] ] = jac[e];
+	vector< double > yp( n );
+	vector< double > ym( n );
+	for ( unsigned int j = 0; j < nv; ++j ) {
+		double delta = 1e-3 * S[j];
+		vector< double > Sp = S;
+		vector< double > Sm = S;
+		Sp[j] += delta;
+		Sm[j] -= delta;
+		sp->updateRates( &Sp[0], &yp[0] );
+		sp->updateRates( &Sm[0], &ym[0] );
+		for ( unsigned int i = 0; i < nv; ++i ) {
+			double fd = ( yp[i] - ym[i] ) / ( 2.0 * delta );
+			assert( fabs( fd - dense[ i * nv + j ] ) < 
+				1e-6 * ( 1.0 + fabs( fd ) ) );
+		}
+	}
+
+	double scale = 0.7;
+	vector< double > lu( kj.numEntries() );
+	bool ok = kj.factor( &jac[0], scale, &lu[0] );
+	assert( ok );
+	vector< double > b( nv );
+	for ( unsigned int i = 0; i < nv; ++i )
+		b[i] = sin( i + 1.0 );
+	vector< double > x = b;
+	kj.solve( &lu[0], &x[0] );
+	for ( unsigned int i = 0; i < nv; ++i ) {
+		double sum = x[i];
+		for ( unsigned int j = 0; j < nv; ++j )
+			sum -= scale * dense[ i * nv + j ] * x[j];
+		assert( doubleApprox( sum, b[i] ) );
+	}
+
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
 void testRunKsolve()
 {
 	double simDt = 0.1;
@@ -256,6 +447,330 @@ void testRunKsolve()
 	cout << "." << flush;
 }
 
+/**
+ * Stiff system, with a fast equilibrium feeding a slow reaction:
+ * A <===> B, kf = kb = 1000/sec
+ * B ---> C, kf = 0.1/sec
+ * Returns the final n of A, B and C, followed by the number of rate
+ * and Jacobian evaluations. With changeRates, it then goes on a step
+ * at a time, and checks that a reused Jacobian is made afresh when a
+ * rate or the rate scale is assigned. Without setEps the tolerances
+ * are left at the defaults of the method.
+ */
+static vector< double > runStiffKsolve( const string& method, bool reuse,
+	bool changeRates = false, bool setEps = true )
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	Id A = s->doCreate( "Pool", kin, "A", 1 );
+	Id B = s->doCreate( "Pool", kin, "B", 1 );
+	Id C = s->doCreate( "Pool", kin, "C", 1 );
+	Id r1 = s->doCreate( "Reac", kin, "r1", 1 );
+	Id r2 = s->doCreate( "Reac", kin, "r2", 1 );
+	s->doAddMsg( "Single", r1, "sub", A, "reac" );
+	s->doAddMsg( "Single", r1, "prd", B, "reac" );
+	s->doAddMsg( "Single", r2, "sub", B, "reac" );
+	s->doAddMsg( "Single", r2, "prd", C, "reac" );
+	Field< double >::set( A, "nInit", 1000 );
+	Field< double >::set( r1, "Kf", 1000 );
+	Field< double >::set( r1, "Kb", 1000 );
+	Field< double >::set( r2, "Kf", 0.1 );
+	Field< double >::set( r2, "Kb", 0 );
+
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< string >::set( ksolve, "method", method );
+	if ( setEps ) {
+		Field< double >::set( ksolve, "epsAbs", 1e-3 );
+		Field< double >::set( ksolve, "epsRel", 1e-6 );
+	}
+	Field< bool >::set( ksolve, "reuseJacobian", reuse );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	assert( Field< string >::get( ksolve, "method" ) == method );
+	s->doUseClock( "/kinetics/ksolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+	s->doStart( 10.0 );
+
+	vector< double > ret;
+	ret.push_back( Field< double >::get( A, "n" ) );
+	ret.push_back( Field< double >::get( B, "n" ) );
+	ret.push_back( Field< double >::get( C, "n" ) );
+	ret.push_back( Field< unsigned int >::get( ksolve, "numRateEvals" ) );
+	ret.push_back( Field< unsigned int >::get( ksolve, "numJacobianEvals"));
+
+	if ( changeRates ) {
+		vector< unsigned int > evals;
+		evals.push_back( ret[4] );
+		for ( unsigned int i = 0; i < 3; ++i ) {
+			if ( i == 1 ) {
+				Field< double >::set( r2, "Kf", 0.101 );
+			} else if ( i == 2 ) {
+				unsigned int numRates = 
+					Field< unsigned int >::get( stoich, "numRates" );
+				LookupField< unsigned int, vector< double > >::set( 
+					ksolve, "rateScale", 0, 
+					vector< double >( numRates, 1.5 ) );
+			}
+			s->doStart( 0.1 );
+			evals.push_back( 
+				Field< unsigned int >::get( ksolve, "numJacobianEvals"));
+		}
+		// The change in Kf is too small to fail a step, which would
+		// also bring in a new Jacobian.
+		assert( evals[1] == evals[0] );
+		assert( evals[2] > evals[1] );
+		assert( evals[3] > evals[2] );
+	}
+	s->doDelete( kin );
+	return ret;
+}
+
+/**
+ * The rosenbrock method should agree with the reference rk5 on the
+ * stiff system, with far fewer rate evaluations, and with fewer still
+ * Jacobian evaluations when they are reused.
+ */
+void testRosenbrock()
+{
+	vector< double > rk5 = runStiffKsolve( "rk5", false );
+	vector< double > ros = runStiffKsolve( "rosenbrock", false );
+	vector< double > reuse = runStiffKsolve( "rosenbrock", true );
+	// B -> C at half of 0.1/sec, from the fast equilibrium.
+	double nC = 1000.0 * ( 1.0 - exp( -0.05 * 10.0 ) );
+	for ( unsigned int i = 0; i < 3; ++i ) {
+		assert( fabs( ros[i] - rk5[i] ) < 1.0 );
+		assert( fabs( reuse[i] - rk5[i] ) < 1.0 );
+	}
+	assert( fabs( ros[2] - nC ) < 1.0 );
+	assert( fabs( ros[0] + ros[1] + ros[2] - 1000.0 ) < 1e-6 );
+	assert( ros[3] * 10 < rk5[3] );
+	assert( rk5[4] == 0 );
+	assert( reuse[4] * 10 < ros[4] );
+	runStiffKsolve( "rosenbrock", true, true );
+
+	// The default tolerance of rosenbrock must still hold the step
+	// below the clock dt through the fast transient, and not just take
+	// two evaluations per clock step.
+	vector< double > dflt = runStiffKsolve( "rosenbrock", false, false,
+		false );
+	for ( unsigned int i = 0; i < 3; ++i )
+		assert( fabs( dflt[i] - rk5[i] ) < 1.0 );
+	assert( dflt[3] > 2 * 100 );
+	cout << "." << flush;
+}
+
+/**
+ * Runs the reac test in many voxels, each started from a different
+ * state, and returns the final pool numbers of all voxels.
+ */
+static vector< double > runMultiVoxelKsolve( unsigned int numThreads )
+{
+	double simDt = 0.1;
+	unsigned int numVoxels = 11;
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", numVoxels );
+	Field< unsigned int >::set( ksolve, "numThreads", numThreads );
+	assert( Field< unsigned int >::get( ksolve, "numThreads" ) == 
+					numThreads );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/ksolve", "process", 4 ); 
+	s->doSetClock( 4, simDt );
+
+	s->doReinit();
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							ksolve, "nVec", 0 );
+		for ( unsigned int j = 0; j < nVec.size(); ++j )
+			nVec[j] *= 1.0 + i * 0.1;
+		LookupField< unsigned int, vector< double > >::set(
+							ksolve, "nVec", i, nVec );
+	}
+	s->doStart( 20.0 );
+	vector< double > ret;
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							ksolve, "nVec", i );
+		ret.insert( ret.end(), nVec.begin(), nVec.end() );
+	}
+	s->doDelete( kin );
+	return ret;
+}
+
+void testRunKsolveThreads()
+{
+	vector< double > serial = runMultiVoxelKsolve( 1 );
+	vector< double > threaded = runMultiVoxelKsolve( 4 );
+	assert( serial.size() == threaded.size() );
+	// Each voxel is integrated independently, so the results must be
+	// bitwise identical.
+	for ( unsigned int i = 0; i < serial.size(); ++i )
+		assert( serial[i] == threaded[i] );
+	cout << "." << flush;
+}
+
+/**
+ * Runs the reac test in a row of voxels, each started from a different
+ * state. If there is diffusion, it is coupled to the Ksolve through a
+ * Dsolve on a cylinder with the same number of voxels.
+ */
+static vector< double > runReacDiff( unsigned int numThreads,
+	bool doDiffusion, double simDt )
+{
+	unsigned int numVoxels = 11;
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	// The table steps T once per tick, which is only first order in dt.
+	s->doDelete( Id( "/kinetics/tab" ) );
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", numVoxels );
+	Field< unsigned int >::set( ksolve, "numThreads", numThreads );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+
+	Id dsolve;
+	if ( doDiffusion ) {
+		Id cyl = s->doCreate( "CylMesh", kin, "cyl", 1 );
+		Field< double >::set( cyl, "r0", 1e-6 );
+		Field< double >::set( cyl, "r1", 1e-6 );
+		Field< double >::set( cyl, "x0", 0 );
+		Field< double >::set( cyl, "x1", numVoxels * 1e-6 );
+		Field< double >::set( cyl, "lambda", 1e-6 );
+		dsolve = s->doCreate( "Dsolve", kin, "dsolve", 1 );
+		Field< Id >::set( dsolve, "compartment", cyl );
+		Field< Id >::set( dsolve, "stoich", stoich );
+		Field< Id >::set( ksolve, "dsolve", dsolve );
+		assert( Field< Id >::get( ksolve, "dsolve" ) == dsolve );
+	}
+	s->doUseClock( "/kinetics/ksolve", "process", 4 ); 
+	s->doSetClock( 4, simDt );
+
+	s->doReinit();
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							ksolve, "nVec", 0 );
+		for ( unsigned int j = 0; j < nVec.size(); ++j )
+			nVec[j] *= 1.0 + i * 0.1;
+		LookupField< unsigned int, vector< double > >::set(
+							ksolve, "nVec", i, nVec );
+	}
+	s->doStart( 20.0 );
+	vector< double > ret;
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							ksolve, "nVec", i );
+		ret.insert( ret.end(), nVec.begin(), nVec.end() );
+	}
+
+	// The views work on the numbers in place.
+	Ksolve* kp = reinterpret_cast< Ksolve* >( ksolve.eref().data() );
+	unsigned int size = 0;
+	double* view = kp->getNvecView( numVoxels - 1, size );
+	assert( size > 0 && equal( view, view + size, ret.end() - size ) );
+	view[0] += 1.0;
+	vector< double > changed = 
+		LookupField< unsigned int, vector< double > >::get(
+						ksolve, "nVec", numVoxels - 1 );
+	assert( changed[0] == view[0] );
+	view[0] -= 1.0;
+	assert( kp->getNvecView( numVoxels, size ) == 0 && size == 0 );
+	if ( doDiffusion ) {
+		Dsolve* dp = reinterpret_cast< Dsolve* >( dsolve.eref().data() );
+		unsigned int stride = 0;
+		unsigned int numPools = 
+			Field< unsigned int >::get( dsolve, "numPools" );
+		assert( numPools > 0 );
+		for ( unsigned int i = 0; i < numPools; ++i ) {
+			view = dp->getNvecView( i, size, stride );
+			vector< double > nVec = 
+				LookupField< unsigned int, vector< double > >::get(
+							dsolve, "nVec", i );
+			assert( size == numVoxels && nVec.size() == size );
+			for ( unsigned int j = 0; j < size; ++j )
+				assert( view[ j * stride ] == nVec[j] );
+		}
+	}
+
+	if ( doDiffusion ) {
+		// Uncoupling hands the pool numbers back to the Ksolve.
+		Field< Id >::set( ksolve, "dsolve", Id() );
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							ksolve, "nVec", numVoxels - 1 );
+		assert( equal( nVec.begin(), nVec.end(), 
+			ret.end() - nVec.size() ) );
+
+		// Deleting a coupled Ksolve lets the Dsolve run on its own.
+		// The zombie pools still refer to the Ksolve, so the model
+		// cannot be run after this.
+		Field< Id >::set( ksolve, "dsolve", dsolve );
+		s->doReinit();
+		Dsolve* dp = reinterpret_cast< Dsolve* >( dsolve.eref().data() );
+		assert( dp->isCoupled() );
+		s->doDelete( ksolve );
+		assert( !dp->isCoupled() );
+	}
+	s->doDelete( kin );
+	return ret;
+}
+
+/// Sum over pools of the range of n across voxels.
+static double voxelSpread( const vector< double >& n, unsigned int numPools )
+{
+	double ret = 0.0;
+	for ( unsigned int j = 0; j < numPools; ++j ) {
+		double lo = n[j];
+		double hi = n[j];
+		for ( unsigned int i = j; i < n.size(); i += numPools ) {
+			lo = min( lo, n[i] );
+			hi = max( hi, n[i] );
+		}
+		ret += hi - lo;
+	}
+	return ret;
+}
+
+void testReacDiff()
+{
+	vector< double > reac = runReacDiff( 1, false, 0.1 );
+	vector< double > serial = runReacDiff( 1, true, 0.1 );
+	vector< double > threaded = runReacDiff( 4, true, 0.1 );
+	vector< double > coarse = runReacDiff( 1, true, 0.2 );
+	vector< double > fine = runReacDiff( 1, true, 0.01 );
+	assert( serial.size() == reac.size() );
+	assert( serial.size() == threaded.size() );
+	// The reaction step works on each voxel independently.
+	for ( unsigned int i = 0; i < serial.size(); ++i )
+		assert( serial[i] == threaded[i] );
+	// Diffusion evens out the voxels.
+	unsigned int numPools = serial.size() / 11;
+	assert( voxelSpread( serial, numPools ) < 
+		0.5 * voxelSpread( reac, numPools ) );
+	// Strang splitting is second order: doubling dt gives 4x the error.
+	double err = 0.0;
+	double coarseErr = 0.0;
+	for ( unsigned int i = 0; i < serial.size(); ++i ) {
+		err += ( serial[i] - fine[i] ) * ( serial[i] - fine[i] );
+		coarseErr += ( coarse[i] - fine[i] ) * ( coarse[i] - fine[i] );
+	}
+	assert( coarseErr > 3.0 * 3.0 * err );
+	cout << "." << flush;
+}
+
 void testRunGsolve()
 {
 	double simDt = 0.1;
@@ -300,12 +815,473 @@ void testRunGsolve()
 	cout << "." << flush;
 }
 
+/**
+ * Checks that all the methods of picking reactions keep the right total
+ * through lots of updates, and pick in proportion to the propensity.
+ */
+void testPropensitySelector()
+{
+	const unsigned int numReac = 37;
+	const unsigned int numPicks = 200000;
+	PropensitySelector::Method methods[] = {
+		PropensitySelector::LINEAR,
+		PropensitySelector::TREE,
+		PropensitySelector::COMPOSITION_REJECTION
+	};
+	for ( unsigned int m = 0; m < 3; ++m ) {
+		RandomStream rng( 4321, m );
+		PropensitySelector ps;
+		ps.setSize( numReac );
+		ps.setMethod( methods[m] );
+		assert( ps.getMethod() == methods[m] );
+		assert( ps.size() == numReac );
+		assert( ps.total() == 0.0 );
+		// Scatter values over many orders of magnitude, with some zeros.
+		for ( unsigned int i = 0; i < 300000; ++i ) {
+			unsigned int j = rng.genInt32() % numReac;
+			double a = ( j % 5 == 0 ) ? 0.0 : 
+					exp( 20.0 * ( rng.uniform() - 0.5 ) );
+			ps.update( j, a );
+		}
+		vector< double > v = ps.propensities();
+		double tot = 0.0;
+		for ( unsigned int i = 0; i < numReac; ++i )
+			tot += v[i];
+		assert( doubleEq( ps.total(), tot ) );
+
+		// Now keep just a few comparable values, and check the picks.
+		for ( unsigned int i = 0; i < numReac; ++i )
+			ps.update( i, ( i % 7 == 3 ) ? 1.0 + i * 0.1 : 0.0 );
+		v = ps.propensities();
+		tot = 0.0;
+		for ( unsigned int i = 0; i < numReac; ++i )
+			tot += v[i];
+		assert( doubleEq( ps.total(), tot ) );
+		vector< unsigned int > count( numReac + 1, 0 );
+		for ( unsigned int i = 0; i < numPicks; ++i )
+			count[ ps.pick( rng ) ]++;
+		for ( unsigned int i = 0; i < numReac; ++i ) {
+			double expected = numPicks * v[i] / tot;
+			if ( v[i] == 0.0 )
+				assert( count[i] == 0 );
+			else
+				assert( fabs( count[i] - expected ) < 0.05 * expected );
+		}
+	}
+	cout << "." << flush;
+}
+
+/**
+ * Runs the Gsolve with each method of picking reactions, to check they
+ * all handle the full reac system.
+ */
+void testGsolveMethods()
+{
+	const char* methods[] = { "linear", "tree", "cr" };
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	for ( unsigned int m = 0; m < 3; ++m ) {
+		Id kin = makeReacTest();
+		Field< double >::set( kin, "volume", 1e-21 );
+		Id gsolve = s->doCreate( "Gsolve", kin, "gsolve", 1 );
+		Id stoich = s->doCreate( "Stoich", gsolve, "stoich", 1 );
+		Field< unsigned int >::set( gsolve, "numAllVoxels", 1 );
+		Field< Id >::set( stoich, "poolInterface", gsolve );
+		Field< Id >::set( gsolve, "stoich", stoich );
+		Field< string >::set( gsolve, "method", methods[m] );
+		assert( Field< string >::get( gsolve, "method" ) == methods[m] );
+		Field< string >::set( stoich, "path", "/kinetics/##" );
+		s->doUseClock( "/kinetics/gsolve", "process", 4 ); 
+		s->doSetClock( 4, 0.1 );
+		s->doReinit();
+		s->doStart( 20.0 );
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							gsolve, "nVec", 0 );
+		for ( unsigned int i = 0; i < nVec.size(); ++i )
+			assert( nVec[i] >= 0.0 );
+		s->doDelete( kin );
+	}
+	cout << "." << flush;
+}
+
+/**
+ * Runs the Gsolve with the specified number of voxels, seed and
+ * threads, and returns the pool numbers of all voxels.
+ */
+static vector< double > runMultiVoxelGsolve( unsigned int numVoxels,
+				long seed, unsigned int numThreads = 1 )
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Field< double >::set( kin, "volume", 1e-21 );
+	Id gsolve = s->doCreate( "Gsolve", kin, "gsolve", 1 );
+	Id stoich = s->doCreate( "Stoich", gsolve, "stoich", 1 );
+	Field< unsigned int >::set( gsolve, "numAllVoxels", numVoxels );
+	Field< Id >::set( stoich, "poolInterface", gsolve );
+	Field< Id >::set( gsolve, "stoich", stoich );
+	Field< long >::set( gsolve, "seed", seed );
+	assert( Field< long >::get( gsolve, "seed" ) == seed );
+	Field< unsigned int >::set( gsolve, "numThreads", numThreads );
+	assert( Field< unsigned int >::get( gsolve, "numThreads" ) == 
+					numThreads );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/gsolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+	s->doStart( 20.0 );
+	vector< double > ret;
+	for ( unsigned int i = 0; i < numVoxels; ++i ) {
+		vector< double > nVec = 
+			LookupField< unsigned int, vector< double > >::get(
+							gsolve, "nVec", i );
+		ret.insert( ret.end(), nVec.begin(), nVec.end() );
+	}
+	s->doDelete( kin );
+	return ret;
+}
+
+/**
+ * Checks that each Gsolve voxel has its own reproducible random
+ * number stream, so that a voxel gives the same result no matter how
+ * many other voxels there are.
+ */
+void testGsolveSeed()
+{
+	vector< double > one = runMultiVoxelGsolve( 1, 1234 );
+	vector< double > three = runMultiVoxelGsolve( 3, 1234 );
+	vector< double > again = runMultiVoxelGsolve( 3, 1234 );
+	vector< double > other = runMultiVoxelGsolve( 1, 4321 );
+	assert( three.size() == 3 * one.size() );
+	assert( again == three );
+	bool differs = false;
+	for ( unsigned int i = 0; i < one.size(); ++i ) {
+		assert( one[i] == three[i] );
+		differs |= ( one[i] != other[i] );
+	}
+	assert( differs );
+	cout << "." << flush;
+}
+
+/**
+ * A pool number assigned between runs must reach the propensities, or
+ * a Gsolve that had nothing to do stays stuck.
+ */
+void testGsolveSetN()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	Id A = s->doCreate( "Pool", kin, "A", 1 );
+	Id B = s->doCreate( "Pool", kin, "B", 1 );
+	Id r1 = s->doCreate( "Reac", kin, "r1", 1 );
+	s->doAddMsg( "Single", r1, "sub", A, "reac" );
+	s->doAddMsg( "Single", r1, "prd", B, "reac" );
+	Field< double >::set( r1, "Kf", 1 );
+	Field< double >::set( r1, "Kb", 0 );
+
+	Id gsolve = s->doCreate( "Gsolve", kin, "gsolve", 1 );
+	Id stoich = s->doCreate( "Stoich", gsolve, "stoich", 1 );
+	Field< Id >::set( stoich, "poolInterface", gsolve );
+	Field< Id >::set( gsolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/gsolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+	s->doStart( 1.0 );
+	assert( Field< double >::get( B, "n" ) == 0.0 );
+
+	Field< double >::set( A, "n", 100 );
+	s->doStart( 10.0 );
+	double nA = Field< double >::get( A, "n" );
+	double nB = Field< double >::get( B, "n" );
+	assert( nB > 50.0 );
+	assert( doubleEq( nA + nB, 100.0 ) );
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
+void testRunGsolveThreads()
+{
+	vector< double > serial = runMultiVoxelGsolve( 7, 5678, 1 );
+	vector< double > threaded = runMultiVoxelGsolve( 7, 5678, 3 );
+	// Each voxel has its own random numbers, so the results must be
+	// identical.
+	assert( serial == threaded );
+	cout << "." << flush;
+}
+
+/**
+ * Runs replicas of the reac test side by side, one per voxel, with
+ * different rate scales. A replica with all its rates scaled by two
+ * must follow the unscaled one at twice the speed, and one with its
+ * rates scaled by zero must not move, in the Ksolve and the Gsolve.
+ */
+void testRateScale()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	s->doDelete( Id( "/kinetics/tab" ) );
+	Field< double >::set( Id( "/kinetics/T" ), "concInit", 1 );
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< unsigned int >::set( ksolve, "numAllVoxels", 3 );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	Field< string >::set( ksolve, "method", "rosenbrock" );
+	Field< double >::set( ksolve, "epsRel", 1e-8 );
+	Field< double >::set( ksolve, "epsAbs", 1e-8 );
+
+	unsigned int numRates = Field< unsigned int >::get( stoich, "numRates" );
+	unsigned int r2 = LookupField< Id, unsigned int >::get( 
+					stoich, "rateIndex", Id( "/kinetics/r2" ) );
+	assert( r2 < numRates );
+	unsigned int notReac = LookupField< Id, unsigned int >::get( 
+					stoich, "rateIndex", Id( "/kinetics/A" ) );
+	assert( notReac == ~0U );
+	LookupField< unsigned int, vector< double > >::set( ksolve, 
+					"rateScale", 1, vector< double >( numRates, 2.0 ) );
+	LookupField< unsigned int, vector< double > >::set( ksolve, 
+					"rateScale", 2, vector< double >( numRates, 0.0 ) );
+	vector< double > scale = LookupField< unsigned int, vector< double > >
+			::get( ksolve, "rateScale", 0 );
+	assert( scale.size() == 0 );
+	scale = LookupField< unsigned int, vector< double > >::get( 
+					ksolve, "rateScale", 1 );
+	assert( scale.size() == numRates && scale[ r2 ] == 2.0 );
+
+	s->doUseClock( "/kinetics/ksolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+	// The pools only set up the first voxel.
+	vector< double > init = LookupField< unsigned int, vector< double > >::
+			get( ksolve, "nVec", 0 );
+	for ( unsigned int i = 1; i < 3; ++i )
+		LookupField< unsigned int, vector< double > >::set( 
+						ksolve, "nVec", i, init );
+	s->doStart( 5.0 );
+	vector< double > fast = LookupField< unsigned int, vector< double > >::
+			get( ksolve, "nVec", 1 );
+	s->doStart( 5.0 );
+	vector< double > slow = LookupField< unsigned int, vector< double > >::
+			get( ksolve, "nVec", 0 );
+	vector< double > stopped = LookupField< unsigned int, vector< double > >
+			::get( ksolve, "nVec", 2 );
+	assert( fast.size() == slow.size() );
+	for ( unsigned int i = 0; i < fast.size(); ++i )
+		assert( doubleApprox( fast[i], slow[i] ) );
+	assert( !doubleApprox( slow[2], init[2] ) );
+	// The function pools are only computed once it runs.
+	unsigned int numVarPools = 
+			Field< unsigned int >::get( stoich, "numVarPools" );
+	for ( unsigned int i = 0; i < numVarPools; ++i )
+		assert( stopped[i] == init[i] );
+	s->doDelete( kin );
+
+	kin = makeReacTest();
+	Field< double >::set( kin, "volume", 1e-21 );
+	Id gsolve = s->doCreate( "Gsolve", kin, "gsolve", 1 );
+	stoich = s->doCreate( "Stoich", gsolve, "stoich", 1 );
+	Field< unsigned int >::set( gsolve, "numAllVoxels", 2 );
+	Field< Id >::set( stoich, "poolInterface", gsolve );
+	Field< Id >::set( gsolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	numRates = Field< unsigned int >::get( stoich, "numRates" );
+	LookupField< unsigned int, vector< double > >::set( gsolve, 
+					"rateScale", 1, vector< double >( numRates, 0.0 ) );
+	s->doUseClock( "/kinetics/gsolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+	init = LookupField< unsigned int, vector< double > >::get( 
+					gsolve, "nVec", 0 );
+	LookupField< unsigned int, vector< double > >::set( 
+					gsolve, "nVec", 1, init );
+	s->doStart( 20.0 );
+	stopped = LookupField< unsigned int, vector< double > >::get( 
+					gsolve, "nVec", 1 );
+	vector< double > moving = LookupField< unsigned int, vector< double > >::get( 
+					gsolve, "nVec", 0 );
+	numVarPools = Field< unsigned int >::get( stoich, "numVarPools" );
+	assert( equal( init.begin(), init.begin() + numVarPools, 
+					stopped.begin() ) );
+	assert( !equal( init.begin(), init.begin() + numVarPools, 
+					moving.begin() ) );
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
+/**
+ * Scans the steady state of A + X <===> B over the concentration of
+ * the buffered pool X, with one and with several threads. At each
+ * point B/A = Kf.X/Kb, and the nonzero eigenvalue is -( Kf.X + Kb ).
+ */
+void testSteadyStateScan()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = s->doCreate( "CubeMesh", Id(), "kinetics", 1 );
+	Id A = s->doCreate( "Pool", kin, "A", 1 );
+	Id B = s->doCreate( "Pool", kin, "B", 1 );
+	Id X = s->doCreate( "BufPool", kin, "X", 1 );
+	Id r1 = s->doCreate( "Reac", kin, "r1", 1 );
+	s->doAddMsg( "Single", r1, "sub", A, "reac" );
+	s->doAddMsg( "Single", r1, "sub", X, "reac" );
+	s->doAddMsg( "Single", r1, "prd", B, "reac" );
+	double Kf = 0.5;
+	double Kb = 0.2;
+	Field< double >::set( A, "concInit", 1 );
+	Field< double >::set( X, "concInit", 1 );
+	Field< double >::set( r1, "Kf", Kf );
+	Field< double >::set( r1, "Kb", Kb );
+
+	Id ksolve = s->doCreate( "Ksolve", kin, "ksolve", 1 );
+	Id stoich = s->doCreate( "Stoich", ksolve, "stoich", 1 );
+	Field< Id >::set( stoich, "poolInterface", ksolve );
+	Field< Id >::set( ksolve, "stoich", stoich );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/ksolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	s->doReinit();
+
+	Id ss = s->doCreate( "SteadyState", kin, "ss", 1 );
+	Field< Id >::set( ss, "stoich", stoich );
+	Field< Id >::set( ss, "scanPool", X );
+	Field< double >::set( ss, "scanStart", 0.1 );
+	Field< double >::set( ss, "scanEnd", 2.0 );
+	Field< unsigned int >::set( ss, "numScanPoints", 20 );
+	vector< vector< double > > single;
+	for ( unsigned int numThreads = 1; numThreads < 4; numThreads += 2 ) {
+		Field< unsigned int >::set( ss, "numThreads", numThreads );
+		SetGet0::set( ss, "scan" );
+		vector< double > x = Field< vector< double > >::get( 
+						ss, "scanValues" );
+		vector< unsigned int > stateType = 
+			Field< vector< unsigned int > >::get( ss, "scanStateType" );
+		vector< unsigned int > status = 
+			Field< vector< unsigned int > >::get( ss, "scanSolutionStatus");
+		assert( x.size() == 20 );
+		assert( doubleEq( x[0], 0.1 ) && doubleEq( x[19], 2.0 ) );
+		for ( unsigned int k = 0; k < x.size(); ++k ) {
+			assert( status[k] == 0 );
+			assert( stateType[k] == 0 );
+			vector< double > nVec = LookupField< unsigned int, 
+				vector< double > >::get( ss, "scanNvec", k );
+			vector< double > eig = LookupField< unsigned int, 
+				vector< double > >::get( ss, "scanEigenvalues", k );
+			assert( nVec.size() == 2 && eig.size() == 2 );
+			// Pool order in the stoich is not known here, but the
+			// product/substrate ratio is either Kf.X/Kb or its inverse.
+			double ratio = Kf * x[k] / Kb;
+			assert( doubleApprox( nVec[1] / nVec[0], ratio ) || 
+				doubleApprox( nVec[0] / nVec[1], ratio ) );
+			double lambda = -( Kf * x[k] + Kb );
+			assert( doubleApprox( eig[0], lambda ) || 
+				doubleApprox( eig[1], lambda ) );
+			if ( numThreads == 1 )
+				single.push_back( nVec );
+			else 
+				assert( doubleApprox( nVec[0], single[k][0] ) );
+		}
+	}
+	s->doDelete( kin );
+	cout << "." << flush;
+}
+
+/// Makes the reac test model on a Gsolve with numVoxels voxels.
+static Id makeCheckpointModel( unsigned int numVoxels )
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id kin = makeReacTest();
+	Field< double >::set( kin, "volume", 1e-21 );
+	Id gsolve = s->doCreate( "Gsolve", kin, "gsolve", 1 );
+	Id stoich = s->doCreate( "Stoich", gsolve, "stoich", 1 );
+	Field< unsigned int >::set( gsolve, "numAllVoxels", numVoxels );
+	Field< Id >::set( stoich, "poolInterface", gsolve );
+	Field< Id >::set( gsolve, "stoich", stoich );
+	Field< string >::set( gsolve, "method", "tree" );
+	Field< string >::set( stoich, "path", "/kinetics/##" );
+	s->doUseClock( "/kinetics/gsolve", "process", 4 ); 
+	s->doSetClock( 4, 0.1 );
+	return kin;
+}
+
+/**
+ * Runs a stochastic model, saves a checkpoint, and runs on. The run
+ * restored from the checkpoint must give exactly the same numbers and
+ * plots. The tree method is used as its sums do not depend on the
+ * order of updates.
+ */
+void testCheckpoint()
+{
+	Shell* s = reinterpret_cast< Shell* >( Id().eref().data() );
+	const string fname = "testCheckpoint.bin";
+	Id kin = makeCheckpointModel( 2 );
+	Id gsolve( "/kinetics/gsolve" );
+	s->doReinit();
+	s->doStart( 5.0 );
+	Id plots( "/kinetics/plots" );
+	unsigned int plotSize = Field< vector< double > >::get(
+		ObjId( plots, 1 ), "vector" ).size();
+	assert( plotSize > 0 );
+	assert( s->doSaveCheckpoint( kin, fname ) );
+
+	s->doStart( 5.0 );
+	vector< double > nVec = LookupField< unsigned int,
+		vector< double > >::get( gsolve, "nVec", 1 );
+	vector< double > plot = Field< vector< double > >::get(
+		ObjId( plots, 1 ), "vector" );
+	assert( plot.size() > plotSize );
+
+	s->doReinit();
+	assert( s->doRestoreCheckpoint( kin, fname ) );
+	assert( doubleEq( Field< double >::get( Id( 1 ), "currentTime" ), 5.0 ));
+	assert( Field< vector< double > >::get( ObjId( plots, 1 ), "vector" ).
+		size() == plotSize );
+	s->doStart( 5.0 );
+	vector< double > restored = LookupField< unsigned int,
+		vector< double > >::get( gsolve, "nVec", 1 );
+	assert( restored == nVec );
+	assert( Field< vector< double > >::get( ObjId( plots, 1 ), "vector" )
+		== plot );
+
+	// A different model is refused, and left alone.
+	s->doDelete( kin );
+	kin = makeReacTest();
+	s->doCreate( "Pool", kin, "extra", 1 );
+	s->doReinit();
+	assert( !s->doRestoreCheckpoint( kin, fname ) );
+	assert( doubleEq( Field< double >::get( Id( 1 ), "currentTime" ), 0.0 ));
+	s->doDelete( kin );
+
+	// So is one with the same tree but another number of voxels, whose
+	// solver state does not fit. The clock must not move.
+	kin = makeCheckpointModel( 3 );
+	s->doReinit();
+	assert( !s->doRestoreCheckpoint( kin, fname ) );
+	assert( doubleEq( Field< double >::get( Id( 1 ), "currentTime" ), 0.0 ));
+	s->doDelete( kin );
+	remove( fname.c_str() );
+	cout << "." << flush;
+}
+
 void testKsolve()
 {
 	testSetupReac();
 	testBuildStoich();
+	testRateTable();
+	testFuncTable();
+	testKinJacobian();
 	testRunKsolve();
+	testRosenbrock();
+	testRunKsolveThreads();
+	testReacDiff();
 	testRunGsolve();
+	testPropensitySelector();
+	testGsolveMethods();
+	testGsolveSeed();
+	testGsolveSetN();
+	testRunGsolveThreads();
+	testRateScale();
+	testSteadyStateScan();
+	testCheckpoint();
 }
 
 void testKsolveProcess()
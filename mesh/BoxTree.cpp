@@ -0,0 +1,191 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "header.h"
+#include "BoxTree.h"
+
+/// Largest number of items kept in a leaf.
+static const unsigned int LEAF_SIZE = 4;
+
+/// Orders positions in the boxes by the centre of the box along an axis.
+class BoxCentreLess
+{
+	public:
+		BoxCentreLess( const vector< double >& boxes, unsigned int axis )
+			: boxes_( boxes ), axis_( axis )
+		{;}
+
+		bool operator()( unsigned int a, unsigned int b ) const
+		{
+			return boxes_[ a * 6 + axis_ ] + boxes_[ a * 6 + axis_ + 3 ] <
+				boxes_[ b * 6 + axis_ ] + boxes_[ b * 6 + axis_ + 3 ];
+		}
+
+	private:
+		const vector< double >& boxes_;
+		unsigned int axis_;
+};
+
+BoxTree::BoxTree()
+{;}
+
+void BoxTree::build( const vector< unsigned int >& items,
+	const vector< double >& boxes )
+{
+	assert( boxes.size() == items.size() * 6 );
+	items_ = items;
+	boxes_ = boxes;
+	order_.resize( items.size() );
+	for ( unsigned int i = 0; i < order_.size(); ++i )
+		order_[i] = i;
+	nodes_.clear();
+	if ( items.size() > 0 )
+		buildNode( 0, items.size() );
+}
+
+unsigned int BoxTree::size() const
+{
+	return items_.size();
+}
+
+unsigned int BoxTree::buildNode( unsigned int begin, unsigned int end )
+{
+	unsigned int n = nodes_.size();
+	nodes_.push_back( Node() );
+	double box[6];
+	double lo[3];
+	double hi[3];
+	for ( unsigned int j = 0; j < 3; ++j ) {
+		box[j] = lo[j] = 1e300;
+		box[j + 3] = hi[j] = -1e300;
+	}
+	for ( unsigned int k = begin; k < end; ++k ) {
+		const double* b = &boxes_[ order_[k] * 6 ];
+		for ( unsigned int j = 0; j < 3; ++j ) {
+			double centre = 0.5 * ( b[j] + b[j + 3] );
+			box[j] = min( box[j], b[j] );
+			box[j + 3] = max( box[j + 3], b[j + 3] );
+			lo[j] = min( lo[j], centre );
+			hi[j] = max( hi[j], centre );
+		}
+	}
+	for ( unsigned int j = 0; j < 6; ++j )
+		nodes_[n].box[j] = box[j];
+	nodes_[n].begin = begin;
+	nodes_[n].end = end;
+	nodes_[n].left = nodes_[n].right = 0;
+	if ( end - begin <= LEAF_SIZE )
+		return n;
+
+	// Split at the median of the box centres along the longest side.
+	unsigned int axis = 0;
+	for ( unsigned int j = 1; j < 3; ++j )
+		if ( hi[j] - lo[j] > hi[axis] - lo[axis] )
+			axis = j;
+	unsigned int mid = ( begin + end ) / 2;
+	nth_element( order_.begin() + begin, order_.begin() + mid,
+		order_.begin() + end, BoxCentreLess( boxes_, axis ) );
+	unsigned int left = buildNode( begin, mid );
+	unsigned int right = buildNode( mid, end );
+	nodes_[n].left = left;
+	nodes_[n].right = right;
+	return n;
+}
+
+double BoxTree::boxDistance( unsigned int n, double x, double y, double z )
+	const
+{
+	const double* b = nodes_[n].box;
+	double p[3] = { x, y, z };
+	double sum = 0.0;
+	for ( unsigned int j = 0; j < 3; ++j ) {
+		double d = 0.0;
+		if ( p[j] < b[j] )
+			d = b[j] - p[j];
+		else if ( p[j] > b[j + 3] )
+			d = p[j] - b[j + 3];
+		sum += d * d;
+	}
+	return sqrt( sum );
+}
+
+double BoxTree::nearest( double x, double y, double z,
+	const ItemDistance& dist, unsigned int& item ) const
+{
+	double best = -1.0;
+	unsigned int bestItem = 0;
+	if ( nodes_.size() == 0 )
+		return best;
+	vector< unsigned int > stack( 1, 0 );
+	while ( stack.size() > 0 ) {
+		unsigned int n = stack.back();
+		stack.pop_back();
+		// Ties are still visited, to pick the smaller item index.
+		if ( best >= 0.0 && boxDistance( n, x, y, z ) > best )
+			continue;
+		const Node& node = nodes_[n];
+		if ( node.left == 0 ) {
+			for ( unsigned int k = node.begin; k < node.end; ++k ) {
+				unsigned int i = items_[ order_[k] ];
+				double d = dist( i );
+				if ( d < 0.0 )
+					continue;
+				if ( best < 0.0 || d < best ||
+						( d == best && i < bestItem ) ) {
+					best = d;
+					bestItem = i;
+				}
+			}
+		} else { // Push the nearer child last, so it is searched first.
+			if ( boxDistance( node.left, x, y, z ) <
+					boxDistance( node.right, x, y, z ) ) {
+				stack.push_back( node.right );
+				stack.push_back( node.left );
+			} else {
+				stack.push_back( node.left );
+				stack.push_back( node.right );
+			}
+		}
+	}
+	if ( best >= 0.0 )
+		item = bestItem;
+	return best;
+}
+
+void BoxTree::overlap( const double* box, vector< unsigned int >& ret )
+	const
+{
+	ret.clear();
+	if ( nodes_.size() == 0 )
+		return;
+	vector< unsigned int > stack( 1, 0 );
+	while ( stack.size() > 0 ) {
+		const Node& node = nodes_[ stack.back() ];
+		stack.pop_back();
+		bool isOutside = false;
+		for ( unsigned int j = 0; j < 3; ++j )
+			if ( node.box[j] > box[j + 3] || node.box[j + 3] < box[j] )
+				isOutside = true;
+		if ( isOutside )
+			continue;
+		if ( node.left == 0 ) {
+			for ( unsigned int k = node.begin; k < node.end; ++k ) {
+				const double* b = &boxes_[ order_[k] * 6 ];
+				if ( b[0] <= box[3] && b[3] >= box[0] &&
+					b[1] <= box[4] && b[4] >= box[1] &&
+					b[2] <= box[5] && b[5] >= box[2] )
+					ret.push_back( items_[ order_[k] ] );
+			}
+		} else {
+			stack.push_back( node.left );
+			stack.push_back( node.right );
+		}
+	}
+	sort( ret.begin(), ret.end() );
+}
@@ -0,0 +1,100 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _BOX_TREE_H
+#define _BOX_TREE_H
+
+/**
+ * Bounding volume hierarchy over axis-aligned boxes, used by the meshes
+ * to find the items near a point, or overlapping a region, without
+ * going through all of them. Each item is an index chosen by the mesh,
+ * such as the index of a NeuroNode, together with a box that must
+ * enclose all of the item's geometry.
+ *
+ * The tree is built once, when the mesh geometry changes, and is
+ * read-only afterwards, so it is safe to query from several threads.
+ */
+class BoxTree
+{
+	public:
+		/**
+		 * Distance from the query point to an item, supplied by the
+		 * mesh. It must never be less than the distance to the item's
+		 * box. A negative value means that the item does not qualify.
+		 */
+		class ItemDistance
+		{
+			public:
+				virtual ~ItemDistance()
+				{;}
+				virtual double operator()( unsigned int item ) const = 0;
+		};
+
+		BoxTree();
+
+		/**
+		 * Builds the tree. boxes holds six entries for each of the
+		 * items: x0, y0, z0, x1, y1, z1.
+		 */
+		void build( const vector< unsigned int >& items,
+			const vector< double >& boxes );
+
+		/// Returns the number of items in the tree.
+		unsigned int size() const;
+
+		/**
+		 * Finds the item with the smallest distance from x, y, z, ties
+		 * going to the smaller item index, and puts it in item.
+		 * Returns the distance, or -1 if no item qualifies, in which
+		 * case item is unchanged.
+		 */
+		double nearest( double x, double y, double z,
+			const ItemDistance& dist, unsigned int& item ) const;
+
+		/**
+		 * Fills ret with the items whose boxes overlap the box,
+		 * given as x0, y0, z0, x1, y1, z1, in ascending order.
+		 */
+		void overlap( const double* box, vector< unsigned int >& ret )
+			const;
+
+	private:
+		/**
+		 * Each node covers the items at positions begin to end of
+		 * order_. A leaf has no children, which is flagged by
+		 * left == 0, as the root is never a child.
+		 */
+		class Node
+		{
+			public:
+				double box[6];
+				unsigned int begin;
+				unsigned int end;
+				unsigned int left;
+				unsigned int right;
+		};
+
+		/// Builds the subtree for items begin to end, returns its node.
+		unsigned int buildNode( unsigned int begin, unsigned int end );
+
+		/// Distance from x, y, z to the box of node n, zero if inside.
+		double boxDistance( unsigned int n, double x, double y, double z )
+			const;
+
+		vector< Node > nodes_;
+
+		/// The items and their boxes, in the order they were given.
+		vector< unsigned int > items_;
+		vector< double > boxes_;
+
+		/// Positions in items_, sorted so that each node is a range.
+		vector< unsigned int > order_;
+};
+
+#endif // _BOX_TREE_H
@@ -321,6 +321,7 @@ void CubeMesh::fillTwoDimSurface()
 	sort( surface_.begin(), surface_.end() );
 	surface_.erase( unique( surface_.begin(), surface_.end() ), 
 					surface_.end() );
+	updateIsSurface();
 }
 
 void CubeMesh::fillThreeDimSurface() // Need to fix duplicate points.
@@ -359,6 +360,7 @@ void CubeMesh::fillThreeDimSurface() // Need to fix duplicate points.
 	sort( surface_.begin(), surface_.end() );
 	surface_.erase( unique( surface_.begin(), surface_.end() ), 
 					surface_.end() );
+	updateIsSurface();
 }
 
 /**
@@ -663,6 +665,7 @@ vector< unsigned int > CubeMesh::getSpaceToMesh() const
 void CubeMesh::setSurface( vector< unsigned int > v )
 {
 	surface_ = v;
+	updateIsSurface();
 }
 
 vector< unsigned int > CubeMesh::getSurface() const
@@ -670,6 +673,15 @@ vector< unsigned int > CubeMesh::getSurface() const
 	return surface_;
 }
 
+void CubeMesh::updateIsSurface()
+{
+	isSurface_.assign( nx_ * ny_ * nz_, false );
+	for ( vector< unsigned int >::const_iterator 
+		i = surface_.begin(); i != surface_.end(); ++i )
+		if ( *i < isSurface_.size() )
+			isSurface_[ *i ] = true;
+}
+
 unsigned int CubeMesh::innerGetDimensions() const
 {
 	return 3;
@@ -1162,18 +1174,49 @@ double CubeMesh::nearest( double x, double y, double z,
 			double tz = z0_ + iz * dz_ + dz_ * 0.5;
 			return distance( x - tx, y - ty, z - tz );
 		} else { // Outside volume. Look over surface for nearest.
+			// Go through the grid in shells of voxels around the point.
+			// Voxels in shell n are at least ( n - 0.5 ) * dmin away,
+			// so once the best is nearer than that for the next shell,
+			// no other voxel can beat it. Ties go to the lower index,
+			// as they would going through the sorted surface_.
+			double dmin = min( dx_, min( dy_, dz_ ) );
+			int maxShell = max( nx_, max( ny_, nz_ ) );
+			int cx = ix;
+			int cy = iy;
+			int cz = iz;
 			double rmin = 1e99;
-			for ( vector< unsigned int >::const_iterator 
-				i = surface_.begin(); i != surface_.end(); ++i )
-   			{
-				double tx, ty, tz;
-				indexToSpace( *i, tx, ty, tz );
-				double r = distance( tx - x, ty - y, tz - z );
-				if ( rmin > r ) {
-						rmin = r;
-						index = *i;
+			unsigned int best = EMPTY;
+			for ( int n = 0; n <= maxShell; ++n ) {
+				int jz1 = min( cz + n, static_cast< int >( nz_ ) - 1 );
+				int jy1 = min( cy + n, static_cast< int >( ny_ ) - 1 );
+				for ( int jz = max( cz - n, 0 ); jz <= jz1; ++jz ) {
+					for ( int jy = max( cy - n, 0 ); jy <= jy1; ++jy ) {
+						// Away from the y and z faces of the shell, only
+						// its two ends in x are in it.
+						bool isFace = 
+							abs( jz - cz ) == n || abs( jy - cy ) == n;
+						int step = isFace ? 1 : 2 * n;
+						for ( int jx = cx - n; jx <= cx + n; jx += step ) {
+							if ( jx < 0 || jx >= static_cast< int >( nx_ ) )
+								continue;
+							unsigned int j = ( jz * ny_ + jy ) * nx_ + jx;
+							if ( j >= isSurface_.size() || !isSurface_[j] )
+								continue;
+							double tx, ty, tz;
+							indexToSpace( j, tx, ty, tz );
+							double r = distance( tx - x, ty - y, tz - z );
+							if ( rmin > r || ( rmin == r && j < best ) ) {
+								rmin = r;
+								best = j;
+							}
+						}
+					}
 				}
+				if ( rmin < ( n + 0.5 ) * dmin )
+					break;
 			}
+			if ( best != EMPTY && s2m_[ best ] != EMPTY )
+				index = s2m_[ best ];
 			return -rmin; // Negative distance indicates xyz is outside vol
 		}
 	}
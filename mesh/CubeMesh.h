@@ -218,6 +218,9 @@ class CubeMesh: public MeshCompt
 		/// that is, puts the surfaces of the cuboid in the vector.
 		void fillThreeDimSurface();
 
+		/// Fills isSurface_ from surface_.
+		void updateIsSurface();
+
 		/// Utility and test function to read surface.
 		const vector< unsigned int >& surface() const;
 		//////////////////////////////////////////////////////////////////
@@ -332,6 +335,13 @@ class CubeMesh: public MeshCompt
 		 * CubeMesh.
 		 */
 		vector< unsigned int > surface_;
+
+		/**
+		 * Flags the spatial meshIndices that are in surface_, so that
+		 * nearest can search the grid around a point for surface voxels
+		 * rather than going through the whole surface_.
+		 */
+		vector< bool > isSurface_;
 };
 
 #endif	// _CUBE_MESH_H
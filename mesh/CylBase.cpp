@@ -260,9 +260,22 @@ double CylBase::selectGridSize( double h, double dia1,
 	return h;
 }
 
+/**
+ * Adds to the area of a CubeMesh entry, noting the entries touched so
+ * that they can be read out and cleared without scanning the whole mesh.
+ */
+static void addArea( vector< double >& area, vector< unsigned int >& touched,
+				unsigned int index, double dArea )
+{
+	if ( area[index] == 0.0 )
+		touched.push_back( index );
+	area[index] += dArea;
+}
+
 static void fillPointsOnCircle( 
 				const Vec& u, const Vec& v, const Vec& q,
 				double h, double r, vector< double >& area,
+				vector< unsigned int >& touched,
 				const CubeMesh* other
 				)
 {
@@ -284,13 +297,14 @@ static void fillPointsOnCircle(
 		double p2 = q.a2() + r * ( u.a2() * c + v.a2() * s );
 		unsigned int index = other->spaceToIndex( p0, p1, p2 );
 		if ( index != CubeMesh::EMPTY )
-			area[index] += dArea;
+			addArea( area, touched, index, dArea );
 	}
 }
 
 static void fillPointsOnDisc( 
 				const Vec& u, const Vec& v, const Vec& q,
 				double h, double r, vector< double >& area,
+				vector< unsigned int >& touched,
 				const CubeMesh* other
 				)
 {
@@ -312,7 +326,7 @@ static void fillPointsOnDisc(
 			double p2 = q.a2() + a * ( u.a2() * c + v.a2() * s );
 			unsigned int index = other->spaceToIndex( p0, p1, p2 );
 			if ( index != CubeMesh::EMPTY )
-				area[index] += dArea;
+				addArea( area, touched, index, dArea );
 		}
 	}
 }
@@ -339,8 +353,9 @@ void CylBase::matchCubeMeshEntries( const ChemCompt* compt,
 	// March along axis of cylinder.
 	// q is the location of the point along axis.
 	double rSlope = ( dia_ - parent.dia_ ) * 0.5 / length_;
+	vector< double > area( other->getNumEntries(), 0.0 );
+	vector< unsigned int > touched;
 	for ( unsigned int i = 0; i < numDivs_; ++i ) {
-		vector< double >area( other->getNumEntries(), 0.0 );
 		if ( useCylinderCurve ) {
 			for ( unsigned int j = 0; j < num; ++j ) {
 				unsigned int m = i * num + j;
@@ -353,21 +368,26 @@ void CylBase::matchCubeMeshEntries( const ChemCompt* compt,
 				if ( !isCylinder_ ) // Use the more complicated conic value
 				r = parent.dia_/2.0 + frac * rSlope;
 				fillPointsOnCircle( u, v, Vec( q0, q1, q2 ),
-							h, r, area, other );
+							h, r, area, touched, other );
 			}
 		}
 		if ( useCylinderCap && i == numDivs_ - 1 ) {
 			fillPointsOnDisc( u, v, Vec( x_, y_, z_ ), 
-							h, dia_/2.0, area, other );
+							h, dia_/2.0, area, touched, other );
 		}
 		// Go through all cubeMesh entries and compute diffusion 
 		// cross-section. Assume this is through a membrane, so the 
 		// only factor relevant is area. Not the distance.
-		for ( unsigned int k = 0; k < area.size(); ++k ) {
+		// Only the touched entries can be nonzero.
+		sort( touched.begin(), touched.end() );
+		for ( unsigned int q = 0; q < touched.size(); ++q ) {
+			unsigned int k = touched[q];
 			if ( area[k] > EPSILON ) {
 				ret.push_back( VoxelJunction( i + startIndex, k, area[k] ));
 			}
+			area[k] = 0.0;
 		}
+		touched.clear();
 	}
 }
 
@@ -20,6 +20,7 @@
 #include "CylBase.h"
 #include "NeuroNode.h"
 // #include "NeuroStencil.h"
+#include "BoxTree.h"
 #include "NeuroMesh.h"
 #include "CylMesh.h"
 #include "../utility/numutil.h"
@@ -851,9 +852,22 @@ double CylMesh::selectGridVolume( double h ) const
 	return h;
 }
 
+/**
+ * Adds to the area of a CubeMesh entry, noting the entries touched so
+ * that they can be read out and cleared without scanning the whole mesh.
+ */
+static void addArea( vector< double >& area, vector< unsigned int >& touched,
+				unsigned int index, double dArea )
+{
+	if ( area[index] == 0.0 )
+		touched.push_back( index );
+	area[index] += dArea;
+}
+
 void fillPointsOnCircle( 
 				const Vec& u, const Vec& v, const Vec& q,
 				double h, double r, vector< double >& area,
+				vector< unsigned int >& touched,
 				const CubeMesh* other
 				)
 {
@@ -875,7 +889,7 @@ void fillPointsOnCircle(
 		double p2 = q.a2() + r * ( u.a2() * c + v.a2() * s );
 		unsigned int index = other->spaceToIndex( p0, p1, p2 );
 		if ( index != CubeMesh::EMPTY )
-			area[index] += dArea;
+			addArea( area, touched, index, dArea );
 	}
 }
 
@@ -893,8 +907,9 @@ vector< VoxelJunction >& ret ) const
 	unsigned int num = floor( 0.1 + lambda_ / h );
 	// March along axis of cylinder.
 	// q is the location of the point along axis.
+	vector< double > area( other->getNumEntries(), 0.0 );
+	vector< unsigned int > touched;
 	for ( unsigned int i = 0; i < numEntries_; ++i ) {
-		vector< double >area( other->getNumEntries(), 0.0 );
 		for ( unsigned int j = 0; j < num; ++j ) {
 			unsigned int m = i * num + j;
 			double frac = ( m * h + h/2.0 ) / totLen_;
@@ -904,16 +919,21 @@ vector< VoxelJunction >& ret ) const
 			// get radius of cylinder at this point.
 			double r = r0_ + ( m * h + h / 2.0 ) * rSlope_;
 			fillPointsOnCircle( u, v, Vec( q0, q1, q2 ),
-						h, r, area, other );
+						h, r, area, touched, other );
 			}
 		// Go through all cubeMesh entries and compute diffusion 
 		// cross-section. Assume this is through a membrane, so the 
 		// only factor relevant is area. Not the distance.
-		for ( unsigned int k = 0; k < area.size(); ++k ) {
+		// Only the touched entries can be nonzero.
+		sort( touched.begin(), touched.end() );
+		for ( unsigned int q = 0; q < touched.size(); ++q ) {
+			unsigned int k = touched[q];
 			if ( area[k] > EPSILON ) {
 				ret.push_back( VoxelJunction( i, k, area[k] ) );
 			}
+			area[k] = 0.0;
 		}
+		touched.clear();
 	}
 }
 
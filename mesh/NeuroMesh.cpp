@@ -20,6 +20,7 @@
 #include "CubeMesh.h"
 #include "CylBase.h"
 #include "NeuroNode.h"
+#include "BoxTree.h"
 #include "NeuroMesh.h"
 #include "SpineEntry.h"
 #include "../utility/numutil.h"
@@ -260,6 +261,7 @@ NeuroMesh& NeuroMesh::operator=( const NeuroMesh& other )
 {
 	nodes_ = other.nodes_;
 	nodeIndex_ = other.nodeIndex_;
+	boxTree_ = other.boxTree_;
 	vs_ = other.vs_;
 	area_ = other.area_;
 	volume_ = other.volume_;
@@ -325,9 +327,32 @@ void NeuroMesh::updateCoords()
 			}
 		}
 	}
+	buildBoxTree();
 	buildStencil();
 }
 
+void NeuroMesh::buildBoxTree()
+{
+	vector< unsigned int > items;
+	vector< double > boxes;
+	for ( unsigned int i = 0; i < nodes_.size(); ++i ) {
+		const NeuroNode& nn = nodes_[i];
+		if ( nn.isDummyNode() )
+			continue;
+		assert( nn.parent() < nodes_.size() );
+		const NeuroNode& pa = nodes_[ nn.parent() ];
+		double r = max( nn.getDia(), pa.getDia() ) / 2.0;
+		items.push_back( i );
+		boxes.push_back( min( nn.getX(), pa.getX() ) - r );
+		boxes.push_back( min( nn.getY(), pa.getY() ) - r );
+		boxes.push_back( min( nn.getZ(), pa.getZ() ) - r );
+		boxes.push_back( max( nn.getX(), pa.getX() ) + r );
+		boxes.push_back( max( nn.getY(), pa.getY() ) + r );
+		boxes.push_back( max( nn.getZ(), pa.getZ() ) + r );
+	}
+	boxTree_.build( items, boxes );
+}
+
 void NeuroMesh::setDiffLength( double v )
 {
 	diffLength_ = v;
@@ -1188,29 +1213,52 @@ void NeuroMesh::indexToSpace( unsigned int index,
 	z = pt.a2();
 }
 
-double NeuroMesh::nearest( double x, double y, double z, 
-				unsigned int& index ) const
+/**
+ * Distance from a point to the segment of a node, for the boxTree_.
+ * Only points that lie along the length of the segment qualify.
+ */
+class NodeDistance: public BoxTree::ItemDistance
 {
-	double best = 1e12;
-	index = 0;
-	for( unsigned int i = 0; i < nodes_.size(); ++i ) {
-		const NeuroNode& nn = nodes_[i];
-		if ( !nn.isDummyNode() ) {
+	public:
+		NodeDistance( const vector< NeuroNode >& nodes,
+			double x, double y, double z )
+			: nodes_( nodes ), x_( x ), y_( y ), z_( z )
+		{;}
+
+		double operator()( unsigned int i ) const
+		{
+			const NeuroNode& nn = nodes_[i];
 			assert( nn.parent() < nodes_.size() );
-			const NeuroNode& pa = nodes_[ nn.parent() ];
 			double linePos;
 			double r;
-			double near = nn.nearest( x, y, z, pa, linePos, r );
-			if ( linePos >= 0 && linePos < 1.0 ) {
-				if ( best > near ) {
-					best = near;
-					index = linePos * nn.getNumDivs() + nn.startFid();
-				}
-			}
+			double near = nn.nearest( x_, y_, z_, nodes_[ nn.parent() ],
+				linePos, r );
+			if ( linePos >= 0 && linePos < 1.0 )
+				return near;
+			return -1.0;
 		}
-	}
-	if ( best == 1e12 )
+
+	private:
+		const vector< NeuroNode >& nodes_;
+		double x_;
+		double y_;
+		double z_;
+};
+
+double NeuroMesh::nearest( double x, double y, double z, 
+				unsigned int& index ) const
+{
+	index = 0;
+	unsigned int i = 0;
+	double best = boxTree_.nearest( x, y, z, 
+					NodeDistance( nodes_, x, y, z ), i );
+	if ( best < 0.0 )
 		return -1;
+	const NeuroNode& nn = nodes_[i];
+	double linePos;
+	double r;
+	nn.nearest( x, y, z, nodes_[ nn.parent() ], linePos, r );
+	index = linePos * nn.getNumDivs() + nn.startFid();
 	return best;
 }
 
@@ -1222,14 +1270,20 @@ void NeuroMesh::matchSpineMeshEntries( const ChemCompt* other,
 void NeuroMesh::matchCubeMeshEntries( const ChemCompt* other,
 	   vector< VoxelJunction >& ret ) const
 {
-	for( unsigned int i = 0; i < nodes_.size(); ++i ) {
-		const NeuroNode& nn = nodes_[i];
-		if ( !nn.isDummyNode() ) {
-			assert( nn.parent() < nodes_.size() );
-			const NeuroNode& pa = nodes_[ nn.parent() ];
-			nn.matchCubeMeshEntries( other, pa, nn.startFid(), 
-							surfaceGranularity_, ret, true, false );
-		}
+	const CubeMesh* cm = dynamic_cast< const CubeMesh* >( other );
+	assert( cm );
+	// Only the nodes that reach into the CubeMesh can have junctions.
+	double box[] = { cm->getX0(), cm->getY0(), cm->getZ0(),
+		cm->getX1(), cm->getY1(), cm->getZ1() };
+	vector< unsigned int > nodes;
+	boxTree_.overlap( box, nodes );
+	for( unsigned int i = 0; i < nodes.size(); ++i ) {
+		const NeuroNode& nn = nodes_[ nodes[i] ];
+		assert( !nn.isDummyNode() );
+		assert( nn.parent() < nodes_.size() );
+		const NeuroNode& pa = nodes_[ nn.parent() ];
+		nn.matchCubeMeshEntries( other, pa, nn.startFid(), 
+						surfaceGranularity_, ret, true, false );
 	}
 }
 
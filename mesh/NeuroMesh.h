@@ -243,6 +243,12 @@ class NeuroMesh: public MeshCompt
  		 */
 		void updateShaftParents();
 
+		/**
+		 * Rebuilds the boxTree_ from the nodes_. Called whenever the
+		 * node geometry changes, that is, from updateCoords.
+		 */
+		void buildBoxTree();
+
 		//////////////////////////////////////////////////////////////////
 		// Utility functions for testing
 		// const Stencil* getStencil() const;
@@ -266,6 +272,13 @@ class NeuroMesh: public MeshCompt
 		 */
 		vector< unsigned int > nodeIndex_;
 
+		/**
+		 * Spatial index over the segments of the non-dummy nodes_,
+		 * each boxed together with its radius. Used by nearest and
+		 * matchCubeMeshEntries to avoid scanning all the nodes.
+		 */
+		BoxTree boxTree_;
+
 		/**
 		 * Volscale pre-calculations for each MeshEntry. 
 		 * vs = #molecules / vol
@@ -20,6 +20,7 @@
 #include "CubeMesh.h"
 #include "CylBase.h"
 #include "NeuroNode.h"
+#include "BoxTree.h"
 #include "NeuroMesh.h"
 #include "SpineEntry.h"
 #include "SpineMesh.h"
@@ -20,6 +20,7 @@
 #include "NeuroNode.h"
 #include "SparseMatrix.h"
 // #include "NeuroStencil.h"
+#include "BoxTree.h"
 #include "NeuroMesh.h"
 #include "../utility/Vec.h"
 #include "CylMesh.h"
@@ -1688,6 +1689,174 @@ void testCubeMeshMultiJunctionTwoD()
 	cout << "." << flush;
 }
 
+/**
+ * Checks the grid search of CubeMesh::nearest against a scan of the
+ * whole surface, for points in the empty voxels around a ball of filled
+ * voxels.
+ */
+void testCubeMeshNearestSurface()
+{
+	CubeMesh cm;
+	cm.setPreserveNumEntries( 0 );
+	vector< double > coords( 9, 1.0 );
+	coords[0] = coords[1] = coords[2] = 0.0;
+	coords[3] = coords[4] = coords[5] = 10.0;
+	cm.innerSetCoords( coords );
+
+	// Fill a ball of voxels, and put on the surface those that touch an
+	// empty voxel or the edge of the grid.
+	vector< unsigned int > m2s;
+	vector< bool > isFilled( 1000, false );
+	for ( unsigned int i = 0; i < 1000; ++i ) {
+		double x, y, z;
+		cm.indexToSpace( i, x, y, z );
+		if ( ChemCompt::distance( x - 5.0, y - 5.0, z - 5.0 ) < 3.5 ) {
+			m2s.push_back( i );
+			isFilled[i] = true;
+		}
+	}
+	cm.setMeshToSpace( m2s );
+	vector< unsigned int > surface;
+	for ( unsigned int i = 0; i < 1000; ++i ) {
+		if ( !isFilled[i] )
+			continue;
+		unsigned int ix = i % 10;
+		unsigned int iy = ( i / 10 ) % 10;
+		unsigned int iz = i / 100;
+		if ( ix == 0 || ix == 9 || iy == 0 || iy == 9 || iz == 0 || 
+			iz == 9 || !isFilled[i - 1] || !isFilled[i + 1] || 
+			!isFilled[i - 10] || !isFilled[i + 10] || 
+			!isFilled[i - 100] || !isFilled[i + 100] )
+			surface.push_back( i );
+	}
+	cm.setSurface( surface );
+	vector< unsigned int > s2m = cm.getSpaceToMesh();
+
+	for ( unsigned int i = 0; i < 1000; ++i ) {
+		if ( isFilled[i] )
+			continue;
+		double x, y, z;
+		cm.indexToSpace( i, x, y, z );
+		x += 0.1;
+		y -= 0.2;
+		z += 0.3;
+		double rmin = 1e99;
+		unsigned int best = 0;
+		for ( unsigned int j = 0; j < surface.size(); ++j ) {
+			double tx, ty, tz;
+			cm.indexToSpace( surface[j], tx, ty, tz );
+			double r = ChemCompt::distance( tx - x, ty - y, tz - z );
+			if ( rmin > r ) {
+				rmin = r;
+				best = surface[j];
+			}
+		}
+		unsigned int index;
+		double dist = cm.nearest( x, y, z, index );
+		assert( doubleEq( dist, -rmin ) );
+		assert( index == s2m[ best ] );
+	}
+
+	cout << "." << flush;
+}
+
+/**
+ * Checks the BoxTree searches in NeuroMesh::nearest and
+ * NeuroMesh::matchCubeMeshEntries against going through all the nodes.
+ */
+void testNeuroMeshSpatialIndex()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id cell = shell->doCreate( "Neutral", Id(), "cell", 1 );
+	double len = 10e-6;
+	double dia = 1e-6;
+	// A soma with four levels of binary branches, fanning out.
+	vector< Id > tips( 1, makeCompt( Id(), cell, "soma", dia, dia, 90 ) );
+	unsigned int k = 0;
+	for ( unsigned int level = 0; level < 4; ++level ) {
+		vector< Id > kids;
+		for ( unsigned int i = 0; i < tips.size(); ++i ) {
+			for ( unsigned int j = 0; j < 2; ++j ) {
+				stringstream ss;
+				ss << "d" << k++;
+				double theta = ( 360.0 * ( 2 * i + j ) + 90.0 ) / 
+					( 2 * tips.size() );
+				kids.push_back( makeCompt( tips[i], cell, ss.str(),
+					len, dia, theta ) );
+			}
+		}
+		tips = kids;
+	}
+	Id nm = shell->doCreate( "NeuroMesh", Id(), "neuromesh", 1 );
+	Field< double >::set( nm, "diffLength", 1e-6 );
+	Field< string >::set( nm, "geometryPolicy", "cylinder" );
+	Field< Id >::set( nm, "cell", cell );
+	const NeuroMesh* neuro = 
+		reinterpret_cast< NeuroMesh* >( nm.eref().data() );
+	const vector< NeuroNode >& nodes = neuro->getNodes();
+
+	for ( unsigned int q = 0; q < 400; ++q ) {
+		double x = ( ( q * 7 ) % 20 ) * 3e-6 - 30e-6;
+		double y = ( ( q * 13 ) % 20 ) * 3e-6 - 30e-6;
+		double z = ( q % 4 ) * 1e-6;
+		double best = 1e12;
+		unsigned int bestIndex = 0;
+		for ( unsigned int i = 0; i < nodes.size(); ++i ) {
+			const NeuroNode& nn = nodes[i];
+			if ( nn.isDummyNode() )
+				continue;
+			double linePos;
+			double r;
+			double near = nn.nearest( x, y, z, nodes[ nn.parent() ], 
+				linePos, r );
+			if ( linePos >= 0 && linePos < 1.0 && best > near ) {
+				best = near;
+				bestIndex = linePos * nn.getNumDivs() + nn.startFid();
+			}
+		}
+		unsigned int index;
+		double dist = neuro->nearest( x, y, z, index );
+		if ( best == 1e12 ) {
+			assert( doubleEq( dist, -1 ) );
+		} else {
+			assert( doubleEq( dist, best ) );
+			assert( index == bestIndex );
+		}
+	}
+
+	// A CubeMesh over one quadrant of the cell.
+	CubeMesh cm;
+	cm.setPreserveNumEntries( 0 );
+	vector< double > coords( 9, 1e-6 );
+	coords[0] = 0.0;
+	coords[1] = 0.0;
+	coords[2] = -5e-6;
+	coords[3] = 40e-6;
+	coords[4] = 40e-6;
+	coords[5] = 5e-6;
+	cm.innerSetCoords( coords );
+	vector< VoxelJunction > ret;
+	neuro->matchCubeMeshEntries( &cm, ret );
+	vector< VoxelJunction > all;
+	for ( unsigned int i = 0; i < nodes.size(); ++i ) {
+		const NeuroNode& nn = nodes[i];
+		if ( !nn.isDummyNode() )
+			nn.matchCubeMeshEntries( &cm, nodes[ nn.parent() ], 
+				nn.startFid(), 0.1, all, true, false );
+	}
+	assert( ret.size() > 0 );
+	assert( ret.size() == all.size() );
+	for ( unsigned int i = 0; i < ret.size(); ++i ) {
+		assert( ret[i].first == all[i].first );
+		assert( ret[i].second == all[i].second );
+		assert( doubleEq( ret[i].diffScale, all[i].diffScale ) );
+	}
+
+	shell->doDelete( cell );
+	shell->doDelete( nm );
+	cout << "." << flush;
+}
+
 void testVec()
 {
 	Vec i( 1, 0, 0 );
@@ -2156,6 +2325,8 @@ void testMesh()
 	testCubeMeshJunctionThreeDimSurface();
 	testCubeMeshJunctionDiffSizeMesh();
 	testCubeMeshMultiJunctionTwoD();
+	testCubeMeshNearestSurface();
+	testNeuroMeshSpatialIndex();
 	// testSpineEntry();
 	// testSpineAndPsdMesh();
 	// testCellPortion();
@@ -7,14 +7,20 @@
 ** See the file COPYING.LIB for the full notice.
 **********************************************************************/
 
+#include <cfloat>
+#include <climits>
 #include "header.h"
 #include "PostMaster.h"
 #include "../shell/Shell.h"
+#include "../biophysics/SpikeRingBuffer.h"
+#include "../biophysics/Synapse.h"
 
 const unsigned int TgtInfo::headerSize = 
 		1 + ( sizeof( TgtInfo ) - 1 )/sizeof( double );
 
+const unsigned int PostMaster::spikeSize = 5;
 const unsigned int PostMaster::reserveBufSize = 1048576;
+const unsigned int PostMaster::maxBufSize = 268435456;
 const unsigned int PostMaster::setRecvBufSize = 1048576;
 const int PostMaster::MSGTAG = 1;
 const int PostMaster::SETTAG = 2;
@@ -31,12 +37,19 @@ PostMaster::PostMaster()
 				recvBuf_( Shell::numNodes() ),
 				sendSize_( Shell::numNodes(), 0 ),
 				getHandlerBuf_( TgtInfo::headerSize, 0 ),
+				spikeRecvSize_( Shell::numNodes(), 0 ),
+				spikeRecvStart_( Shell::numNodes(), 0 ),
+				lookahead_( 0.0 ),
+				autoLookahead_( false ),
+				syncInterval_( 1 ),
+				stepsSinceSync_( 0 ),
 				doneIndices_( Shell::numNodes(), 0 ),
 				isSetSent_( 1 ), // Flag. Have any pending 'set' gone?
 				isSetRecv_( 0 ), // Flag. Has some data come in?
 				setSendSize_( 0 ),
 				numRecvDone_( 0 )
 {
+	assert( maxBufSize <= static_cast< unsigned int >( INT_MAX ) );
 	for ( unsigned int i = 0; i < Shell::numNodes(); ++i ) {
 		sendBuf_[i].resize( reserveBufSize, 0 );
 	}
@@ -100,6 +113,30 @@ const Cinfo* PostMaster::initCinfo()
 			&PostMaster::setBufferSize,
 			&PostMaster::getBufferSize
 		);
+		static ValueFinfo< PostMaster, double > lookahead(
+			"lookahead",
+			"Time for which the nodes run without swapping messages. "
+			"It must not be more than the smallest delay of any synapse "
+			"between nodes, and other messages between nodes arrive up "
+			"to this much later than they would otherwise. "
+			"The default, 0, swaps on every step of the PostMaster clock.",
+			&PostMaster::setLookahead,
+			&PostMaster::getLookahead
+		);
+		static ValueFinfo< PostMaster, bool > autoLookahead(
+			"autoLookahead",
+			"Flag: when true, the lookahead is set on each reinit to the "
+			"smallest delay of any Synapse on any node that receives "
+			"spikes.",
+			&PostMaster::setAutoLookahead,
+			&PostMaster::getAutoLookahead
+		);
+		static ReadOnlyValueFinfo< PostMaster, unsigned int > syncInterval(
+			"syncInterval",
+			"Number of steps between swaps of messages, as set up from "
+			"the lookahead on the last reinit.",
+			&PostMaster::getSyncInterval
+		);
 		//////////////////////////////////////////////////////////////
 		// MsgDest Definitions
 		//////////////////////////////////////////////////////////////
@@ -125,6 +162,9 @@ const Cinfo* PostMaster::initCinfo()
 		&numNodes,	// ReadOnlyValue
 		&myNode,	// ReadOnlyValue
 		&bufferSize,	// ReadOnlyValue
+		&lookahead,		// Value
+		&autoLookahead,	// Value
+		&syncInterval,	// ReadOnlyValue
 		&proc		// SharedFinfo
 	};
 
@@ -158,13 +198,40 @@ void PostMaster::finalizeSends()
 //
 /**
  * PostMaster class: handles cross-node messaging using MPI.
- * Identical to the Process call: sends out what needs to go, and then
- * waits for any incoming messages and passes them on.
+ * Sets up the window from the lookahead, and then swaps everything
+ * that is waiting to go, as the process call does at the end of each
+ * window.
  */
 void PostMaster::reinit( const Eref& e, ProcPtr p )
+{
+	spikeSendBuf_.clear();
+	if ( autoLookahead_ )
+		lookahead_ = minSynapseDelay();
+	// Windows of length syncInterval_ * dt that do not exceed lookahead_.
+	syncInterval_ = 1e-6 + lookahead_ / p->dt;
+	if ( syncInterval_ == 0 )
+		syncInterval_ = 1;
+	stepsSinceSync_ = 0;
+	exchange();
+}
+
+void PostMaster::process( const Eref& e, ProcPtr p )
+{
+	if ( ++stepsSinceSync_ < syncInterval_ )
+		return;
+	stepsSinceSync_ = 0;
+	exchange();
+}
+
+/**
+ * Sends out the buffers for all nodes, waits for theirs, and swaps the
+ * spikes. Must be called on all nodes at the same step.
+ */
+void PostMaster::exchange()
 {
 #ifdef USE_MPI
 	// MPI_Barrier( MPI_COMM_WORLD );
+	growRecvBufs();
 	unsigned int reqIndex = 0;
 	for ( unsigned int i = 0; i < Shell::numNodes(); ++i )
 	{
@@ -182,36 +249,150 @@ void PostMaster::reinit( const Eref& e, ProcPtr p )
 	while ( numRecvDone_ < Shell::numNodes() -1 )
 		clearPending();
 	finalizeSends();
+	exchangeSpikes();
 	MPI_Barrier( MPI_COMM_WORLD );
 	numRecvDone_ = 0;
 #endif
 }
 
-void PostMaster::process( const Eref& e, ProcPtr p )
+/**
+ * Returns size doubled as often as needed to reach need, but not past
+ * maxBufSize. Doubling keeps the number of regrowths small however many
+ * steps a window holds.
+ */
+static unsigned int grownBufSize( unsigned int size, unsigned int need )
+{
+	assert( need <= PostMaster::maxBufSize );
+	if ( size < PostMaster::reserveBufSize )
+		size = PostMaster::reserveBufSize;
+	while ( size < need ) {
+		if ( size > PostMaster::maxBufSize / 2 )
+			return PostMaster::maxBufSize;
+		size *= 2;
+	}
+	return size;
+}
+
+/**
+ * Called from exchange before any node sends, when every message of the
+ * last window has been received, so the recvs still pending have nothing
+ * matched to them and may be cancelled. All nodes grow to the same size.
+ */
+void PostMaster::growRecvBufs()
 {
 #ifdef USE_MPI
-	unsigned int reqIndex = 0;
+	unsigned int maxSend = 0;
 	for ( unsigned int i = 0; i < Shell::numNodes(); ++i )
-	{
+		if ( maxSend < sendSize_[i] )
+			maxSend = sendSize_[i];
+	unsigned int need = 0;
+	MPI_Allreduce( &maxSend, &need, 1, MPI_UNSIGNED, MPI_MAX,
+		MPI_COMM_WORLD );
+	if ( need <= recvBufSize_ )
+		return;
+	unsigned int size = grownBufSize( recvBufSize_, need );
+	recvBufSize_ = size;
+	unsigned int k = 0;
+	for ( unsigned int i = 0; i < Shell::numNodes(); ++i ) {
 		if ( i == Shell::myNode() ) continue;
-		// MPI_scatter would have been better but it doesn't allow
-		// one to post larger recvs than the actual data sent.
-		MPI_Isend( 
-			&sendBuf_[i][0], sendSize_[i], MPI_DOUBLE,
-			i, 		// Where to send to.
-			MSGTAG, MPI_COMM_WORLD,
-			&sendReq_[ reqIndex++ ]
+		MPI_Cancel( &recvReq_[k] );
+		MPI_Wait( &recvReq_[k], MPI_STATUS_IGNORE );
+		recvBuf_[i].resize( size, 0 );
+		MPI_Irecv( &recvBuf_[i][0], recvBufSize_, MPI_DOUBLE,
+			i, MSGTAG, MPI_COMM_WORLD,
+			&recvReq_[k++]
 		);
-		clearPending(); // Try to interleave communications.
 	}
-	while ( numRecvDone_ < Shell::numNodes() -1 )
-		clearPending();
-	finalizeSends();
+	// No node may send until every node has reposted its recvs.
 	MPI_Barrier( MPI_COMM_WORLD );
-	numRecvDone_ = 0;
 #endif
 }
 
+/**
+ * Returns the smallest delay of any Synapse on any node, or 0 if none.
+ * Synapses that no message sends spikes to are left out.
+ */
+double PostMaster::minSynapseDelay() const
+{
+	static const DestFinfo* addSpike = dynamic_cast< const DestFinfo* >(
+		Synapse::initCinfo()->findFinfo( "addSpike" ) );
+	assert( addSpike );
+	double ret = DBL_MAX;
+	for ( unsigned int i = 0; i < Id::numIds(); ++i ) {
+		if ( !Id::isValid( i ) )
+			continue;
+		const Element* e = Id( i ).element();
+		if ( !e->cinfo()->isA( "Synapse" ) ||
+			e->findCaller( addSpike->getFid() ).bad() )
+			continue;
+		for ( unsigned int j = 0; j < e->numLocalData(); ++j ) {
+			unsigned int n = e->numField( j );
+			for ( unsigned int k = 0; k < n; ++k ) {
+				const Synapse* syn =
+					reinterpret_cast< const Synapse* >( e->data( j, k ) );
+				if ( ret > syn->getDelay() )
+					ret = syn->getDelay();
+			}
+		}
+	}
+#ifdef USE_MPI
+	double local = ret;
+	MPI_Allreduce( &local, &ret, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD );
+#endif
+	if ( ret == DBL_MAX )
+		return 0.0;
+	return ret;
+}
+
+void PostMaster::addSpike( const Eref& e, unsigned int bindIndex, double t )
+{
+	spikeSendBuf_.push_back( e.id().value() );
+	spikeSendBuf_.push_back( e.dataIndex() );
+	spikeSendBuf_.push_back( bindIndex );
+	unsigned int word[2];
+	memcpy( word, &t, sizeof( double ) );
+	spikeSendBuf_.push_back( word[0] );
+	spikeSendBuf_.push_back( word[1] );
+}
+
+void PostMaster::exchangeSpikes()
+{
+#ifdef USE_MPI
+	int numSend = spikeSendBuf_.size();
+	MPI_Allgather( &numSend, 1, MPI_INT, 
+		&spikeRecvSize_[0], 1, MPI_INT, MPI_COMM_WORLD );
+	int numRecv = 0;
+	for ( unsigned int i = 0; i < Shell::numNodes(); ++i ) {
+		spikeRecvStart_[i] = numRecv;
+		numRecv += spikeRecvSize_[i];
+	}
+	if ( numRecv > 0 ) {
+		// Keep the buffers non-empty so that &buf[0] is valid.
+		spikeSendBuf_.push_back( 0 );
+		spikeRecvBuf_.resize( numRecv + 1 );
+		MPI_Allgatherv( &spikeSendBuf_[0], numSend, MPI_UNSIGNED,
+			&spikeRecvBuf_[0], &spikeRecvSize_[0], &spikeRecvStart_[0],
+			MPI_UNSIGNED, MPI_COMM_WORLD );
+		for ( unsigned int i = 0; i < Shell::numNodes(); ++i ) {
+			if ( i == Shell::myNode() )
+				continue;
+			const unsigned int* buf = &spikeRecvBuf_[ spikeRecvStart_[i] ];
+			const unsigned int* end = buf + spikeRecvSize_[i];
+			for ( ; buf < end; buf += spikeSize ) {
+				Eref src( Id( buf[0] ).element(), buf[1] );
+				const SrcFinfo* sf = dynamic_cast< const SrcFinfo* >(
+					src.element()->cinfo()->getSrcFinfo( buf[2] ) );
+				assert( sf );
+				double t;
+				memcpy( &t, buf + 3, sizeof( double ) );
+				sf->sendBuffer( src, &t );
+			}
+		}
+	}
+#endif
+	spikeSendBuf_.clear();
+}
+
 void PostMaster::clearPending()
 {
 	if ( Shell::numNodes() == 1 )
@@ -444,15 +625,18 @@ double* PostMaster::addToSendBuf( const Eref& e, unsigned int bindIndex,
 {
 	unsigned int node = e.fieldIndex(); // nasty evil wicked hack
 	unsigned int end = sendSize_[node];
-	if ( end + TgtInfo::headerSize + size > recvBufSize_ ) {
-		// Here we need to activate the fallback second send which will
-		// deal with the big block. Also various routines for tracking
-		// send size so we don't get too big or small.
+	// Written as a subtraction so that it cannot wrap.
+	if ( TgtInfo::headerSize + size > maxBufSize - end ) {
 		cerr << "Error: PostMaster::addToSendBuf on node " << 
 				Shell::myNode() << 
-				": Data size (" << size << ") goes past end of buffer\n";
+				": Data size (" << size << ") goes past the largest " <<
+				"buffer of " << maxBufSize << " doubles\n";
 		assert( 0 );
 	}
+	unsigned int need = end + TgtInfo::headerSize + size;
+	if ( need > sendBuf_[node].size() )
+		sendBuf_[node].resize(
+			grownBufSize( sendBuf_[node].size(), need ), 0 );
 	TgtInfo* tgt = reinterpret_cast< TgtInfo* >( &sendBuf_[node][end] );
 	tgt->set( e.objId(), bindIndex, size );
 	end += TgtInfo::headerSize;
@@ -724,3 +908,33 @@ void PostMaster::setBufferSize( unsigned int size )
 	for ( unsigned int i =0; i < sendBuf_.size(); ++i )
 		sendBuf_[i].resize( size );
 }
+
+void PostMaster::setLookahead( double v )
+{
+	if ( v < 0.0 ) {
+		cout << "Warning: PostMaster::setLookahead: " << v <<
+			" is negative, using 0\n";
+		v = 0.0;
+	}
+	lookahead_ = v;
+}
+
+double PostMaster::getLookahead() const
+{
+	return lookahead_;
+}
+
+void PostMaster::setAutoLookahead( bool v )
+{
+	autoLookahead_ = v;
+}
+
+bool PostMaster::getAutoLookahead() const
+{
+	return autoLookahead_;
+}
+
+unsigned int PostMaster::getSyncInterval() const
+{
+	return syncInterval_;
+}
@@ -56,6 +56,33 @@
  * the originating object, plus using its FieldIndex to specify the target
  * node.
  *
+ * Spikes take a shorter path. A SpikeRouter whose source has off-node
+ * targets calls addSpike instead of the HopFunc, which puts five
+ * integers into the spike buffer: the Id and DataIndex of the source,
+ * the BindIndex of its SrcFinfo, and the two words of the spike time.
+ * The time goes as it is rather than as a clock step because the base
+ * dt of the Clocks may differ between nodes. On process the
+ * PostMasters swap their spike buffers with one MPI_Allgatherv, and
+ * each node then calls sendBuffer on
+ * each arrived source, which goes out through the local MsgDigest to
+ * whatever targets the source has on that node. The messages are
+ * replicated on all nodes, so they serve as the connectivity table.
+ *
+ * Level 3. Lookahead.
+ * By default the PostMaster swaps its buffers on every step of its
+ * clock tick. If the only traffic between nodes is spikes, and every
+ * synapse delay is at least the lookahead, the nodes may instead run
+ * for a window of syncInterval steps and swap once at its end. A spike
+ * keeps its send time, so when it arrives late in the window its
+ * synapse still places it in the right bin. Other messages are simply
+ * delivered at the end of the window, so a lookahead is only safe if
+ * they can tolerate the delay. The lookahead may be assigned, or found
+ * on each reinit from the smallest Synapse delay on any node. A
+ * window may hold more messages than reserveBufSize, so the send
+ * buffers grow as they fill, and before each swap the nodes agree on
+ * the largest send and grow their recv buffers to match, up to
+ * maxBufSize.
+ *
  * Possible optimization here would be to have a sendToAll buffer
  * that was filled when the digestMessages detected that a majority of
  * target nodes received a given message. A setup time complication, not
@@ -108,6 +135,11 @@ class PostMaster {
 		unsigned int getMyNode() const;
 		unsigned int getBufferSize() const;
 		void setBufferSize( unsigned int size );
+		void setLookahead( double v );
+		double getLookahead() const;
+		void setAutoLookahead( bool v );
+		bool getAutoLookahead() const;
+		unsigned int getSyncInterval() const;
 		void reinit( const Eref& e, ProcPtr p );
 		void process( const Eref& e, ProcPtr p );
 
@@ -120,6 +152,27 @@ class PostMaster {
 		/// Checks that all sends have gone out
 		void finalizeSends();
 
+		/**
+		 * Queues a spike sent at time t from e through the SrcFinfo
+		 * with this bindIndex, for delivery on all other nodes.
+		 */
+		void addSpike( const Eref& e, unsigned int bindIndex, double t );
+		/**
+		 * Swaps the queued spikes with all other nodes, and sends the
+		 * arrived ones to their local targets. Must be called on all
+		 * nodes at the same clock step.
+		 */
+		void exchangeSpikes();
+		/// Swaps all buffers with the other nodes.
+		void exchange();
+		/**
+		 * Grows the recv buffers to hold the largest send of any node
+		 * in this window, reposting the pending recvs.
+		 */
+		void growRecvBufs();
+		/// Returns the smallest delay of any Synapse on any node.
+		double minSynapseDelay() const;
+
 		/// Handles 'get' calls from another node, to an object on mynode.
 		void handleRemoteGet( const Eref& e, 
 						const OpFunc* op, int requestingNode );
@@ -144,7 +197,11 @@ class PostMaster {
 		void remoteFieldGetVec( const Eref& e, unsigned int bindIndex,
 				vector< double >& getRecvBuf ); 
 
+		/// Number of unsigned ints for each spike in the spike buffers.
+		static const unsigned int spikeSize;
 		static const unsigned int reserveBufSize;
+		/// Largest size of a send or recv buffer, below the MPI count limit
+		static const unsigned int maxBufSize;
 		static const unsigned int setRecvBufSize;
 		static const int MSGTAG;
 		static const int SETTAG;
@@ -162,6 +219,20 @@ class PostMaster {
 		vector< vector< double > > recvBuf_;
 		vector< unsigned int > sendSize_;
 		vector< double > getHandlerBuf_; // Just enough for one TgtInfo.
+
+		vector< unsigned int > spikeSendBuf_;
+		vector< unsigned int > spikeRecvBuf_;
+		/// Number of entries and offset of each node in spikeRecvBuf_
+		vector< int > spikeRecvSize_;
+		vector< int > spikeRecvStart_;
+
+		/// Time for which nodes may run without swapping buffers.
+		double lookahead_;
+		/// If true, the lookahead is the smallest Synapse delay.
+		bool autoLookahead_;
+		/// Number of process steps in each window, from the lookahead.
+		unsigned int syncInterval_;
+		unsigned int stepsSinceSync_;
 #ifdef USE_MPI
 		MPI_Request setSendReq_;
 		MPI_Request setRecvReq_;
@@ -11,6 +11,7 @@
 #include "SparseMatrix.h"
 #include "SparseMsg.h"
 #include "../randnum/randnum.h"
+#include "../randnum/RandomStream.h"
 #include "../biophysics/SpikeRingBuffer.h"
 #include "../biophysics/Synapse.h"
 #include "../shell/Shell.h"
@@ -53,7 +54,9 @@ const Cinfo* SparseMsg::initCinfo()
 
 	static ValueFinfo< SparseMsg, long > seed(
 		"seed",
-		"Random number seed for generating probabilistic connectivity.",
+		"Random number seed for generating probabilistic connectivity. "
+		"If zero, a seed is drawn from the global random number "
+		"generator, so that moose.seed decides the connectivity.",
 		&SparseMsg::setSeed,
 		&SparseMsg::getSeed
 	);
@@ -142,7 +145,6 @@ static const Cinfo* sparseMsgCinfo = SparseMsg::initCinfo();
 void SparseMsg::setProbability ( double probability )
 {
 	p_ = probability;
-	mtseed( seed_ );
 	randomConnect( probability );
 }
 
@@ -154,7 +156,6 @@ double SparseMsg::getProbability ( ) const
 void SparseMsg::setSeed ( long seed )
 {
 	seed_ = seed;
-	mtseed( seed_ );
 	randomConnect( p_ );
 }
 
@@ -186,7 +187,6 @@ void SparseMsg::setRandomConnectivity( double probability, long seed )
 {
 	p_ = probability;
 	seed_ = seed;
-	mtseed( seed );
 	randomConnect( probability );
 }
 
@@ -250,7 +250,9 @@ void SparseMsg::tripletFill( vector< unsigned int > src,
 
 SparseMsg::SparseMsg( Element* e1, Element* e2, unsigned int msgIndex )
 	: Msg( ObjId( managerId_, (msgIndex != 0) ? msgIndex: msg_.size() ),
-					e1, e2 )
+					e1, e2 ),
+		p_( 0.0 ),
+		seed_( 0 )
 {
 	unsigned int nrows = 0;
 	unsigned int ncolumns = 0;
@@ -306,9 +308,11 @@ Eref SparseMsg::firstTgt( const Eref& src ) const
  * Fills it in transpose form, because we need to count and index the 
  * number of synapses on the target, so we need to iterate over the sources
  * in the inner loop. Once full, does the transpose.
- * Should really have a seed argument for the random number.
- * Later need a way to fast-forward mtrand to just the entries we
- * need to fill.
+ * Each target (column) draws from its own random number stream, made
+ * from seed_ and the column index, so the connectivity does not depend
+ * on the order in which the columns are filled, or on how they are
+ * split between nodes. A seed_ of zero takes the seed from mtrand, as
+ * the Gsolve does.
  */
 unsigned int SparseMsg::randomConnect( double probability )
 {
@@ -324,13 +328,17 @@ unsigned int SparseMsg::randomConnect( double probability )
 
 	assert( nCols == syn->numData() );
 
+	unsigned long seed = seed_;
+	if ( seed == 0 )
+		seed = genrand_int32();
 	for ( unsigned int i = 0; i < nCols; ++i ) {
 		vector< unsigned int > synIndex;
 		// This needs to be obtained from current size of syn array.
 		// unsigned int synNum = sizes[ i ];
 		unsigned int synNum = 0;
+		RandomStream rng( seed, i );
 		for ( unsigned int j = 0; j < nRows; ++j ) {
-			double r = mtrand(); // Want to ensure it is called each time round the loop.
+			double r = rng.uniform();
 			if ( r < probability ) {
 				synIndex.push_back( synNum );
 				++synNum;
@@ -98,6 +98,22 @@
 #include "../randnum/randnum.h"
 #include "../shell/Shell.h"
 #include "../shell/Wildcard.h"
+#include "../basecode/SparseMatrix.h"
+#include "../ksolve/KinSparseMatrix.h"
+#include "../basecode/ThreadPool.h"
+#ifdef USE_GSL
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_odeiv2.h>
+#endif
+#include "../ksolve/OdeSystem.h"
+#include "../ksolve/VoxelPoolsBase.h"
+#include "../ksolve/VoxelPools.h"
+#include "../ksolve/ZombiePoolInterface.h"
+#include "../ksolve/Ksolve.h"
+#include "../diffusion/DiffPoolVec.h"
+#include "../diffusion/DiffBatch.h"
+#include "../diffusion/Dsolve.h"
 
 #include "moosemodule.h"
 
@@ -129,7 +145,7 @@ extern void nonMpiTests(Shell *);
 extern void test_moosemodule();
 
 
-extern Id init(int argc, char ** argv, bool& doUnitTests, bool& doRegressionTests, unsigned int& benchmark );
+extern Id init(int argc, char ** argv, bool& doUnitTests, bool& doRegressionTests, string& benchmark );
 
 extern void initMsgManagers();
 extern void destroyMsgManagers();
@@ -138,7 +154,7 @@ extern void speedTestMultiNodeIntFireNetwork(
 #ifdef USE_SMOLDYN
 	extern void testSmoldyn();
 #endif
-extern void mooseBenchmarks( unsigned int option );
+extern void mooseBenchmarks( const string& option );
 
 
 // C-wrapper to be used by Python
@@ -810,7 +826,7 @@ extern "C" {
         }
         bool dounit = doUnitTests != 0;
         bool doregress = doRegressionTests != 0;
-        unsigned int doBenchmark = 0;
+        string doBenchmark = "";
         // Utilize the main::init function which has friend access to Id
         Id shellId = init(argc, argv, dounit, doregress, doBenchmark );
         inited = 1;
@@ -823,7 +839,7 @@ extern "C" {
 			// Use the last clock for the postmaster, so that it is called
 			// after everything else has been processed and all messages
 			// are ready to send out.
-			shellPtr->doUseClock( "/postmaster", "process", 9 );
+			shellPtr->doUseClock( "/postmaster", "proc", 9 );
 			shellPtr->doSetClock( 9, 1.0 ); // Use a sensible default.
 		}
 #ifdef DO_UNIT_TESTS
@@ -836,7 +852,7 @@ extern "C" {
 		// These are outside unit tests because they happen in optimized
 		// mode, using a command-line argument. As soon as they are done
 		// the system quits, in order to estimate timing.
-		if ( doBenchmark != 0 ) {
+		if ( doBenchmark != "" ) {
 			mooseBenchmarks( doBenchmark );
                 }
         }
@@ -1514,6 +1530,97 @@ extern "C" {
         Py_RETURN_NONE;
     }
     
+    /// Gets the Id of the model root for the checkpoint functions.
+    static bool checkpointModel(PyObject * source, Id& model, const char * func)
+    {
+        if (PyString_Check(source)){
+            char * srcPath = PyString_AsString(source);
+            if (!srcPath){
+                return false;
+            }
+            model = Id(string(srcPath));
+        } else if (Id_SubtypeCheck(source)){
+            model = ((_Id*)source)->id_;
+        } else if (ObjId_SubtypeCheck(source)){
+            model = ((_ObjId*)source)->oid_.id;
+        } else {
+            ostringstream msg;
+            msg << func << ": need an vec, element or string for first argument.";
+            PyErr_SetString(PyExc_TypeError, msg.str().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    PyDoc_STRVAR(moose_saveCheckpoint_documentation,
+                 "saveCheckpoint(source, filename)\n"
+                 "\n"
+                 "Save the run time state of the model rooted at `source`, and of\n"
+                 "the clock, to the binary file `filename`. The state includes the\n"
+                 "solvers, the random number streams and the spikes still on their\n"
+                 "way to synapses. The parameters of the model are not saved.\n"
+                 "\n"
+                 "\nParameters\n"
+                 "----------\n"
+                 "source: vec or element or str\n"
+                 "\troot of the model tree\n"
+                 "\n"
+                 "filename: str\n"
+                 "\tdestination file to save the state in.\n"
+                 "\n");
+
+    PyObject * moose_saveCheckpoint(PyObject * dummy, PyObject * args)
+    {
+        char * filename = NULL;
+        PyObject * source = NULL;
+        Id model;
+        if (!PyArg_ParseTuple(args, "Os: moose_saveCheckpoint", &source, &filename)){
+            return NULL;
+        }
+        if (!checkpointModel(source, model, "moose_saveCheckpoint")){
+            return NULL;
+        }
+        if (!SHELLPTR->doSaveCheckpoint(model, filename)){
+            PyErr_SetString(PyExc_IOError, "could not save checkpoint");
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+
+    PyDoc_STRVAR(moose_restoreCheckpoint_documentation,
+                 "restoreCheckpoint(source, filename)\n"
+                 "\n"
+                 "Restore the state saved by saveCheckpoint onto the model rooted at\n"
+                 "`source`, which must have been built by the same script. Call it\n"
+                 "after reinit(), and then carry on with start().\n"
+                 "\n"
+                 "\nParameters\n"
+                 "----------\n"
+                 "source: vec or element or str\n"
+                 "\troot of the model tree\n"
+                 "\n"
+                 "filename: str\n"
+                 "\tcheckpoint file to read the state from.\n"
+                 "\n");
+
+    PyObject * moose_restoreCheckpoint(PyObject * dummy, PyObject * args)
+    {
+        char * filename = NULL;
+        PyObject * source = NULL;
+        Id model;
+        if (!PyArg_ParseTuple(args, "Os: moose_restoreCheckpoint", &source, &filename)){
+            return NULL;
+        }
+        if (!checkpointModel(source, model, "moose_restoreCheckpoint")){
+            return NULL;
+        }
+        if (!SHELLPTR->doRestoreCheckpoint(model, filename)){
+            PyErr_SetString(PyExc_IOError, "could not restore checkpoint");
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+
     PyObject * moose_setCwe(PyObject * dummy, PyObject * args)
     {
         PyObject * element = NULL;
@@ -1960,6 +2067,134 @@ extern "C" {
         }
         return ret;
     }
+
+    /**
+       Finds the molecule numbers at index in a Ksolve or Dsolve. Sets a
+       Python error and returns NULL if there are none. The pointer is
+       only good until the solver storage is next rebuilt, so it must not
+       be kept past the call that asked for it.
+    */
+    static double * _nvecPtr(PyObject * obj, unsigned int index,
+                             unsigned int & size, unsigned int & stride,
+                             const char * fname)
+    {
+        size = 0;
+        stride = 1;
+        if (!PyObject_IsInstance(obj, (PyObject*)&ObjIdType)){
+            PyErr_Format(PyExc_TypeError, "%s: first argument must be a solver element.", fname);
+            return NULL;
+        }
+        ObjId oid = ((_ObjId*)obj)->oid_;
+        if (oid.bad() || !oid.isDataHere()){
+            PyErr_Format(PyExc_ValueError, "%s: invalid Id", fname);
+            return NULL;
+        }
+        string className = oid.element()->cinfo()->name();
+        double * data = NULL;
+        if (className == "Ksolve"){
+            data = reinterpret_cast< Ksolve* >(oid.data())->getNvecView(index, size);
+        } else if (className == "Dsolve"){
+            data = reinterpret_cast< Dsolve* >(oid.data())->getNvecView(index, size, stride);
+        } else {
+            PyErr_Format(PyExc_TypeError, "%s: element must be a Ksolve or a Dsolve.", fname);
+            return NULL;
+        }
+        if (data == NULL){
+            PyErr_Format(PyExc_IndexError, "%s: index out of range.", fname);
+        }
+        return data;
+    }
+
+    PyDoc_STRVAR(moose_getNvec_documentation,
+                 "moose.getNvec(solver, index) -> numpy array\n"
+                 "\n"
+                 "Get the molecule numbers held in a solver as a numpy array, copied\n"
+                 "in one pass straight out of the solver storage.\n"
+                 "\n"
+                 "\nParameters\n"
+                 "----------\n"
+                 "solver: element\n"
+                 "\tA Ksolve or a Dsolve.\n"
+                 "index: int\n"
+                 "\tFor a Ksolve, the voxel: the array has one entry per pool.\n"
+                 "\tFor a Dsolve, the pool: the array has one entry per voxel.\n"
+                 "\n"
+                 "The array is a copy, since the solvers rebuild their storage on\n"
+                 "reinit and setup. Use moose.setNvec to write it back.\n"
+                 "\n");
+
+    PyObject * moose_getNvec(PyObject * dummy, PyObject * args)
+    {
+        PyObject * obj = NULL;
+        unsigned int index = 0;
+        if (!PyArg_ParseTuple(args, "OI:moose.getNvec", &obj, &index)){
+            return NULL;
+        }
+        unsigned int size = 0;
+        unsigned int stride = 1;
+        double * data = _nvecPtr(obj, index, size, stride, "moose.getNvec");
+        if (data == NULL){
+            return NULL;
+        }
+        npy_intp dims = size;
+        PyObject * ret = PyArray_SimpleNew(1, &dims, NPY_DOUBLE);
+        if (ret == NULL){
+            return NULL;
+        }
+        double * ptr = (double*)PyArray_DATA((PyArrayObject*)ret);
+        for (unsigned int ii = 0; ii < size; ++ii){
+            ptr[ii] = data[ii * stride];
+        }
+        return ret;
+    }
+
+    PyDoc_STRVAR(moose_setNvec_documentation,
+                 "moose.setNvec(solver, index, values)\n"
+                 "\n"
+                 "Assign the molecule numbers held in a solver in one pass.\n"
+                 "\n"
+                 "\nParameters\n"
+                 "----------\n"
+                 "solver: element\n"
+                 "\tA Ksolve or a Dsolve.\n"
+                 "index: int\n"
+                 "\tThe voxel for a Ksolve, or the pool for a Dsolve, as in\n"
+                 "\tmoose.getNvec.\n"
+                 "values: sequence of float\n"
+                 "\tOne entry per pool for a Ksolve, or per voxel for a Dsolve.\n"
+                 "\n");
+
+    PyObject * moose_setNvec(PyObject * dummy, PyObject * args)
+    {
+        PyObject * obj = NULL;
+        PyObject * values = NULL;
+        unsigned int index = 0;
+        if (!PyArg_ParseTuple(args, "OIO:moose.setNvec", &obj, &index, &values)){
+            return NULL;
+        }
+        unsigned int size = 0;
+        unsigned int stride = 1;
+        double * data = _nvecPtr(obj, index, size, stride, "moose.setNvec");
+        if (data == NULL){
+            return NULL;
+        }
+        PyObject * arr = PyArray_FROMANY(values, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+        if (arr == NULL){
+            return NULL;
+        }
+        if (PyArray_SIZE((PyArrayObject*)arr) != (npy_intp)size){
+            Py_DECREF(arr);
+            PyErr_SetString(PyExc_ValueError, "moose.setNvec: length of values does not match the solver.");
+            return NULL;
+        }
+        double * src = (double*)PyArray_DATA((PyArrayObject*)arr);
+        for (unsigned int ii = 0; ii < size; ++ii){
+            data[ii * stride] = src[ii];
+        }
+        Py_DECREF(arr);
+        Py_RETURN_NONE;
+    }
+
     /**
        This should not be required or accessible to the user. Put here
        for debugging threading issue.
@@ -2522,6 +2757,8 @@ extern "C" {
 	{"readSBML",  (PyCFunction)moose_readSBML,  METH_VARARGS, "Import SBML model to Moose."},
         {"loadModel", (PyCFunction)moose_loadModel, METH_VARARGS, moose_loadModel_documentation},
         {"saveModel", (PyCFunction)moose_saveModel, METH_VARARGS, moose_saveModel_documentation},
+        {"saveCheckpoint", (PyCFunction)moose_saveCheckpoint, METH_VARARGS, moose_saveCheckpoint_documentation},
+        {"restoreCheckpoint", (PyCFunction)moose_restoreCheckpoint, METH_VARARGS, moose_restoreCheckpoint_documentation},
         {"connect", (PyCFunction)moose_connect, METH_VARARGS, moose_connect_documentation},        
         {"getCwe", (PyCFunction)moose_getCwe, METH_VARARGS, "Get the current working element. 'pwe' is an alias of this function."},
         // {"pwe", (PyCFunction)moose_getCwe, METH_VARARGS, "Get the current working element. 'getCwe' is an alias of this function."},
@@ -2533,6 +2770,8 @@ extern "C" {
         {"seed", (PyCFunction)moose_seed, METH_VARARGS, moose_seed_documentation},
         {"rand", (PyCFunction)moose_rand, METH_NOARGS, moose_rand_documentation},
         {"wildcardFind", (PyCFunction)moose_wildcardFind, METH_VARARGS, moose_wildcardFind_documentation},
+        {"getNvec", (PyCFunction)moose_getNvec, METH_VARARGS, moose_getNvec_documentation},
+        {"setNvec", (PyCFunction)moose_setNvec, METH_VARARGS, moose_setNvec_documentation},
         {"quit", (PyCFunction)moose_quit, METH_NOARGS, "Finalize MOOSE threads and quit MOOSE. This is made available for"
          " debugging purpose only. It will automatically get called when moose"
          " module is unloaded. End user should not use this function."},
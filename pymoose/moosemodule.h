@@ -244,6 +244,8 @@ extern "C" {
     PyObject * moose_exists(PyObject * dummy, PyObject * args);
     PyObject * moose_loadModel(PyObject * dummy, PyObject * args);
     PyObject * moose_saveModel(PyObject * dummy, PyObject * args);
+    PyObject * moose_saveCheckpoint(PyObject * dummy, PyObject * args);
+    PyObject * moose_restoreCheckpoint(PyObject * dummy, PyObject * args);
     PyObject * moose_writeSBML(PyObject * dummy, PyObject * args);
     PyObject * moose_readSBML(PyObject * dummy, PyObject * args);
     PyObject * moose_setCwe(PyObject * dummy, PyObject * args);
@@ -257,6 +259,8 @@ extern "C" {
     PyObject * moose_syncDataHandler(PyObject * dummy, PyObject * target);
     PyObject * moose_seed(PyObject * dummy, PyObject * args);
     PyObject * moose_wildcardFind(PyObject * dummy, PyObject * args);
+    PyObject * moose_getNvec(PyObject * dummy, PyObject * args);
+    PyObject * moose_setNvec(PyObject * dummy, PyObject * args);
     // This should not be required or accessible to the user. Put here
     // for debugging threading issue.
     PyObject * moose_quit(PyObject * dummy);
@@ -876,7 +876,16 @@ extern "C" {
         switch(ftype){
             case 'd': {//SET_VECFIELD(double, d)
                 vector<double> _value;
-                if (is_seq){
+                if (PyArray_Check(value)){
+                    // One copy out of a numpy array, no per item lookup.
+                    PyObject * arr = PyArray_FROMANY(value, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+                    if (arr == NULL){
+                        return -1;
+                    }
+                    double * data = (double*)PyArray_DATA((PyArrayObject*)arr);
+                    _value.assign(data, data + PyArray_SIZE((PyArrayObject*)arr));
+                    Py_DECREF(arr);
+                } else if (is_seq){
                     for (unsigned int ii = 0; ii < length; ++ii){
                         double v = PyFloat_AsDouble(PySequence_GetItem(value, ii));
                         _value.push_back(v);
@@ -0,0 +1,70 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include "RandomStream.h"
+
+/// Odd constant close to 2^64 / golden ratio. Steps the counter.
+static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t mix64( uint64_t z )
+{
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+	return z ^ ( z >> 31 );
+}
+
+RandomStream::RandomStream()
+{
+	setSeed( 0, 0 );
+}
+
+RandomStream::RandomStream( unsigned long seed, unsigned long stream )
+{
+	setSeed( seed, stream );
+}
+
+void RandomStream::setSeed( unsigned long seed, unsigned long stream )
+{
+	// Hash twice so that neighbouring seeds and streams are unrelated.
+	key_ = mix64( mix64( seed ) + GOLDEN_GAMMA * ( stream + 1 ) );
+	counter_ = 0;
+}
+
+uint64_t RandomStream::next()
+{
+	++counter_;
+	return mix64( key_ + counter_ * GOLDEN_GAMMA );
+}
+
+double RandomStream::uniform()
+{
+	return ( next() >> 11 ) * ( 1.0 / 9007199254740992.0 ); // 2^53
+}
+
+unsigned long RandomStream::genInt32()
+{
+	return static_cast< unsigned long >( next() >> 32 );
+}
+
+void RandomStream::skip( unsigned long n )
+{
+	counter_ += n;
+}
+
+void RandomStream::getState( uint64_t& key, uint64_t& counter ) const
+{
+	key = key_;
+	counter = counter_;
+}
+
+void RandomStream::setState( uint64_t key, uint64_t counter )
+{
+	key_ = key;
+	counter_ = counter;
+}
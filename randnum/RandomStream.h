@@ -0,0 +1,59 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#ifndef _RANDOM_STREAM_H
+#define _RANDOM_STREAM_H
+
+#include <stdint.h>
+
+/**
+ * Counter-based random number stream. Each number is a hash of a key
+ * and a counter, so the whole state is just two integers. The key is
+ * made from a seed and a stream index, so that every voxel or object
+ * can own its own stream, which gives the same numbers however the
+ * objects are ordered or split between threads and nodes.
+ * Unlike mtrand(), it is safe for different threads to use different
+ * streams at the same time.
+ *
+ * The hash is the finalizer from SplitMix64 (Steele, Lea and Flood,
+ * 2014) which passes BigCrush. Streams start at hashed offsets in a
+ * 2^64 cycle, so they will not overlap in any practical run.
+ */
+class RandomStream
+{
+	public:
+		/// Stream 0 of seed 0.
+		RandomStream();
+		RandomStream( unsigned long seed, unsigned long stream );
+
+		/// Restarts the stream for the specified seed and stream index.
+		void setSeed( unsigned long seed, unsigned long stream );
+
+		/// Returns a random number in [0,1), with 53 bits of resolution.
+		double uniform();
+
+		/// Returns a random integer in [0, 0xffffffff].
+		unsigned long genInt32();
+
+		/// Jumps ahead by n numbers, in constant time.
+		void skip( unsigned long n );
+
+		/// Returns the whole state, so that the stream can be resumed.
+		void getState( uint64_t& key, uint64_t& counter ) const;
+		/// Resumes the stream from a state given by getState.
+		void setState( uint64_t key, uint64_t counter );
+
+	private:
+		uint64_t next();
+
+		uint64_t key_;
+		uint64_t counter_;
+};
+
+#endif // _RANDOM_STREAM_H
@@ -255,3 +255,25 @@ double mtrand(void)
     return genrand_int32()*(1.0/4294967296.0); 
     /* divided by 2^32 */
 }
+
+/* Number of words in the state of the generator, for mtgetstate */
+unsigned int mtstatesize(void)
+{
+    return N + 1;
+}
+
+/* Copies out the state of the generator: the N words and the index */
+void mtgetstate(unsigned long* s)
+{
+    for (int i = 0; i < N; i++)
+        s[i] = mt[i];
+    s[N] = mti;
+}
+
+/* Puts back a state from mtgetstate */
+void mtsetstate(const unsigned long* s)
+{
+    for (int i = 0; i < N; i++)
+        mt[i] = s[i] & 0xffffffffUL;
+    mti = s[N] > N + 1 ? N + 1 : s[N];
+}
@@ -12,4 +12,7 @@
 extern double mtrand(void);
 extern void mtseed(long seed);
 extern unsigned long genrand_int32(void);
+extern unsigned int mtstatesize(void);
+extern void mtgetstate(unsigned long* s);
+extern void mtsetstate(const unsigned long* s);
 
@@ -48,11 +48,41 @@
  * 		retain their state, the simulation can resume smoothly.
  */
 
+#include <set>
 #include "header.h"
 #include "Clock.h"
 
 const unsigned int Clock::numTicks = 10;
 
+/**
+ * Runs the target groups of one tick on each thread of the Clock
+ * ThreadPool. The groups differ a great deal in size, so rather than
+ * giving each thread a fixed block the threads take the next group
+ * off a shared counter whenever they are free.
+ */
+class ClockTickJob: public ThreadJob
+{
+	public:
+		ClockTickJob( const Clock* clock, unsigned int tick,
+			unsigned int numGroups, ProcPtr p )
+			: clock_( clock ), tick_( tick ), numGroups_( numGroups ),
+			next_( 0 ), p_( p )
+		{;}
+
+		void runThread( unsigned int threadIndex, unsigned int numThreads )
+		{
+			for ( unsigned int g = __sync_fetch_and_add( &next_, 1 );
+				g < numGroups_; g = __sync_fetch_and_add( &next_, 1 ) )
+				clock_->processGroup( tick_, g, p_ );
+		}
+	private:
+		const Clock* clock_;
+		unsigned int tick_;
+		unsigned int numGroups_;
+		unsigned int next_;
+		ProcPtr p_;
+};
+
 ///////////////////////////////////////////////////////
 // MsgSrc definitions
 ///////////////////////////////////////////////////////
@@ -172,6 +202,19 @@ const Cinfo* Clock::initCinfo()
 			&Clock::setTickDt,
 			&Clock::getTickDt
 		);
+		static ValueFinfo< Clock, unsigned int > numThreads(
+			"numThreads",
+			"Number of threads used for the process calls of each tick. "
+			"The targets of a tick are split into groups that have no "
+			"messages between them, and the groups are shared out "
+			"among the threads. Each group runs in the usual order, so "
+			"results are identical to the single-threaded run. Objects "
+			"that share state other than through messages, such as a "
+			"random number generator, should stay at 1. "
+			"Defaults to 1.",
+			&Clock::setNumThreads,
+			&Clock::getNumThreads
+		);
 	///////////////////////////////////////////////////////
 	// Shared definitions
 	///////////////////////////////////////////////////////
@@ -245,6 +288,7 @@ const Cinfo* Clock::initCinfo()
 		&isRunning,			// ReadOnlyValue
 		&tickStep,			// LookupValue
 		&tickDt,			// LookupValue
+		&numThreads,		// Value
 		&clockControl,		// Shared
 		finished(),			// Src
 		&proc0,				// Src
@@ -320,7 +364,9 @@ Clock::Clock()
 	  isRunning_( false ),
 	  doingReinit_( false ),
 	  info_(),
-	  ticks_( Clock::numTicks, 0 )
+	  ticks_( Clock::numTicks, 0 ),
+	  isTicksChanged_( true ),
+	  rewireCount_( 0 )
 {
 }
 ///////////////////////////////////////////////////
@@ -333,6 +379,7 @@ void Clock::setDt( double v)
 		return;
 	}
 	dt_ = v;
+	isTicksChanged_ = true;
 }
 
 double Clock::getDt() const
@@ -374,6 +421,21 @@ vector< double > Clock::getDts() const
 	return ret;
 }
 
+void Clock::setNumThreads( unsigned int num )
+{
+	if ( isRunning_ || doingReinit_ ) {
+		cout << "Warning: Clock::setNumThreads: Cannot change threads while simulation is running\n";
+		return;
+	}
+	threads_.setNumThreads( num );
+	isTicksChanged_ = true;
+}
+
+unsigned int Clock::getNumThreads() const
+{
+	return threads_.getNumThreads();
+}
+
 bool Clock::isRunning() const
 {
 	return isRunning_;
@@ -402,8 +464,10 @@ bool Clock::checkTickNum( const string& funcName, unsigned int i ) const
 
 void Clock::setTickStep( unsigned int i, unsigned int v )
 {
-	if ( checkTickNum( "setTickStep", i ) )
+	if ( checkTickNum( "setTickStep", i ) ) {
 		ticks_[i] = v;
+		isTicksChanged_ = true;
+	}
 }
 unsigned int Clock::getTickStep( unsigned int i ) const
 {
@@ -432,6 +496,7 @@ void Clock::setTickDt( unsigned int i, double v )
 
 	if ( checkTickNum( "setTickDt", i ) )
 		ticks_[i] = round( v / dt_ );
+	isTicksChanged_ = true;
 }
 
 double Clock::getTickDt( unsigned int i ) const
@@ -493,6 +558,206 @@ void Clock::buildTicks( const Eref& e )
 			activeTicksMap_.push_back( i );
 		}
 	}
+	if ( threads_.getNumThreads() > 1 )
+		buildGroups( e );
+	isTicksChanged_ = false;
+	rewireCount_ = Element::getRewireCount();
+}
+
+/**
+ * Union-find lookup with path halving.
+ */
+static unsigned int findRoot( vector< unsigned int >& root, unsigned int i )
+{
+	while ( root[i] != i ) {
+		root[i] = root[ root[i] ];
+		i = root[i];
+	}
+	return i;
+}
+
+/**
+ * Identifies the object that a message to this Eref would change.
+ * Fields such as Synapses are part of their parent's data, so they map
+ * onto the parent. Elements that get messages to ALLDATA are treated as
+ * one object.
+ */
+static pair< Element*, unsigned int > conflictKey( const Eref& er,
+	const set< Element* >& whole )
+{
+	Element* e = er.element();
+	if ( e->hasFields() ) {
+		unsigned int i = er.dataIndex() == ALLDATA ? 0 : er.dataIndex();
+		e = Neutral::parent( ObjId( e->id(), i ) ).element();
+	}
+	if ( er.dataIndex() == ALLDATA || whole.find( e ) != whole.end() )
+		return pair< Element*, unsigned int >( e, ALLDATA );
+	return pair< Element*, unsigned int >( e, er.dataIndex() );
+}
+
+/**
+ * True if the entries of the element share data without messages, so
+ * that they must all run in one group. The only such class is the Func,
+ * whose bulk groups are evaluated and sent by one entry for all.
+ */
+static bool sharesData( const Element* e )
+{
+	if ( !e->cinfo()->isA( "Func" ) )
+		return false;
+	unsigned int start = e->localDataStart();
+	unsigned int end = start + e->numLocalData();
+	for ( unsigned int i = start; i < end; ++i )
+		if ( Field< bool >::get( ObjId( e->id(), i ), "useBulk" ) )
+			return true;
+	return false;
+}
+
+/**
+ * Splits the targets of each active tick into groups that can run at
+ * the same time. Two targets go in the same group if either of them
+ * sends a message to the other, or both send to the same object. The
+ * calls within a group keep the order of the serial send, so that
+ * anything that depends on the update order within a tick comes out the
+ * same.
+ *
+ * Only direct messages from the targets are looked at. Objects that
+ * send on further messages from inside a message handler, or that
+ * share data without messages, should not be run with threads. The
+ * exception is a Func array evaluated in bulk, which is kept whole.
+ *
+ * This also brings all the message digests up to date, as they would
+ * otherwise be rebuilt on the first send, which is not safe from
+ * threads.
+ */
+void Clock::buildGroups( const Eref& e )
+{
+	tickFunc_.resize( activeTicks_.size() );
+	tickTarget_.resize( activeTicks_.size() );
+	groupStart_.resize( activeTicks_.size() );
+	for ( unsigned int i = 0; i < activeTicks_.size(); ++i ) {
+		vector< const OpFunc1Base< ProcPtr >* > func;
+		vector< Eref > target;
+		const vector< MsgDigest >& md =
+			e.msgDigest( processVec()[ activeTicksMap_[i] ]->getBindIndex() );
+		for ( vector< MsgDigest >::const_iterator
+			j = md.begin(); j != md.end(); ++j ) {
+			const OpFunc1Base< ProcPtr >* f =
+				dynamic_cast< const OpFunc1Base< ProcPtr >* >( j->func );
+			assert( f );
+			for ( vector< Eref >::const_iterator
+				k = j->targets.begin(); k != j->targets.end(); ++k ) {
+				if ( k->dataIndex() == ALLDATA ) {
+					Element* te = k->element();
+					unsigned int start = te->localDataStart();
+					unsigned int end = start + te->numLocalData();
+					for ( unsigned int q = start; q < end; ++q ) {
+						func.push_back( f );
+						target.push_back( Eref( te, q ) );
+					}
+				} else {
+					func.push_back( f );
+					target.push_back( *k );
+				}
+			}
+		}
+
+		// Collect the outgoing message targets of each entry.
+		vector< vector< Eref > > dests( target.size() );
+		set< Element* > whole;
+		set< Element* > checked;
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			Element* te = target[j].element();
+			if ( checked.insert( te ).second && sharesData( te ) )
+				whole.insert( te );
+		}
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			unsigned int numBind = target[j].element()->cinfo()->numBindIndex();
+			for ( unsigned int b = 0; b < numBind; ++b ) {
+				const vector< MsgDigest >& tmd = target[j].msgDigest( b );
+				for ( vector< MsgDigest >::const_iterator
+					k = tmd.begin(); k != tmd.end(); ++k ) {
+					for ( vector< Eref >::const_iterator q =
+						k->targets.begin(); q != k->targets.end(); ++q ) {
+						Element* de = q->element();
+						// Handlers may send on in turn.
+						if ( de->cinfo()->numBindIndex() > 0 )
+							de->msgDigest( 0 );
+						if ( q->dataIndex() == ALLDATA )
+							whole.insert( de );
+						dests[j].push_back( *q );
+					}
+				}
+			}
+		}
+
+		// Union-find over the objects touched by each entry.
+		map< pair< Element*, unsigned int >, unsigned int > node;
+		vector< unsigned int > root( target.size() );
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			root[j] = j;
+			pair< Element*, unsigned int > key =
+				conflictKey( target[j], whole );
+			map< pair< Element*, unsigned int >, unsigned int >::iterator
+				n = node.find( key );
+			if ( n == node.end() )
+				node[ key ] = j;
+			else
+				root[ findRoot( root, j ) ] = findRoot( root, n->second );
+		}
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			for ( vector< Eref >::const_iterator
+				k = dests[j].begin(); k != dests[j].end(); ++k ) {
+				pair< Element*, unsigned int > key = conflictKey( *k, whole );
+				map< pair< Element*, unsigned int >, unsigned int >::iterator
+					n = node.find( key );
+				if ( n == node.end() )
+					node[ key ] = j;
+				else
+					root[ findRoot( root, j ) ] = findRoot( root, n->second );
+			}
+		}
+
+		// Number the groups by their first entry, and sort the entries
+		// by group, keeping the original order within each group.
+		vector< unsigned int > groupOf( target.size() );
+		vector< unsigned int > groupSize;
+		map< unsigned int, unsigned int > groupIndex;
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			unsigned int r = findRoot( root, j );
+			map< unsigned int, unsigned int >::iterator g =
+				groupIndex.find( r );
+			if ( g == groupIndex.end() ) {
+				groupOf[j] = groupSize.size();
+				groupIndex[r] = groupSize.size();
+				groupSize.push_back( 1 );
+			} else {
+				groupOf[j] = g->second;
+				++groupSize[ g->second ];
+			}
+		}
+		groupStart_[i].assign( 1, 0 );
+		for ( unsigned int g = 0; g < groupSize.size(); ++g )
+			groupStart_[i].push_back( groupStart_[i].back() + groupSize[g] );
+		vector< unsigned int > pos( groupStart_[i].begin(),
+			groupStart_[i].end() - 1 );
+		tickFunc_[i].resize( target.size() );
+		tickTarget_[i].resize( target.size(), Eref( e.element(), 0 ) );
+		for ( unsigned int j = 0; j < target.size(); ++j ) {
+			unsigned int k = pos[ groupOf[j] ]++;
+			tickFunc_[i][k] = func[j];
+			tickTarget_[i][k] = target[j];
+		}
+	}
+}
+
+void Clock::processGroup( unsigned int tick, unsigned int group,
+	ProcPtr p ) const
+{
+	const vector< const OpFunc1Base< ProcPtr >* >& func = tickFunc_[ tick ];
+	const vector< Eref >& target = tickTarget_[ tick ];
+	unsigned int end = groupStart_[ tick ][ group + 1 ];
+	for ( unsigned int j = groupStart_[ tick ][ group ]; j < end; ++j )
+		func[j]->op( target[j], p );
 }
 
 /**
@@ -512,7 +777,8 @@ void Clock::handleStep( const Eref& e, unsigned int numSteps )
 		cout << "Clock::handleStart: Warning: simulation already in progress.\n Command ignored\n";
 		return;
 	}
-	buildTicks( e );
+	if ( isTicksChanged_ || rewireCount_ != Element::getRewireCount() )
+		buildTicks( e );
 	assert( currentStep_ == nSteps_ );
 	nSteps_ += numSteps;
 	runTime_ = nSteps_ * dt_;
@@ -522,12 +788,17 @@ void Clock::handleStep( const Eref& e, unsigned int numSteps )
 		// Curr time is end of current step.
 		unsigned int endStep = currentStep_ + 1;
 		currentTime_ = info_.currTime = dt_ * endStep;
-		vector< unsigned int >::const_iterator k = activeTicksMap_.begin();
-		for ( vector< unsigned int>::iterator j = 
-			activeTicks_.begin(); j != activeTicks_.end(); ++j ) {
-			if ( endStep % *j == 0 ) {
-				info_.dt = *j * dt_;
-				processVec()[*k++]->send( e, &info_ );
+		for ( unsigned int j = 0; j < activeTicks_.size(); ++j ) {
+			if ( endStep % activeTicks_[j] == 0 ) {
+				info_.dt = activeTicks_[j] * dt_;
+				if ( threads_.getNumThreads() == 1 ||
+						groupStart_[j].size() < 3 ) {
+					processVec()[ activeTicksMap_[j] ]->send( e, &info_ );
+				} else {
+					ClockTickJob job( this, j,
+						groupStart_[j].size() - 1, &info_ );
+					threads_.run( &job );
+				}
 			}
 		}
 	}
@@ -536,6 +807,17 @@ void Clock::handleStep( const Eref& e, unsigned int numSteps )
 	finished()->send( e );
 }
 
+void Clock::restoreStep( unsigned int step )
+{
+	if ( isRunning_ || doingReinit_ ) {
+		cout << "Warning: Clock::restoreStep: Cannot change the time while simulation is running\n";
+		return;
+	}
+	currentStep_ = nSteps_ = step;
+	currentTime_ = info_.currTime = dt_ * step;
+	runTime_ = currentTime_;
+}
+
 /**
  * This is the dest function that sets off the reinit.
  */
@@ -10,6 +10,8 @@
 #ifndef _CLOCK_H
 #define _CLOCK_H
 
+#include "../basecode/ThreadPool.h"
+
 /**
  * Clock now uses integral scheduling. The Clock has an array of child
  * Ticks, each of which controls the process and reinit calls of its 
@@ -20,11 +22,20 @@
  * of execution of target objects is undefined.
  *
  * The Reinit call goes through all Ticks in order.
+ *
+ * With numThreads > 1 the process calls of each Tick are spread over a
+ * pool of threads. The targets of a Tick are split into groups that
+ * have no messages between them, and each group is run by one thread
+ * in the original order, so the results are the same as the serial
+ * run. Ticks still go off one after another, with a barrier between
+ * them.
  */
 
 class Clock
 {
 	friend void testClock();
+	friend void testClockThreads();
+	friend void testFuncBulk();
 	public:
 		Clock();
 
@@ -44,6 +55,9 @@ class Clock
 		double getTickDt( unsigned int i ) const;
 
 		vector< double > getDts() const;
+
+		void setNumThreads( unsigned int num );
+		unsigned int getNumThreads() const;
 		
 		//////////////////////////////////////////////////////////
 		//  Dest functions
@@ -63,6 +77,13 @@ class Clock
 		/// dest function for message to trigger reinit.
 		void handleReinit( const Eref& e );
 
+		/**
+		 * Moves the clock to the end of the specified step, as if a
+		 * run had just stopped there. Used to resume from a checkpoint.
+		 * Only allowed between runs.
+		 */
+		void restoreStep( unsigned int step );
+
 		///////////////////////////////////////////////////////////////
 		// Stuff for new scheduling.
 		///////////////////////////////////////////////////////////////
@@ -94,8 +115,23 @@ class Clock
 		/// Utility func to range-check when Ticks are being changed.
 		bool checkTickNum( const string& funcName, unsigned int i ) const;
 
+		/// Runs one group of targets of an active tick, in order.
+		void processGroup( unsigned int tick, unsigned int group,
+			ProcPtr p ) const;
+
 	private:
+		/**
+		 * Finds the active ticks and their groups. Called on reinit,
+		 * and on start or step only if the ticks, dt, the number of
+		 * threads or any messages have changed since the last call.
+		 */
 		void buildTicks( const Eref& e );
+
+		/**
+		 * Fills in the target groups of each active tick, for the
+		 * threaded process loop.
+		 */
+		void buildGroups( const Eref& e );
 		double runTime_;
 		double currentTime_;
 		unsigned int nSteps_;
@@ -135,6 +171,25 @@ class Clock
 		 */
 		vector< unsigned int > activeTicksMap_;
 
+		/**
+		 * Targets of the process call of each active tick, in the order
+		 * the serial send would visit them, but sorted by group. Group g
+		 * of active tick i runs from groupStart_[i][g] to
+		 * groupStart_[i][g+1].
+		 */
+		vector< vector< const OpFunc1Base< ProcPtr >* > > tickFunc_;
+		vector< vector< Eref > > tickTarget_;
+		vector< vector< unsigned int > > groupStart_;
+
+		/// Threads for the process calls. One thread means serial.
+		ThreadPool threads_;
+
+		/// True if the ticks, dt or threads changed since buildTicks.
+		bool isTicksChanged_;
+
+		/// Element::getRewireCount as of the last buildTicks.
+		unsigned int rewireCount_;
+
 		/**
 		 * number of Ticks.
 		 */
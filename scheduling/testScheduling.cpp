@@ -169,9 +169,93 @@ void testClock()
 	cout << "." << flush;
 }
 
+/**
+ * Runs chains of Arith objects in which each entry feeds its output to
+ * itself and to the next entry. The result depends on the update order
+ * within the tick, so the threaded run only matches the serial one if
+ * each chain is kept together and in order. Leaves the model in place.
+ */
+static const unsigned int numChains = 5;
+static const unsigned int chainLength = 7;
+
+static vector< double > runArithChains( unsigned int numThreads )
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id clock( 1 );
+	Id nid = shell->doCreate( "Neutral", Id(), "chains", 1 );
+	vector< Id > chains;
+	for ( unsigned int i = 0; i < numChains; ++i ) {
+		stringstream ss;
+		ss << "a" << i;
+		Id a = shell->doCreate( "Arith", nid, ss.str(), chainLength );
+		ObjId mid = shell->doAddMsg( "OneToOne", a, "output", a, "arg1" );
+		assert( !mid.bad() );
+		mid = shell->doAddMsg( "Diagonal", a, "output", a, "arg3" );
+		assert( !mid.bad() );
+		chains.push_back( a );
+		// A wildcard would give a clock message for every entry.
+		shell->doUseClock( "/chains/" + ss.str(), "process", 0 );
+	}
+	shell->doSetClock( 0, 1.0 );
+	Field< unsigned int >::set( clock, "numThreads", numThreads );
+	assert( Field< unsigned int >::get( clock, "numThreads" ) ==
+		numThreads );
+	shell->doReinit();
+	for ( unsigned int i = 0; i < numChains; ++i )
+		for ( unsigned int j = 0; j < chainLength; ++j )
+			LookupField< unsigned int, double >::set( ObjId( chains[i], j ),
+				"anyValue", 2, 0.1 * ( i + j + 1 ) );
+	shell->doStart( 10.0 );
+
+	vector< double > ret;
+	for ( unsigned int i = 0; i < numChains; ++i )
+		for ( unsigned int j = 0; j < chainLength; ++j )
+			ret.push_back( Field< double >::get( ObjId( chains[i], j ),
+				"outputValue" ) );
+	return ret;
+}
+
+/**
+ * Check that the threaded Clock gives the same results as the serial one.
+ */
+void testClockThreads()
+{
+	Shell* shell = reinterpret_cast< Shell* >( Id().eref().data() );
+	Id clock( 1 );
+	vector< double > serial = runArithChains( 1 );
+	shell->doDelete( Id( "/chains" ) );
+	vector< double > threaded = runArithChains( 4 );
+
+	// Each chain is one group, in order.
+	Clock* cdata = reinterpret_cast< Clock* >( clock.eref().data() );
+	assert( cdata->groupStart_.size() == 1 );
+	assert( cdata->groupStart_[0].size() == numChains + 1 );
+	for ( unsigned int i = 0; i <= numChains; ++i )
+		assert( cdata->groupStart_[0][i] == i * chainLength );
+
+	// The groups are kept from one start to the next, but a new message
+	// joining two chains must be seen without a reinit.
+	assert( !cdata->isTicksChanged_ );
+	assert( cdata->rewireCount_ == Element::getRewireCount() );
+	shell->doAddMsg( "Single", ObjId( Id( "/chains/a0" ), 0 ), "output",
+		ObjId( Id( "/chains/a1" ), 0 ), "arg2" );
+	shell->doStart( 1.0 );
+	assert( cdata->groupStart_[0].size() == numChains );
+	Field< unsigned int >::set( clock, "numThreads", 1 );
+	shell->doDelete( Id( "/chains" ) );
+
+	assert( serial.size() == threaded.size() );
+	for ( unsigned int i = 0; i < serial.size(); ++i )
+		assert( serial[i] == threaded[i] );
+	// The head of each chain just sums its arg2 each step.
+	assert( doubleEq( serial[0], 1.0 ) );
+	cout << "." << flush;
+}
+
 void testScheduling()
 {
 	testClock();
+	testClockThreads();
 }
 
 void testSchedulingProcess()
@@ -0,0 +1,461 @@
+/**********************************************************************
+** This program is part of 'MOOSE', the
+** Messaging Object Oriented Simulation Environment.
+**           Copyright (C) 2003-2014 Upinder S. Bhalla. and NCBS
+** It is made available under the terms of the
+** GNU Lesser General Public License version 2.1
+** See the file COPYING.LIB for the full notice.
+**********************************************************************/
+
+#include <fstream>
+#include "header.h"
+#include "Shell.h"
+#include "Wildcard.h"
+#include "../scheduling/Clock.h"
+#include "SparseMatrix.h"
+#include "../ksolve/KinSparseMatrix.h"
+#ifdef USE_GSL
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_odeiv2.h>
+#endif
+#include "../ksolve/OdeSystem.h"
+#include "../ksolve/VoxelPoolsBase.h"
+#include "../ksolve/VoxelPools.h"
+#include "../ksolve/ZombiePoolInterface.h"
+#include "../ksolve/Ksolve.h"
+#include "../randnum/randnum.h"
+#include "../randnum/RandomStream.h"
+#include "../ksolve/PropensitySelector.h"
+#include "../ksolve/GssaSystem.h"
+#include "../ksolve/GssaVoxelPools.h"
+#include "../ksolve/Gsolve.h"
+#include "../diffusion/DiffPoolVec.h"
+#include "../diffusion/DiffBatch.h"
+#include "../diffusion/Dsolve.h"
+#include "../biophysics/HHGate.h"
+#include "../biophysics/SpikeRingBuffer.h"
+#include "../biophysics/Synapse.h"
+#include "../biophysics/SynHandler.h"
+#include "../biophysics/SpikeRouter.h"
+#include "../biophysics/IntFire.h"
+#include "../biophysics/SpikeGen.h"
+#include "../biophysics/ChanBase.h"
+#include "../biophysics/SynChanBase.h"
+#include "../biophysics/SynChan.h"
+#include "../hsolve/HSolve.h"
+
+/**
+ * A checkpoint file holds, in the native byte order:
+ *	The magic string and the version.
+ *	The Clock: base dt, the step of each tick, and the current step.
+ *	The state of the global random number generator behind mtrand.
+ *	The number of Elements, and then for each Element its path, class,
+ *	numData and number of messages, followed by its state as an array
+ *	of doubles.
+ * Each array is written as its size followed by the raw data, so that
+ * the state of a solver goes out and comes back in one block.
+ */
+static const char CHECKPOINT_MAGIC[] = "MOOSECKP";
+static const unsigned int CHECKPOINT_VERSION = 2;
+
+/**
+ * Objects that are not in a solver keep their state in these fields.
+ * Everything else about them is set up by the model script, and is
+ * not saved.
+ */
+static const char* stateFields[][4] = {
+	{ "Pool", "n", "nInit", 0 },
+	{ "BufPool", "n", "nInit", 0 },
+	{ "Compartment", "Vm", 0, 0 },
+	{ "SymCompartment", "Vm", 0, 0 },
+	{ "HHChannel", "X", "Y", "Z" },
+	{ "CaConc", "Ca", 0, 0 },
+	{ "IntFire", "Vm", 0, 0 },
+	{ "StimulusTable", "stepPosition", 0, 0 },
+};
+
+namespace {
+	class CheckpointReader
+	{
+		public:
+			CheckpointReader( ifstream& fin )
+				: pos_( 0 ), ok_( true )
+			{
+				fin.seekg( 0, ios::end );
+				buf_.resize( fin.tellg() );
+				fin.seekg( 0, ios::beg );
+				if ( buf_.size() > 0 )
+					fin.read( &buf_[0], buf_.size() );
+				ok_ = fin.good();
+			}
+			bool ok() const {
+				return ok_;
+			}
+			const char* take( unsigned int n ) {
+				if ( !ok_ || pos_ + n > buf_.size() ) {
+					ok_ = false;
+					return 0;
+				}
+				pos_ += n;
+				return &buf_[ pos_ - n ];
+			}
+			unsigned int readUint() {
+				unsigned int ret = 0;
+				const char* p = take( sizeof( unsigned int ) );
+				if ( p )
+					memcpy( &ret, p, sizeof( unsigned int ) );
+				return ret;
+			}
+			double readDouble() {
+				double ret = 0.0;
+				const char* p = take( sizeof( double ) );
+				if ( p )
+					memcpy( &ret, p, sizeof( double ) );
+				return ret;
+			}
+			string readString() {
+				unsigned int n = readUint();
+				const char* p = take( n );
+				return p ? string( p, n ) : string();
+			}
+			void readDoubles( vector< double >& ret ) {
+				unsigned int n = readUint();
+				const char* p = take( n * sizeof( double ) );
+				ret.resize( p ? n : 0 );
+				if ( p && n > 0 )
+					memcpy( &ret[0], p, n * sizeof( double ) );
+			}
+		private:
+			vector< char > buf_;
+			unsigned int pos_;
+			bool ok_;
+	};
+}
+
+static void writeUint( ofstream& fout, unsigned int v )
+{
+	fout.write( reinterpret_cast< const char* >( &v ), sizeof( v ) );
+}
+
+static void writeDouble( ofstream& fout, double v )
+{
+	fout.write( reinterpret_cast< const char* >( &v ), sizeof( v ) );
+}
+
+static void writeString( ofstream& fout, const string& s )
+{
+	writeUint( fout, s.length() );
+	fout.write( s.c_str(), s.length() );
+}
+
+static void writeDoubles( ofstream& fout, const vector< double >& v )
+{
+	writeUint( fout, v.size() );
+	if ( v.size() > 0 )
+		fout.write( reinterpret_cast< const char* >( &v[0] ),
+			v.size() * sizeof( double ) );
+}
+
+/// Returns the model and all Elements under it, in a fixed order.
+static void checkpointElements( Id model, vector< Id >& ret )
+{
+	vector< ObjId > list;
+	wildcardFind( model.path() + "/##", list );
+	ret.assign( 1, model );
+	for ( vector< ObjId >::iterator
+		i = list.begin(); i != list.end(); ++i ) {
+		if ( i->id != ret.back() )
+			ret.push_back( i->id );
+	}
+}
+
+static unsigned int findStateFields( const string& className )
+{
+	unsigned int num = sizeof( stateFields ) / sizeof( stateFields[0] );
+	for ( unsigned int i = 0; i < num; ++i )
+		if ( className == stateFields[i][0] )
+			return i;
+	return num;
+}
+
+/**
+ * The solvers, Tables and the spiking objects save each entry as a
+ * block, prefixed by its size.
+ */
+static bool hasStateBlocks( const string& className )
+{
+	return ( className == "Ksolve" || className == "Gsolve" ||
+		className == "Dsolve" || className == "HSolve" ||
+		className == "Table" || className == "IntFire" ||
+		className == "SynChan" || className == "SpikeGen" );
+}
+
+/**
+ * Appends the state of all entries of the Element to s. Solvers fill
+ * in their own blocks, each entry prefixed by its size. Other objects
+ * go one field at a time, with the values of all entries together.
+ */
+static void getElementState( Id id, vector< double >& s )
+{
+	const Element* elm = id.element();
+	const string& className = elm->cinfo()->name();
+	unsigned int num = elm->numData();
+	for ( unsigned int i = 0; i < num; ++i ) {
+		char* data = ObjId( id, i ).data();
+		vector< double > block;
+		if ( className == "Ksolve" )
+			reinterpret_cast< const Ksolve* >( data )->getState( block );
+		else if ( className == "Gsolve" )
+			reinterpret_cast< const Gsolve* >( data )->getState( block );
+		else if ( className == "Dsolve" )
+			reinterpret_cast< const Dsolve* >( data )->getState( block );
+		else if ( className == "HSolve" )
+			reinterpret_cast< const HSolve* >( data )->getState( block );
+		else if ( className == "IntFire" )
+			reinterpret_cast< const IntFire* >( data )->getState( block );
+		else if ( className == "SynChan" )
+			reinterpret_cast< const SynChan* >( data )->getState( block );
+		else if ( className == "SpikeGen" )
+			reinterpret_cast< const SpikeGen* >( data )->getState( block );
+		else if ( className == "Table" )
+			block = Field< vector< double > >::get( ObjId( id, i ),
+				"vector" );
+		else
+			break;
+		s.push_back( block.size() );
+		s.insert( s.end(), block.begin(), block.end() );
+	}
+
+	unsigned int k = findStateFields( className );
+	if ( k == sizeof( stateFields ) / sizeof( stateFields[0] ) )
+		return;
+	for ( unsigned int j = 1; j < 4 && stateFields[k][j]; ++j ) {
+		vector< double > val;
+		Field< double >::getVec( id, stateFields[k][j], val );
+		assert( val.size() == num );
+		s.insert( s.end(), val.begin(), val.end() );
+	}
+}
+
+/// Reads back the state from getElementState. Returns false on a mismatch.
+static bool setElementState( Id id, const vector< double >& s )
+{
+	const Element* elm = id.element();
+	const string& className = elm->cinfo()->name();
+	unsigned int num = elm->numData();
+	unsigned int pos = 0;
+	bool isBlock = hasStateBlocks( className );
+	for ( unsigned int i = 0; isBlock && i < num; ++i ) {
+		if ( pos >= s.size() || pos + 1 + s[pos] > s.size() )
+			return false;
+		unsigned int size = s[pos];
+		const double* block = size > 0 ? &s[ pos + 1 ] : 0;
+		pos += 1 + size;
+		char* data = ObjId( id, i ).data();
+		bool ok = true;
+		if ( className == "Ksolve" )
+			ok = reinterpret_cast< Ksolve* >( data )->setState( block, size );
+		else if ( className == "Gsolve" )
+			ok = reinterpret_cast< Gsolve* >( data )->setState( block, size );
+		else if ( className == "Dsolve" )
+			ok = reinterpret_cast< Dsolve* >( data )->setState( block, size );
+		else if ( className == "HSolve" )
+			ok = reinterpret_cast< HSolve* >( data )->setState( block, size );
+		else if ( className == "IntFire" )
+			ok = reinterpret_cast< IntFire* >( data )->setState( block, size );
+		else if ( className == "SynChan" )
+			ok = reinterpret_cast< SynChan* >( data )->setState( block, size );
+		else if ( className == "SpikeGen" )
+			ok = reinterpret_cast< SpikeGen* >( data )->setState( block, size );
+		else
+			Field< vector< double > >::set( ObjId( id, i ), "vector",
+				vector< double >( block, block + size ) );
+		if ( !ok )
+			return false;
+	}
+
+	unsigned int k = findStateFields( className );
+	if ( k < sizeof( stateFields ) / sizeof( stateFields[0] ) ) {
+		for ( unsigned int j = 1; j < 4 && stateFields[k][j]; ++j ) {
+			if ( pos + num > s.size() )
+				return false;
+			vector< double > val( s.begin() + pos, s.begin() + pos + num );
+			Field< double >::setVec( id, stateFields[k][j], val );
+			pos += num;
+		}
+	}
+	return pos == s.size();
+}
+
+/**
+ * Checks that setElementState would take s without changing anything.
+ * The solvers only take back blocks of the size they give out, so their
+ * blocks are compared with the current ones. A Table takes a vector of
+ * any size.
+ */
+static bool stateFits( Id id, const vector< double >& s )
+{
+	const Element* elm = id.element();
+	const string& className = elm->cinfo()->name();
+	unsigned int num = elm->numData();
+	vector< double > cur;
+	getElementState( id, cur );
+	unsigned int pos = 0;
+	unsigned int curPos = 0;
+	for ( unsigned int i = 0; hasStateBlocks( className ) && i < num; ++i ){
+		if ( pos >= s.size() || pos + 1 + s[pos] > s.size() )
+			return false;
+		if ( className != "Table" && s[pos] != cur[curPos] )
+			return false;
+		pos += 1 + s[pos];
+		curPos += 1 + cur[curPos];
+	}
+	return s.size() - pos == cur.size() - curPos;
+}
+
+bool Shell::doSaveCheckpoint( Id model, const string& fileName ) const
+{
+	if ( model.element() == 0 ) {
+		cout << "Warning: Shell::doSaveCheckpoint: no model to save\n";
+		return false;
+	}
+	ofstream fout( fileName.c_str(), ios::out | ios::binary );
+	if ( !fout ) {
+		cout << "Warning: Shell::doSaveCheckpoint: could not open file " <<
+			fileName << endl;
+		return false;
+	}
+	fout.write( CHECKPOINT_MAGIC, sizeof( CHECKPOINT_MAGIC ) );
+	writeUint( fout, CHECKPOINT_VERSION );
+
+	const Clock* clock = reinterpret_cast< const Clock* >(
+		Id( 1 ).eref().data() );
+	writeDouble( fout, clock->getDt() );
+	writeUint( fout, clock->getNumTicks() );
+	for ( unsigned int i = 0; i < clock->getNumTicks(); ++i )
+		writeUint( fout, clock->getTickStep( i ) );
+	writeUint( fout, clock->getCurrentStep() );
+
+	vector< unsigned long > rng( mtstatesize() );
+	mtgetstate( &rng[0] );
+	writeUint( fout, rng.size() );
+	for ( unsigned int i = 0; i < rng.size(); ++i )
+		writeUint( fout, rng[i] );
+
+	vector< Id > elms;
+	checkpointElements( model, elms );
+	writeUint( fout, elms.size() );
+	vector< double > state;
+	for ( vector< Id >::iterator i = elms.begin(); i != elms.end(); ++i ) {
+		const Element* elm = i->element();
+		if ( elm->cinfo()->isA( "SynHandler" ) &&
+			!hasStateBlocks( elm->cinfo()->name() ) )
+			cout << "Warning: Shell::doSaveCheckpoint: pending spikes of " <<
+				i->path() << " are not saved\n";
+		writeString( fout, i->path() );
+		writeString( fout, elm->cinfo()->name() );
+		writeUint( fout, elm->numData() );
+		writeUint( fout, elm->msgIn().size() );
+		state.resize( 0 );
+		getElementState( *i, state );
+		writeDoubles( fout, state );
+	}
+	if ( !fout.good() ) {
+		cout << "Warning: Shell::doSaveCheckpoint: failed to write " <<
+			fileName << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Shell::doRestoreCheckpoint( Id model, const string& fileName )
+{
+	ifstream fin( fileName.c_str(), ios::in | ios::binary );
+	if ( !fin || model.element() == 0 ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: could not open file "
+			<< fileName << endl;
+		return false;
+	}
+	CheckpointReader r( fin );
+	const char* magic = r.take( sizeof( CHECKPOINT_MAGIC ) );
+	if ( !magic || memcmp( magic, CHECKPOINT_MAGIC,
+		sizeof( CHECKPOINT_MAGIC ) ) != 0 ||
+		r.readUint() != CHECKPOINT_VERSION ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: " << fileName <<
+			" is not a checkpoint file\n";
+		return false;
+	}
+
+	double dt = r.readDouble();
+	vector< unsigned int > tickStep( r.readUint() );
+	for ( unsigned int i = 0; i < tickStep.size(); ++i )
+		tickStep[i] = r.readUint();
+	unsigned int currentStep = r.readUint();
+	vector< unsigned long > rng( r.readUint() );
+	for ( unsigned int i = 0; i < rng.size(); ++i )
+		rng[i] = r.readUint();
+
+	// Everything is read and checked before anything is changed.
+	vector< Id > elms;
+	checkpointElements( model, elms );
+	unsigned int numElms = r.readUint();
+	vector< vector< double > > state( numElms );
+	bool matches = ( numElms == elms.size() );
+	for ( unsigned int i = 0; r.ok() && i < numElms; ++i ) {
+		string path = r.readString();
+		string className = r.readString();
+		unsigned int numData = r.readUint();
+		unsigned int numMsgs = r.readUint();
+		r.readDoubles( state[i] );
+		if ( matches ) {
+			const Element* elm = elms[i].element();
+			matches = ( path == elms[i].path() &&
+				className == elm->cinfo()->name() &&
+				numData == elm->numData() &&
+				numMsgs == elm->msgIn().size() );
+		}
+	}
+	if ( !r.ok() ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: " << fileName <<
+			" is truncated\n";
+		return false;
+	}
+	if ( rng.size() != mtstatesize() ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: the random number " <<
+			"generator in " << fileName << " is not the one in use\n";
+		return false;
+	}
+	if ( !matches ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: the model at " <<
+			model.path() << " does not match the one in " << fileName <<
+			endl;
+		return false;
+	}
+
+	Clock* clock = reinterpret_cast< Clock* >( Id( 1 ).eref().data() );
+	if ( clock->isRunning() || clock->isDoingReinit() || 
+		tickStep.size() != clock->getNumTicks() || !( dt > 0.0 ) ) {
+		cout << "Warning: Shell::doRestoreCheckpoint: the clock in " <<
+			fileName << " cannot be restored now\n";
+		return false;
+	}
+	for ( unsigned int i = 0; i < numElms; ++i ) {
+		if ( !stateFits( elms[i], state[i] ) ) {
+			cout << "Warning: Shell::doRestoreCheckpoint: state of " <<
+				elms[i].path() << " does not fit\n";
+			return false;
+		}
+	}
+
+	clock->setDt( dt );
+	for ( unsigned int i = 0; i < tickStep.size(); ++i )
+		clock->setTickStep( i, tickStep[i] );
+	clock->restoreStep( currentStep );
+	mtsetstate( &rng[0] );
+
+	// stateFits has checked all of these, so none of them fails.
+	for ( unsigned int i = 0; i < numElms; ++i )
+		setElementState( elms[i], state[i] );
+	return true;
+}
@@ -7,6 +7,7 @@
 ** See the file COPYING.LIB for the full notice.
 **********************************************************************/
 
+#include <set>
 #include "header.h"
 #include "SingleMsg.h"
 #include "DiagonalMsg.h"
@@ -69,6 +70,14 @@ const Cinfo* Shell::initCinfo()
 	static DestFinfo handleCreate( "create", 
 			"create( class, parent, newElm, name, numData, isGlobal )",
 			new EpFunc6< Shell, string, ObjId, Id, string, NodeBalance, unsigned int >( &Shell::handleCreate ) );
+	static DestFinfo handleCreateMany( "createMany", 
+			"createMany( class, parent, newElms, names, nodeBalance, "
+			"parentMsgIndex ): Creates one Element for each name. The "
+			"parent-child messages take consecutive indices from "
+			"parentMsgIndex.",
+			new EpFunc6< Shell, string, ObjId, vector< Id >, 
+			vector< string >, NodeBalance, unsigned int >( 
+				&Shell::handleCreateMany ) );
 	static DestFinfo handleDelete( "delete", 
 			"Destroys Element, all its messages, and all its children. Args: Id",
 			new EpFunc1< Shell, Id >( & Shell::destroy ) );
@@ -106,6 +115,7 @@ const Cinfo* Shell::initCinfo()
 		// &master,
 		// &worker,
 		&handleCreate,
+		&handleCreateMany,
 		&handleDelete,
 		&handleCopy,
 		&handleMove,
@@ -213,6 +223,52 @@ Id Shell::doCreate( string type, ObjId parent, string name,
 	return Id();
 }
 
+vector< Id > Shell::doCreateMany( const string& type, ObjId parent,
+	const vector< string >& names,
+	NodePolicy nodePolicy, unsigned int preferredNode )
+{
+	vector< Id > ret;
+	if ( !Cinfo::find( type ) ) {
+		stringstream ss;
+		ss << "Shell::doCreateMany: Class '" << type << "' not known. No Elements created";
+		warning( ss.str() );
+		return ret;
+	}
+	if ( !parent.element() ) {
+		stringstream ss;
+		ss << "Shell::doCreateMany: Parent Element'" << parent << "' not found. No Elements created";
+		warning( ss.str() );
+		return ret;
+	}
+	vector< Id > kids;
+	Neutral::children( parent.eref(), kids );
+	set< string > taken;
+	for ( vector< Id >::iterator i = kids.begin(); i != kids.end(); ++i )
+		taken.insert( i->element()->getName() );
+	for ( vector< string >::const_iterator 
+		i = names.begin(); i != names.end(); ++i ) {
+		if ( i->find_first_of( "[] #?\"/\\" ) != string::npos ||
+			!taken.insert( *i ).second ) {
+			stringstream ss;
+			ss << "Shell::doCreateMany: bad or duplicate name '" << *i <<
+				"' under '" << parent.path() << "'. No Elements created";
+			warning( ss.str() );
+			return ret;
+		}
+	}
+	if ( names.size() == 0 )
+		return ret;
+
+	for ( unsigned int i = 0; i < names.size(); ++i )
+		ret.push_back( Id::nextId() );
+	NodeBalance nb( 1, nodePolicy, preferredNode );
+	unsigned int parentMsgIndex = OneToAllMsg::numMsg();
+	SetGet6< string, ObjId, vector< Id >, vector< string >, NodeBalance, 
+		unsigned int >::set( ObjId(), "createMany",
+		type, parent, ret, names, nb, parentMsgIndex );
+	return ret;
+}
+
 bool Shell::doDelete( Id id )
 {
 	SetGet1< Id >::set( ObjId(), "delete", id );
@@ -610,6 +666,15 @@ void Shell::handleCreate( const Eref& e,
 }
 
 
+void Shell::handleCreateMany( const Eref& e,
+	string type, ObjId parent, vector< Id > newElms, vector< string > names,
+	NodeBalance nb, unsigned int parentMsgIndex )
+{
+	assert( newElms.size() == names.size() );
+	for ( unsigned int i = 0; i < newElms.size(); ++i )
+		innerCreate( type, parent, newElms[i], names[i], nb, 
+			parentMsgIndex + i );
+}
 
 /**
  * Static utility function. Attaches child element to parent element.
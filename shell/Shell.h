@@ -80,6 +80,21 @@ class Shell
 				NodePolicy nodePolicy = MooseBlockBalance,
 				unsigned int preferredNode = 1 );
 
+		/**
+		 * Creates one single-entry Element of the given class for
+		 * each name, all under the same parent, in one call. The names
+		 * are checked against each other and against the existing
+		 * children in one pass, so this takes time in proportion to
+		 * the number of objects, whereas calling doCreate for each
+		 * takes time in proportion to its square. Returns the new Ids
+		 * in the order of the names, or an empty vector without making
+		 * anything if any name is bad or taken.
+		 */
+		vector< Id > doCreateMany( const string& type, ObjId parent,
+				const vector< string >& names,
+				NodePolicy nodePolicy = MooseBlockBalance,
+				unsigned int preferredNode = 1 );
+
 		/**
 		 * Delete specified Element and all its children and all 
 		 * Msgs connected to it.
@@ -201,6 +216,29 @@ class Shell
 		 */
 		 void doSaveModel( Id model, const string& fileName, 
 			 bool qflag = 0 ) const;
+
+		/**
+		 * Saves the run time state of the model and of the clock to a
+		 * binary checkpoint file. This covers the pools and voxels of
+		 * the Ksolve, Gsolve and Dsolve, the HSolve, the random number
+		 * streams of the solvers and the global one behind mtrand,
+		 * Tables, the spikes waiting in the synaptic buffers of
+		 * IntFires and SynChans, the last spikes of IntFires and
+		 * SpikeGens, and the state variables of objects outside
+		 * solvers. The structure of the model is
+		 * recorded so that it can be checked on restore, but not the
+		 * parameters, which come from the model script.
+		 * Returns true on success.
+		 */
+		 bool doSaveCheckpoint( Id model, const string& fileName ) const;
+
+		/**
+		 * Restores the state saved by doSaveCheckpoint onto a model
+		 * built by the same script. Call it after doReinit, and then
+		 * carry on with doStart. Nothing is changed if the model does
+		 * not match the file. Returns true on success.
+		 */
+		 bool doRestoreCheckpoint( Id model, const string& fileName );
 		
 		/**
 		 * Write given model to SBML file. Returns success value.
@@ -286,6 +324,11 @@ class Shell
 		void handleCreate( const Eref& e,
 			string type, ObjId parent, Id newElm, string name,
 			NodeBalance nb, unsigned int parentMsgIndex );
+		/// Creates the Elements for doCreateMany, on all nodes.
+		void handleCreateMany( const Eref& e,
+			string type, ObjId parent, vector< Id > newElms,
+			vector< string > names,
+			NodeBalance nb, unsigned int parentMsgIndex );
 		void destroy( const Eref& e, Id eid);
 
 		/**
@@ -757,6 +757,61 @@ void testShellSetGet()
 	cout << "." << flush;
 }
 
+/**
+ * Tests the bulk calls used by the model loaders: doCreateMany makes
+ * one Element per name under the parent, and setMany assigns a column
+ * of values to many objects. The last of these is Global, so setMany
+ * has to send its value to every node rather than set it here.
+ */
+void testShellCreateMany()
+{
+	Eref sheller = Id().eref();
+	Shell* shell = reinterpret_cast< Shell* >( sheller.data() );
+	const unsigned int size = 10;
+
+	Id pa = shell->doCreate( "Neutral", Id(), "pa", 1 );
+	Id old = shell->doCreate( "Arith", pa, "a0", 1, MooseGlobal );
+	vector< string > names;
+	for ( unsigned int i = 1; i <= size; ++i ) {
+		stringstream ss;
+		ss << "a" << i;
+		names.push_back( ss.str() );
+	}
+	vector< Id > ids = shell->doCreateMany( "Arith", pa, names );
+	assert( ids.size() == size );
+	for ( unsigned int i = 0; i < size; ++i ) {
+		assert( ids[i].element()->getName() == names[i] );
+		assert( ids[i].element()->cinfo()->name() == "Arith" );
+		assert( Neutral::parent( ids[i].eref() ).id == pa );
+		assert( Neutral::child( pa.eref(), names[i] ) == ids[i] );
+	}
+	vector< Id > kids;
+	Neutral::children( pa.eref(), kids );
+	assert( kids.size() == size + 1 );
+
+	if ( TEST_WARNING ) {
+		// Should fail, as a0 is already there.
+		cout << "\nTesting warning for bulk creation with existing name: ";
+		names.push_back( "a0" );
+		assert( shell->doCreateMany( "Arith", pa, names ).size() == 0 );
+	}
+
+	vector< ObjId > dest( ids.begin(), ids.end() );
+	dest.push_back( old );
+	vector< double > val;
+	for ( unsigned int i = 0; i <= size; ++i )
+		val.push_back( i * i );
+	bool ret = Field< double >::setMany( dest, "outputValue", val );
+	assert( ret );
+	for ( unsigned int i = 0; i <= size; ++i ) {
+		double x = Field< double >::get( dest[i], "outputValue" );
+		assert( doubleEq( x, i * i ) );
+	}
+
+	shell->doDelete( pa );
+	cout << "." << flush;
+}
+
 bool checkArg1( Id id, 
 	double v0, double v1, double v2, double v3, double v4 )
 {
@@ -1842,6 +1897,7 @@ void testMpiShell( )
 	// testMultiLevelCopyAndPath(); // Uses HH channels.
 
 	testShellSetGet();
+	testShellCreateMany();
 	testInterNodeOps();
 	testShellAddMsg();
 	testCopyMsgOps();